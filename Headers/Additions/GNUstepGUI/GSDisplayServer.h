@@ -197,6 +197,10 @@ APPKIT_EXPORT_CLASS
 - (void) discardEventsMatchingMask: (unsigned)mask
 		       beforeEvent: (NSEvent*)limit;
 - (void) postEvent: (NSEvent*)anEvent atStart: (BOOL)flag;
+- (void) setCoalescesEvents: (BOOL)flag;
+- (BOOL) coalescesEvents;
+- (NSDictionary *) eventQueueStatistics;
+- (void) resetEventQueueStatistics;
 - (void) _printEventQueue;
 @end
 
@@ -78,6 +78,12 @@ APPKIT_EXPORT_CLASS
   int lineFragmentCount, lineFragmentCapacity;
 }
 
+/*
+Returns the shared instance of the current thread. Each thread has its own,
+so layout in different threads doesn't contend for it. A typesetter that is
+called while it is busy (reentrantly, or from another thread) hands the call
+to a spare instance; spare instances are kept for reuse.
+*/
 +(GSHorizontalTypesetter *) sharedInstance;
 
 @end
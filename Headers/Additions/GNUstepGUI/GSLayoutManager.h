@@ -69,6 +69,7 @@ APPKIT_EXPORT_CLASS
   id _delegate;
 
   BOOL usesScreenFonts;
+  BOOL usesFontLeading;
   BOOL backgroundLayoutEnabled;
   BOOL showsInvisibleCharacters;
   BOOL showsControlCharacters;
@@ -111,6 +112,15 @@ how it's supposed to work. It's functional and correct, but it isn't fast. */
   */
   struct GSLayoutManager_glyph_run_s *cached_run;
   unsigned int cached_pos, cached_cpos;
+
+  /* YES while a slice of background layout is scheduled. */
+  BOOL background_layout_pending;
+
+  /* YES if typesetter is the system typesetter, in which case the system
+  typesetter of the current thread is used for layout. */
+  BOOL usesSystemTypesetter;
+
+  BOOL parallelLayoutEnabled;
 }
 
 
@@ -125,13 +135,39 @@ how it's supposed to work. It's functional and correct, but it isn't fast. */
 - (void) setDelegate: (id)aDelegate;
 
 
+/*
+If the typesetter is the system typesetter, -typesetter returns the system
+typesetter of the calling thread.
+
+Layout in other threads: a layout manager whose text containers don't have
+text views can be used, with its text storage, from any thread as long as
+only one thread at a time uses them. With the system typesetter, each thread
+lays out with its own typesetter, so layout managers in different threads
+can lay out concurrently. Background layout, if enabled, runs in the run
+loop of the thread that invalidated the layout.
+*/
 -(GSTypesetter *) typesetter;
 -(void) setTypesetter: (GSTypesetter *)typesetter;
 
 
+/*
+If enabled (it is disabled by default), text that hasn't been laid out yet
+is laid out in short slices from the current run loop after each change, and
+-usedRectForTextContainer: no longer causes layout.
+*/
 - (void) setBackgroundLayoutEnabled: (BOOL)flag;
 - (BOOL) backgroundLayoutEnabled;
 
+/*
+If enabled (it is disabled by default), laying out a long text in a single
+simple rectangular text container with the system typesetter lays out
+chunks of paragraphs concurrently in worker threads, and then stacks up
+their line frags. This is a GNUstep extension. Glyphs are generated and
+typeset in the worker threads, so the font backend must be thread safe.
+*/
+- (void) setParallelLayoutEnabled: (BOOL)flag;
+- (BOOL) parallelLayoutEnabled;
+
 - (void) setShowsInvisibleCharacters: (BOOL)flag;
 - (BOOL) showsInvisibleCharacters;
 
@@ -151,6 +187,14 @@ how it's supposed to work. It's functional and correct, but it isn't fast. */
 - (BOOL) usesScreenFonts;
 - (void) setUsesScreenFonts: (BOOL)flag;
 
+/*
+If YES (the default), lines are at least as high as the default line height
+of their font, which includes its leading. Otherwise lines are only as high
+as the ascender and descender of their glyphs.
+*/
+- (BOOL) usesFontLeading;
+- (void) setUsesFontLeading: (BOOL)flag;
+
 - (NSFont *) substituteFontForFont: (NSFont *)originalFont;
 
 
@@ -395,6 +439,10 @@ layout information.
 -(unsigned int) _softInvalidateFirstGlyphInTextContainer: (NSTextContainer *)textContainer;
 -(unsigned int) _softInvalidateNumberOfLineFragsInTextContainer: (NSTextContainer *)textContainer;
 
+/* Returns the number of lines laid out in textContainer so far. Line frags
+on the same baseline make up one line. */
+-(unsigned int) _numberOfLinesInTextContainer: (NSTextContainer *)textContainer;
+
 @end
 
 
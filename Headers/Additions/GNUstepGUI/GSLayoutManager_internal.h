@@ -162,6 +162,13 @@ typedef struct
 
   linefrag_attachment_t *attachments;
   int num_attachments;
+
+  /*
+  YES for a line frag that stands in for text that hasn't been laid out yet
+  with non-contiguous layout. It has an estimated height and a single point
+  for all its glyphs, and its glyphs are never drawn.
+  */
+  BOOL estimated;
 } linefrag_t;
 
 typedef struct GSLayoutManager_textcontainer_s
@@ -194,6 +201,14 @@ typedef struct GSLayoutManager_textcontainer_s
   int num_soft;
   int size_linefrags;
 
+  /*
+  The number of estimated line frags among the num_linefrags first, so
+  that -hasNonContiguousLayout doesn't have to look at every line frag.
+  It is updated wherever line frags are added, freed, soft invalidated
+  or taken back into use.
+  */
+  int num_estimated;
+
   /*
   Keep some per-textcontainer info that's expensive to calculate and often
   requested here.
@@ -203,9 +218,81 @@ typedef struct GSLayoutManager_textcontainer_s
   */
   NSRect usedRect;
   BOOL usedRectValid;
+
+  /*
+  The number of line frags usedRect covers. Since line frags are only ever
+  added at the end, the rect can be extended as layout proceeds (which is
+  what makes it cheap to ask for during background layout).
+  */
+  int usedRectLineFrags;
 } textcontainer_t;
 
 
+/*
+The line frags of a text container are kept in glyph order, and since the
+typesetter fills a text container from the top down, in vertical order as
+well. Thus the array is its own index: these binary searches find line
+frags in O(log n), and there's nothing extra to keep up to date when line
+frags are added or soft invalidated layout is taken into use.
+*/
+
+/* Returns the number of estimated line frags among count line frags. */
+static inline int
+linefrags_estimated(linefrag_t *lf, int count)
+{
+  int n = 0;
+
+  for (; count > 0; count--, lf++)
+    if (lf->estimated)
+      n++;
+  return n;
+}
+
+/* Returns the index of the line frag in tc containing glyph, or -1. */
+static inline int
+linefrag_index_for_glyph(textcontainer_t *tc, unsigned int glyph)
+{
+  int lo, hi, mid;
+  linefrag_t *lf = tc->linefrags;
+
+  if (!tc->num_linefrags
+      || glyph < lf->pos
+      || glyph >= lf[tc->num_linefrags - 1].pos + lf[tc->num_linefrags - 1].length)
+    return -1;
+
+  for (lo = 0, hi = tc->num_linefrags - 1; lo < hi;)
+    {
+      mid = (lo + hi) / 2;
+      if (lf[mid].pos > glyph)
+	hi = mid - 1;
+      else if (lf[mid].pos + lf[mid].length <= glyph)
+	lo = mid + 1;
+      else
+	lo = hi = mid;
+    }
+  return lo;
+}
+
+/* Returns the index of the first line frag in tc that reaches below y, or
+tc->num_linefrags if there is none. */
+static inline int
+linefrag_index_for_y(textcontainer_t *tc, CGFloat y)
+{
+  int lo, hi, mid;
+  linefrag_t *lf = tc->linefrags;
+
+  for (lo = 0, hi = tc->num_linefrags; lo < hi;)
+    {
+      mid = (lo + hi) / 2;
+      if (NSMaxY(lf[mid].rect) > y)
+	hi = mid;
+      else
+	lo = mid + 1;
+    }
+  return lo;
+}
+
+
 
 @interface GSLayoutManager (GlyphsHelpers)
 
@@ -241,9 +328,31 @@ typedef struct GSLayoutManager_textcontainer_s
 
 -(void) _doLayout; /* TODO: this is just a hack until proper incremental layout is done */
 -(void) _doLayoutToGlyph: (unsigned int)glyphIndex;
+-(void) _doLayoutForGlyphRange: (NSRange)glyphRange;
 -(void) _doLayoutToContainer: (int)cindex;
+-(void) _doLayoutToContainer: (int)cindex  maxY: (CGFloat)y;
+-(int) _layoutLineFragsInContainer: (int)i  count: (unsigned int)howMany;
+
+/* Non-contiguous layout. Subclasses decide when it is used. */
+-(BOOL) _usesNonContiguousLayout;
+-(void) _doNonContiguousLayoutToGlyph: (unsigned int)glyphIndex;
+-(void) _doNonContiguousLayoutInRect: (NSRect)rect;
+-(void) _fillEstimatedLineFrag: (int)k
+		     fromGlyph: (unsigned int)first
+		       toGlyph: (unsigned int)last
+			  maxY: (CGFloat)y;
+-(CGFloat) _estimatedHeightOfRemainingText;
+
+-(BOOL) _usesParallelLayout;
+-(void) _doParallelLayoutInContainer: (int)i;
 
 -(void) _didInvalidateLayout;
+
+-(void) _scheduleBackgroundLayout;
+-(void) _cancelBackgroundLayout;
+/* Called after a slice of background layout with the index of the first
+text container that was not completely laid out before it. */
+-(void) _didLayoutInBackgroundFromContainer: (int)idx;
 @end
 
 
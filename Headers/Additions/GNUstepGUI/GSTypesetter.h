@@ -55,7 +55,8 @@ GSTypesetter's implementation returns NSMakeSize(0,0).
 
 /*
 Returns a thread-safe shared GSTypesetter (a GSHorizontalTypesetter
-instance in practice, at least when this is done).
+instance in practice, at least when this is done). Each thread gets its own
+instance.
 */
 +(GSTypesetter *) sharedSystemTypesetter;
 
@@ -268,6 +268,12 @@ APPKIT_EXPORT_CLASS
 
 @interface NSBitmapImageRep (GNUstepExtension)
 + (NSArray*) imageRepsWithFile: (NSString *)filename;
+#if OS_API_VERSION(GS_API_NONE, GS_API_NONE)
++ (id) imageRepWithData: (NSData*)imageData
+	   maxPixelSize: (NSUInteger)maxSize;
+- (id) initWithData: (NSData*)imageData
+       maxPixelSize: (NSUInteger)maxSize;
+#endif
 @end
 
 #endif // _GNUstep_H_NSBitmapImageRep
@@ -453,6 +453,12 @@ APPKIT_EXPORT_CLASS
   NSMapTable *_registeredNibs;
   NSMapTable *_registeredClasses;
 
+  // Items scrolled out of sight, kept for reuse by identifier
+  NSMutableDictionary *_reuseQueues;
+
+  // Layout attributes of all items, from the last layout pass
+  id _layoutCache;
+
   // Selection management...
   BOOL _allowsMultipleSelection;
   BOOL _isSelectable;
@@ -514,6 +514,18 @@ APPKIT_EXPORT_CLASS
 		      inRect: (NSRect)aRect;
 
 @end
+
+/**
+ * Returns counters of the cache of tinted masks used to draw template
+ * images: the masks kept (Entries), and the draws which found a mask
+ * (Hits) or had to draw one (Misses).
+ */
+APPKIT_EXPORT NSDictionary *GSImageTemplateCacheStatistics(void);
+
+/**
+ * Resets the hit and miss counters of the template image cache.
+ */
+APPKIT_EXPORT void GSImageResetTemplateCacheStatistics(void);
 #endif
 
 #endif // _GNUstep_H_NSImage
@@ -36,6 +36,7 @@
 #import <AppKit/NSMenuItem.h>
 #import <AppKit/AppKitDefines.h>
 
+@class NSDictionary;
 @class NSString;
 @class NSEvent;
 @class NSFont;
@@ -765,6 +766,17 @@ APPKIT_EXPORT_CLASS
  */
 @interface NSMenu (GNUstepExtra)
 
+/** Returns counters of the validation of menu items since the counters
+ *  were last reset: the number of items validated (Validations), of menus
+ *  updated (Updates), the time in seconds (Seconds) and the number of
+ *  items validated per second (ValidationsPerSecond).
+ */
++ (NSDictionary *) validationStatistics;
+
+/** Sets the counters returned by +validationStatistics back to zero.
+ */
++ (void) resetValidationStatistics;
+
 /** Remove the window from the screen.  This method can/should be
  *  used by the menurepresentation to remove a submenu from the screen.
  */
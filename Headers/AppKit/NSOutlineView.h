@@ -33,6 +33,7 @@
 
 #import <AppKit/NSTableView.h>
 
+@class NSHashTable;
 @class NSMapTable;
 @class NSMutableArray;
 @class NSString;
@@ -42,9 +43,8 @@ APPKIT_EXPORT_CLASS
 @interface NSOutlineView : NSTableView
 {
   NSMapTable *_itemDict;
-  NSMutableArray *_items;
-  NSMutableArray *_expandedItems;
-  NSMapTable *_levelOfItems;
+  void *_itemTree;
+  NSHashTable *_expandedItems;
   BOOL _autoResizesOutlineColumn;
   BOOL _indentationMarkerFollowsCell;
   BOOL _autosaveExpandedItems;
@@ -49,7 +49,8 @@ typedef enum
     NSStringDrawingUsesFontLeading=0x02,
     NSStringDrawingDisableScreenFontSubstitution=0x04,
     NSStringDrawingUsesDeviceMetrics=0x08,
-    NSStringDrawingOneShot=0x10
+    NSStringDrawingOneShot=0x10,
+    NSStringDrawingTruncatesLastVisibleLine=0x20
 } NSStringDrawingOptions;
 #endif
 
@@ -68,6 +69,19 @@ typedef enum
            attributes: (NSDictionary *)attributes;
 #endif
 
+#if OS_API_VERSION(GS_API_NONE, GS_API_NONE)
+/**
+ * Like -boundingRectWithSize:options:attributes:, but stops laying out the
+ * string after the given number of lines, so measuring the first lines of
+ * a long string doesn't lay out all of it.  Passing 0 doesn't limit the
+ * number of lines.
+ */
+- (NSRect) boundingRectWithSize: (NSSize)size
+                        options: (NSStringDrawingOptions)options
+                     attributes: (NSDictionary *)attributes
+           maximumNumberOfLines: (NSUInteger)lines;
+#endif
+
 @end
 
 @interface NSAttributedString (NSStringDrawing)
@@ -83,8 +97,48 @@ typedef enum
               options: (NSStringDrawingOptions)options;
 #endif
 
+#if OS_API_VERSION(GS_API_NONE, GS_API_NONE)
+/**
+ * Like -boundingRectWithSize:options:, but stops laying out the string
+ * after the given number of lines.  Passing 0 doesn't limit the number of
+ * lines.
+ */
+- (NSRect) boundingRectWithSize: (NSSize)size
+                        options: (NSStringDrawingOptions)options
+           maximumNumberOfLines: (NSUInteger)lines;
+#endif
+
 @end
 
+#if OS_API_VERSION(GS_API_NONE, GS_API_NONE)
+/**
+ * Sets the number of laid out strings the string drawing methods keep in
+ * the cache of each thread.  The default is 64, or the value of the
+ * GSStringDrawingCacheSize user default; passing 0 restores 64.  The
+ * cache of a thread is recreated with the new size the next time the
+ * thread draws or measures a string.
+ */
+APPKIT_EXPORT void GSStringDrawingSetCacheSize(NSUInteger entries);
+
+/**
+ * Returns the number of laid out strings kept in the cache of each thread.
+ */
+APPKIT_EXPORT NSUInteger GSStringDrawingCacheSize(void);
+
+/**
+ * Returns counters of the string drawing cache of the current thread:
+ * the number of lookups (Total), the lookups finding a laid out string
+ * (Hits) or not (Misses), the entries whose hash matched (HashHits), and
+ * the strings measured without laying them out (FastPath).
+ */
+APPKIT_EXPORT NSDictionary *GSStringDrawingCacheStatistics(void);
+
+/**
+ * Resets the counters of the string drawing cache of the current thread.
+ */
+APPKIT_EXPORT void GSStringDrawingResetCacheStatistics(void);
+#endif
+
 #else
 @class NSAttributedString;
 #endif
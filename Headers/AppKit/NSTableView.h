@@ -208,6 +208,18 @@ APPKIT_EXPORT_CLASS
 
   /* NSTableRowView support */
   NSMutableDictionary *_rowViews;
+
+  /* Views of rows scrolled out of sight, kept for reuse: cell views by
+     identifier, and the row views the table made itself */
+  NSMutableDictionary *_reuseQueues;
+  NSMutableArray *_reusableRowViews;
+
+  /* Heights of the rows given by the delegate, and a Fenwick tree of
+     their sums */
+  CGFloat *_rowHeights;
+  CGFloat *_rowHeightSums;
+  NSInteger _rowHeightsCount;
+  BOOL _rowHeightsValid;
 }
 
 /* Data Source */
@@ -99,6 +99,7 @@ APPKIT_EXPORT_CLASS
 
   NSRect _containerRect;
   CGFloat _lineFragmentPadding;
+  NSUInteger _maximumNumberOfLines;
 
   BOOL _observingFrameChanges;
   BOOL _widthTracksTextView;
@@ -264,6 +265,18 @@ a line fragment rectangle by the standard typesetter. The default is 0.0.
 - (void) setLineFragmentPadding: (CGFloat)aFloat;
 - (CGFloat) lineFragmentPadding;
 
+#if OS_API_VERSION(MAC_OS_X_VERSION_10_11, GS_API_LATEST)
+/**
+Maximum number of lines<br />
+
+The standard typesetter stops filling the text container once it holds
+this many lines, as if it were full. Line fragments on the same baseline
+count as one line. The default, 0, means no limit.
+*/
+- (void) setMaximumNumberOfLines: (NSUInteger)lines;
+- (NSUInteger) maximumNumberOfLines;
+#endif
+
 @end
 
 #else
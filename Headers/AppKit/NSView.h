@@ -149,6 +149,10 @@ PACKAGE_SCOPE
 PACKAGE_SCOPE
   NSMutableArray *_tracking_rects;
   NSMutableArray *_cursor_rects;
+  void *_invalidRegion;  /* The rects making up _invalidRect */
+  NSRect _pendingInvalidRect;  /* Marked by other threads, not yet drained */
+  NSView *_nextPendingView;
+  int _pendingLock;
 @protected
   NSRect _invalidRect;
   NSRect _visibleRect;
@@ -280,6 +280,8 @@ PACKAGE_SCOPE
 PACKAGE_SCOPE
   NSRect        _rectNeedingFlush;
   NSMutableArray *_rectsBeingDrawn;
+  id            _trackingIndex;
+  id            _cursorIndex;
 @protected
   unsigned	_disableFlushWindow;
   
@@ -30,11 +30,14 @@
 #define _GS_BINDING_HELPER_H
 
 #import <Foundation/NSObject.h>
+#import <Foundation/NSKeyValueObserving.h>
 
 @class NSString;
 @class NSDictionary;
 @class NSMutableDictionary;
 @class NSArray;
+@class NSIndexSet;
+@class NSMutableArray;
 
 @interface GSKeyValueBinding : NSObject
 {
@@ -80,10 +83,29 @@
 @interface GSKeyValueAndBinding : GSKeyValueBinding 
 @end
 
+/* Informal protocol for objects with a to-many binding which can update
+ * the indexes named in an insertion, removal or replacement change instead
+ * of reloading the whole value.  Returns NO when the object needs the whole
+ * value set as usual.
+ */
+@interface NSObject (GSIndexedBindingUpdate)
+- (BOOL) _updateBinding: (NSString *)binding
+                 change: (NSKeyValueChange)kind
+              atIndexes: (NSIndexSet *)indexes;
+@end
+
 @interface GSObservableArray : NSArray
 {
-  NSArray *_array;
+  NSMutableArray *_array;
+  NSMutableArray *_observations;
 }
+
+/* Change the array in place.  Observers added to the elements through the
+ * array are added to inserted objects and removed from removed ones.  The
+ * owner sends the KVO change notifications.
+ */
+- (void) _insertObjects: (NSArray *)objects atIndexes: (NSIndexSet *)indexes;
+- (void) _removeObjectsAtIndexes: (NSIndexSet *)indexes;
 @end
 
 #endif //_GS_BINDING_HELPER_H
@@ -0,0 +1,92 @@
+/*
+   GSBitmapKernels.h
+
+   Row kernels for premultiplying and converting bitmap image data.
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of the GNUstep GUI Library.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; see the file COPYING.LIB.
+   If not, see <http://www.gnu.org/licenses/> or write to the
+   Free Software Foundation, 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef _GNUstep_H_GSBitmapKernels
+#define _GNUstep_H_GSBitmapKernels
+
+#import <Foundation/NSObjCRuntime.h>
+
+/* Each kernel works on one row of n pixels.  Meshed rows hold the spp
+ * samples of each pixel next to each other with no padding, planar rows
+ * are given as an array of spp pointers, one into each plane.  Sixteen
+ * bit samples are in host byte order.  The alpha sample of a pixel is at
+ * index ai.  Where SSE2 or NEON is available the common four sample cases
+ * use it, other cases use portable code giving the same results.
+ */
+
+/* Multiply the colour samples by alpha, or divide them by it, rounding
+ * the way -[NSBitmapImageRep _premultiply] always has.
+ */
+void GSPremultiplyRow8(unsigned char *row, NSInteger n,
+  NSInteger spp, NSInteger ai);
+void GSUnpremultiplyRow8(unsigned char *row, NSInteger n,
+  NSInteger spp, NSInteger ai);
+void GSPremultiplyRow16(unsigned short *row, NSInteger n,
+  NSInteger spp, NSInteger ai);
+void GSUnpremultiplyRow16(unsigned short *row, NSInteger n,
+  NSInteger spp, NSInteger ai);
+void GSPremultiplyPlanarRow8(unsigned char **rows, NSInteger n,
+  NSInteger spp, NSInteger ai);
+void GSUnpremultiplyPlanarRow8(unsigned char **rows, NSInteger n,
+  NSInteger spp, NSInteger ai);
+void GSPremultiplyPlanarRow16(unsigned short **rows, NSInteger n,
+  NSInteger spp, NSInteger ai);
+void GSUnpremultiplyPlanarRow16(unsigned short **rows, NSInteger n,
+  NSInteger spp, NSInteger ai);
+
+/* Move the alpha sample of meshed pixels from the last place to the first
+ * (RGBA to ARGB) or back, in place.
+ */
+void GSAlphaFirstRow8(unsigned char *row, NSInteger n, NSInteger spp);
+void GSAlphaLastRow8(unsigned char *row, NSInteger n, NSInteger spp);
+void GSAlphaFirstRow16(unsigned short *row, NSInteger n, NSInteger spp);
+void GSAlphaLastRow16(unsigned short *row, NSInteger n, NSInteger spp);
+
+/* Scale count samples between eight and sixteen bits. */
+void GSWidenRow8To16(const unsigned char *src, unsigned short *dst,
+  NSInteger count);
+void GSNarrowRow16To8(const unsigned short *src, unsigned char *dst,
+  NSInteger count);
+
+/* Copy meshed gray pixels, with alpha last if alpha is YES, to meshed RGB
+ * pixels with alpha last.
+ */
+void GSGrayToRGBRow8(const unsigned char *src, unsigned char *dst,
+  NSInteger n, BOOL alpha);
+void GSGrayToRGBRow16(const unsigned short *src, unsigned short *dst,
+  NSInteger n, BOOL alpha);
+
+/* Copy planar pixels to meshed ones (mesh) or back (unmesh). */
+void GSMeshRow8(unsigned char **rows, unsigned char *dst,
+  NSInteger n, NSInteger spp);
+void GSUnmeshRow8(const unsigned char *src, unsigned char **rows,
+  NSInteger n, NSInteger spp);
+void GSMeshRow16(unsigned short **rows, unsigned short *dst,
+  NSInteger n, NSInteger spp);
+void GSUnmeshRow16(const unsigned short *src, unsigned short **rows,
+  NSInteger n, NSInteger spp);
+
+#endif /* _GNUstep_H_GSBitmapKernels */
@@ -0,0 +1,727 @@
+/*
+   GSBitmapKernels.m
+
+   Row kernels for premultiplying and converting bitmap image data.
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of the GNUstep GUI Library.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; see the file COPYING.LIB.
+   If not, see <http://www.gnu.org/licenses/> or write to the
+   Free Software Foundation, 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#import "config.h"
+#import "GSBitmapKernels.h"
+
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define	GS_SSE2	1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define	GS_NEON	1
+#endif
+
+/* a * v / 255, rounded as NSBitmapImageRep always has. */
+static inline unsigned char
+mul255(unsigned a, unsigned v)
+{
+  unsigned t = a * v + 0x80;
+
+  return ((t >> 8) + t) >> 8;
+}
+
+/* 255 * 65536 / a rounded up, so that (v * recip[a]) >> 16 is exactly
+ * v * 255 / a rounded down for every eight bit v.  Worked out ahead, so
+ * that threads can share it without setting it up.
+ */
+static const unsigned	recip8[256] = {
+  0, 16711680, 8355840, 5570560, 4177920, 3342336, 2785280, 2387383,
+  2088960, 1856854, 1671168, 1519244, 1392640, 1285514, 1193692, 1114112,
+  1044480, 983040, 928427, 879563, 835584, 795795, 759622, 726595,
+  696320, 668468, 642757, 618952, 596846, 576265, 557056, 539087,
+  522240, 506415, 491520, 477477, 464214, 451668, 439782, 428505,
+  417792, 407602, 397898, 388644, 379811, 371371, 363298, 355568,
+  348160, 341055, 334234, 327680, 321379, 315315, 309476, 303849,
+  298423, 293188, 288133, 283249, 278528, 273962, 269544, 265265,
+  261120, 257103, 253208, 249429, 245760, 242199, 238739, 235376,
+  232107, 228928, 225834, 222823, 219891, 217035, 214253, 211541,
+  208896, 206318, 203801, 201346, 198949, 196608, 194322, 192089,
+  189906, 187772, 185686, 183645, 181649, 179696, 177784, 175913,
+  174080, 172286, 170528, 168805, 167117, 165463, 163840, 162250,
+  160690, 159159, 157658, 156184, 154738, 153319, 151925, 150556,
+  149212, 147891, 146594, 145319, 144067, 142835, 141625, 140435,
+  139264, 138114, 136981, 135868, 134772, 133694, 132633, 131589,
+  130560, 129548, 128552, 127571, 126604, 125652, 124715, 123791,
+  122880, 121984, 121100, 120228, 119370, 118523, 117688, 116865,
+  116054, 115253, 114464, 113685, 112917, 112159, 111412, 110674,
+  109946, 109227, 108518, 107818, 107127, 106444, 105771, 105105,
+  104448, 103800, 103159, 102526, 101901, 101283, 100673, 100070,
+  99475, 98886, 98304, 97730, 97161, 96600, 96045, 95496,
+  94953, 94417, 93886, 93362, 92843, 92330, 91823, 91321,
+  90825, 90334, 89848, 89368, 88892, 88422, 87957, 87496,
+  87040, 86590, 86143, 85701, 85264, 84831, 84403, 83979,
+  83559, 83143, 82732, 82324, 81920, 81521, 81125, 80733,
+  80345, 79961, 79580, 79203, 78829, 78459, 78092, 77729,
+  77369, 77013, 76660, 76310, 75963, 75619, 75278, 74941,
+  74606, 74275, 73946, 73620, 73297, 72977, 72660, 72345,
+  72034, 71724, 71418, 71114, 70813, 70514, 70218, 69924,
+  69632, 69344, 69057, 68773, 68491, 68211, 67934, 67659,
+  67386, 67116, 66847, 66581, 66317, 66055, 65795, 65536
+};
+
+static inline unsigned char
+unpremultiply8(unsigned v, unsigned a)
+{
+  unsigned c = (v * recip8[a]) >> 16;
+
+  return (c >= 255) ? 255 : c;
+}
+
+static inline unsigned short
+unpremultiply16(unsigned v, unsigned a)
+{
+  unsigned c = (v * 65535U) / a;
+
+  return (c >= 65535) ? 65535 : c;
+}
+
+void
+GSPremultiplyRow8(unsigned char *row, NSInteger n, NSInteger spp,
+  NSInteger ai)
+{
+  NSInteger x = 0;
+  NSInteger i;
+
+#if GS_SSE2
+  if (spp == 4 && (ai == 0 || ai == 3))
+    {
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i half = _mm_set1_epi16(0x80);
+      const __m128i keep = (ai == 0)
+	? _mm_set_epi16(0, 0, 0, -1, 0, 0, 0, -1)
+	: _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+
+      for (; x + 4 <= n; x += 4)
+	{
+	  __m128i p = _mm_loadu_si128((__m128i*)(row + x * 4));
+	  __m128i lo = _mm_unpacklo_epi8(p, zero);
+	  __m128i hi = _mm_unpackhi_epi8(p, zero);
+	  __m128i alo;
+	  __m128i ahi;
+	  __m128i t;
+
+	  if (ai == 0)
+	    {
+	      alo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, 0x00), 0x00);
+	      ahi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, 0x00), 0x00);
+	    }
+	  else
+	    {
+	      alo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, 0xff), 0xff);
+	      ahi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, 0xff), 0xff);
+	    }
+	  t = _mm_add_epi16(_mm_mullo_epi16(lo, alo), half);
+	  t = _mm_srli_epi16(_mm_add_epi16(_mm_srli_epi16(t, 8), t), 8);
+	  lo = _mm_or_si128(_mm_and_si128(keep, lo), _mm_andnot_si128(keep, t));
+	  t = _mm_add_epi16(_mm_mullo_epi16(hi, ahi), half);
+	  t = _mm_srli_epi16(_mm_add_epi16(_mm_srli_epi16(t, 8), t), 8);
+	  hi = _mm_or_si128(_mm_and_si128(keep, hi), _mm_andnot_si128(keep, t));
+	  _mm_storeu_si128((__m128i*)(row + x * 4), _mm_packus_epi16(lo, hi));
+	}
+    }
+#elif GS_NEON
+  if (spp == 4 && (ai == 0 || ai == 3))
+    {
+      for (; x + 8 <= n; x += 8)
+	{
+	  uint8x8x4_t p = vld4_u8(row + x * 4);
+	  uint8x8_t a = p.val[ai];
+
+	  for (i = 0; i < 4; i++)
+	    {
+	      if (i != ai)
+		{
+		  uint16x8_t t = vaddq_u16(vmull_u8(p.val[i], a),
+		    vdupq_n_u16(0x80));
+
+		  p.val[i] = vaddhn_u16(t, vshrq_n_u16(t, 8));
+		}
+	    }
+	  vst4_u8(row + x * 4, p);
+	}
+    }
+#endif
+
+  for (; x < n; x++)
+    {
+      unsigned char *p = row + x * spp;
+      unsigned a = p[ai];
+
+      if (a != 255)
+	{
+	  for (i = 0; i < spp; i++)
+	    {
+	      if (i != ai)
+		{
+		  p[i] = mul255(a, p[i]);
+		}
+	    }
+	}
+    }
+}
+
+void
+GSUnpremultiplyRow8(unsigned char *row, NSInteger n, NSInteger spp,
+  NSInteger ai)
+{
+  NSInteger x;
+  NSInteger i;
+
+  /* There is no vector divide, but a table of reciprocals turns each
+   * division into a multiplication and a shift.
+   */
+  for (x = 0; x < n; x++)
+    {
+      unsigned char *p = row + x * spp;
+      unsigned a = p[ai];
+
+      if (a != 0 && a != 255)
+	{
+	  for (i = 0; i < spp; i++)
+	    {
+	      if (i != ai)
+		{
+		  p[i] = unpremultiply8(p[i], a);
+		}
+	    }
+	}
+    }
+}
+
+void
+GSPremultiplyRow16(unsigned short *row, NSInteger n, NSInteger spp,
+  NSInteger ai)
+{
+  NSInteger x;
+  NSInteger i;
+
+  for (x = 0; x < n; x++)
+    {
+      unsigned short *p = row + x * spp;
+      unsigned a = p[ai];
+
+      if (a != 65535)
+	{
+	  for (i = 0; i < spp; i++)
+	    {
+	      if (i != ai)
+		{
+		  p[i] = (p[i] * a) / 65535U;
+		}
+	    }
+	}
+    }
+}
+
+void
+GSUnpremultiplyRow16(unsigned short *row, NSInteger n, NSInteger spp,
+  NSInteger ai)
+{
+  NSInteger x;
+  NSInteger i;
+
+  for (x = 0; x < n; x++)
+    {
+      unsigned short *p = row + x * spp;
+      unsigned a = p[ai];
+
+      if (a != 0 && a != 65535)
+	{
+	  for (i = 0; i < spp; i++)
+	    {
+	      if (i != ai)
+		{
+		  p[i] = unpremultiply16(p[i], a);
+		}
+	    }
+	}
+    }
+}
+
+void
+GSPremultiplyPlanarRow8(unsigned char **rows, NSInteger n, NSInteger spp,
+  NSInteger ai)
+{
+  const unsigned char *alpha = rows[ai];
+  NSInteger i;
+
+  for (i = 0; i < spp; i++)
+    {
+      unsigned char *p = rows[i];
+      NSInteger x;
+
+      if (i == ai)
+	{
+	  continue;
+	}
+      for (x = 0; x < n; x++)
+	{
+	  p[x] = mul255(alpha[x], p[x]);
+	}
+    }
+}
+
+void
+GSUnpremultiplyPlanarRow8(unsigned char **rows, NSInteger n, NSInteger spp,
+  NSInteger ai)
+{
+  const unsigned char *alpha = rows[ai];
+  NSInteger i;
+
+  for (i = 0; i < spp; i++)
+    {
+      unsigned char *p = rows[i];
+      NSInteger x;
+
+      if (i == ai)
+	{
+	  continue;
+	}
+      for (x = 0; x < n; x++)
+	{
+	  unsigned a = alpha[x];
+
+	  if (a != 0 && a != 255)
+	    {
+	      p[x] = unpremultiply8(p[x], a);
+	    }
+	}
+    }
+}
+
+void
+GSPremultiplyPlanarRow16(unsigned short **rows, NSInteger n, NSInteger spp,
+  NSInteger ai)
+{
+  const unsigned short *alpha = rows[ai];
+  NSInteger i;
+
+  for (i = 0; i < spp; i++)
+    {
+      unsigned short *p = rows[i];
+      NSInteger x;
+
+      if (i == ai)
+	{
+	  continue;
+	}
+      for (x = 0; x < n; x++)
+	{
+	  p[x] = (p[x] * (unsigned)alpha[x]) / 65535U;
+	}
+    }
+}
+
+void
+GSUnpremultiplyPlanarRow16(unsigned short **rows, NSInteger n, NSInteger spp,
+  NSInteger ai)
+{
+  const unsigned short *alpha = rows[ai];
+  NSInteger i;
+
+  for (i = 0; i < spp; i++)
+    {
+      unsigned short *p = rows[i];
+      NSInteger x;
+
+      if (i == ai)
+	{
+	  continue;
+	}
+      for (x = 0; x < n; x++)
+	{
+	  unsigned a = alpha[x];
+
+	  if (a != 0 && a != 65535)
+	    {
+	      p[x] = unpremultiply16(p[x], a);
+	    }
+	}
+    }
+}
+
+void
+GSAlphaFirstRow8(unsigned char *row, NSInteger n, NSInteger spp)
+{
+  NSInteger x = 0;
+
+#if GS_SSE2
+  if (spp == 4)
+    {
+      /* Each pixel is one little endian word: rotate it left a byte. */
+      for (; x + 4 <= n; x += 4)
+	{
+	  __m128i p = _mm_loadu_si128((__m128i*)(row + x * 4));
+
+	  p = _mm_or_si128(_mm_slli_epi32(p, 8), _mm_srli_epi32(p, 24));
+	  _mm_storeu_si128((__m128i*)(row + x * 4), p);
+	}
+    }
+#elif GS_NEON
+  if (spp == 4)
+    {
+      for (; x + 16 <= n; x += 16)
+	{
+	  uint8x16x4_t p = vld4q_u8(row + x * 4);
+	  uint8x16x4_t q;
+
+	  q.val[0] = p.val[3];
+	  q.val[1] = p.val[0];
+	  q.val[2] = p.val[1];
+	  q.val[3] = p.val[2];
+	  vst4q_u8(row + x * 4, q);
+	}
+    }
+#endif
+
+  for (; x < n; x++)
+    {
+      unsigned char *p = row + x * spp;
+      unsigned char a = p[spp - 1];
+
+      memmove(p + 1, p, spp - 1);
+      p[0] = a;
+    }
+}
+
+void
+GSAlphaLastRow8(unsigned char *row, NSInteger n, NSInteger spp)
+{
+  NSInteger x = 0;
+
+#if GS_SSE2
+  if (spp == 4)
+    {
+      for (; x + 4 <= n; x += 4)
+	{
+	  __m128i p = _mm_loadu_si128((__m128i*)(row + x * 4));
+
+	  p = _mm_or_si128(_mm_srli_epi32(p, 8), _mm_slli_epi32(p, 24));
+	  _mm_storeu_si128((__m128i*)(row + x * 4), p);
+	}
+    }
+#elif GS_NEON
+  if (spp == 4)
+    {
+      for (; x + 16 <= n; x += 16)
+	{
+	  uint8x16x4_t p = vld4q_u8(row + x * 4);
+	  uint8x16x4_t q;
+
+	  q.val[0] = p.val[1];
+	  q.val[1] = p.val[2];
+	  q.val[2] = p.val[3];
+	  q.val[3] = p.val[0];
+	  vst4q_u8(row + x * 4, q);
+	}
+    }
+#endif
+
+  for (; x < n; x++)
+    {
+      unsigned char *p = row + x * spp;
+      unsigned char a = p[0];
+
+      memmove(p, p + 1, spp - 1);
+      p[spp - 1] = a;
+    }
+}
+
+void
+GSAlphaFirstRow16(unsigned short *row, NSInteger n, NSInteger spp)
+{
+  NSInteger x;
+
+  for (x = 0; x < n; x++)
+    {
+      unsigned short *p = row + x * spp;
+      unsigned short a = p[spp - 1];
+
+      memmove(p + 1, p, (spp - 1) * sizeof(unsigned short));
+      p[0] = a;
+    }
+}
+
+void
+GSAlphaLastRow16(unsigned short *row, NSInteger n, NSInteger spp)
+{
+  NSInteger x;
+
+  for (x = 0; x < n; x++)
+    {
+      unsigned short *p = row + x * spp;
+      unsigned short a = p[0];
+
+      memmove(p, p + 1, (spp - 1) * sizeof(unsigned short));
+      p[spp - 1] = a;
+    }
+}
+
+void
+GSWidenRow8To16(const unsigned char *src, unsigned short *dst,
+  NSInteger count)
+{
+  NSInteger i = 0;
+
+#if GS_SSE2
+  /* Pairing each byte with itself gives v * 257 in either byte order. */
+  for (; i + 16 <= count; i += 16)
+    {
+      __m128i p = _mm_loadu_si128((const __m128i*)(src + i));
+
+      _mm_storeu_si128((__m128i*)(dst + i), _mm_unpacklo_epi8(p, p));
+      _mm_storeu_si128((__m128i*)(dst + i + 8), _mm_unpackhi_epi8(p, p));
+    }
+#elif GS_NEON
+  for (; i + 16 <= count; i += 16)
+    {
+      uint8x16_t p = vld1q_u8(src + i);
+      uint8x16x2_t z = vzipq_u8(p, p);
+
+      vst1q_u16(dst + i, vreinterpretq_u16_u8(z.val[0]));
+      vst1q_u16(dst + i + 8, vreinterpretq_u16_u8(z.val[1]));
+    }
+#endif
+
+  for (; i < count; i++)
+    {
+      dst[i] = src[i] * 257;
+    }
+}
+
+void
+GSNarrowRow16To8(const unsigned short *src, unsigned char *dst,
+  NSInteger count)
+{
+  NSInteger i;
+
+  for (i = 0; i < count; i++)
+    {
+      dst[i] = (src[i] * 255U + 32767) / 65535;
+    }
+}
+
+void
+GSGrayToRGBRow8(const unsigned char *src, unsigned char *dst,
+  NSInteger n, BOOL alpha)
+{
+  NSInteger x;
+
+  if (alpha)
+    {
+      for (x = 0; x < n; x++)
+	{
+	  unsigned char v = src[2 * x];
+
+	  dst[4 * x] = dst[4 * x + 1] = dst[4 * x + 2] = v;
+	  dst[4 * x + 3] = src[2 * x + 1];
+	}
+    }
+  else
+    {
+      for (x = 0; x < n; x++)
+	{
+	  dst[3 * x] = dst[3 * x + 1] = dst[3 * x + 2] = src[x];
+	}
+    }
+}
+
+void
+GSGrayToRGBRow16(const unsigned short *src, unsigned short *dst,
+  NSInteger n, BOOL alpha)
+{
+  NSInteger x;
+
+  if (alpha)
+    {
+      for (x = 0; x < n; x++)
+	{
+	  unsigned short v = src[2 * x];
+
+	  dst[4 * x] = dst[4 * x + 1] = dst[4 * x + 2] = v;
+	  dst[4 * x + 3] = src[2 * x + 1];
+	}
+    }
+  else
+    {
+      for (x = 0; x < n; x++)
+	{
+	  dst[3 * x] = dst[3 * x + 1] = dst[3 * x + 2] = src[x];
+	}
+    }
+}
+
+void
+GSMeshRow8(unsigned char **rows, unsigned char *dst, NSInteger n,
+  NSInteger spp)
+{
+  NSInteger x = 0;
+  NSInteger i;
+
+#if GS_SSE2
+  if (spp == 4)
+    {
+      for (; x + 16 <= n; x += 16)
+	{
+	  __m128i r = _mm_loadu_si128((__m128i*)(rows[0] + x));
+	  __m128i g = _mm_loadu_si128((__m128i*)(rows[1] + x));
+	  __m128i b = _mm_loadu_si128((__m128i*)(rows[2] + x));
+	  __m128i a = _mm_loadu_si128((__m128i*)(rows[3] + x));
+	  __m128i rg = _mm_unpacklo_epi8(r, g);
+	  __m128i ba = _mm_unpacklo_epi8(b, a);
+	  __m128i *d = (__m128i*)(dst + x * 4);
+
+	  _mm_storeu_si128(d, _mm_unpacklo_epi16(rg, ba));
+	  _mm_storeu_si128(d + 1, _mm_unpackhi_epi16(rg, ba));
+	  rg = _mm_unpackhi_epi8(r, g);
+	  ba = _mm_unpackhi_epi8(b, a);
+	  _mm_storeu_si128(d + 2, _mm_unpacklo_epi16(rg, ba));
+	  _mm_storeu_si128(d + 3, _mm_unpackhi_epi16(rg, ba));
+	}
+    }
+#elif GS_NEON
+  if (spp == 4)
+    {
+      for (; x + 16 <= n; x += 16)
+	{
+	  uint8x16x4_t p;
+
+	  for (i = 0; i < 4; i++)
+	    {
+	      p.val[i] = vld1q_u8(rows[i] + x);
+	    }
+	  vst4q_u8(dst + x * 4, p);
+	}
+    }
+#endif
+
+  for (; x < n; x++)
+    {
+      for (i = 0; i < spp; i++)
+	{
+	  dst[x * spp + i] = rows[i][x];
+	}
+    }
+}
+
+void
+GSUnmeshRow8(const unsigned char *src, unsigned char **rows, NSInteger n,
+  NSInteger spp)
+{
+  NSInteger x = 0;
+  NSInteger i;
+
+#if GS_SSE2
+  if (spp == 4)
+    {
+      /* Four rounds of interleaving the registers in pairs sort the
+       * bytes of sixteen pixels into their planes.
+       */
+      for (; x + 16 <= n; x += 16)
+	{
+	  const __m128i *s = (const __m128i*)(src + x * 4);
+	  __m128i r0 = _mm_loadu_si128(s);
+	  __m128i r1 = _mm_loadu_si128(s + 1);
+	  __m128i r2 = _mm_loadu_si128(s + 2);
+	  __m128i r3 = _mm_loadu_si128(s + 3);
+	  int round;
+
+	  for (round = 0; round < 4; round++)
+	    {
+	      __m128i t0 = _mm_unpacklo_epi8(r0, r2);
+	      __m128i t1 = _mm_unpackhi_epi8(r0, r2);
+	      __m128i t2 = _mm_unpacklo_epi8(r1, r3);
+	      __m128i t3 = _mm_unpackhi_epi8(r1, r3);
+
+	      r0 = t0;
+	      r1 = t1;
+	      r2 = t2;
+	      r3 = t3;
+	    }
+	  _mm_storeu_si128((__m128i*)(rows[0] + x), r0);
+	  _mm_storeu_si128((__m128i*)(rows[1] + x), r1);
+	  _mm_storeu_si128((__m128i*)(rows[2] + x), r2);
+	  _mm_storeu_si128((__m128i*)(rows[3] + x), r3);
+	}
+    }
+#elif GS_NEON
+  if (spp == 4)
+    {
+      for (; x + 16 <= n; x += 16)
+	{
+	  uint8x16x4_t p = vld4q_u8(src + x * 4);
+
+	  for (i = 0; i < 4; i++)
+	    {
+	      vst1q_u8(rows[i] + x, p.val[i]);
+	    }
+	}
+    }
+#endif
+
+  for (; x < n; x++)
+    {
+      for (i = 0; i < spp; i++)
+	{
+	  rows[i][x] = src[x * spp + i];
+	}
+    }
+}
+
+void
+GSMeshRow16(unsigned short **rows, unsigned short *dst, NSInteger n,
+  NSInteger spp)
+{
+  NSInteger x;
+  NSInteger i;
+
+  for (x = 0; x < n; x++)
+    {
+      for (i = 0; i < spp; i++)
+	{
+	  dst[x * spp + i] = rows[i][x];
+	}
+    }
+}
+
+void
+GSUnmeshRow16(const unsigned short *src, unsigned short **rows, NSInteger n,
+  NSInteger spp)
+{
+  NSInteger x;
+  NSInteger i;
+
+  for (x = 0; x < n; x++)
+    {
+      for (i = 0; i < spp; i++)
+	{
+	  rows[i][x] = src[x * spp + i];
+	}
+    }
+}
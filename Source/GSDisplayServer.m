@@ -34,6 +34,8 @@
 #import <Foundation/NSRunLoop.h>
 #import <Foundation/NSSet.h>
 #import <Foundation/NSGeometry.h>
+#import <Foundation/NSUserDefaults.h>
+#import <Foundation/NSValue.h>
 
 #import "AppKit/NSApplication.h"
 #import "AppKit/NSEvent.h"
@@ -64,6 +66,305 @@ static NSRecursiveLock  *serverLock = nil;
 
 static GSDisplayServer *currentServer = nil;
 
+/* The number of event types counted by the event queue. */
+#define	QUEUE_TYPES	64
+
+/* The event queue of a server.  It keeps the events in a ring buffer, so
+ * that events are taken from the start of the queue without moving the
+ * others, and counts the events of each type so that a scan for types
+ * which aren't in the queue is avoided.  When asked to, it merges a mouse
+ * motion or scroll wheel event added at the end with the one before it.
+ * It is an array so that backends can go on using event_queue as one.
+ */
+@interface GSEventQueue : NSMutableArray
+{
+@public
+  id		*items;
+  NSUInteger	head;
+  NSUInteger	count;
+  NSUInteger	capacity;	/* Always a power of two */
+  NSUInteger	typeCount[QUEUE_TYPES];
+  NSEventMask	present;	/* Mask of the types in the queue */
+  BOOL		coalesces;
+  NSUInteger	maxDepth;
+  NSUInteger	posted;
+  NSUInteger	coalesced;
+}
+- (id) initWithCapacity: (NSUInteger)aCapacity;
+- (NSUInteger) indexOfEventMatchingMask: (NSEventMask)mask
+                              fromIndex: (NSUInteger)index;
+@end
+
+static inline id
+queueItem(GSEventQueue *q, NSUInteger index)
+{
+  return q->items[(q->head + index) & (q->capacity - 1)];
+}
+
+static inline NSUInteger
+queueType(NSEvent *event)
+{
+  NSUInteger type = [event type];
+
+  return type < QUEUE_TYPES ? type : QUEUE_TYPES - 1;
+}
+
+static void
+queueCount(GSEventQueue *q, NSEvent *event)
+{
+  NSUInteger type = queueType(event);
+
+  if (q->typeCount[type]++ == 0)
+    {
+      q->present |= NSEventMaskFromType(type);
+    }
+}
+
+static void
+queueUncount(GSEventQueue *q, NSEvent *event)
+{
+  NSUInteger type = queueType(event);
+
+  if (--q->typeCount[type] == 0)
+    {
+      q->present &= ~NSEventMaskFromType(type);
+    }
+}
+
+/* Returns an event merging last and event, if event can be merged with
+ * the event before it, otherwise nil.  Motion events are merged into one
+ * at the later location which moved by both, scroll wheel events into one
+ * which scrolls by both.
+ */
+static NSEvent *
+coalescedEvent(NSEvent *last, NSEvent *event)
+{
+  NSEventType type = [event type];
+
+  if ([last type] != type
+    || [last windowNumber] != [event windowNumber]
+    || [last modifierFlags] != [event modifierFlags])
+    {
+      return nil;
+    }
+  switch (type)
+    {
+      case NSMouseMoved:
+      case NSLeftMouseDragged:
+      case NSRightMouseDragged:
+      case NSOtherMouseDragged:
+      case NSScrollWheel:
+        return [NSEvent mouseEventWithType: type
+                                  location: [event locationInWindow]
+                             modifierFlags: [event modifierFlags]
+                                 timestamp: [event timestamp]
+                              windowNumber: [event windowNumber]
+                                   context: [event context]
+                               eventNumber: [event eventNumber]
+                                clickCount: [event clickCount]
+                                  pressure: [event pressure]
+                              buttonNumber: [event buttonNumber]
+                                    deltaX: [last deltaX] + [event deltaX]
+                                    deltaY: [last deltaY] + [event deltaY]
+                                    deltaZ: [last deltaZ] + [event deltaZ]];
+      default:
+        return nil;
+    }
+}
+
+@implementation GSEventQueue
+
+- (id) initWithCapacity: (NSUInteger)aCapacity
+{
+  capacity = 16;
+  while (capacity < aCapacity)
+    {
+      capacity *= 2;
+    }
+  items = NSZoneMalloc([self zone], capacity * sizeof(id));
+  return self;
+}
+
+- (id) init
+{
+  return [self initWithCapacity: 0];
+}
+
+- (void) dealloc
+{
+  while (count > 0)
+    {
+      RELEASE(queueItem(self, --count));
+    }
+  NSZoneFree([self zone], items);
+  [super dealloc];
+}
+
+- (NSUInteger) count
+{
+  return count;
+}
+
+- (id) objectAtIndex: (NSUInteger)index
+{
+  if (index >= count)
+    {
+      [NSException raise: NSRangeException
+		  format: @"Index %lu out of range", (unsigned long)index];
+    }
+  return queueItem(self, index);
+}
+
+- (void) _grow
+{
+  id *bigger = NSZoneMalloc([self zone], capacity * 2 * sizeof(id));
+  NSUInteger i;
+
+  for (i = 0; i < count; i++)
+    {
+      bigger[i] = queueItem(self, i);
+    }
+  NSZoneFree([self zone], items);
+  items = bigger;
+  head = 0;
+  capacity *= 2;
+}
+
+- (void) insertObject: (id)anObject atIndex: (NSUInteger)index
+{
+  NSUInteger mask = capacity - 1;
+  NSUInteger i;
+
+  if (index > count)
+    {
+      [NSException raise: NSRangeException
+		  format: @"Index %lu out of range", (unsigned long)index];
+    }
+  if (count == capacity)
+    {
+      [self _grow];
+      mask = capacity - 1;
+    }
+  if (index < count / 2)
+    {
+      /* Move the events before index back by one. */
+      head = (head - 1) & mask;
+      for (i = 0; i < index; i++)
+        {
+          items[(head + i) & mask] = items[(head + i + 1) & mask];
+        }
+    }
+  else
+    {
+      /* Move the events after index on by one. */
+      for (i = count; i > index; i--)
+        {
+          items[(head + i) & mask] = items[(head + i - 1) & mask];
+        }
+    }
+  items[(head + index) & mask] = RETAIN(anObject);
+  count++;
+  queueCount(self, anObject);
+  posted++;
+  if (count > maxDepth)
+    {
+      maxDepth = count;
+    }
+}
+
+- (void) addObject: (id)anObject
+{
+  if (coalesces && count > 0)
+    {
+      NSUInteger last = (head + count - 1) & (capacity - 1);
+      NSEvent *event = coalescedEvent(items[last], anObject);
+
+      if (event != nil)
+        {
+          ASSIGN(items[last], event);
+          posted++;
+          coalesced++;
+          return;
+        }
+    }
+  [self insertObject: anObject atIndex: count];
+}
+
+- (void) removeObjectAtIndex: (NSUInteger)index
+{
+  NSUInteger mask = capacity - 1;
+  id old;
+  NSUInteger i;
+
+  if (index >= count)
+    {
+      [NSException raise: NSRangeException
+		  format: @"Index %lu out of range", (unsigned long)index];
+    }
+  old = items[(head + index) & mask];
+  if (index < count / 2)
+    {
+      /* Move the events before index on by one. */
+      for (i = index; i > 0; i--)
+        {
+          items[(head + i) & mask] = items[(head + i - 1) & mask];
+        }
+      head = (head + 1) & mask;
+    }
+  else
+    {
+      /* Move the events after index back by one. */
+      for (i = index; i + 1 < count; i++)
+        {
+          items[(head + i) & mask] = items[(head + i + 1) & mask];
+        }
+    }
+  count--;
+  queueUncount(self, old);
+  RELEASE(old);
+}
+
+- (void) removeLastObject
+{
+  if (count > 0)
+    {
+      [self removeObjectAtIndex: count - 1];
+    }
+}
+
+- (void) replaceObjectAtIndex: (NSUInteger)index withObject: (id)anObject
+{
+  NSUInteger i;
+
+  if (index >= count)
+    {
+      [NSException raise: NSRangeException
+		  format: @"Index %lu out of range", (unsigned long)index];
+    }
+  i = (head + index) & (capacity - 1);
+  queueUncount(self, items[i]);
+  queueCount(self, anObject);
+  ASSIGN(items[i], anObject);
+}
+
+- (NSUInteger) indexOfEventMatchingMask: (NSEventMask)mask
+                              fromIndex: (NSUInteger)index
+{
+  if ((mask & present) != 0)
+    {
+      for (; index < count; index++)
+        {
+          if (mask & NSEventMaskFromType([queueItem(self, index) type]))
+            {
+              return index;
+            }
+        }
+    }
+  return NSNotFound;
+}
+
+@end
+
 /** Returns the GSDisplayServer that created the interal
     representation for window. If the internal representation has not
     yet been created (for instance, if the window is deferred), it
@@ -208,8 +509,10 @@ GSCurrentServer(void)
     return nil;
 
   server_info = [attributes mutableCopy];
-  event_queue = [[NSMutableArray allocWithZone: [self zone]]
-			initWithCapacity: 32];
+  event_queue = [[GSEventQueue allocWithZone: [self zone]]
+			initWithCapacity: 256];
+  ((GSEventQueue*)event_queue)->coalesces = [[NSUserDefaults standardUserDefaults]
+    boolForKey: @"GSCoalesceEvents"];
   drag_types = NSCreateMapTable(NSIntMapKeyCallBacks,
                 NSObjectMapValueCallBacks, 0);
 
@@ -967,16 +1270,16 @@ GSCurrentServer(void)
 			   inMode: (NSString*)mode
 			  dequeue: (BOOL)flag
 {
+  GSEventQueue *queue = (GSEventQueue*)event_queue;
   NSUInteger pos = 0;	/* Position in queue scanned so far	*/
   NSRunLoop *loop = nil;
 
   do
     {
-      NSUInteger count = [event_queue count];
-      NSEvent *event;
-      NSUInteger i = 0;
+      NSEvent *event = nil;
+      NSUInteger index;
 
-      if (count == 0)
+      if (queue->count == 0)
 	{
 	  event = nil;
 	}
@@ -986,37 +1289,27 @@ GSCurrentServer(void)
 	   * Special case - if the mask matches any event, we just get the
 	   * first event on the queue.
 	   */
-	  event = [event_queue objectAtIndex: 0];
+	  pos = 0;
+	  event = queueItem(queue, 0);
 	}
       else
 	{
-	  event = nil;
 	  /*
 	   * Scan the queue from the last position we have seen, up to the end.
+	   * The queue knows when there is no event of a type in it.
 	   */
-	  if (count > pos)
+	  index = [queue indexOfEventMatchingMask: mask fromIndex: pos];
+	  if (index == NSNotFound)
 	    {
-	      NSUInteger end = count - pos;
-	      NSRange	r = NSMakeRange(pos, end);
-	      NSEvent	*events[end];
-
-	      [event_queue getObjects: events range: r];
-	      for (i = 0; i < end; i++)
-		{
-		  if (mask & NSEventMaskFromType([events[i] type]))
-		    {
-		      event = events[i];
-		      break;
-		    }
-		}
+	      pos = MAX(pos, queue->count);
+	    }
+	  else
+	    {
+	      pos = index;
+	      event = queueItem(queue, index);
 	    }
 	}
 
-      /*
-       * Note the position we have read up to.
-       */
-      pos += i;
-
       /*
        * If we found a matching event, we (depending on the flag) de-queue it.
        * We return the event RETAINED - the caller must release it.
@@ -1026,7 +1319,7 @@ GSCurrentServer(void)
 	  RETAIN(event);
 	  if (flag)
 	    {
-	      [event_queue removeObjectAtIndex: pos];
+	      [queue removeObjectAtIndex: pos];
 	    }
 	  return AUTORELEASE(event);
 	}
@@ -1093,6 +1386,52 @@ GSCurrentServer(void)
     [event_queue addObject: anEvent];
 }
 
+/** Sets whether a mouse moved, mouse dragged or scroll wheel event posted
+ * at the end of the queue is merged with a like event before it, for the
+ * same window and with the same modifiers.  The merged event is at the
+ * location of the later one and its deltas are the sums of their deltas.
+ * The default is the value of the GSCoalesceEvents user default.
+ */
+- (void) setCoalescesEvents: (BOOL)flag
+{
+  ((GSEventQueue*)event_queue)->coalesces = flag;
+}
+
+/** Returns whether motion and scroll wheel events are merged.
+ */
+- (BOOL) coalescesEvents
+{
+  return ((GSEventQueue*)event_queue)->coalesces;
+}
+
+/** Returns counters of the event queue, as numbers for the keys Depth
+ * (events in the queue), MaxDepth (most events in the queue at once),
+ * Posted (events posted) and Coalesced (events merged with the one before
+ * them instead of being added).
+ */
+- (NSDictionary *) eventQueueStatistics
+{
+  GSEventQueue *queue = (GSEventQueue*)event_queue;
+
+  return [NSDictionary dictionaryWithObjectsAndKeys:
+    [NSNumber numberWithUnsignedInteger: queue->count], @"Depth",
+    [NSNumber numberWithUnsignedInteger: queue->maxDepth], @"MaxDepth",
+    [NSNumber numberWithUnsignedInteger: queue->posted], @"Posted",
+    [NSNumber numberWithUnsignedInteger: queue->coalesced], @"Coalesced",
+    nil];
+}
+
+/** Sets the counters of the event queue back to zero.
+ */
+- (void) resetEventQueueStatistics
+{
+  GSEventQueue *queue = (GSEventQueue*)event_queue;
+
+  queue->maxDepth = queue->count;
+  queue->posted = 0;
+  queue->coalesced = 0;
+}
+
 - (void) _printEventQueue
 {
   NSUInteger index = [event_queue count];
@@ -28,6 +28,7 @@
 
 #include <math.h>
 
+#import <Foundation/NSArray.h>
 #import <Foundation/NSDebug.h>
 #import <Foundation/NSException.h>
 #import <Foundation/NSGeometry.h>
@@ -48,13 +49,69 @@
 
 /*
 Note that unless the user creates extra instances, there will only be one
-instance of GSHorizontalTypesetter for all text typesetting, so we can
-cache fairly aggressively without having to worry about memory consumption.
+instance of GSHorizontalTypesetter per thread for all text typesetting, so
+we can cache fairly aggressively without having to worry about memory
+consumption.
 */
 
+/*
+Typesetters that stand in for one that is busy, eg. when layout is done
+while a layout manager's delegate is being told about layout, or when
+several threads share a typesetter that isn't the system typesetter. They
+are kept for reuse, along with their buffers, instead of being created and
+destroyed for each call.
+*/
+static NSMutableArray *spareTypesetters;
+static NSLock *spareTypesettersLock;
+
+/* OPT: tweak */
+#define MAX_SPARE_TYPESETTERS 8
+
 
 @implementation GSHorizontalTypesetter
 
++ (void) initialize
+{
+  if (self == [GSHorizontalTypesetter class])
+    {
+      spareTypesetters = [[NSMutableArray alloc] init];
+      spareTypesettersLock = [[NSLock alloc] init];
+    }
+}
+
+/* Returns a retained typesetter of the receiver's class that isn't in use. */
++(GSHorizontalTypesetter *) _spareTypesetter
+{
+  GSHorizontalTypesetter *spare = nil;
+  NSInteger i;
+
+  [spareTypesettersLock lock];
+  for (i = [spareTypesetters count] - 1; i >= 0; i--)
+    {
+      if (object_getClass([spareTypesetters objectAtIndex: i]) == self)
+        {
+          spare = RETAIN([spareTypesetters objectAtIndex: i]);
+          [spareTypesetters removeObjectAtIndex: i];
+          break;
+        }
+    }
+  [spareTypesettersLock unlock];
+
+  if (!spare)
+    spare = [[self alloc] init];
+  return spare;
+}
+
+/* Takes back a typesetter from +_spareTypesetter and releases it. */
++(void) _recycleSpareTypesetter: (GSHorizontalTypesetter *)spare
+{
+  [spareTypesettersLock lock];
+  if ([spareTypesetters count] < MAX_SPARE_TYPESETTERS)
+    [spareTypesetters addObject: spare];
+  [spareTypesettersLock unlock];
+  RELEASE(spare);
+}
+
 - init
 {
   if (!(self = [super init])) return nil;
@@ -586,7 +643,10 @@ For bigger values the width gets ignored.
 
   if (currentFont)
     {
-      lineHeight = [currentFont defaultLineHeightForFont];
+      if ([currentLayoutManager usesFontLeading])
+        lineHeight = [currentFont defaultLineHeightForFont];
+      else
+        lineHeight = [currentFont ascender] - [currentFont descender];
     }
   else
     {
@@ -1131,9 +1191,12 @@ static inline BOOL wantNewLineHeight(CGFloat height, CGFloat *lineHeight, CGFloa
     if (maxLineHeight > 0 && maxLineHeight < min)
       maxLineHeight = min;
 
-    lineHeight = [glyphCache->font defaultLineHeightForFont];
     ascender = [glyphCache->font ascender];
     descender = -[glyphCache->font descender];
+    if ([currentLayoutManager usesFontLeading])
+      lineHeight = [glyphCache->font defaultLineHeightForFont];
+    else
+      lineHeight = ascender + descender;
 
     if (lineHeight < min)
       lineHeight = min;
@@ -1358,22 +1421,32 @@ static inline BOOL wantNewLineHeight(CGFloat height, CGFloat *lineHeight, CGFloa
 {
   int ret, realRet;
   BOOL newParagraph;
+  NSUInteger maxLines;
 
   if (![lock tryLock])
     {
       /* Since we might be the shared system typesetter, we must be
       reentrant. Thus, if we are already in use and can't lock our lock,
-      we create a new instance and let it handle the call. */
+      we let a spare instance handle the call. */
       GSHorizontalTypesetter *tempTypesetter;
 
-      tempTypesetter = [[object_getClass(self) alloc] init];
-      ret = [tempTypesetter layoutGlyphsInLayoutManager: layoutManager
-                                        inTextContainer: textContainer
-                                   startingAtGlyphIndex: glyphIndex
-                               previousLineFragmentRect: previousLineFragRect
-                                         nextGlyphIndex: nextGlyphIndex
-                                  numberOfLineFragments: howMany];
-      DESTROY(tempTypesetter);
+      tempTypesetter = [object_getClass(self) _spareTypesetter];
+      NS_DURING
+        {
+          ret = [tempTypesetter layoutGlyphsInLayoutManager: layoutManager
+                                            inTextContainer: textContainer
+                                       startingAtGlyphIndex: glyphIndex
+                                   previousLineFragmentRect: previousLineFragRect
+                                             nextGlyphIndex: nextGlyphIndex
+                                      numberOfLineFragments: howMany];
+        }
+      NS_HANDLER
+        {
+          RELEASE(tempTypesetter);
+          [localException raise];
+        }
+      NS_ENDHANDLER
+      [object_getClass(self) _recycleSpareTypesetter: tempTypesetter];
       return ret;
     }
 
@@ -1389,10 +1462,22 @@ NS_DURING
 
   [self _clearCache];
 
+  /* A text container with a maximum number of lines is full once it has
+  that many lines. */
+  maxLines = [textContainer maximumNumberOfLines];
+
   realRet = 4;
   currentPoint = NSMakePoint(0, NSMaxY(previousLineFragRect));
   while (1)
     {
+      if (maxLines
+          && [currentLayoutManager _numberOfLinesInTextContainer:
+                                     currentTextContainer] >= maxLines)
+        {
+          ret = 1;
+          break;
+        }
+
       if (realRet == 4)
         {
           /*
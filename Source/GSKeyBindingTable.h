@@ -27,6 +27,7 @@
 #ifndef _GS_KEYBINDING_TABLE_H
 #define _GS_KEYBINDING_TABLE_H
 
+#import <Foundation/NSMapTable.h>
 #import "GSKeyBindingAction.h"
 
 @class GSKeyBindingTable;
@@ -80,6 +81,9 @@ struct _GSKeyBinding
   
   /* The length of the array of bindings.  */
   int _bindingsCount;
+
+  /* Maps each keystroke to one more than the index of its binding.  */
+  NSMapTable *_index;
 }
 /* Load all the bindings from this dictionary.  The dictionary binds
    keys to actions, as described below under bindKey:toAction:.  The
@@ -29,6 +29,14 @@
 #import "GSKeyBindingAction.h"
 #import "GSKeyBindingTable.h"
 
+/* The modifiers a binding can have, and the key under which a keystroke
+ * is found in the index.  The modifiers are all above the sixteen bits of
+ * the character, and the key is never zero.
+ */
+#define BINDING_MODIFIERS (NSShiftKeyMask | NSAlternateKeyMask \
+  | NSControlKeyMask | NSNumericPadKeyMask)
+#define BINDING_KEY(C, M) ((void *)(((NSUInteger)(M) | (C)) + 1))
+
 @implementation GSKeyBindingTable : NSObject
 
 - (void) loadBindingsFromDictionary: (NSDictionary *)dict
@@ -225,6 +233,14 @@
   RETAIN (a);
   _bindings[_bindingsCount - 1].table = t;
   RETAIN (t);
+
+  if (_index == NULL)
+    {
+      _index = NSCreateMapTable (NSIntMapKeyCallBacks,
+				 NSIntMapValueCallBacks, 0);
+    }
+  NSMapInsert (_index, BINDING_KEY (character, modifiers),
+	       (void *)(NSUInteger)_bindingsCount);
 }
 
 - (BOOL) lookupKeyStroke: (unichar)character
@@ -232,29 +248,29 @@
        returningActionIn: (GSKeyBindingAction **)action
 		 tableIn: (GSKeyBindingTable **)table
 {
-  int i;
-  
-  for (i = 0; i < _bindingsCount; i++)
+  NSUInteger i;
+
+  /* No binding has other modifiers.  */
+  if (_index == NULL || (flags & ~BINDING_MODIFIERS) != 0)
     {
-      if (_bindings[i].character == character)
-	{
-	  if (_bindings[i].modifiers == flags)
-	    {
-	      if (_bindings[i].action == nil  &&  _bindings[i].table == nil)
-		{
-		  /* Found the keybinding, but it is disabled!  */
-		  return NO;
-		}
-	      else
-		{
-		  *action = _bindings[i].action;
-		  *table = _bindings[i].table;
-		  return YES;
-		}
-	    }
-	}
+      return NO;
+    }
+
+  i = (NSUInteger)NSMapGet (_index, BINDING_KEY (character, flags));
+  if (i == 0)
+    {
+      return NO;
+    }
+  i--;
+
+  if (_bindings[i].action == nil  &&  _bindings[i].table == nil)
+    {
+      /* Found the keybinding, but it is disabled!  */
+      return NO;
     }
-  return NO;
+  *action = _bindings[i].action;
+  *table = _bindings[i].table;
+  return YES;
 }
 
 - (void) dealloc
@@ -267,6 +283,10 @@
       RELEASE (_bindings[i].table);
     }
   free (_bindings);
+  if (_index != NULL)
+    {
+      NSFreeMapTable (_index);
+    }
   [super dealloc];
 }
 
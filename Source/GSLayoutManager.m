@@ -25,12 +25,19 @@
    Boston, MA 02110-1301, USA.
 */
 
+#import <Foundation/NSArray.h>
 #import <Foundation/NSCharacterSet.h>
+#import <Foundation/NSDate.h>
 #import <Foundation/NSDebug.h>
 #import <Foundation/NSEnumerator.h>
 #import <Foundation/NSException.h>
+#import <Foundation/NSLock.h>
+#import <Foundation/NSProcessInfo.h>
+#import <Foundation/NSRunLoop.h>
+#import <Foundation/NSThread.h>
 #import <Foundation/NSValue.h>
 
+#import "AppKit/NSApplication.h"
 #import "AppKit/NSAttributedString.h"
 #import "AppKit/NSTextStorage.h"
 #import "AppKit/NSTextContainer.h"
@@ -185,7 +192,7 @@ Private method used internally by GSLayoutManager for sanity checking.
   else
     r->ligature = 1;
 
-  font = [typesetter fontForCharactersWithAttributes: attributes];
+  font = [[self typesetter] fontForCharactersWithAttributes: attributes];
   /* TODO: it might be useful to change this slightly:
   Returning a nil font from -fontForCharactersWithAttributes: causes those
   characters to not be displayed (ie. no glyphs are generated).
@@ -1783,8 +1790,298 @@ places where we switch.
 
 /***** Layout handling *****/
 
+/* Background layout is done in slices of at most this many seconds... */
+/* OPT: tweak */
+#define BACKGROUND_LAYOUT_SLICE 0.02
+/* ...checking the time after every this many line frags. */
+#define BACKGROUND_LAYOUT_LINES 16
+
+/* With non-contiguous layout, layout jumps ahead of the text that has been
+laid out if it would otherwise have to lay out at least this many
+characters to get where it is asked for. */
+/* OPT: tweak */
+#define NONCONTIGUOUS_LAYOUT_DISTANCE 16384
+/* Line frags to lay out before estimating the height of text from them. */
+#define NONCONTIGUOUS_LAYOUT_SAMPLE 32
+/* Line frags laid out at a time when laying out to a point or filling in
+estimated layout. */
+#define NONCONTIGUOUS_LAYOUT_LINES 8
+/* Attempts at filling in estimated layout in a rect. */
+#define NONCONTIGUOUS_LAYOUT_TRIES 8
+
+/*
+Parallel layout. Chunks of whole paragraphs are laid out concurrently, each
+in a private layout manager in a worker thread, and the line frags are then
+stacked into the real layout in order. Paragraphs only depend on each other
+through their vertical position, so in a single simple rectangular text
+container this gives the same layout as laying them out one after another.
+*/
+
+/* Don't bother unless there are at least this many characters to lay out. */
+/* OPT: tweak */
+#define PARALLEL_LAYOUT_MIN_LENGTH 65536
+/* Approximate number of characters in each chunk. */
+#define PARALLEL_LAYOUT_CHUNK_LENGTH 8192
+/* Most threads to use. */
+#define PARALLEL_LAYOUT_MAX_THREADS 16
+
+@interface GSLayoutChunk : NSObject
+{
+@public
+  /* Set up in the main thread. */
+  NSAttributedString *text;
+  NSSize containerSize;
+  CGFloat lineFragmentPadding;
+  NSRange glyphRange;
+  /* Settings of the layout manager which change the glyphs or lines. */
+  BOOL usesScreenFonts;
+  BOOL usesFontLeading;
+  BOOL showsInvisibleCharacters;
+  BOOL showsControlCharacters;
+
+  /* Set by -layout. Glyph positions are relative to the chunk. */
+  BOOL failed;
+  unsigned int num_glyphs;
+  linefrag_t *linefrags;
+  int num_linefrags;
+  /* Where the next paragraph after the chunk would start. */
+  CGFloat height;
+  /* Glyphs whose not shown and draws outside line frag flags are set. */
+  unsigned int *not_shown, *draws_outside;
+  int num_not_shown, num_draws_outside;
+}
+- (void) layout;
+@end
+
+@interface GSLayoutManager (ParallelLayoutChunks)
+-(void) _takeLayoutForChunk: (GSLayoutChunk *)chunk;
+@end
+
+@implementation GSLayoutChunk
+
+- (void) dealloc
+{
+  int i;
+
+  for (i = 0; i < num_linefrags; i++)
+    {
+      free(linefrags[i].points);
+      free(linefrags[i].attachments);
+    }
+  free(linefrags);
+  free(not_shown);
+  free(draws_outside);
+  DESTROY(text);
+  [super dealloc];
+}
+
+- (void) layout
+{
+  CREATE_AUTORELEASE_POOL(pool);
+  NSTextStorage *storage;
+  NSTextContainer *container;
+  GSLayoutManager *layoutManager;
+
+  NS_DURING
+    {
+      storage = AUTORELEASE([[NSTextStorage alloc]
+        initWithAttributedString: text]);
+      container = AUTORELEASE([[NSTextContainer alloc]
+        initWithContainerSize: containerSize]);
+      [container setLineFragmentPadding: lineFragmentPadding];
+      layoutManager = AUTORELEASE([[GSLayoutManager alloc] init]);
+      [layoutManager setUsesScreenFonts: usesScreenFonts];
+      [layoutManager setUsesFontLeading: usesFontLeading];
+      [layoutManager setShowsInvisibleCharacters: showsInvisibleCharacters];
+      [layoutManager setShowsControlCharacters: showsControlCharacters];
+      [layoutManager addTextContainer: container];
+      [storage addLayoutManager: layoutManager];
+      [layoutManager _takeLayoutForChunk: self];
+      [storage removeLayoutManager: layoutManager];
+    }
+  NS_HANDLER
+    {
+      NSDebugLLog(@"GSLayoutManager", @"parallel layout failed: %@",
+        localException);
+      failed = YES;
+    }
+  NS_ENDHANDLER
+  RELEASE(pool);
+}
+
+@end
+
+/* The chunks of one parallel layout, and the threads working on them. */
+@interface GSLayoutChunkQueue : NSObject
+{
+  NSArray *chunks;
+  NSUInteger next, unfinished;
+  NSConditionLock *lock;
+}
+- (id) initWithChunks: (NSArray *)someChunks;
+/* Lays out chunks until there are none left. */
+- (void) work: (id)sender;
+/* Waits until all chunks have been laid out. */
+- (void) wait;
+@end
+
+@implementation GSLayoutChunkQueue
+
+- (id) initWithChunks: (NSArray *)someChunks
+{
+  if (!(self = [super init]))
+    return nil;
+  ASSIGN(chunks, someChunks);
+  unfinished = [chunks count];
+  lock = [[NSConditionLock alloc] initWithCondition: unfinished ? 0 : 1];
+  return self;
+}
+
+- (void) dealloc
+{
+  DESTROY(chunks);
+  DESTROY(lock);
+  [super dealloc];
+}
+
+- (void) work: (id)sender
+{
+  while (1)
+    {
+      GSLayoutChunk *chunk;
+
+      [lock lock];
+      if (next == [chunks count])
+        {
+          [lock unlock];
+          break;
+        }
+      chunk = [chunks objectAtIndex: next++];
+      [lock unlock];
+
+      [chunk layout];
+
+      [lock lock];
+      unfinished--;
+      [lock unlockWithCondition: unfinished ? 0 : 1];
+    }
+}
+
+- (void) wait
+{
+  [lock lockWhenCondition: 1];
+  [lock unlock];
+}
+
+@end
+
+/* The worker threads of parallel layout. They are started as they are
+first needed and then kept, waiting for queues of chunks to work on. */
+@interface GSLayoutWorkers : NSObject
+/* Has up to helpers worker threads help with the chunks in queue. */
++ (void) addQueue: (GSLayoutChunkQueue *)queue  helpers: (NSUInteger)helpers;
+@end
+
+static NSCondition *workersCondition = nil;
+static NSMutableArray *waitingQueues = nil;
+static NSUInteger numWorkers = 0;
+
+@implementation GSLayoutWorkers
+
++ (void) initialize
+{
+  if (self == [GSLayoutWorkers class])
+    {
+      workersCondition = [[NSCondition alloc] init];
+      waitingQueues = [[NSMutableArray alloc] init];
+    }
+}
+
++ (void) addQueue: (GSLayoutChunkQueue *)queue  helpers: (NSUInteger)helpers
+{
+  NSUInteger j;
+
+  [workersCondition lock];
+  for (j = 0; j < helpers; j++)
+    [waitingQueues addObject: queue];
+  while (numWorkers < helpers)
+    {
+      [NSThread detachNewThreadSelector: @selector(_work:)
+			       toTarget: self
+			     withObject: nil];
+      numWorkers++;
+    }
+  [workersCondition broadcast];
+  [workersCondition unlock];
+}
+
++ (void) _work: (id)sender
+{
+  while (1)
+    {
+      CREATE_AUTORELEASE_POOL(pool);
+      GSLayoutChunkQueue *queue;
+
+      [workersCondition lock];
+      while (![waitingQueues count])
+	[workersCondition wait];
+      queue = RETAIN([waitingQueues objectAtIndex: 0]);
+      [waitingQueues removeObjectAtIndex: 0];
+      [workersCondition unlock];
+
+      /* If the other threads have already done all chunks, this returns
+      at once. */
+      [queue work: nil];
+      RELEASE(queue);
+      RELEASE(pool);
+    }
+}
+
+@end
+
 @implementation GSLayoutManager (LayoutHelpers)
 
+/*
+Marks text container i as completely laid out, removes any soft invalidated
+layout information left in it and tells the delegate. The delegate might add
+text containers, so the (possibly moved) text container is returned.
+*/
+-(textcontainer_t *) _completeLayoutForContainer: (int)i
+                                           atEnd: (BOOL)atEnd
+                                delegateResponds: (BOOL)delegate_responds
+{
+  textcontainer_t *tc = textcontainers + i;
+
+  tc->complete = YES;
+  if (tc->num_soft)
+    {
+      int k;
+      linefrag_t *lf;
+      for (k = tc->num_linefrags, lf = tc->linefrags + k; 
+           k < tc->num_linefrags + tc->num_soft; k++, lf++)
+        {
+          if (lf->points)
+            {
+              free(lf->points);
+              lf->points = NULL;
+            }
+          if (lf->attachments)
+            {
+              free(lf->attachments);
+              lf->attachments = NULL;
+            }
+        }
+      tc->num_soft = 0;
+    }
+  if (delegate_responds)
+    {
+      [_delegate layoutManager: self
+             didCompleteLayoutForTextContainer: tc->textContainer
+                     atEnd: atEnd];
+    }
+  return textcontainers + i;
+}
+
 -(void) _invalidateLayoutFromContainer: (int)idx
 {
   int i, j;
@@ -1810,6 +2107,7 @@ places where we switch.
 	}
       tc->linefrags = NULL;
       tc->num_linefrags = tc->num_soft = 0;
+      tc->num_estimated = 0;
       tc->size_linefrags = 0;
       tc->pos = tc->length = 0;
       tc->was_invalidated = YES;
@@ -1854,6 +2152,21 @@ places where we switch.
   NSRect prev;
   BOOL delegate_responds;
 
+  if ([self _usesNonContiguousLayout])
+    {
+      /* Only lay out as far as the glyph, not the whole text container. */
+      [self _doNonContiguousLayoutToGlyph: glyphIndex];
+      tc = textcontainers;
+      while (!tc->complete && layout_glyph <= glyphIndex)
+	{
+	  if ([self _layoutLineFragsInContainer: 0
+					  count: NONCONTIGUOUS_LAYOUT_LINES])
+	    break;
+	  tc = textcontainers;
+	}
+      return;
+    }
+
   delegate_responds = [_delegate respondsToSelector:
     @selector(layoutManager:didCompleteLayoutForTextContainer:atEnd:)];
 
@@ -1863,13 +2176,23 @@ places where we switch.
       if (tc->complete)
           continue;
 
+      /* The typesetter lays out the whole text container anyway. */
+      if ([self _usesParallelLayout])
+        {
+          [self _doParallelLayoutInContainer: i];
+          tc = textcontainers + i;
+          next = layout_glyph;
+          if (tc->complete)
+            continue;
+        }
+
       while (1)
         {
           if (tc->num_linefrags)
             prev = tc->linefrags[tc->num_linefrags - 1].rect;
           else
             prev = NSZeroRect;
-          j = [typesetter layoutGlyphsInLayoutManager: self
+          j = [[self typesetter] layoutGlyphsInLayoutManager: self
                           inTextContainer: tc->textContainer
                           startingAtGlyphIndex: next
                           previousLineFragmentRect: prev
@@ -1884,41 +2207,9 @@ places where we switch.
               return;
             }
         }
-      tc->complete = YES;
-      tc->usedRectValid = NO;
-      if (tc->num_soft)
-        {
-          /*
-            If there is any soft invalidated layout information left, remove
-            it.
-          */
-          int k;
-          linefrag_t *lf;
-          for (k = tc->num_linefrags, lf = tc->linefrags + k; 
-               k < tc->num_linefrags + tc->num_soft; k++, lf++)
-            {
-              if (lf->points)
-                {
-                  free(lf->points);
-                  lf->points = NULL;
-                }
-              if (lf->attachments)
-                {
-                  free(lf->attachments);
-                  lf->attachments = NULL;
-                }
-            }
-          tc->num_soft = 0;
-        }
-      if (delegate_responds)
-        {
-          [_delegate layoutManager: self
-                     didCompleteLayoutForTextContainer: tc->textContainer
-                     atEnd: j == 2];
-          /* The call might have resulted in more text containers being
-             added, so 'textcontainers' might have moved. */
-          tc = textcontainers + i;
-        }
+      tc = [self _completeLayoutForContainer: i
+                                       atEnd: j == 2
+                            delegateResponds: delegate_responds];
       if (j == 2)
         {
           break;
@@ -1949,13 +2240,20 @@ places where we switch.
       if (tc->complete)
           continue;
 
+      if ([self _usesParallelLayout])
+        {
+          [self _doParallelLayoutInContainer: i];
+          tc = textcontainers + i;
+          next = layout_glyph;
+        }
+
       while (1)
         {
           if (tc->num_linefrags)
             prev = tc->linefrags[tc->num_linefrags - 1].rect;
           else
             prev = NSZeroRect;
-          j = [typesetter layoutGlyphsInLayoutManager: self
+          j = [[self typesetter] layoutGlyphsInLayoutManager: self
                           inTextContainer: tc->textContainer
                           startingAtGlyphIndex: next
                           previousLineFragmentRect: prev
@@ -1964,41 +2262,9 @@ places where we switch.
           if (j)
             break;
         }
-      tc->complete = YES;
-      tc->usedRectValid = NO;
-      if (tc->num_soft)
-        {
-          /*
-            If there is any soft invalidated layout information left, remove
-            it.
-          */
-          int k;
-          linefrag_t *lf;
-          for (k = tc->num_linefrags, lf = tc->linefrags + k; 
-               k < tc->num_linefrags + tc->num_soft; k++, lf++)
-            {
-              if (lf->points)
-                {
-                  free(lf->points);
-                  lf->points = NULL;
-                }
-              if (lf->attachments)
-                {
-                  free(lf->attachments);
-                  lf->attachments = NULL;
-                }
-            }
-          tc->num_soft = 0;
-        }
-      if (delegate_responds)
-        {
-          [_delegate layoutManager: self
-                     didCompleteLayoutForTextContainer: tc->textContainer
-                     atEnd: j == 2];
-          /* The call might have resulted in more text containers being
-             added, so 'textcontainers' might have moved. */
-          tc = textcontainers + i;
-        }
+      tc = [self _completeLayoutForContainer: i
+                                       atEnd: j == 2
+                            delegateResponds: delegate_responds];
       if (j == 2)
         {
           break;
@@ -2012,6 +2278,768 @@ places where we switch.
     }
 }
 
+/*
+Lays out at most howMany line frags (or all that fit, if howMany is 0) in
+text container i, continuing from layout_glyph, and completes the text
+container if the typesetter runs out of text or space. Returns what the
+typesetter returned.
+*/
+-(int) _layoutLineFragsInContainer: (int)i  count: (unsigned int)howMany
+{
+  textcontainer_t *tc = textcontainers + i;
+  unsigned int next;
+  NSRect prev;
+  int j;
+
+  if (tc->num_linefrags)
+    prev = tc->linefrags[tc->num_linefrags - 1].rect;
+  else
+    prev = NSZeroRect;
+  j = [[self typesetter] layoutGlyphsInLayoutManager: self
+                  inTextContainer: tc->textContainer
+                  startingAtGlyphIndex: layout_glyph
+                  previousLineFragmentRect: prev
+                  nextGlyphIndex: &next
+                  numberOfLineFragments: howMany];
+  if (j)
+    {
+      [self _completeLayoutForContainer: i
+                                  atEnd: j == 2
+                       delegateResponds: [_delegate respondsToSelector:
+        @selector(layoutManager:didCompleteLayoutForTextContainer:atEnd:)]];
+    }
+  return j;
+}
+
+/*
+Lays out the text containers before cindex completely, and text container
+cindex until its line frags reach below y.
+*/
+-(void) _doLayoutToContainer: (int)cindex  maxY: (CGFloat)y
+{
+  textcontainer_t *tc;
+
+  if (cindex > 0)
+    [self _doLayoutToContainer: cindex - 1];
+  if (cindex >= num_textcontainers)
+    return;
+
+  tc = textcontainers + cindex;
+  while (!tc->complete
+	 && (!tc->num_linefrags
+	     || NSMinY(tc->linefrags[tc->num_linefrags - 1].rect) <= y))
+    {
+      if ([self _layoutLineFragsInContainer: cindex
+				      count: NONCONTIGUOUS_LAYOUT_LINES])
+	break;
+      tc = textcontainers + cindex;
+    }
+}
+
+
+/*
+Non-contiguous layout. This is only done for a single, simple rectangular
+text container (which is what a text view in a scroll view has).
+
+Instead of laying out all text up to where layout is asked for, we put in a
+line frag covering the glyphs in between with an estimated height, and
+continue from the start of the paragraph that was asked for. The estimated
+line frag is a line frag like any other (with a single point for all its
+glyphs), so everything that looks at line frags keeps working, and edits
+invalidate and soft invalidate it like any other layout. Its glyphs are
+never drawn.
+
+An estimated line frag is filled in when layout is asked for inside it.
+Everything after it is turned into soft invalidated layout, which the
+typesetter takes up again (shifted) when it gets there, and what is left of
+the estimated line frag absorbs the difference in height when it can, so
+that text further down doesn't move.
+*/
+
+-(BOOL) _usesNonContiguousLayout
+{
+  return NO;
+}
+
+/*
+The average height of a character in the layout so far. A few lines are
+laid out first if there isn't enough layout to go by.
+*/
+-(CGFloat) _estimatedHeightPerCharacter
+{
+  textcontainer_t *tc = textcontainers;
+
+  if (!tc->complete && tc->num_linefrags < NONCONTIGUOUS_LAYOUT_SAMPLE)
+    {
+      [self _layoutLineFragsInContainer: 0
+				  count: NONCONTIGUOUS_LAYOUT_SAMPLE - tc->num_linefrags];
+      tc = textcontainers;
+    }
+  if (!tc->num_linefrags || !layout_char)
+    return 0.0;
+  return NSMaxY(tc->linefrags[tc->num_linefrags - 1].rect) / layout_char;
+}
+
+/*
+Adds an estimated line frag for the glyphs from layout_glyph up to
+glyphIndex (which is the first glyph of character cindex).
+*/
+-(void) _addEstimatedLineFragToGlyph: (unsigned int)glyphIndex
+			   character: (unsigned int)cindex
+			      height: (CGFloat)height
+{
+  textcontainer_t *tc = textcontainers;
+  linefrag_t *lf;
+  NSRange r;
+  CGFloat y;
+
+  r = NSMakeRange(layout_glyph, glyphIndex - layout_glyph);
+  if (tc->num_linefrags)
+    {
+      y = NSMaxY(tc->linefrags[tc->num_linefrags - 1].rect);
+    }
+  else
+    {
+      y = 0.0;
+      tc->pos = 0;
+    }
+  tc->length = NSMaxRange(r) - tc->pos;
+
+  [self setLineFragmentRect: NSMakeRect(0.0, y,
+    [tc->textContainer containerSize].width, height)
+	      forGlyphRange: r
+		   usedRect: NSMakeRect(0.0, y, 0.0, height)];
+  [self setLocation: NSZeroPoint
+    forStartOfGlyphRange: r];
+  lf = tc->linefrags + tc->num_linefrags - 1;
+  lf->estimated = YES;
+  tc->num_estimated++;
+
+  layout_glyph = glyphIndex;
+  layout_char = cindex;
+}
+
+/*
+Lays out text up to the start of the paragraph containing character cindex
+if it is far enough away, estimating the height of the text in between.
+*/
+-(void) _jumpLayoutToCharacter: (unsigned int)cindex
+{
+  unsigned int start;
+  CGFloat h;
+
+  h = [self _estimatedHeightPerCharacter];
+  if (textcontainers->complete || h <= 0.0)
+    return;
+
+  start = [[_textStorage string] paragraphRangeForRange:
+    NSMakeRange(cindex, 0)].location;
+  if (start < layout_char + NONCONTIGUOUS_LAYOUT_DISTANCE)
+    return;
+
+  [self _addEstimatedLineFragToGlyph:
+	  [self glyphRangeForCharacterRange: NSMakeRange(start, 1)
+		       actualCharacterRange: NULL].location
+			   character: start
+			      height: (start - layout_char) * h];
+}
+
+/*
+Replaces estimated line frag k with real layout. Layout starts at the
+beginning of the paragraph containing glyph first, and goes on until glyph
+last has been laid out and the line frags reach below y.
+*/
+-(void) _fillEstimatedLineFrag: (int)k
+		     fromGlyph: (unsigned int)first
+		       toGlyph: (unsigned int)last
+			  maxY: (CGFloat)y
+{
+  textcontainer_t *tc = textcontainers;
+  linefrag_t *lf = tc->linefrags + k;
+  unsigned int gap_pos, gap_end, gap_cpos, gap_cend;
+  unsigned int start, gstart;
+  CGFloat gap_y, gap_maxy, next_y, est;
+  NSRange cr;
+  BOOL has_next, has_gap;
+  int total, j;
+
+  gap_pos = lf->pos;
+  gap_end = lf->pos + lf->length;
+  gap_y = NSMinY(lf->rect);
+  gap_maxy = NSMaxY(lf->rect);
+  cr = [self characterRangeForGlyphRange: NSMakeRange(gap_pos, lf->length)
+			actualGlyphRange: NULL];
+  gap_cpos = cr.location;
+  gap_cend = NSMaxRange(cr);
+
+  start = [self characterIndexForGlyphAtIndex: first];
+  start = [[_textStorage string] paragraphRangeForRange:
+    NSMakeRange(start, 0)].location;
+  if (start <= gap_cpos)
+    {
+      start = gap_cpos;
+      gstart = gap_pos;
+    }
+  else
+    {
+      gstart = [self glyphRangeForCharacterRange: NSMakeRange(start, 1)
+			    actualCharacterRange: NULL].location;
+      if (gstart >= gap_end)
+	return;
+    }
+
+  has_next = k + 1 < tc->num_linefrags;
+  next_y = has_next ? NSMinY(lf[1].rect) : 0.0;
+  total = tc->num_linefrags + tc->num_soft;
+
+  /* Shrink the estimated line frag to end where layout will start, or get
+  rid of it. */
+  tc->num_estimated -= linefrags_estimated(lf + 1, tc->num_linefrags - k - 1);
+  free(lf->points);
+  lf->points = NULL;
+  lf->num_points = 0;
+  has_gap = gstart > gap_pos;
+  if (has_gap)
+    {
+      est = (gap_maxy - gap_y) * (start - gap_cpos) / (gap_cend - gap_cpos);
+      lf->length = gstart - gap_pos;
+      lf->rect.size.height = est;
+      lf->used_rect.size.height = est;
+      lf->points = malloc(sizeof(linefrag_point_t));
+      lf->num_points = 1;
+      lf->points->pos = gap_pos;
+      lf->points->length = lf->length;
+      lf->points->p = NSZeroPoint;
+      k++;
+    }
+  else
+    {
+      total--;
+      tc->num_estimated--;
+      memmove(lf, lf + 1, sizeof(linefrag_t) * (total - k));
+    }
+
+  /* Everything after it becomes soft invalidated layout. */
+  tc->num_soft = total - k;
+  tc->num_linefrags = k;
+  if (k)
+    tc->length = tc->linefrags[k - 1].pos + tc->linefrags[k - 1].length - tc->pos;
+  else
+    tc->pos = tc->length = 0;
+  tc->complete = NO;
+  tc->usedRectValid = NO;
+  layout_glyph = gstart;
+  layout_char = start;
+
+  while (1)
+    {
+      j = [self _layoutLineFragsInContainer: 0
+				      count: NONCONTIGUOUS_LAYOUT_LINES];
+      tc = textcontainers;
+      if (j)
+	break;
+      if (has_next && layout_glyph > gap_end)
+	{
+	  /* The layout after the gap has been taken up again. */
+	  break;
+	}
+      if (layout_glyph > last
+	  && NSMinY(tc->linefrags[tc->num_linefrags - 1].rect) > y)
+	{
+	  if (!has_next)
+	    break;
+	  if (layout_glyph < gap_end)
+	    {
+	      /* Put back what is left of the gap. The next time round, the
+	      typesetter takes up the layout after it. */
+	      [self _addEstimatedLineFragToGlyph: gap_end
+				       character: gap_cend
+					  height: MAX(gap_maxy
+	- NSMaxY(tc->linefrags[tc->num_linefrags - 1].rect), 0.0)];
+	    }
+	}
+    }
+
+  /*
+  If the layout after the gap moved, move it back, and everything after it,
+  and let the part of the gap before the new layout make up for it.
+  */
+  k--;
+  if (has_next && has_gap && !tc->linefrags[k].estimated)
+    has_gap = NO;
+  if (has_next && has_gap)
+    {
+      int i = linefrag_index_for_glyph(tc, gap_end);
+      CGFloat delta;
+
+      if (i < 0 || tc->linefrags[i].pos != gap_end)
+	return;
+      delta = NSMinY(tc->linefrags[i].rect) - next_y;
+      if (delta > tc->linefrags[k].rect.size.height)
+	delta = tc->linefrags[k].rect.size.height;
+      if (delta == 0.0)
+	return;
+
+      lf = tc->linefrags + k;
+      lf->rect.size.height -= delta;
+      lf->used_rect.size.height -= delta;
+      for (i = k + 1, lf++; i < tc->num_linefrags + tc->num_soft; i++, lf++)
+	{
+	  lf->rect.origin.y -= delta;
+	  lf->used_rect.origin.y -= delta;
+	}
+      if (extra_textcontainer == tc->textContainer)
+	{
+	  extra_rect.origin.y -= delta;
+	  extra_used_rect.origin.y -= delta;
+	}
+      tc->usedRectValid = NO;
+    }
+}
+
+/* Makes sure that glyphIndex has been laid out for real. */
+-(void) _doNonContiguousLayoutToGlyph: (unsigned int)glyphIndex
+{
+  textcontainer_t *tc = textcontainers;
+  int k;
+
+  if (glyphIndex < layout_glyph)
+    {
+      k = linefrag_index_for_glyph(tc, glyphIndex);
+      if (k >= 0 && tc->linefrags[k].estimated)
+	{
+	  [self _fillEstimatedLineFrag: k
+			     fromGlyph: glyphIndex
+			       toGlyph: glyphIndex
+				  maxY: 0.0];
+	}
+    }
+  else if ([self isValidGlyphIndex: glyphIndex])
+    {
+      unsigned int cindex = [self characterIndexForGlyphAtIndex: glyphIndex];
+
+      if (cindex >= layout_char + NONCONTIGUOUS_LAYOUT_DISTANCE)
+	[self _jumpLayoutToCharacter: cindex];
+    }
+}
+
+/* Makes sure that everything in rect has been laid out for real, or is far
+enough below the layout to be laid out after an estimated line frag. */
+-(void) _doNonContiguousLayoutInRect: (NSRect)rect
+{
+  textcontainer_t *tc = textcontainers;
+  linefrag_t *lf;
+  CGFloat top = NSMinY(rect), bottom = NSMaxY(rect);
+  int k, tries;
+
+  /* Each try narrows down the estimated line frag at the top of rect, so
+  only a few are needed. */
+  for (tries = 0; tries < NONCONTIGUOUS_LAYOUT_TRIES; tries++)
+    {
+      unsigned int g;
+      NSRange cr;
+      CGFloat f;
+
+      for (k = linefrag_index_for_y(tc, top), lf = tc->linefrags + k;
+	   k < tc->num_linefrags && NSMinY(lf->rect) <= bottom; k++, lf++)
+	{
+	  if (lf->estimated)
+	    break;
+	}
+      if (k == tc->num_linefrags || NSMinY(lf->rect) > bottom)
+	break;
+
+      /* Guess which glyph is at the top of rect from where it is in the
+      estimated line frag. */
+      cr = [self characterRangeForGlyphRange: NSMakeRange(lf->pos, lf->length)
+			    actualGlyphRange: NULL];
+      f = 0.0;
+      if (top > NSMinY(lf->rect) && lf->rect.size.height > 0.0)
+	f = (top - NSMinY(lf->rect)) / lf->rect.size.height;
+      if (f > 1.0)
+	f = 1.0;
+      g = [self glyphRangeForCharacterRange:
+	NSMakeRange(cr.location + (unsigned int)((cr.length - 1) * f), 1)
+		       actualCharacterRange: NULL].location;
+
+      [self _fillEstimatedLineFrag: k
+			 fromGlyph: g
+			   toGlyph: g
+			      maxY: bottom];
+      tc = textcontainers;
+    }
+
+  if (!tc->complete && layout_char < [_textStorage length])
+    {
+      CGFloat y, h;
+      unsigned int cindex;
+
+      y = tc->num_linefrags ? NSMaxY(tc->linefrags[tc->num_linefrags - 1].rect) : 0.0;
+      if (top <= y)
+	return;
+      h = [self _estimatedHeightPerCharacter];
+      tc = textcontainers;
+      if (h <= 0.0 || tc->complete)
+	return;
+      y = NSMaxY(tc->linefrags[tc->num_linefrags - 1].rect);
+      if (top <= y)
+	return;
+
+      if ((top - y) / h >= [_textStorage length] - layout_char)
+	cindex = [_textStorage length] - 1;
+      else
+	cindex = layout_char + (unsigned int)((top - y) / h);
+      if (cindex >= layout_char + NONCONTIGUOUS_LAYOUT_DISTANCE)
+	[self _jumpLayoutToCharacter: cindex];
+    }
+}
+
+/*
+Lays out glyphRange. With non-contiguous layout, any estimated line frags in
+it are filled in, so that the whole range has been laid out for real.
+*/
+-(void) _doLayoutForGlyphRange: (NSRange)glyphRange
+{
+  textcontainer_t *tc;
+  unsigned int last;
+  int k;
+
+  last = NSMaxRange(glyphRange) - 1;
+  [self _doLayoutToGlyph: last];
+  if (!glyphRange.length || ![self _usesNonContiguousLayout])
+    return;
+
+  tc = textcontainers;
+  k = linefrag_index_for_glyph(tc, glyphRange.location);
+  if (k < 0)
+    return;
+  for (; k < tc->num_linefrags && tc->linefrags[k].pos <= last; k++)
+    {
+      linefrag_t *lf = tc->linefrags + k;
+
+      if (lf->estimated)
+	{
+	  unsigned int first = MAX(glyphRange.location, lf->pos);
+	  unsigned int end = lf->pos + lf->length - 1;
+
+	  [self _fillEstimatedLineFrag: k
+			     fromGlyph: first
+			       toGlyph: MIN(last, end)
+				  maxY: 0.0];
+	  tc = textcontainers;
+	  /* Line frags have moved, so carry on from the one that now holds
+	  the first glyph that was filled in. */
+	  k = linefrag_index_for_glyph(tc, first);
+	  if (k < 0)
+	    return;
+	  k--;
+	}
+    }
+}
+
+/*
+The estimated height of the text that hasn't been laid out yet, which
+-usedRectForTextContainer: leaves room for with non-contiguous layout.
+*/
+-(CGFloat) _estimatedHeightOfRemainingText
+{
+  unsigned int length = [_textStorage length];
+  CGFloat h;
+
+  if (textcontainers->complete || layout_char >= length)
+    return 0.0;
+  h = [self _estimatedHeightPerCharacter];
+  return (length - layout_char) * h;
+}
+
+/*
+Background layout. While it is enabled, invalidating layout schedules a zero
+delay timer that lays out a slice of the remaining text, bounded in time by
+BACKGROUND_LAYOUT_SLICE, and reschedules itself until all text has been laid
+out. Each slice runs from its own run loop iteration, so events are handled
+between slices. Requests for layout in the foreground (-_doLayoutToGlyph: and
+friends) simply continue from wherever background layout has got to.
+*/
+
+-(BOOL) _needsBackgroundLayout
+{
+  int i;
+
+  if (!backgroundLayoutEnabled || !_textStorage)
+    return NO;
+  if (layout_char >= [_textStorage length])
+    return NO;
+  for (i = 0; i < num_textcontainers; i++)
+    if (!textcontainers[i].complete)
+      return YES;
+  return NO;
+}
+
+-(void) _scheduleBackgroundLayout
+{
+  if (![self _needsBackgroundLayout])
+    {
+      [self _cancelBackgroundLayout];
+      return;
+    }
+  if (background_layout_pending)
+    return;
+
+  background_layout_pending = YES;
+  [self performSelector: @selector(_backgroundLayout:)
+             withObject: nil
+             afterDelay: 0.0
+                inModes: [NSArray arrayWithObjects:
+                                    NSDefaultRunLoopMode,
+                                  NSModalPanelRunLoopMode, nil]];
+}
+
+-(void) _cancelBackgroundLayout
+{
+  if (!background_layout_pending)
+    return;
+
+  background_layout_pending = NO;
+  [NSObject cancelPreviousPerformRequestsWithTarget: self
+                                           selector: @selector(_backgroundLayout:)
+                                             object: nil];
+}
+
+/*
+Lays out line frags, BACKGROUND_LAYOUT_LINES at a time, until all text has
+been laid out, all text containers are full, or limit has passed. Returns
+YES if there is nothing more to lay out.
+*/
+-(BOOL) _doBackgroundLayoutUntil: (NSTimeInterval)limit
+{
+  int i, j;
+  textcontainer_t *tc;
+  unsigned int next;
+  NSRect prev;
+  BOOL delegate_responds;
+
+  delegate_responds = [_delegate respondsToSelector:
+    @selector(layoutManager:didCompleteLayoutForTextContainer:atEnd:)];
+
+  next = layout_glyph;
+  for (i = 0, tc = textcontainers; i < num_textcontainers; i++, tc++)
+    {
+      if (tc->complete)
+          continue;
+
+      while (1)
+        {
+          if (tc->num_linefrags)
+            prev = tc->linefrags[tc->num_linefrags - 1].rect;
+          else
+            prev = NSZeroRect;
+          j = [[self typesetter] layoutGlyphsInLayoutManager: self
+                          inTextContainer: tc->textContainer
+                          startingAtGlyphIndex: next
+                          previousLineFragmentRect: prev
+                          nextGlyphIndex: &next
+                          numberOfLineFragments: BACKGROUND_LAYOUT_LINES];
+          if (j)
+            break;
+
+          if ([NSDate timeIntervalSinceReferenceDate] >= limit)
+            return NO;
+        }
+      tc = [self _completeLayoutForContainer: i
+                                       atEnd: j == 2
+                            delegateResponds: delegate_responds];
+      if (j == 2)
+        return YES;
+    }
+
+  /* There is more text, but no text container left to put it in. */
+  if (delegate_responds)
+    {
+      [_delegate layoutManager: self
+             didCompleteLayoutForTextContainer: nil
+                     atEnd: NO];
+    }
+  return YES;
+}
+
+-(void) _backgroundLayout: (id)sender
+{
+  int first;
+  BOOL done;
+
+  background_layout_pending = NO;
+  if (![self _needsBackgroundLayout])
+    return;
+
+  for (first = 0; first < num_textcontainers; first++)
+    if (!textcontainers[first].complete)
+      break;
+
+  done = [self _doBackgroundLayoutUntil:
+    [NSDate timeIntervalSinceReferenceDate] + BACKGROUND_LAYOUT_SLICE];
+  [self _didLayoutInBackgroundFromContainer: first];
+
+  if (!done)
+    [self _scheduleBackgroundLayout];
+}
+
+-(void) _didLayoutInBackgroundFromContainer: (int)idx
+{
+}
+
+-(BOOL) _usesParallelLayout
+{
+  return parallelLayoutEnabled && usesSystemTypesetter
+    && num_textcontainers == 1
+    && [textcontainers[0].textContainer isSimpleRectangularTextContainer]
+    && [textcontainers[0].textContainer maximumNumberOfLines] == 0;
+}
+
+/*
+Lays out text container i, which is the only one, up to the start of the
+last paragraph with parallel layout, if there is enough text to make it
+worthwhile. Whatever isn't laid out is left for normal layout.
+*/
+-(void) _doParallelLayoutInContainer: (int)i
+{
+  textcontainer_t *tc = textcontainers + i;
+  NSString *str = [_textStorage string];
+  unsigned int length = [str length];
+  unsigned int start, end, pos;
+  NSMutableArray *chunks;
+  GSLayoutChunkQueue *queue;
+  NSSize size;
+  CGFloat padding, y;
+  NSUInteger threads, j, count;
+
+  if (tc->complete || length - layout_char < PARALLEL_LAYOUT_MIN_LENGTH)
+    return;
+
+  /* Finish the paragraph layout is in the middle of, if any. */
+  while (layout_char && [str characterAtIndex: layout_char - 1] != '\n')
+    {
+      if ([self _layoutLineFragsInContainer: i  count: 1])
+	return;
+      tc = textcontainers + i;
+    }
+
+  start = layout_char;
+  end = [str paragraphRangeForRange: NSMakeRange(length - 1, 0)].location;
+  if (end <= start || end - start < PARALLEL_LAYOUT_MIN_LENGTH)
+    return;
+
+  size = [tc->textContainer containerSize];
+  padding = [tc->textContainer lineFragmentPadding];
+
+  /* Cut the text into chunks at paragraph boundaries. This generates the
+  glyphs, which has to be done here anyway. */
+  chunks = [NSMutableArray array];
+  for (pos = start; pos < end;)
+    {
+      GSLayoutChunk *chunk = AUTORELEASE([[GSLayoutChunk alloc] init]);
+      NSRange r;
+
+      r.location = pos;
+      if (end - pos <= PARALLEL_LAYOUT_CHUNK_LENGTH)
+	r.length = end - pos;
+      else
+	r.length = NSMaxRange([str paragraphRangeForRange:
+	  NSMakeRange(pos + PARALLEL_LAYOUT_CHUNK_LENGTH, 0)]) - pos;
+      if (NSMaxRange(r) > end)
+	r.length = end - pos;
+
+      chunk->text = RETAIN([_textStorage attributedSubstringFromRange: r]);
+      chunk->containerSize = size;
+      chunk->lineFragmentPadding = padding;
+      chunk->usesScreenFonts = usesScreenFonts;
+      chunk->usesFontLeading = usesFontLeading;
+      chunk->showsInvisibleCharacters = showsInvisibleCharacters;
+      chunk->showsControlCharacters = showsControlCharacters;
+      chunk->glyphRange = [self glyphRangeForCharacterRange: r
+				       actualCharacterRange: NULL];
+      [chunks addObject: chunk];
+      pos = NSMaxRange(r);
+    }
+
+  /* Lay them out, in this thread too. */
+  count = [chunks count];
+  queue = AUTORELEASE([[GSLayoutChunkQueue alloc] initWithChunks: chunks]);
+  threads = [[NSProcessInfo processInfo] activeProcessorCount];
+  if (threads > PARALLEL_LAYOUT_MAX_THREADS)
+    threads = PARALLEL_LAYOUT_MAX_THREADS;
+  if (threads > count)
+    threads = count;
+  if (threads > 1)
+    [GSLayoutWorkers addQueue: queue  helpers: threads - 1];
+  [queue work: nil];
+  [queue wait];
+
+  /* Stack the line frags. */
+  tc = textcontainers + i;
+  if (tc->num_soft)
+    {
+      linefrag_t *lf;
+
+      for (j = 0, lf = tc->linefrags + tc->num_linefrags; j < tc->num_soft; j++, lf++)
+	{
+	  free(lf->points);
+	  free(lf->attachments);
+	}
+      tc->num_soft = 0;
+    }
+  y = tc->num_linefrags ? NSMaxY(tc->linefrags[tc->num_linefrags - 1].rect) : 0.0;
+
+  for (j = 0; j < count; j++)
+    {
+      GSLayoutChunk *chunk = [chunks objectAtIndex: j];
+      NSRange r = chunk->glyphRange;
+      linefrag_t *lf;
+      int k, l;
+
+      if (chunk->failed || chunk->num_glyphs != r.length
+	  || r.location != layout_glyph || !chunk->num_linefrags
+	  || y + chunk->height > size.height)
+	break;
+
+      [self setTextContainer: tc->textContainer
+	       forGlyphRange: r];
+      tc = textcontainers + i;
+      for (k = 0; k < chunk->num_not_shown; k++)
+	[self setNotShownAttribute: YES
+		   forGlyphAtIndex: r.location + chunk->not_shown[k]];
+      for (k = 0; k < chunk->num_draws_outside; k++)
+	[self setDrawsOutsideLineFragment: YES
+			  forGlyphAtIndex: r.location + chunk->draws_outside[k]];
+
+      if (tc->size_linefrags < tc->num_linefrags + chunk->num_linefrags)
+	{
+	  tc->size_linefrags = tc->num_linefrags + chunk->num_linefrags
+	    + tc->size_linefrags / 2;
+	  tc->linefrags = realloc(tc->linefrags,
+	    sizeof(linefrag_t) * tc->size_linefrags);
+	}
+      lf = tc->linefrags + tc->num_linefrags;
+      memcpy(lf, chunk->linefrags, sizeof(linefrag_t) * chunk->num_linefrags);
+      for (k = 0; k < chunk->num_linefrags; k++, lf++)
+	{
+	  lf->rect.origin.y += y;
+	  lf->used_rect.origin.y += y;
+	  lf->pos += r.location;
+	  for (l = 0; l < lf->num_points; l++)
+	    lf->points[l].pos += r.location;
+	  for (l = 0; l < lf->num_attachments; l++)
+	    lf->attachments[l].pos += r.location;
+	}
+      tc->num_linefrags += chunk->num_linefrags;
+      /* The points and attachments now belong to the layout. */
+      free(chunk->linefrags);
+      chunk->linefrags = NULL;
+      chunk->num_linefrags = 0;
+
+      y += chunk->height;
+    }
+}
+
 -(void) _didInvalidateLayout
 {
   int i;
@@ -2022,6 +3050,71 @@ places where we switch.
       // FIXME: This value never gets used
       tc->was_invalidated = YES;
     }
+
+  [self _scheduleBackgroundLayout];
+}
+
+@end
+
+@implementation GSLayoutManager (ParallelLayoutChunks)
+
+/* Lays out all text (which is a chunk of paragraphs) and hands the result
+over to the chunk. */
+-(void) _takeLayoutForChunk: (GSLayoutChunk *)chunk
+{
+  textcontainer_t *tc;
+  glyph_run_t *r;
+  unsigned int pos, i;
+  int size_not_shown = 0, size_draws_outside = 0;
+
+  [self _doLayout];
+  tc = textcontainers;
+
+  chunk->num_glyphs = [self numberOfGlyphs];
+  if (tc->num_soft || tc->pos + tc->length != chunk->num_glyphs)
+    {
+      /* It didn't fit in the text container. */
+      chunk->failed = YES;
+      return;
+    }
+
+  chunk->linefrags = tc->linefrags;
+  chunk->num_linefrags = tc->num_linefrags;
+  tc->linefrags = NULL;
+  tc->num_linefrags = tc->size_linefrags = 0;
+
+  if (extra_textcontainer)
+    chunk->height = NSMinY(extra_rect);
+  else if (chunk->num_linefrags)
+    chunk->height = NSMaxY(chunk->linefrags[chunk->num_linefrags - 1].rect);
+
+  r = (glyph_run_t *)(glyphs + SKIP_LIST_DEPTH - 1)->next;
+  for (pos = 0; r; pos += r->head.glyph_length, r = (glyph_run_t *)r->head.next)
+    {
+      for (i = 0; i < r->head.glyph_length; i++)
+	{
+	  if (r->glyphs[i].isNotShown)
+	    {
+	      if (chunk->num_not_shown == size_not_shown)
+		{
+		  size_not_shown = size_not_shown * 2 + 16;
+		  chunk->not_shown = realloc(chunk->not_shown,
+		    sizeof(unsigned int) * size_not_shown);
+		}
+	      chunk->not_shown[chunk->num_not_shown++] = pos + i;
+	    }
+	  if (r->glyphs[i].drawsOutsideLineFragment)
+	    {
+	      if (chunk->num_draws_outside == size_draws_outside)
+		{
+		  size_draws_outside = size_draws_outside * 2 + 16;
+		  chunk->draws_outside = realloc(chunk->draws_outside,
+		    sizeof(unsigned int) * size_draws_outside);
+		}
+	      chunk->draws_outside[chunk->num_draws_outside++] = pos + i;
+	    }
+	}
+    }
 }
 
 @end
@@ -2262,6 +3355,10 @@ by calling this incorrectly.
       lf = &tc->linefrags[tc->num_linefrags - 1];
     }
 
+  /* A line frag the cached used rect covers is being replaced. */
+  if (tc->usedRectLineFrags >= tc->num_linefrags)
+    tc->usedRectValid = NO;
+
   memset(lf, 0, sizeof(linefrag_t));
   lf->rect = fragmentRect;
   lf->used_rect = usedRect;
@@ -2363,19 +3460,16 @@ forStartOfGlyphRange: (NSRange)glyphRange
       return;
     }
 
-  for (i = 0, lf = tc->linefrags; i < tc->num_linefrags; i++, lf++)
-    {
-      if (lf->pos <= glyphRange.location &&
-	  lf->pos + lf->length >= glyphRange.location + glyphRange.length)
-	break;
-    }
-  if (i == tc->num_linefrags)
+  i = linefrag_index_for_glyph(tc, glyphRange.location);
+  if (i < 0 || tc->linefrags[i].pos + tc->linefrags[i].length
+		 < glyphRange.location + glyphRange.length)
     {
       [NSException raise: NSRangeException
 		  format: @"%s: glyph range not consistent with existing layout",
 			  __PRETTY_FUNCTION__];
       return;
     }
+  lf = tc->linefrags + i;
 
   /* TODO: we do no sanity checking of attachment size ranges. might want
   to consider doing it */
@@ -2455,14 +3549,13 @@ forStartOfGlyphRange: (NSRange)glyphRange
       return NSZeroRect;
     }
 
-  for (i = 0, lf = tc->linefrags; i < tc->num_linefrags; i++, lf++)
-    if (lf->pos + lf->length > glyphIndex)
-      break;
-  if (i == tc->num_linefrags)
+  i = linefrag_index_for_glyph(tc, glyphIndex);
+  if (i < 0)
     {
       NSLog(@"%s: can't find line frag rect for glyph (internal error)", __PRETTY_FUNCTION__);
       return NSZeroRect;
     }
+  lf = tc->linefrags + i;
 
   if (effectiveGlyphRange)
     {
@@ -2499,14 +3592,13 @@ forStartOfGlyphRange: (NSRange)glyphRange
       return NSMakeRect(0, 0, 0, 0);
     }
 
-  for (i = 0, lf = tc->linefrags; i < tc->num_linefrags; i++, lf++)
-    if (lf->pos + lf->length > glyphIndex)
-      break;
-  if (i == tc->num_linefrags)
+  i = linefrag_index_for_glyph(tc, glyphIndex);
+  if (i < 0)
     {
       NSLog(@"%s: can't find line frag rect for glyph (internal error)", __PRETTY_FUNCTION__);
       return NSMakeRect(0, 0, 0, 0);
     }
+  lf = tc->linefrags + i;
 
   if (effectiveGlyphRange)
     {
@@ -2533,14 +3625,13 @@ forStartOfGlyphRange: (NSRange)glyphRange
       return NSMakeRange(NSNotFound, 0);
     }
 
-  for (i = 0, lf = tc->linefrags; i < tc->num_linefrags; i++, lf++)
-    if (lf->pos + lf->length > glyphIndex)
-      break;
-  if (i == tc->num_linefrags)
+  i = linefrag_index_for_glyph(tc, glyphIndex);
+  if (i < 0)
     {
       NSLog(@"%s: can't find line frag rect for glyph (internal error)", __PRETTY_FUNCTION__);
       return NSMakeRange(NSNotFound, 0);
     }
+  lf = tc->linefrags + i;
 
   for (i = 0, lp = lf->points; i < lf->num_points; i++, lp++)
     if (lp->pos + lp->length > glyphIndex)
@@ -2564,13 +3655,16 @@ forStartOfGlyphRange: (NSRange)glyphRange
 }
 
 
-/* The union of all line frag rects' used rects. */
+/* The union of all line frag rects' used rects. While background layout is
+enabled, this doesn't cause any layout, and only covers the line frags laid
+out so far. */
 - (NSRect) usedRectForTextContainer: (NSTextContainer *)container
 {
   textcontainer_t *tc;
   linefrag_t *lf;
   int i;
   NSRect used;
+  CGFloat remaining = 0.0;
 
   for (i = 0, tc = textcontainers; i < num_textcontainers; i++, tc++)
     if (tc->textContainer == container)
@@ -2580,33 +3674,55 @@ forStartOfGlyphRange: (NSRange)glyphRange
       NSLog(@"%s: doesn't own text container", __PRETTY_FUNCTION__);
       return NSMakeRect(0, 0, 0, 0);
     }
-  if (!tc->complete)
+  if (!tc->complete && [self _usesNonContiguousLayout])
+    {
+      /* Leave room for the rest of the text instead of laying it out. */
+      remaining = [self _estimatedHeightOfRemainingText];
+      tc = textcontainers + i;
+    }
+  else if (!tc->complete && !backgroundLayoutEnabled)
     {
       [self _doLayoutToContainer: i];
       tc = textcontainers + i;
     }
 
-  if (tc->usedRectValid)
+  if (!tc->usedRectValid || tc->usedRectLineFrags > tc->num_linefrags)
     {
-      used = tc->usedRect;
-      if (tc->textContainer == extra_textcontainer)
-        {
-          used = NSUnionRect(used, extra_used_rect);
-        }
-      return used;
+      tc->usedRect = NSZeroRect;
+      tc->usedRectLineFrags = 0;
+      tc->usedRectValid = YES;
     }
 
-  if (tc->num_linefrags)
+  /* Extend the cached rect with any line frags added since it was built. */
+  if (tc->usedRectLineFrags < tc->num_linefrags)
     {
       double x0, y0, x1, y1;
-      i = 0;
-      lf = tc->linefrags;
-      x0 = NSMinX(lf->used_rect);
-      y0 = NSMinY(lf->used_rect);
-      x1 = NSMaxX(lf->used_rect);
-      y1 = NSMaxY(lf->used_rect);
-      for (i++, lf++; i < tc->num_linefrags; i++, lf++)
+      i = tc->usedRectLineFrags;
+      lf = tc->linefrags + i;
+      if (!i)
+        {
+          x0 = NSMinX(lf->used_rect);
+          y0 = NSMinY(lf->used_rect);
+          x1 = NSMaxX(lf->used_rect);
+          y1 = NSMaxY(lf->used_rect);
+          i++, lf++;
+        }
+      else
+        {
+          x0 = NSMinX(tc->usedRect);
+          y0 = NSMinY(tc->usedRect);
+          x1 = NSMaxX(tc->usedRect);
+          y1 = NSMaxY(tc->usedRect);
+        }
+      for (; i < tc->num_linefrags; i++, lf++)
 	{
+	  if (lf->estimated)
+	    {
+	      /* Only its height is known. */
+	      if (NSMaxY(lf->used_rect) > y1)
+		y1 = NSMaxY(lf->used_rect);
+	      continue;
+	    }
 	  if (NSMinX(lf->used_rect) < x0)
 	    x0 = NSMinX(lf->used_rect);
 	  if (NSMinY(lf->used_rect) < y0)
@@ -2616,18 +3732,16 @@ forStartOfGlyphRange: (NSRange)glyphRange
 	  if (NSMaxY(lf->used_rect) > y1)
 	    y1 = NSMaxY(lf->used_rect);
 	}
-      used = NSMakeRect(x0, y0, x1 - x0, y1 - y0);
+      tc->usedRect = NSMakeRect(x0, y0, x1 - x0, y1 - y0);
+      tc->usedRectLineFrags = tc->num_linefrags;
     }
-  else
-    {
-      used = NSZeroRect;
-    }  
-  tc->usedRect = used;
-  tc->usedRectValid = YES;
+
+  used = tc->usedRect;
   if (tc->textContainer == extra_textcontainer)
     {
       used = NSUnionRect(used, extra_used_rect);
     }
+  used.size.height += remaining;
   return used;
 }
 
@@ -2802,6 +3916,10 @@ forStartOfGlyphRange: (NSRange)glyphRange
 	  lf->used_rect.origin.y += shift.height;
 	}
     }
+  if (tc->usedRectLineFrags > tc->num_linefrags)
+    tc->usedRectValid = NO;
+  tc->num_estimated += linefrags_estimated(tc->linefrags + tc->num_linefrags,
+    num);
   tc->num_soft -= num;
   tc->num_linefrags += num;
   lf = &tc->linefrags[tc->num_linefrags - 1];
@@ -2877,6 +3995,34 @@ forStartOfGlyphRange: (NSRange)glyphRange
   return tc->num_soft;
 }
 
+-(unsigned int) _numberOfLinesInTextContainer: (NSTextContainer *)textContainer
+{
+  int i, j;
+  textcontainer_t *tc;
+  linefrag_t *lf;
+  unsigned int lines = 0;
+  CGFloat baseline, last = 0.0;
+
+  for (i = 0, tc = textcontainers; i < num_textcontainers; i++, tc++)
+    if (tc->textContainer == textContainer)
+      break;
+  if (i == num_textcontainers)
+    {
+      NSLog(@"(%s): does not own text container", __PRETTY_FUNCTION__);
+      return 0;
+    }
+  for (j = 0, lf = tc->linefrags; j < tc->num_linefrags; j++, lf++)
+    {
+      baseline = NSMinY(lf->rect);
+      if (lf->num_points)
+	baseline += lf->points[0].p.y;
+      if (!lines || baseline != last)
+	lines++;
+      last = baseline;
+    }
+  return lines;
+}
+
 @end
 
 
@@ -2893,6 +4039,7 @@ forStartOfGlyphRange: (NSRange)glyphRange
   [self setGlyphGenerator: [NSGlyphGenerator sharedGlyphGenerator]];
 
   usesScreenFonts = YES;
+  usesFontLeading = YES;
   [self _initGlyphs];
 
   return self;
@@ -2907,6 +4054,7 @@ forStartOfGlyphRange: (NSRange)glyphRange
   rect_array_size = 0;
   rect_array = NULL;
 
+  [self _cancelBackgroundLayout];
   [self _freeLayout];
   for (i = 0, tc = textcontainers; i < num_textcontainers; i++, tc++)
     {
@@ -3008,13 +4156,21 @@ See [NSTextView -setTextContainer:] for more information about these calls.
 }
 
 
+/*
+The system typesetter is per thread, so a layout manager using it uses the
+one of the thread it is laying out in. That way, layout managers laying out
+in different threads don't contend for one typesetter.
+*/
 -(GSTypesetter *) typesetter
 {
+  if (usesSystemTypesetter)
+    return [GSTypesetter sharedSystemTypesetter];
   return typesetter;
 }
 -(void) setTypesetter: (GSTypesetter *)a_typesetter
 {
   ASSIGN(typesetter, a_typesetter);
+  usesSystemTypesetter = (typesetter == [GSTypesetter sharedSystemTypesetter]);
 }
 
 - (BOOL) usesScreenFonts
@@ -3032,6 +4188,21 @@ See [NSTextView -setTextContainer:] for more information about these calls.
   [self _didInvalidateLayout];
 }
 
+- (BOOL) usesFontLeading
+{
+  return usesFontLeading;
+}
+
+- (void) setUsesFontLeading: (BOOL)flag
+{
+  flag = !!flag;
+  if (flag == usesFontLeading)
+    return;
+  usesFontLeading = flag;
+  [self _invalidateLayoutFromContainer: 0];
+  [self _didInvalidateLayout];
+}
+
 - (NSFont *) substituteFontForFont: (NSFont *)originalFont
 {
   NSFont *f;
@@ -3051,13 +4222,25 @@ See [NSTextView -setTextContainer:] for more information about these calls.
   if (flag == backgroundLayoutEnabled)
     return;
   backgroundLayoutEnabled = flag;
-  /* TODO */
+  if (flag)
+    [self _scheduleBackgroundLayout];
+  else
+    [self _cancelBackgroundLayout];
 }
 - (BOOL) backgroundLayoutEnabled
 {
   return backgroundLayoutEnabled;
 }
 
+- (void) setParallelLayoutEnabled: (BOOL)flag
+{
+  parallelLayoutEnabled = !!flag;
+}
+- (BOOL) parallelLayoutEnabled
+{
+  return parallelLayoutEnabled;
+}
+
 - (void) setShowsInvisibleCharacters: (BOOL)flag
 {
   flag = !!flag;
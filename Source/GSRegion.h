@@ -0,0 +1,67 @@
+/*
+   GSRegion.h
+
+   A small list of disjoint rectangles, used for the area of a view which
+   needs display and the area being drawn.
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of the GNUstep GUI Library.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; see the file COPYING.LIB.
+   If not, see <http://www.gnu.org/licenses/> or write to the
+   Free Software Foundation, 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef _GNUstep_H_GSRegion
+#define _GNUstep_H_GSRegion
+
+#import <Foundation/NSGeometry.h>
+
+/* The most rectangles a region holds.  Beyond this, rectangles are merged
+ * with the ones they add least area to.
+ */
+#define	GS_REGION_MAX_RECTS	8
+
+typedef struct _GSRegion
+{
+  NSUInteger count;
+  NSRect bounds;	/* The union of the rectangles. */
+  NSRect rects[GS_REGION_MAX_RECTS];
+} GSRegion;
+
+/* Empties the region. */
+void GSRegionInit(GSRegion *region);
+
+/* Adds rect to the region.  Rectangles which overlap rect, or which
+ * nearly touch it, are merged with it, so the rectangles stay disjoint.
+ */
+void GSRegionAddRect(GSRegion *region, NSRect rect);
+
+/* Restricts the region to rect. */
+void GSRegionIntersectRect(GSRegion *region, NSRect rect);
+
+/* Removes rect from the region.  Rectangles which are only partly covered
+ * by rect are kept, unless what is left of them is a rectangle.
+ */
+void GSRegionSubtractRect(GSRegion *region, NSRect rect);
+
+/* Returns YES if rect is inside one of the rectangles of the region. */
+BOOL GSRegionContainsRect(const GSRegion *region, NSRect rect);
+
+/* Returns YES if rect overlaps one of the rectangles of the region. */
+BOOL GSRegionIntersectsRect(const GSRegion *region, NSRect rect);
+
+#endif /* _GNUstep_H_GSRegion */
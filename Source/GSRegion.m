@@ -0,0 +1,235 @@
+/*
+   GSRegion.m
+
+   A small list of disjoint rectangles, used for the area of a view which
+   needs display and the area being drawn.
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of the GNUstep GUI Library.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; see the file COPYING.LIB.
+   If not, see <http://www.gnu.org/licenses/> or write to the
+   Free Software Foundation, 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#import "config.h"
+#import "GSRegion.h"
+
+/* Two rectangles are merged when the rectangle enclosing them is at most
+ * this much larger than they are together.  Drawing a little more is
+ * cheaper than drawing twice.
+ */
+#define	MERGE_FACTOR	1.25
+
+static inline CGFloat
+area(NSRect r)
+{
+  return NSWidth(r) * NSHeight(r);
+}
+
+static void
+remove_rect(GSRegion *region, NSUInteger i)
+{
+  region->rects[i] = region->rects[--region->count];
+}
+
+static void
+update_bounds(GSRegion *region)
+{
+  NSUInteger i;
+
+  region->bounds = NSZeroRect;
+  for (i = 0; i < region->count; i++)
+    {
+      region->bounds = NSUnionRect(region->bounds, region->rects[i]);
+    }
+}
+
+void
+GSRegionInit(GSRegion *region)
+{
+  region->count = 0;
+  region->bounds = NSZeroRect;
+}
+
+void
+GSRegionAddRect(GSRegion *region, NSRect rect)
+{
+  BOOL merged;
+  NSUInteger i;
+
+  if (NSIsEmptyRect(rect) || GSRegionContainsRect(region, rect))
+    {
+      return;
+    }
+
+  do
+    {
+      merged = NO;
+      for (i = 0; i < region->count; i++)
+	{
+	  NSRect r = region->rects[i];
+	  NSRect u = NSUnionRect(r, rect);
+
+	  if (NSIntersectsRect(r, rect)
+	    || area(u) <= (area(r) + area(rect)) * MERGE_FACTOR)
+	    {
+	      rect = u;
+	      remove_rect(region, i);
+	      merged = YES;
+	      break;
+	    }
+	}
+
+      if (merged == NO && region->count == GS_REGION_MAX_RECTS)
+	{
+	  NSUInteger best = 0;
+	  CGFloat least = 0.0;
+
+	  /* Full, so merge with the rectangle that adds the least area. */
+	  for (i = 0; i < region->count; i++)
+	    {
+	      NSRect r = region->rects[i];
+	      CGFloat added = area(NSUnionRect(r, rect)) - area(r) - area(rect);
+
+	      if (i == 0 || added < least)
+		{
+		  best = i;
+		  least = added;
+		}
+	    }
+	  rect = NSUnionRect(region->rects[best], rect);
+	  remove_rect(region, best);
+	  merged = YES;
+	}
+    }
+  while (merged);
+
+  region->rects[region->count++] = rect;
+  region->bounds = NSUnionRect(region->bounds, rect);
+}
+
+void
+GSRegionIntersectRect(GSRegion *region, NSRect rect)
+{
+  NSUInteger i = region->count;
+
+  if (NSContainsRect(rect, region->bounds))
+    {
+      return;
+    }
+  while (i-- > 0)
+    {
+      NSRect r = NSIntersectionRect(region->rects[i], rect);
+
+      if (NSIsEmptyRect(r))
+	{
+	  remove_rect(region, i);
+	}
+      else
+	{
+	  region->rects[i] = r;
+	}
+    }
+  update_bounds(region);
+}
+
+void
+GSRegionSubtractRect(GSRegion *region, NSRect rect)
+{
+  NSUInteger i = region->count;
+
+  if (!NSIntersectsRect(region->bounds, rect))
+    {
+      return;
+    }
+  while (i-- > 0)
+    {
+      NSRect r = region->rects[i];
+
+      if (!NSIntersectsRect(r, rect))
+	{
+	  continue;
+	}
+      if (NSContainsRect(rect, r))
+	{
+	  remove_rect(region, i);
+	  continue;
+	}
+      if (NSMinY(rect) <= NSMinY(r) && NSMaxY(rect) >= NSMaxY(r))
+	{
+	  /* rect covers a vertical strip of r; keep what is left of it
+	     if it is on one side only. */
+	  if (NSMinX(rect) <= NSMinX(r))
+	    {
+	      r.size.width = NSMaxX(r) - NSMaxX(rect);
+	      r.origin.x = NSMaxX(rect);
+	    }
+	  else if (NSMaxX(rect) >= NSMaxX(r))
+	    {
+	      r.size.width = NSMinX(rect) - NSMinX(r);
+	    }
+	}
+      else if (NSMinX(rect) <= NSMinX(r) && NSMaxX(rect) >= NSMaxX(r))
+	{
+	  if (NSMinY(rect) <= NSMinY(r))
+	    {
+	      r.size.height = NSMaxY(r) - NSMaxY(rect);
+	      r.origin.y = NSMaxY(rect);
+	    }
+	  else if (NSMaxY(rect) >= NSMaxY(r))
+	    {
+	      r.size.height = NSMinY(rect) - NSMinY(r);
+	    }
+	}
+      region->rects[i] = r;
+    }
+  update_bounds(region);
+}
+
+BOOL
+GSRegionContainsRect(const GSRegion *region, NSRect rect)
+{
+  NSUInteger i;
+
+  for (i = 0; i < region->count; i++)
+    {
+      if (NSContainsRect(region->rects[i], rect))
+	{
+	  return YES;
+	}
+    }
+  return NO;
+}
+
+BOOL
+GSRegionIntersectsRect(const GSRegion *region, NSRect rect)
+{
+  NSUInteger i;
+
+  if (!NSIntersectsRect(region->bounds, rect))
+    {
+      return NO;
+    }
+  for (i = 0; i < region->count; i++)
+    {
+      if (NSIntersectsRect(region->rects[i], rect))
+	{
+	  return YES;
+	}
+    }
+  return NO;
+}
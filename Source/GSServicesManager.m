@@ -56,6 +56,7 @@
 #import "AppKit/NSWindow.h"
 #import "AppKit/NSWorkspace.h"
 #import "AppKit/NSDocumentController.h"
+#import "AppKit/NSEvent.h"
 
 #import "GNUstepGUI/GSServicesManager.h"
 #import "GSGuiPrivate.h"
@@ -90,6 +91,83 @@ static NSString		*providerName = nil;
 
 static NSDictionary *serviceFromAnyLocalizedTitle(NSString *title);
 
+/* Whether the responder chain from resp has a valid requestor for the
+ * types.  Many services take the same types, so the answers are kept
+ * until the next event or until the first responder changes.  The event
+ * and the responder are only compared, never sent messages, so they are
+ * not retained.  An event may be allocated where the previous one was,
+ * so its time and type are compared as well as its address.
+ */
+static BOOL
+hasRequestor(NSResponder *resp, NSString *sendType, NSString *returnType)
+{
+  static NSMutableDictionary	*known = nil;
+  static NSEvent		*knownEvent = nil;
+  static NSTimeInterval		knownTime = 0.0;
+  static NSEventType		knownType = 0;
+  static NSResponder		*knownResponder = nil;
+  NSEvent	*event = [NSApp currentEvent];
+  NSTimeInterval time = 0.0;
+  NSEventType	type = 0;
+  NSString	*key;
+  NSNumber	*answer;
+
+  if (known == nil)
+    {
+      known = [NSMutableDictionary new];
+    }
+  if (event != nil)
+    {
+      time = [event timestamp];
+      type = [event type];
+    }
+  if (event != knownEvent || time != knownTime || type != knownType
+    || resp != knownResponder)
+    {
+      knownEvent = event;
+      knownTime = time;
+      knownType = type;
+      knownResponder = resp;
+      [known removeAllObjects];
+    }
+
+  key = [NSString stringWithFormat: @"%@\n%@",
+    (sendType == nil) ? (id)@"" : (id)sendType,
+    (returnType == nil) ? (id)@"" : (id)returnType];
+  answer = [known objectForKey: key];
+  if (answer == nil)
+    {
+      answer = [NSNumber numberWithBool:
+	[resp validRequestorForSendType: sendType
+			     returnType: returnType] != nil];
+      [known setObject: answer forKey: key];
+    }
+  return [answer boolValue];
+}
+
+/* Whether menu, or one of its submenus, is on screen.  */
+static BOOL
+isShown(NSMenu *menu)
+{
+  NSArray	*a = [menu itemArray];
+  NSUInteger	i;
+
+  if ([[menu window] isVisible])
+    {
+      return YES;
+    }
+  for (i = 0; i < [a count]; i++)
+    {
+      NSMenu	*sub = [[a objectAtIndex: i] submenu];
+
+      if (sub != nil && isShown(sub))
+	{
+	  return YES;
+	}
+    }
+  return NO;
+}
+
 /**
  * Unregisters the service provider registered on the named port.<br />
  * Applications should use [NSApplication-setServicesProvider:] with a nil
@@ -1602,8 +1680,7 @@ static NSString         *disabledName = @".GNUstepDisabled";
     {
       if (er == 0)
 	{
-	  if ([resp validRequestorForSendType: nil
-				   returnType: nil] != nil)
+	  if (hasRequestor(resp, nil, nil))
 	    return YES;
 	}
       else
@@ -1613,8 +1690,7 @@ static NSString         *disabledName = @".GNUstepDisabled";
 	      NSString      *returnType;
 
 	      returnType = [returnTypes objectAtIndex: j];
-	      if ([resp validRequestorForSendType: nil
-				       returnType: returnType] != nil)
+	      if (hasRequestor(resp, nil, returnType))
 		return YES;
 	    }
 	}
@@ -1629,8 +1705,7 @@ static NSString         *disabledName = @".GNUstepDisabled";
 
 	  if (er == 0)
 	    {
-	      if ([resp validRequestorForSendType: sendType
-				       returnType: nil] != nil)
+	      if (hasRequestor(resp, sendType, nil))
 		return YES;
 	    }
 	  else
@@ -1640,8 +1715,7 @@ static NSString         *disabledName = @".GNUstepDisabled";
 		  NSString      *returnType;
 
 		  returnType = [returnTypes objectAtIndex: j];
-		  if ([resp validRequestorForSendType: sendType
-					   returnType: returnType] != nil)
+		  if (hasRequestor(resp, sendType, returnType))
 		    return YES;
 		}
 	    }
@@ -1652,7 +1726,10 @@ static NSString         *disabledName = @".GNUstepDisabled";
 
 - (void) updateServicesMenu
 {
-  if (_servicesMenu && [[_application mainMenu] autoenablesItems])
+  /* The menu is updated when it is displayed, so leave it alone while it
+     is not on screen.  */
+  if (_servicesMenu && [[_application mainMenu] autoenablesItems]
+    && isShown(_servicesMenu))
     {
       NSArray   	*a;
       unsigned  	i;
@@ -43,6 +43,7 @@
   // local attributes
   NSString *findString;
   NSString *replaceString;
+  BOOL usesRegularExpressions;
 
   // GUI
   NSPanel *panel;
@@ -77,6 +78,17 @@
 	      onlyInSelection: (BOOL)flag;
 - (NSTextView *) targetView: (NSTextView *)aTextView;
 
+// the strings to find and to replace them with
+- (NSString *) findString;
+- (void) setFindString: (NSString *)aString;
+- (NSString *) replaceString;
+- (void) setReplaceString: (NSString *)aString;
+
+// treat the find string as a regular expression and the replace string as
+// its template
+- (BOOL) usesRegularExpressions;
+- (void) setUsesRegularExpressions: (BOOL)flag;
+
 @end
 
 #endif /* _GS_TEXT_FINDER_H */
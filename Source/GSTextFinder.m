@@ -25,8 +25,11 @@
 */
 
 #import "config.h"
+#import <Foundation/NSArray.h>
+#import <Foundation/NSRegularExpression.h>
 #import <Foundation/NSString.h>
 #import <Foundation/NSNotification.h>
+#import <Foundation/NSValue.h>
 #import "AppKit/NSApplication.h"
 #import "AppKit/NSButton.h"
 #import "AppKit/NSEvent.h"
@@ -53,6 +56,23 @@
 - (void) _putFindStringToPasteboard;
 @end
 
+@interface NSTextView (GSTextFinder)
+- (void) _replaceCharactersInRanges: (NSArray *)ranges
+			withStrings: (NSArray *)strings;
+@end
+
+@interface GSTextFinder(ReplaceAll)
+- (NSRegularExpression *) _regularExpressionWithOptions: (unsigned int)options;
+- (NSString *) _replacementForRange: (NSRange)range
+			   inString: (NSString *)string
+			    options: (unsigned int)options;
+- (NSUInteger) _findMatchesInString: (NSString *)string
+			      range: (NSRange)range
+			    options: (unsigned int)options
+			     ranges: (NSMutableArray *)ranges
+			    strings: (NSMutableArray *)strings;
+@end
+
 @implementation GSTextFinder
 
 static GSTextFinder *sharedTextFinder;
@@ -290,6 +310,13 @@ static GSTextFinder *sharedTextFinder;
   string = [aTextView string];
   selectedRange = [aTextView selectedRange];
   [self _updateFindStringFromPanel: &options putToPasteboard: YES];
+  if ((options & NSRegularExpressionSearch)
+      && [self _regularExpressionWithOptions: options] == nil)
+    {
+      [messageText setStringValue: _(@"Invalid regular expression")];
+      NSBeep();
+      return NO;
+    }
   if (forward)
     {
       range = NSMakeRange(NSMaxRange(selectedRange),
@@ -342,25 +369,40 @@ static GSTextFinder *sharedTextFinder;
     {
       NSRange range = [aTextView selectedRange];
 
+      unsigned int options = NSLiteralSearch | NSCaseInsensitiveSearch;
+      NSString *replacement;
+
+      [self _updateFindStringFromPanel: &options putToPasteboard: NO];
+      [self _updateReplaceStringFromPanel];
+      replacement = [self _replacementForRange: range
+				      inString: [aTextView string]
+				       options: options];
       if ([aTextView shouldChangeTextInRange: range
-			   replacementString: replaceString])
+			   replacementString: replacement])
 	{
-	  [self _updateReplaceStringFromPanel];
 	  [aTextView replaceCharactersInRange: range
-				   withString: replaceString];
+				   withString: replacement];
 	  [aTextView didChangeText];
 	  [aTextView scrollRangeToVisible: range];
 	}
     }
 }
 
+/* All the matches are found before anything is replaced, and then replaced
+ * in a single change to the text, so the delegate is asked once, the change
+ * is undone as one action and the layout is invalidated only once.
+ */
 - (void) replaceAllInTextView: (NSTextView *)aTextView
 	      onlyInSelection: (BOOL)flag
 {
-  int n;
+  NSUInteger n;
   NSRange range, replaceRange;
   NSString *format;
   NSString *string;
+  NSMutableArray *ranges;
+  NSMutableArray *strings;
+  NSInteger delta = 0;
+  NSUInteger i;
   unsigned int options = NSLiteralSearch | NSCaseInsensitiveSearch;
   [messageText setStringValue: @""];
   if (aTextView == nil)
@@ -368,52 +410,89 @@ static GSTextFinder *sharedTextFinder;
 
   [self _updateFindStringFromPanel: &options putToPasteboard: YES];
   [self _updateReplaceStringFromPanel];
+  if ((options & NSRegularExpressionSearch)
+      && [self _regularExpressionWithOptions: options] == nil)
+    {
+      [messageText setStringValue: _(@"Invalid regular expression")];
+      NSBeep();
+      return;
+    }
   string = [aTextView string];
   replaceRange =
     flag ? [aTextView selectedRange] : NSMakeRange(0, [string length]);
 
-  // look for a first match in the range
-  range = [string rangeOfString: findString
-			options: options
-			  range: replaceRange];
-  if (range.location == NSNotFound)
+  ranges = [NSMutableArray array];
+  strings = [NSMutableArray array];
+  n = [self _findMatchesInString: string
+			   range: replaceRange
+			 options: options
+			  ranges: ranges
+			 strings: strings];
+  if (n == 0)
     {
       [messageText setStringValue: _(@"Not found")];
       NSBeep();
       return;
     }
 
-  n = 0;
-  do
+  if ([aTextView shouldChangeTextInRanges: ranges
+		       replacementStrings: strings])
     {
-      if ([aTextView shouldChangeTextInRange: range
-			   replacementString: replaceString])
+      for (i = 0; i < n; i++)
 	{
-	  [aTextView replaceCharactersInRange: range
-				   withString: replaceString];
-	  [aTextView didChangeText];
-	  n++;
+	  delta += (NSInteger)[[strings objectAtIndex: i] length]
+	    - (NSInteger)[[ranges objectAtIndex: i] rangeValue].length;
 	}
-
-      replaceRange =
-	NSMakeRange(range.location + [replaceString length],
-		    NSMaxRange(replaceRange) -
-		    (range.location + [findString length]));
-      range = [string rangeOfString: findString
-			    options: options
-			      range: replaceRange];
+      [aTextView _replaceCharactersInRanges: ranges withStrings: strings];
+      [aTextView didChangeText];
+    }
+  else
+    {
+      n = 0;
     }
-  while (range.location != NSNotFound);
 
   format = _(@"%d replaced");
-  [messageText setStringValue: [NSString stringWithFormat: format, n]];
+  [messageText setStringValue: [NSString stringWithFormat: format, (int)n]];
 
   // set insertion point to the end of the last match
-  range = NSMakeRange(replaceRange.location, 0);
+  range = [[ranges lastObject] rangeValue];
+  range = NSMakeRange(NSMaxRange(range) + delta, 0);
   [aTextView setSelectedRange: range];
   [aTextView scrollRangeToVisible: range];
 }
 
+- (NSString *) findString
+{
+  return findString;
+}
+
+- (void) setFindString: (NSString *)aString
+{
+  ASSIGNCOPY(findString, aString);
+  [findText setStringValue: findString];
+}
+
+- (NSString *) replaceString
+{
+  return replaceString;
+}
+
+- (void) setReplaceString: (NSString *)aString
+{
+  ASSIGNCOPY(replaceString, aString);
+  [replaceText setStringValue: replaceString];
+}
+
+- (BOOL) usesRegularExpressions
+{
+  return usesRegularExpressions;
+}
+
+- (void) setUsesRegularExpressions: (BOOL)flag
+{
+  usesRegularExpressions = flag;
+}
+
 - (NSTextView *) targetView: (NSTextView *)aTextView
 {
   // If aTextView is equal to the find panel's field editor use the default
@@ -489,6 +568,12 @@ static GSTextFinder *sharedTextFinder;
 	}
     }
 
+  if (usesRegularExpressions)
+    {
+      *options |= NSRegularExpressionSearch;
+      *options &= ~NSLiteralSearch;
+    }
+
   if (flag)
     {
       [self _putFindStringToPasteboard];
@@ -527,3 +612,97 @@ static GSTextFinder *sharedTextFinder;
 }
 
 @end
+
+@implementation GSTextFinder(ReplaceAll)
+
+/* Returns nil when the find string isn't a valid regular expression. */
+- (NSRegularExpression *) _regularExpressionWithOptions: (unsigned int)options
+{
+  NSRegularExpressionOptions regexOptions = 0;
+
+  if (options & NSCaseInsensitiveSearch)
+    {
+      regexOptions |= NSRegularExpressionCaseInsensitive;
+    }
+  return [NSRegularExpression regularExpressionWithPattern: findString
+						   options: regexOptions
+						     error: NULL];
+}
+
+/* The replacement for the text in range, which is the replace string
+ * unless it is a template for a regular expression matching that text.
+ */
+- (NSString *) _replacementForRange: (NSRange)range
+			   inString: (NSString *)string
+			    options: (unsigned int)options
+{
+  if (options & NSRegularExpressionSearch)
+    {
+      NSRegularExpression *regex;
+      NSTextCheckingResult *match;
+
+      regex = [self _regularExpressionWithOptions: options];
+      match = [regex firstMatchInString: string
+				options: NSMatchingAnchored
+				  range: range];
+      if (match != nil && NSEqualRanges([match range], range))
+	{
+	  return [regex replacementStringForResult: match
+					  inString: string
+					    offset: 0
+					  template: replaceString];
+	}
+    }
+  return replaceString;
+}
+
+/* Adds the range of each match in range to ranges and the string to
+ * replace it with to strings, returning the number of matches.
+ */
+- (NSUInteger) _findMatchesInString: (NSString *)string
+			      range: (NSRange)range
+			    options: (unsigned int)options
+			     ranges: (NSMutableArray *)ranges
+			    strings: (NSMutableArray *)strings
+{
+  if (options & NSRegularExpressionSearch)
+    {
+      NSRegularExpression *regex;
+      NSEnumerator *e;
+      NSTextCheckingResult *match;
+
+      regex = [self _regularExpressionWithOptions: options];
+      e = [[regex matchesInString: string
+			  options: 0
+			    range: range] objectEnumerator];
+      while ((match = [e nextObject]) != nil)
+	{
+	  [ranges addObject: [NSValue valueWithRange: [match range]]];
+	  [strings addObject: [regex replacementStringForResult: match
+						      inString: string
+							offset: 0
+						      template: replaceString]];
+	}
+    }
+  else
+    {
+      NSRange found;
+
+      found = [string rangeOfString: findString
+			    options: options
+			      range: range];
+      while (found.location != NSNotFound)
+	{
+	  [ranges addObject: [NSValue valueWithRange: found]];
+	  [strings addObject: replaceString];
+	  range = NSMakeRange(NSMaxRange(found),
+			      NSMaxRange(range) - NSMaxRange(found));
+	  found = [string rangeOfString: findString
+				options: options
+				  range: range];
+	}
+    }
+  return [ranges count];
+}
+
+@end
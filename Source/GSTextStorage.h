@@ -30,14 +30,26 @@
 
 #import "AppKit/NSTextStorage.h"
 
+@class NSDictionary;
 @class NSMutableString;
-@class NSMutableArray;
+struct GSTextRuns;
 
 @interface GSTextStorage : NSTextStorage
 {
   NSMutableString       *_textChars;
-  NSMutableArray        *_infoArray;
+  struct GSTextRuns     *_runs;
   NSString		*_textProxy;
 }
+
+/* Returns counters of the table attribute dictionaries are uniqued in:
+ * the number of lookups that found a dictionary (Hits) and that added one
+ * (Misses), the number of times a thread had to wait for the table
+ * (Contentions), and the number of dictionaries in it (Count).
+ */
++ (NSDictionary*) _attributeCacheStatistics;
+
+/* Resets the Hits, Misses and Contentions counters to zero.
+ */
++ (void) _resetAttributeCacheStatistics;
 @end
 
@@ -49,6 +49,7 @@
 #import <Foundation/NSZone.h>
 #import <Foundation/NSLock.h>
 #import <Foundation/NSThread.h>
+#import <Foundation/NSValue.h>
 #import <Foundation/NSProxy.h>
 #import <Foundation/NSInvocation.h>
 #import <Foundation/NSNotification.h>
@@ -57,47 +58,74 @@
 
 #define		SANITY_CHECKS	0
 
-static BOOL     adding;
+/* The number of independently locked tables the attribute dictionaries
+ * are uniqued in.  Must be a power of two.
+ */
+#define	ATTR_SHARDS	16
 
-/* When caching attributes we make a shallow copy of the dictionary cached,
- * so that it is immutable and safe to cache.
- * However, we have a potential problem if the objects within the attributes
- * dictionary are themselves mutable, and something mutates them while they
- * are in the cache.  In this case we could items added while different and
- * then mutated to have the same contents, so we would not know which of
- * the equal dictionaries to remove.
- * The solution is to require dictionaries to be identical for removal.
+/*
+ * The hash of an attributes dictionary.  NSDictionary only hashes its
+ * count, which puts all dictionaries with the same number of attributes
+ * in the same bucket (and shard), so we mix in the keys and values.
+ * The sum doesn't depend on the order of enumeration.
  */
-static inline BOOL
-cacheEqual(id A, id B)
+static NSUInteger
+attrHash(NSDictionary *d)
 {
-  if (YES == adding)
-    return [A isEqualToDictionary: B];
-  else
-    return A == B;
+  NSUInteger	count = [d count];
+  NSUInteger	h = count;
+
+  if (count <= 16)
+    {
+      id	keys[16];
+      id	objs[16];
+      NSUInteger	i;
+
+      [d getObjects: objs andKeys: keys];
+      for (i = 0; i < count; i++)
+	{
+	  h += [keys[i] hash] * 31 + [objs[i] hash];
+	}
+    }
+  return h;
 }
 
 #define	GSI_MAP_RETAIN_KEY(M, X)	
 #define	GSI_MAP_RELEASE_KEY(M, X)	
 #define	GSI_MAP_RETAIN_VAL(M, X)	
 #define	GSI_MAP_RELEASE_VAL(M, X)	
-#define	GSI_MAP_EQUAL(M, X,Y)	cacheEqual((X).obj, (Y).obj)
+#define	GSI_MAP_HASH(M, X)	attrHash((X).obj)
+#define	GSI_MAP_EQUAL(M, X,Y)	\
+  ((X).obj == (Y).obj || [(X).obj isEqualToDictionary: (Y).obj])
 #define GSI_MAP_KTYPES	GSUNION_OBJ
 #define GSI_MAP_VTYPES	GSUNION_NSINT
 #define	GSI_MAP_NOCLEAN	1
 #include <GNUstepBase/GSIMap.h>
 
+/*
+ * Attribute dictionaries are uniqued in one of several tables chosen by
+ * their hash, each with its own lock, so that threads building attributed
+ * strings at the same time rarely wait for each other.  The counters are
+ * only changed with the lock of the table held.
+ */
+typedef struct {
+  GSIMapTable_t	map;
+  NSLock	*lock;
+  NSUInteger	hits;		/* Lookups finding a cached dictionary.	*/
+  NSUInteger	misses;		/* Lookups adding a dictionary.	*/
+  NSUInteger	contentions;	/* Times the lock was held by another thread. */
+} attr_shard_t;
+
 static NSDictionary	*blank;
-static NSLock		*attrLock = nil;
-static GSIMapTable_t	attrMap;
+static attr_shard_t	attrShards[ATTR_SHARDS];
+static BOOL		attrLocking = NO;
 static SEL		lockSel;
+static SEL		tryLockSel;
 static SEL		unlockSel;
 static IMP		lockImp;
+static BOOL		(*tryLockImp)(id, SEL);
 static IMP		unlockImp;
 
-#define	ALOCK()	if (attrLock != nil) (*lockImp)(attrLock, lockSel)
-#define	AUNLOCK() if (attrLock != nil) (*unlockImp)(attrLock, unlockSel)
-
 @interface GSTextStorageProxy : NSProxy
 {
   NSString	*string;
@@ -195,6 +223,18 @@ static Class NSStringClass = nil;
 
 @end
 
+static inline attr_shard_t *
+attrShard(NSUInteger hash)
+{
+  return &attrShards[(hash ^ (hash >> 7)) & (ATTR_SHARDS - 1)];
+}
+
+#define	ALOCK(S)	\
+  if (attrLocking == YES && (*tryLockImp)((S)->lock, tryLockSel) == NO) \
+    { (*lockImp)((S)->lock, lockSel); (S)->contentions++; }
+#define	AUNLOCK(S)	\
+  if (attrLocking == YES) (*unlockImp)((S)->lock, unlockSel)
+
 /*
  * Add a dictionary to the cache - if it was not already there, return
  * the copy added to the cache, if it was, count it and return retained
@@ -203,11 +243,11 @@ static Class NSStringClass = nil;
 static NSDictionary*
 cacheAttributes(NSDictionary *attrs)
 {
+  attr_shard_t	*shard = attrShard(attrHash(attrs));
   GSIMapNode	node;
 
-  ALOCK();
-  adding = YES;
-  node = GSIMapNodeForKey(&attrMap, (GSIMapKey)((id)attrs));
+  ALOCK(shard);
+  node = GSIMapNodeForKey(&shard->map, (GSIMapKey)((id)attrs));
   if (node == 0)
     {
       /*
@@ -215,42 +255,101 @@ cacheAttributes(NSDictionary *attrs)
        * in an immutable dictionary that can safely be cached.
        */
       attrs = [[NSDictionary alloc] initWithDictionary: attrs copyItems: NO];
-      GSIMapAddPair(&attrMap,
+      GSIMapAddPair(&shard->map,
         (GSIMapKey)((id)attrs), (GSIMapVal)(NSUInteger)1);
+      shard->misses++;
     }
   else
     {
       node->value.nsu++;
       attrs = RETAIN(node->key.obj);
+      shard->hits++;
     }
-  AUNLOCK();
+  AUNLOCK(shard);
   return attrs;
 }
 
-static void
-unCacheAttributes(NSDictionary *attrs)
+/*
+ * Look for the node of a cached dictionary in a bucket.
+ * When caching attributes we make a shallow copy of the dictionary cached,
+ * so that it is immutable and safe to cache.
+ * However, we have a potential problem if the objects within the attributes
+ * dictionary are themselves mutable, and something mutates them while they
+ * are in the cache.  In this case we could items added while different and
+ * then mutated to have the same contents, so we would not know which of
+ * the equal dictionaries to remove.
+ * The solution is to require dictionaries to be identical for removal.
+ */
+static inline GSIMapNode
+nodeInBucket(GSIMapBucket bucket, NSDictionary *attrs)
+{
+  GSIMapNode	node = bucket->firstNode;
+
+  while (node != 0 && node->key.obj != attrs)
+    {
+      node = node->nextInBucket;
+    }
+  return node;
+}
+
+static BOOL
+removeFromShard(attr_shard_t *shard, NSDictionary *attrs, BOOL anyBucket)
 {
-  GSIMapBucket       bucket;
+  BOOL	found = NO;
 
-  ALOCK();
-  adding = NO;
-  bucket = GSIMapBucketForKey(&attrMap, (GSIMapKey)((id)attrs));
-  if (bucket != 0)
+  ALOCK(shard);
+  if (shard->map.nodeCount > 0)
     {
-      GSIMapNode     node;
+      GSIMapBucket	bucket = 0;
+      GSIMapNode	node = 0;
+
+      if (anyBucket == NO)
+	{
+	  bucket = GSIMapBucketForKey(&shard->map, (GSIMapKey)((id)attrs));
+	  node = nodeInBucket(bucket, attrs);
+	}
+      else
+	{
+	  NSUInteger	i;
 
-      node = GSIMapNodeForKeyInBucket(&attrMap,
-        bucket, (GSIMapKey)((id)attrs));
+	  for (i = 0; node == 0 && i < shard->map.bucketCount; i++)
+	    {
+	      bucket = shard->map.buckets + i;
+	      node = nodeInBucket(bucket, attrs);
+	    }
+	}
       if (node != 0)
 	{
 	  if (--node->value.nsu == 0)
 	    {
-	      GSIMapRemoveNodeFromMap(&attrMap, bucket, node);
-	      GSIMapFreeNode(&attrMap, node);
+	      GSIMapRemoveNodeFromMap(&shard->map, bucket, node);
+	      GSIMapFreeNode(&shard->map, node);
+	    }
+	  found = YES;
+	}
+    }
+  AUNLOCK(shard);
+  return found;
+}
+
+static void
+unCacheAttributes(NSDictionary *attrs)
+{
+  /* If an object in the dictionary was mutated, its hash may have changed
+   * since it was cached, and we have to search all the tables for it.
+   */
+  if (removeFromShard(attrShard(attrHash(attrs)), attrs, NO) == NO)
+    {
+      unsigned	i;
+
+      for (i = 0; i < ATTR_SHARDS; i++)
+	{
+	  if (removeFromShard(&attrShards[i], attrs, YES) == YES)
+	    {
+	      break;
 	    }
 	}
     }
-  AUNLOCK();
 }
 
 
@@ -333,63 +432,205 @@ unCacheAttributes(NSDictionary *attrs)
 
 @end
 
-
 
-static Class	infCls = 0;
 
-static SEL infSel;
-static SEL addSel;
-static SEL cntSel;
-static SEL insSel;
-static SEL oatSel;
-static SEL remSel;
+/*
+ * The attribute runs of a text storage are kept in a gap buffer.  Each
+ * run records the location of its first character and its (cached)
+ * attributes, in order of location.  The gap sits at the run index of
+ * the last edit.  Runs before the gap store their location, runs after
+ * it store their location minus 'delta', so changing the length of the
+ * text at the gap shifts all later runs by adjusting 'delta' alone.
+ * Edits move the gap to where they take place, which costs the number of
+ * runs between the two edit points, so that typing into a heavily styled
+ * text doesn't touch every run after the insertion point.  Lookups are
+ * binary searches over the logical run indexes.
+ */
+typedef struct {
+  unsigned	loc;
+  NSDictionary	*attrs;
+} GSTextRun;
 
-static IMP	infImp;
-static void	(*addImp)(NSMutableArray*, SEL, NSObject*);
-static unsigned (*cntImp)(NSMutableArray*, SEL);
-static void	(*insImp)(NSMutableArray*, SEL, NSObject*, NSUInteger);
-static IMP	oatImp;
-static void	(*remImp)(NSMutableArray*, SEL, NSUInteger);
+struct GSTextRuns {
+  NSZone	*zone;
+  GSTextRun	*runs;
+  unsigned	capacity;
+  unsigned	gapStart;	/* Index of the first free slot.	*/
+  unsigned	gapEnd;		/* Index of the first run after the gap.	*/
+  unsigned	delta;		/* Added to the locations after the gap.	*/
+};
 
-#define	NEWINFO(Z,O,L)	((*infImp)(infCls, infSel, (Z), (O), (L)))
-#define	ADDOBJECT(O)	((*addImp)(_infoArray, addSel, (O)))
-#define	INSOBJECT(O,I)	((*insImp)(_infoArray, insSel, (O), (I)))
-#define	OBJECTAT(I)	((*oatImp)(_infoArray, oatSel, (I)))
-#define	REMOVEAT(I)	((*remImp)(_infoArray, remSel, (I)))
+typedef struct GSTextRuns GSTextRuns;
 
-static inline NSDictionary *attrDict(GSTextInfo* info)
+static inline unsigned
+runCount(GSTextRuns *r)
 {
-  return info->attrs;
+  return r->gapStart + r->capacity - r->gapEnd;
 }
 
+static inline GSTextRun *
+runAt(GSTextRuns *r, unsigned i)
+{
+  if (i < r->gapStart)
+    return r->runs + i;
+  return r->runs + i + r->gapEnd - r->gapStart;
+}
 
-static void _setup()
+static inline unsigned
+runLoc(GSTextRuns *r, unsigned i)
+{
+  if (i < r->gapStart)
+    return r->runs[i].loc;
+  return r->runs[i + r->gapEnd - r->gapStart].loc + r->delta;
+}
+
+static inline NSDictionary *
+runAttrs(GSTextRuns *r, unsigned i)
+{
+  return runAt(r, i)->attrs;
+}
+
+static inline void
+runSetLoc(GSTextRuns *r, unsigned i, unsigned loc)
+{
+  if (i < r->gapStart)
+    r->runs[i].loc = loc;
+  else
+    r->runs[i + r->gapEnd - r->gapStart].loc = loc - r->delta;
+}
+
+static GSTextRuns *
+runsCreate(NSZone *z)
 {
-  if (infCls == 0)
+  GSTextRuns	*r = NSZoneMalloc(z, sizeof(GSTextRuns));
+
+  r->zone = z;
+  r->capacity = 4;
+  r->runs = NSZoneMalloc(z, r->capacity * sizeof(GSTextRun));
+  r->gapStart = 0;
+  r->gapEnd = r->capacity;
+  r->delta = 0;
+  return r;
+}
+
+/*
+ * Move the gap so that the run at logical index i is the first run after
+ * it.
+ */
+static void
+runsMoveGap(GSTextRuns *r, unsigned i)
+{
+  while (r->gapStart > i)
     {
-      NSMutableArray	*a;
-      NSDictionary	*d;
+      r->gapStart--;
+      r->gapEnd--;
+      r->runs[r->gapEnd].loc = r->runs[r->gapStart].loc - r->delta;
+      r->runs[r->gapEnd].attrs = r->runs[r->gapStart].attrs;
+    }
+  while (r->gapStart < i)
+    {
+      r->runs[r->gapStart].loc = r->runs[r->gapEnd].loc + r->delta;
+      r->runs[r->gapStart].attrs = r->runs[r->gapEnd].attrs;
+      r->gapStart++;
+      r->gapEnd++;
+    }
+}
+
+/*
+ * Insert a run at logical index i - the given attributes dictionary must
+ * have been produced by 'cacheAttributes()' so that it is already
+ * copied/retained.
+ */
+static void
+runsInsert(GSTextRuns *r, unsigned i, unsigned loc, NSDictionary *attrs)
+{
+  runsMoveGap(r, i);
+  if (r->gapStart == r->gapEnd)
+    {
+      unsigned	after = r->capacity - r->gapEnd;
+      unsigned	capacity = r->capacity * 2;
+
+      r->runs = NSZoneRealloc(r->zone, r->runs, capacity * sizeof(GSTextRun));
+      memmove(r->runs + capacity - after, r->runs + r->gapEnd,
+	after * sizeof(GSTextRun));
+      r->gapEnd = capacity - after;
+      r->capacity = capacity;
+    }
+  r->runs[r->gapStart].loc = loc;
+  r->runs[r->gapStart].attrs = attrs;
+  r->gapStart++;
+}
+
+static inline void
+runsAppend(GSTextRuns *r, unsigned loc, NSDictionary *attrs)
+{
+  runsInsert(r, runCount(r), loc, attrs);
+}
+
+static void
+runsRemove(GSTextRuns *r, unsigned i)
+{
+  GSTextRun	*run;
+
+  runsMoveGap(r, i);
+  run = r->runs + r->gapEnd;
+  unCacheAttributes(run->attrs);
+  DESTROY(run->attrs);
+  r->gapEnd++;
+}
+
+static void
+runsRemoveAll(GSTextRuns *r)
+{
+  unsigned	i = runCount(r);
+
+  while (i-- > 0)
+    {
+      GSTextRun	*run = runAt(r, i);
+
+      unCacheAttributes(run->attrs);
+      DESTROY(run->attrs);
+    }
+  r->gapStart = 0;
+  r->gapEnd = r->capacity;
+  r->delta = 0;
+}
+
+/*
+ * Add offset to the locations of the runs from logical index i onwards.
+ */
+static inline void
+runsShift(GSTextRuns *r, unsigned i, int offset)
+{
+  runsMoveGap(r, i);
+  r->delta += offset;
+}
+
+static void
+runsDestroy(GSTextRuns *r)
+{
+  runsRemoveAll(r);
+  NSZoneFree(r->zone, r->runs);
+  NSZoneFree(r->zone, r);
+}
+
 
-      GSIMapInitWithZoneAndCapacity(&attrMap, NSDefaultMallocZone(), 32);
 
-      infSel = @selector(newWithZone:value:at:);
-      addSel = @selector(addObject:);
-      cntSel = @selector(count);
-      insSel = @selector(insertObject:atIndex:);
-      oatSel = @selector(objectAtIndex:);
-      remSel = @selector(removeObjectAtIndex:);
+static void _setup()
+{
+  static BOOL	beenHere = NO;
 
-      infCls = [GSTextInfo class];
-      infImp = [infCls methodForSelector: infSel];
+  if (beenHere == NO)
+    {
+      NSDictionary	*d;
+      unsigned	i;
 
-      a = [NSMutableArray allocWithZone: NSDefaultMallocZone()];
-      a = [a initWithCapacity: 1];
-      addImp = (void (*)())[a methodForSelector: addSel];
-      cntImp = (unsigned (*)())[a methodForSelector: cntSel];
-      insImp = (void (*)())[a methodForSelector: insSel];
-      oatImp = [a methodForSelector: oatSel];
-      remImp = (void (*)())[a methodForSelector: remSel];
-      RELEASE(a);
+      beenHere = YES;
+      for (i = 0; i < ATTR_SHARDS; i++)
+	{
+	  GSIMapInitWithZoneAndCapacity(&attrShards[i].map,
+	    NSDefaultMallocZone(), 32);
+	}
 
       d = [NSDictionary new];
       blank = cacheAttributes(d);
@@ -401,18 +642,16 @@ static void
 _setAttributesFrom(
   NSAttributedString *attributedString,
   NSRange aRange,
-  NSMutableArray *_infoArray)
+  GSTextRuns *runs)
 {
-  NSZone	*z = [_infoArray zone];
   NSRange	range;
   NSDictionary	*attr;
-  GSTextInfo	*info;
   unsigned	loc;
 
   /*
    * remove any old attributes of the string.
    */
-  [_infoArray removeAllObjects];
+  runsRemoveAll(runs);
 
   if (aRange.length <= 0)
     {
@@ -424,19 +663,13 @@ _setAttributesFrom(
       attr = [attributedString attributesAtIndex: aRange.location
 				  effectiveRange: &range];
     }
-  attr = cacheAttributes(attr);
-  info = NEWINFO(z, attr, 0);
-  ADDOBJECT(info);
-  RELEASE(info);
+  runsAppend(runs, 0, cacheAttributes(attr));
 
   while ((loc = NSMaxRange(range)) < NSMaxRange(aRange))
     {
       attr = [attributedString attributesAtIndex: loc
 				  effectiveRange: &range];
-      attr = cacheAttributes(attr);
-      info = NEWINFO(z, attr, loc - aRange.location);
-      ADDOBJECT(info);
-      RELEASE(info);
+      runsAppend(runs, loc - aRange.location, cacheAttributes(attr));
     }
 }
 
@@ -445,13 +678,12 @@ _attributesAtIndexEffectiveRange(
   unsigned int index,
   NSRange *aRange,
   unsigned int tmpLength,
-  NSMutableArray *_infoArray,
+  GSTextRuns *runs,
   unsigned int *foundIndex)
 {
-  unsigned	low, high, used, cnt, nextLoc;
-  GSTextInfo	*found = nil;
+  unsigned	low, high, used, cnt, loc, nextLoc;
 
-  used = (*cntImp)(_infoArray, cntSel);
+  used = runCount(runs);
   NSCAssert(used > 0, NSInternalInconsistencyException);
   high = used - 1;
 
@@ -459,17 +691,17 @@ _attributesAtIndexEffectiveRange(
     {
       if (index == tmpLength)
 	{
-	  found = OBJECTAT(high);
+	  loc = runLoc(runs, high);
 	  if (foundIndex != 0)
 	    {
 	      *foundIndex = high;
 	    }
 	  if (aRange != 0)
 	    {
-	      aRange->location = found->loc;
-	      aRange->length = tmpLength - found->loc;
+	      aRange->location = loc;
+	      aRange->length = tmpLength - loc;
 	    }
-	  return attrDict(found);
+	  return runAttrs(runs, high);
 	}
       [NSException raise: NSRangeException
 		  format: @"index is out of range in function "
@@ -483,8 +715,8 @@ _attributesAtIndexEffectiveRange(
   while (low <= high)
     {
       cnt = (low + high) / 2;
-      found = OBJECTAT(cnt);
-      if (found->loc > index)
+      loc = runLoc(runs, cnt);
+      if (loc > index)
 	{
 	  high = cnt - 1;
 	}
@@ -496,23 +728,21 @@ _attributesAtIndexEffectiveRange(
 	    }
 	  else
 	    {
-	      GSTextInfo	*inf = OBJECTAT(cnt + 1);
-
-	      nextLoc = inf->loc;
+	      nextLoc = runLoc(runs, cnt + 1);
 	    }
-	  if (found->loc == index || index < nextLoc)
+	  if (loc == index || index < nextLoc)
 	    {
 	      //Found
 	      if (aRange != 0)
 		{
-		  aRange->location = found->loc;
-		  aRange->length = nextLoc - found->loc;
+		  aRange->location = loc;
+		  aRange->length = nextLoc - loc;
 		}
 	      if (foundIndex != 0)
 		{
 		  *foundIndex = cnt;
 		}
-	      return attrDict(found);
+	      return runAttrs(runs, cnt);
 	    }
 	  else
 	    {
@@ -537,21 +767,20 @@ _attributesAtIndexEffectiveRange(
  * regression test cases.  */
 - (void) _sanity
 {
-  GSTextInfo	*info;
   unsigned	i;
   unsigned	l = 0;
   unsigned	len = [_textChars length];
-  unsigned	c = (*cntImp)(_infoArray, cntSel);
+  unsigned	c = runCount(_runs);
 
   NSAssert(c > 0, NSInternalInconsistencyException);
-  info = OBJECTAT(0);
-  NSAssert(info->loc == 0, NSInternalInconsistencyException);
+  NSAssert(runLoc(_runs, 0) == 0, NSInternalInconsistencyException);
   for (i = 1; i < c; i++)
     {
-      info = OBJECTAT(i);
-      NSAssert(info->loc > l, NSInternalInconsistencyException);
-      NSAssert(info->loc < len, NSInternalInconsistencyException);
-      l = info->loc;
+      unsigned	loc = runLoc(_runs, i);
+
+      NSAssert(loc > l, NSInternalInconsistencyException);
+      NSAssert(loc < len, NSInternalInconsistencyException);
+      l = loc;
     }
 }
 
@@ -560,11 +789,63 @@ _attributesAtIndexEffectiveRange(
  */
 + (void) _becomeThreaded: (id)notification
 {
-  attrLock = [NSLock new];
+  unsigned	i;
+
+  for (i = 0; i < ATTR_SHARDS; i++)
+    {
+      attrShards[i].lock = [NSLock new];
+    }
   lockSel = @selector(lock);
+  tryLockSel = @selector(tryLock);
   unlockSel = @selector(unlock);
-  lockImp = [attrLock methodForSelector: lockSel];
-  unlockImp = [attrLock methodForSelector: unlockSel];
+  lockImp = [attrShards[0].lock methodForSelector: lockSel];
+  tryLockImp = (BOOL (*)(id, SEL))[attrShards[0].lock
+    methodForSelector: tryLockSel];
+  unlockImp = [attrShards[0].lock methodForSelector: unlockSel];
+  attrLocking = YES;
+}
+
++ (NSDictionary*) _attributeCacheStatistics
+{
+  NSUInteger	hits = 0;
+  NSUInteger	misses = 0;
+  NSUInteger	contentions = 0;
+  NSUInteger	count = 0;
+  unsigned	i;
+
+  for (i = 0; i < ATTR_SHARDS; i++)
+    {
+      attr_shard_t	*shard = &attrShards[i];
+
+      ALOCK(shard);
+      hits += shard->hits;
+      misses += shard->misses;
+      contentions += shard->contentions;
+      count += shard->map.nodeCount;
+      AUNLOCK(shard);
+    }
+  return [NSDictionary dictionaryWithObjectsAndKeys:
+    [NSNumber numberWithUnsignedInteger: hits], @"Hits",
+    [NSNumber numberWithUnsignedInteger: misses], @"Misses",
+    [NSNumber numberWithUnsignedInteger: contentions], @"Contentions",
+    [NSNumber numberWithUnsignedInteger: count], @"Count",
+    nil];
+}
+
++ (void) _resetAttributeCacheStatistics
+{
+  unsigned	i;
+
+  for (i = 0; i < ATTR_SHARDS; i++)
+    {
+      attr_shard_t	*shard = &attrShards[i];
+
+      ALOCK(shard);
+      shard->hits = 0;
+      shard->misses = 0;
+      shard->contentions = 0;
+      AUNLOCK(shard);
+    }
 }
 
 + (void) initialize
@@ -593,8 +874,25 @@ _attributesAtIndexEffectiveRange(
       if ([aCoder versionForClassName: @"GSTextStorage"] != (NSInteger)NSNotFound)
         {
           NSLog(@"Warning - decoding archive containing obsolete %@ object - please delete/replace this archive", NSStringFromClass([self class]));
+          NSArray	*infoArray;
+          unsigned	count;
+          unsigned	i;
+
           [aCoder decodeValueOfObjCType: @encode(id) at: &_textChars];
-          [aCoder decodeValueOfObjCType: @encode(id) at: &_infoArray];
+          [aCoder decodeValueOfObjCType: @encode(id) at: &infoArray];
+          if (_runs == 0)
+            {
+              _runs = runsCreate([self zone]);
+            }
+          runsRemoveAll(_runs);
+          count = [infoArray count];
+          for (i = 0; i < count; i++)
+            {
+              GSTextInfo	*info = [infoArray objectAtIndex: i];
+
+              runsAppend(_runs, info->loc, cacheAttributes(info->attrs));
+            }
+          RELEASE(infoArray);
         }
     }
   return self;
@@ -606,26 +904,21 @@ _attributesAtIndexEffectiveRange(
   NSZone *z = [self zone];
 
   self = [super initWithString: aString attributes: attributes];
-  _infoArray = [[NSMutableArray allocWithZone: z] initWithCapacity: 1];
+  _runs = runsCreate(z);
   if (aString != nil && [aString isKindOfClass: [NSAttributedString class]])
     {
       NSAttributedString *as = (NSAttributedString*)aString;
 
       aString = [as string];
-      _setAttributesFrom(as, NSMakeRange(0, [aString length]), _infoArray);
+      _setAttributesFrom(as, NSMakeRange(0, [aString length]), _runs);
     }
   else
     {
-      GSTextInfo *info;
-
       if (attributes == nil)
         {
           attributes = blank;
         }
-      attributes = cacheAttributes(attributes);
-      info = NEWINFO(z, attributes, 0);
-      ADDOBJECT(info);
-      RELEASE(info);
+      runsAppend(_runs, 0, cacheAttributes(attributes));
     }
   if (aString == nil)
     _textChars = [[NSMutableString allocWithZone: z] init];
@@ -652,7 +945,7 @@ _attributesAtIndexEffectiveRange(
   unsigned dummy;
 
   return _attributesAtIndexEffectiveRange(
-    index, aRange, [_textChars length], _infoArray, &dummy);
+    index, aRange, [_textChars length], _runs, &dummy);
 }
 
 /*
@@ -676,8 +969,7 @@ _attributesAtIndexEffectiveRange(
   NSRange	originalRange = range;
   unsigned	afterRangeLoc, beginRangeLoc;
   NSDictionary	*attrs;
-  NSZone	*z = [self zone];
-  GSTextInfo	*info;
+  GSTextRun	*run;
 
   if (range.length == 0)
     {
@@ -692,7 +984,7 @@ _attributesAtIndexEffectiveRange(
 SANITY();
   tmpLength = [_textChars length];
   GS_RANGE_CHECK(range, tmpLength);
-  arraySize = (*cntImp)(_infoArray, cntSel);
+  arraySize = runCount(_runs);
   beginRangeLoc = range.location;
   afterRangeLoc = NSMaxRange(range);
   if (afterRangeLoc < tmpLength)
@@ -701,7 +993,7 @@ SANITY();
        * Locate the first range that extends beyond our range.
        */
       attrs = _attributesAtIndexEffectiveRange(
-	afterRangeLoc, &effectiveRange, tmpLength, _infoArray, &arrayIndex);
+	afterRangeLoc, &effectiveRange, tmpLength, _runs, &arrayIndex);
       if (attrs == attributes)
 	{
 	  /*
@@ -724,8 +1016,7 @@ SANITY();
 	  /*
 	   * The located range also starts at or after our range.
 	   */
-	  info = OBJECTAT(arrayIndex);
-	  info->loc = afterRangeLoc;
+	  runSetLoc(_runs, arrayIndex, afterRangeLoc);
 	  arrayIndex--;
 	}
       else if (NSMaxRange(effectiveRange) > afterRangeLoc)
@@ -734,11 +1025,8 @@ SANITY();
 	   * The located range starts before our range.
 	   * Create a subrange to go from our end to the end of the old range.
 	   */
-	  info = NEWINFO(z, cacheAttributes(attrs), afterRangeLoc);
-	  arrayIndex++;
-	  INSOBJECT(info, arrayIndex);
-	  RELEASE(info);
-	  arrayIndex--;
+	  runsInsert(_runs, arrayIndex + 1, afterRangeLoc,
+	    cacheAttributes(attrs));
 	}
     }
   else
@@ -751,10 +1039,9 @@ SANITY();
    */
   while (arrayIndex > 0)
     {
-      info = OBJECTAT(arrayIndex-1);
-      if (info->loc < beginRangeLoc)
+      if (runLoc(_runs, arrayIndex-1) < beginRangeLoc)
 	break;
-      REMOVEAT(arrayIndex);
+      runsRemove(_runs, arrayIndex);
       arrayIndex--;
     }
 
@@ -762,33 +1049,30 @@ SANITY();
    * Use the location/attribute info in the current slot if possible,
    * otherwise, add a new slot and use that.
    */
-  info = OBJECTAT(arrayIndex);
-  if (info->loc >= beginRangeLoc)
+  run = runAt(_runs, arrayIndex);
+  if (runLoc(_runs, arrayIndex) >= beginRangeLoc)
     {
-      info->loc = beginRangeLoc;
-      if (info->attrs == attributes)
+      runSetLoc(_runs, arrayIndex, beginRangeLoc);
+      if (run->attrs == attributes)
 	{
 	  unCacheAttributes(attributes);
 	  RELEASE(attributes);
 	}
       else
 	{
-	  unCacheAttributes(info->attrs);
-	  RELEASE(info->attrs);
-	  info->attrs = attributes;
+	  unCacheAttributes(run->attrs);
+	  RELEASE(run->attrs);
+	  run->attrs = attributes;
 	}
     }
-  else if (info->attrs == attributes)
+  else if (run->attrs == attributes)
     {
       unCacheAttributes(attributes);
       RELEASE(attributes);
     }
   else
     {
-      arrayIndex++;
-      info = NEWINFO(z, attributes, beginRangeLoc);
-      INSOBJECT(info, arrayIndex);
-      RELEASE(info);
+      runsInsert(_runs, arrayIndex + 1, beginRangeLoc, attributes);
     }
   
 SANITY();
@@ -804,7 +1088,6 @@ changeInLength: 0];
   unsigned      arrayIndex = 0;
   unsigned      arraySize;
   NSRange	effectiveRange = NSMakeRange(0, NSNotFound);
-  GSTextInfo	*info;
   int		moveLocations;
   unsigned	start;
 
@@ -825,7 +1108,7 @@ SANITY();
       goto finish;
     }
 
-  arraySize = (*cntImp)(_infoArray, cntSel);
+  arraySize = runCount(_runs);
   if (arraySize == 1)
     {
       /*
@@ -847,7 +1130,7 @@ SANITY();
   else
     start = range.location;
   _attributesAtIndexEffectiveRange(start, &effectiveRange,
-                                   tmpLength, _infoArray, &arrayIndex);
+                                   tmpLength, _runs, &arrayIndex);
 
   moveLocations = [aString length] - range.length;
 
@@ -859,19 +1142,16 @@ SANITY();
        * we are replacing.  Adjust the start point of a range that
        * extends beyond ours.
        */
-      info = OBJECTAT(arrayIndex);
-      if (info->loc < NSMaxRange(range))
+      if (runLoc(_runs, arrayIndex) < NSMaxRange(range))
 	{
 	  unsigned int	next = arrayIndex + 1;
 
 	  while (next < arraySize)
 	    {
-	      GSTextInfo	*n = OBJECTAT(next);
-	      if (n->loc <= NSMaxRange(range))
+	      if (runLoc(_runs, next) <= NSMaxRange(range))
 		{
-		  REMOVEAT(arrayIndex);
+		  runsRemove(_runs, arrayIndex);
 		  arraySize--;
-		  info = n;
 		}
 	      else
 		{
@@ -881,11 +1161,11 @@ SANITY();
 	}
       if (NSMaxRange(range) < [_textChars length])
 	{
-	  info->loc = NSMaxRange(range);
+	  runSetLoc(_runs, arrayIndex, NSMaxRange(range));
 	}
       else
 	{
-	  REMOVEAT(arrayIndex);
+	  runsRemove(_runs, arrayIndex);
 	  arraySize--;
 	}
     }
@@ -898,7 +1178,7 @@ SANITY();
   if ((moveLocations + range.length) == 0)
     {
       _attributesAtIndexEffectiveRange(start, &effectiveRange,
-                                       tmpLength, _infoArray, &arrayIndex);
+                                       tmpLength, _runs, &arrayIndex);
       arrayIndex++;
 
       if (effectiveRange.location == range.location
@@ -907,31 +1187,28 @@ SANITY();
 	  arrayIndex--;
 	  if (arrayIndex != 0 || arraySize > 1)
 	    {
-	      REMOVEAT(arrayIndex);
+	      runsRemove(_runs, arrayIndex);
 	      arraySize--;
 	    }
 	  else
 	    {
-	      NSDictionary	*d = blank;
-
-	      info = OBJECTAT(0);
-	      unCacheAttributes(info->attrs);
-	      DESTROY(info->attrs);
-	      d = cacheAttributes(d);
-	      info->attrs = d;
-	      info->loc = NSMaxRange(range);
+	      GSTextRun	*run = runAt(_runs, 0);
+
+	      unCacheAttributes(run->attrs);
+	      DESTROY(run->attrs);
+	      run->attrs = cacheAttributes(blank);
+	      runSetLoc(_runs, 0, NSMaxRange(range));
 	    }
 	}
     }
 
   /*
    * Now adjust the positions of the ranges following the one we are using.
+   * This moves the gap of the run buffer to them rather than visiting each.
    */
-  while (arrayIndex < arraySize)
+  if (arrayIndex < arraySize)
     {
-      info = OBJECTAT(arrayIndex);
-      info->loc += moveLocations;
-      arrayIndex++;
+      runsShift(_runs, arrayIndex, moveLocations);
     }
   [_textChars replaceCharactersInRange: range withString: aString];
 
@@ -945,7 +1222,10 @@ changeInLength: [aString length] - range.length];
 - (void) dealloc
 {
   RELEASE(_textChars);
-  RELEASE(_infoArray);
+  if (_runs != 0)
+    {
+      runsDestroy(_runs);
+    }
   RELEASE(_textProxy);
   [super dealloc];
 }
@@ -3229,6 +3229,7 @@ static NSDictionary *titleTextAttributes[3] = {nil, nil, nil};
   if ([tableView usesAlternatingRowBackgroundColors])
     {
       const CGFloat rowHeight = [tableView rowHeight];
+      const NSInteger numberOfRows = [tableView numberOfRows];
       NSInteger startingRow = [tableView rowAtPoint: NSMakePoint(0, NSMinY(aRect))];
       NSInteger endingRow;
       NSInteger i;
@@ -3243,23 +3244,48 @@ static NSDictionary *titleTextAttributes[3] = {nil, nil, nil};
 	  || aRect.size.height <= 0)
 	return;
 
-      if (startingRow <= 0)
-	startingRow = 0;
-      
-      rowRect = [tableView rectOfRow: startingRow];
+      /* Rows may differ in height; below the last row, continue with
+	 stripes of the standard row height.  */
+      if (startingRow == -1 && numberOfRows > 0
+	  && NSMinY(aRect) >= NSMaxY([tableView rectOfRow: numberOfRows - 1]))
+	{
+	  startingRow = numberOfRows;
+	  rowRect = [tableView rectOfRow: numberOfRows - 1];
+	  rowRect.origin.y = NSMaxY(rowRect);
+	}
+      else
+	{
+	  if (startingRow <= 0)
+	    startingRow = 0;
+	  rowRect = [tableView rectOfRow: startingRow];
+	}
       rowRect.origin.x = aRect.origin.x;
       rowRect.size.width = aRect.size.width;
       
-      endingRow = startingRow + ceil(aRect.size.height / rowHeight);
+      endingRow = [tableView rowAtPoint: NSMakePoint(0, NSMaxY(aRect))];
+      if (endingRow == -1)
+	{
+	  CGFloat bottom = NSMinY(rowRect);
+
+	  if (numberOfRows > 0 && startingRow < numberOfRows)
+	    bottom = NSMaxY([tableView rectOfRow: numberOfRows - 1]);
+	  endingRow = MAX(numberOfRows, startingRow)
+	    + ceil((NSMaxY(aRect) - bottom) / rowHeight);
+	}
       
       for (i = startingRow; i <= endingRow; i++)
 	{
 	  NSColor *color = [rowColors objectAtIndex: (i % rowColorCount)];
 	  
+	  if (i < numberOfRows)
+	    rowRect.size.height = NSHeight([tableView rectOfRow: i]);
+	  else
+	    rowRect.size.height = rowHeight;
+
 	  [color set];
 	  NSRectFill(rowRect);
 	  
-	  rowRect.origin.y += rowHeight;
+	  rowRect.origin.y += rowRect.size.height;
 	}
     }
 }
@@ -43,6 +43,7 @@
 #import "GNUstepGUI/GSTrackingRect.h"
 #import "GSToolTips.h"
 #import "GSFastEnumeration.h"
+#import "NSWindowPrivate.h"
 
 @interface NSWindow (GNUstepPrivate)
 
@@ -476,6 +477,7 @@ GSDetachToolTipParentWindow(NSWindow *toolTipWindow)
       idx++;
   END_FOR_IN(tracking_rects)
   [((NSViewPtr)view)->_tracking_rects removeObjectsAtIndexes: indexes];
+  [[view window] _invalidateTrackingIndex];
   if ([((NSViewPtr)view)->_tracking_rects count] == 0)
     {
       ((NSViewPtr)view)->_rFlags.has_trkrects = 0;
@@ -676,7 +678,8 @@ GSDetachToolTipParentWindow(NSWindow *toolTipWindow)
     {
       NSRect rect;
       rect = [toolTipText boundingRectWithSize: NSMakeSize(300, 1e7)
-                                       options: 0];
+                                       options: NSStringDrawingUsesLineFragmentOrigin
+                                                | NSStringDrawingUsesFontLeading];
       textSize = rect.size;
     }
 
@@ -0,0 +1,91 @@
+/*
+   GSTrackingIndex.h
+
+   A grid of the tracking and cursor rectangles of a window, used to find
+   the rectangles which may contain a point without visiting every view.
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of the GNUstep GUI Library.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; see the file COPYING.LIB.
+   If not, see <http://www.gnu.org/licenses/> or write to the
+   Free Software Foundation, 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef _GNUstep_H_GSTrackingIndex
+#define _GNUstep_H_GSTrackingIndex
+
+#import <Foundation/NSObject.h>
+#import <Foundation/NSGeometry.h>
+
+@class	GSTrackingRect;
+@class	NSView;
+
+/* A rectangle found in the index, with the view it belongs to.  The
+ * rectangles are returned in the order a walk of the view tree visits
+ * them, either before (pre) or after (post) the subviews of their view.
+ */
+typedef struct _GSTrackingEntry
+{
+  GSTrackingRect	*rect;
+  NSView		*view;
+  NSRect		frame;	/* Enclosing rect in window coordinates. */
+  NSUInteger		pre;
+  NSUInteger		post;
+  unsigned		stamp;
+} GSTrackingEntry;
+
+@interface	GSTrackingIndex : NSObject
+{
+  GSTrackingEntry	*entries;
+  NSUInteger		count;
+  NSUInteger		capacity;
+  NSRect		bounds;
+  NSUInteger		columns;
+  NSUInteger		rows;
+  NSUInteger		*cellStart;	/* Offsets into cellItems. */
+  NSUInteger		*cellItems;	/* Entry indexes by cell. */
+  NSUInteger		*outside;	/* Entries not inside bounds. */
+  NSUInteger		outsideCount;
+  unsigned		stamp;
+}
+
+/** Returns an index of the tracking rectangles (when cursor is NO) or of
+ * the cursor rectangles (when cursor is YES) of the visible views under
+ * root.
+ */
+- (id) initWithView: (NSView*)root cursorRects: (BOOL)cursor;
+
+/** Returns the number of rectangles in the index.
+ */
+- (NSUInteger) count;
+
+/** Returns the most rectangles -getEntries:near:and:postOrder: may find
+ * for the points a and b.
+ */
+- (NSUInteger) countNear: (NSPoint)a and: (NSPoint)b;
+
+/** Puts the rectangles which may contain a or b into found, which must
+ * have room for -countNear:and: entries, in the order of the walk (post
+ * or pre) and returns how many there are.
+ */
+- (NSUInteger) getEntries: (GSTrackingEntry*)found
+                     near: (NSPoint)a
+                      and: (NSPoint)b
+                postOrder: (BOOL)post;
+@end
+
+#endif /* _GNUstep_H_GSTrackingIndex */
@@ -0,0 +1,396 @@
+/*
+   GSTrackingIndex.m
+
+   A grid of the tracking and cursor rectangles of a window, used to find
+   the rectangles which may contain a point without visiting every view.
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of the GNUstep GUI Library.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; see the file COPYING.LIB.
+   If not, see <http://www.gnu.org/licenses/> or write to the
+   Free Software Foundation, 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#import "config.h"
+#import <Foundation/NSArray.h>
+#import "AppKit/NSView.h"
+#import "GNUstepGUI/GSTrackingRect.h"
+#import "GSTrackingIndex.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+/* The size of a grid cell, and the most cells along each side. */
+#define	CELL_SIZE	32.0
+#define	MAX_CELLS	256
+
+static int
+comparePre(const void *a, const void *b)
+{
+  NSUInteger x = ((const GSTrackingEntry*)a)->pre;
+  NSUInteger y = ((const GSTrackingEntry*)b)->pre;
+
+  return (x < y) ? -1 : ((x > y) ? 1 : 0);
+}
+
+static int
+comparePost(const void *a, const void *b)
+{
+  NSUInteger x = ((const GSTrackingEntry*)a)->post;
+  NSUInteger y = ((const GSTrackingEntry*)b)->post;
+
+  return (x < y) ? -1 : ((x > y) ? 1 : 0);
+}
+
+@interface GSTrackingIndex (Private)
+- (void) _addView: (NSView*)view
+           cursor: (BOOL)cursor
+              pre: (NSUInteger*)pre
+             post: (NSUInteger*)post;
+- (NSUInteger) _cellForPoint: (NSPoint)p;
+- (void) _columns: (NSRange*)c rows: (NSRange*)r forRect: (NSRect)rect;
+@end
+
+@implementation GSTrackingIndex
+
+- (id) initWithView: (NSView*)root cursorRects: (BOOL)cursor
+{
+  NSUInteger pre = 0;
+  NSUInteger post = 0;
+  NSUInteger cellCount;
+  NSUInteger total;
+  NSUInteger *fill;
+  NSUInteger i;
+
+  if ((self = [super init]) == nil)
+    {
+      return nil;
+    }
+
+  bounds = [root convertRect: [root bounds] toView: nil];
+  columns = (NSUInteger)ceil(NSWidth(bounds) / CELL_SIZE);
+  rows = (NSUInteger)ceil(NSHeight(bounds) / CELL_SIZE);
+  columns = MAX(1, MIN(columns, MAX_CELLS));
+  rows = MAX(1, MIN(rows, MAX_CELLS));
+
+  if (root != nil)
+    {
+      [self _addView: root cursor: cursor pre: &pre post: &post];
+    }
+
+  /* Count the entries of each cell, then place them. */
+  cellCount = columns * rows;
+  cellStart = NSZoneCalloc(NSDefaultMallocZone(), cellCount + 1,
+    sizeof(NSUInteger));
+  outside = NSZoneMalloc(NSDefaultMallocZone(),
+    (count + 1) * sizeof(NSUInteger));
+  total = 0;
+  for (i = 0; i < count; i++)
+    {
+      NSRect frame = entries[i].frame;
+      NSRange c;
+      NSRange r;
+      NSUInteger x;
+      NSUInteger y;
+
+      if (NSContainsRect(bounds, frame) == NO)
+        {
+          outside[outsideCount++] = i;
+          continue;
+        }
+      [self _columns: &c rows: &r forRect: frame];
+      for (y = r.location; y < NSMaxRange(r); y++)
+        {
+          for (x = c.location; x < NSMaxRange(c); x++)
+            {
+              cellStart[y * columns + x + 1]++;
+              total++;
+            }
+        }
+    }
+  for (i = 0; i < cellCount; i++)
+    {
+      cellStart[i + 1] += cellStart[i];
+    }
+  cellItems = NSZoneMalloc(NSDefaultMallocZone(),
+    (total + 1) * sizeof(NSUInteger));
+  fill = NSZoneMalloc(NSDefaultMallocZone(), cellCount * sizeof(NSUInteger));
+  memcpy(fill, cellStart, cellCount * sizeof(NSUInteger));
+  for (i = 0; i < count; i++)
+    {
+      NSRect frame = entries[i].frame;
+      NSRange c;
+      NSRange r;
+      NSUInteger x;
+      NSUInteger y;
+
+      if (NSContainsRect(bounds, frame) == NO)
+        {
+          continue;
+        }
+      [self _columns: &c rows: &r forRect: frame];
+      for (y = r.location; y < NSMaxRange(r); y++)
+        {
+          for (x = c.location; x < NSMaxRange(c); x++)
+            {
+              cellItems[fill[y * columns + x]++] = i;
+            }
+        }
+    }
+  NSZoneFree(NSDefaultMallocZone(), fill);
+  return self;
+}
+
+- (void) dealloc
+{
+  if (entries != NULL)
+    {
+      NSZoneFree(NSDefaultMallocZone(), entries);
+    }
+  if (cellStart != NULL)
+    {
+      NSZoneFree(NSDefaultMallocZone(), cellStart);
+    }
+  if (cellItems != NULL)
+    {
+      NSZoneFree(NSDefaultMallocZone(), cellItems);
+    }
+  if (outside != NULL)
+    {
+      NSZoneFree(NSDefaultMallocZone(), outside);
+    }
+  [super dealloc];
+}
+
+- (NSUInteger) count
+{
+  return count;
+}
+
+- (NSUInteger) countNear: (NSPoint)a and: (NSPoint)b
+{
+  NSUInteger cellA = [self _cellForPoint: a];
+  NSUInteger cellB = [self _cellForPoint: b];
+  NSUInteger n = outsideCount;
+
+  if (cellA != NSNotFound)
+    {
+      n += cellStart[cellA + 1] - cellStart[cellA];
+    }
+  if (cellB != NSNotFound && cellB != cellA)
+    {
+      n += cellStart[cellB + 1] - cellStart[cellB];
+    }
+  return n;
+}
+
+- (NSUInteger) getEntries: (GSTrackingEntry*)found
+                     near: (NSPoint)a
+                      and: (NSPoint)b
+                postOrder: (BOOL)post
+{
+  NSPoint points[2] = {a, b};
+  NSUInteger n = 0;
+  NSUInteger p;
+  NSUInteger i;
+
+  if (++stamp == 0)
+    {
+      for (i = 0; i < count; i++)
+        {
+          entries[i].stamp = 0;
+        }
+      stamp = 1;
+    }
+
+  for (p = 0; p < 2; p++)
+    {
+      NSUInteger cell = [self _cellForPoint: points[p]];
+
+      if (cell != NSNotFound)
+        {
+          for (i = cellStart[cell]; i < cellStart[cell + 1]; i++)
+            {
+              GSTrackingEntry *e = &entries[cellItems[i]];
+
+              if (e->stamp != stamp)
+                {
+                  e->stamp = stamp;
+                  found[n++] = *e;
+                }
+            }
+        }
+    }
+  for (i = 0; i < outsideCount; i++)
+    {
+      GSTrackingEntry *e = &entries[outside[i]];
+
+      if (e->stamp != stamp)
+        {
+          e->stamp = stamp;
+          found[n++] = *e;
+        }
+    }
+
+  if (n > 1)
+    {
+      qsort(found, n, sizeof(GSTrackingEntry),
+        post ? comparePost : comparePre);
+    }
+  return n;
+}
+
+@end
+
+@implementation GSTrackingIndex (Private)
+
+- (void) _addView: (NSView*)view
+           cursor: (BOOL)cursor
+              pre: (NSUInteger*)pre
+             post: (NSUInteger*)post
+{
+  NSArray *rects = nil;
+  NSUInteger first = count;
+  NSUInteger i;
+
+  if (cursor)
+    {
+      if (view->_rFlags.valid_rects)
+        {
+          rects = view->_cursor_rects;
+        }
+    }
+  else if (view->_rFlags.has_trkrects)
+    {
+      rects = view->_tracking_rects;
+    }
+
+  if (rects != nil)
+    {
+      NSUInteger n = [rects count];
+      NSRect vr = NSZeroRect;
+
+      if (n > 0)
+        {
+          GSTrackingRect *objects[n];
+
+          if (count + n > capacity)
+            {
+              capacity = MAX(capacity * 2, count + n);
+              entries = NSZoneRealloc(NSDefaultMallocZone(), entries,
+                capacity * sizeof(GSTrackingEntry));
+            }
+          if (cursor == NO)
+            {
+              vr = [view visibleRect];
+            }
+          [rects getObjects: objects];
+          for (i = 0; i < n; i++)
+            {
+              GSTrackingEntry *e;
+              NSRect frame;
+
+              /* Cursor rects are kept in window coordinates, tracking
+                 rects only count where they are visible. */
+              if (cursor)
+                {
+                  frame = objects[i]->rectangle;
+                }
+              else
+                {
+                  frame = NSIntersectionRect(vr, objects[i]->rectangle);
+                  if (NSIsEmptyRect(frame))
+                    {
+                      continue;
+                    }
+                  frame = [view convertRect: frame toView: nil];
+                }
+              e = &entries[count++];
+              e->rect = objects[i];
+              e->view = view;
+              e->frame = frame;
+              e->pre = (*pre)++;
+              e->stamp = 0;
+            }
+        }
+    }
+
+  if (view->_rFlags.has_subviews)
+    {
+      NSArray *sb = view->_sub_views;
+      NSUInteger n = [sb count];
+
+      if (n > 0)
+        {
+          NSView *subs[n];
+
+          [sb getObjects: subs];
+          for (i = 0; i < n; i++)
+            {
+              if (![subs[i] isHidden])
+                {
+                  [self _addView: subs[i] cursor: cursor pre: pre post: post];
+                }
+            }
+        }
+    }
+
+  for (i = first; i < count; i++)
+    {
+      if (entries[i].view == view)
+        {
+          entries[i].post = (*post)++;
+        }
+    }
+}
+
+- (NSUInteger) _cellForPoint: (NSPoint)p
+{
+  NSUInteger x;
+  NSUInteger y;
+
+  if (NSIsEmptyRect(bounds)
+    || p.x < NSMinX(bounds) || p.x > NSMaxX(bounds)
+    || p.y < NSMinY(bounds) || p.y > NSMaxY(bounds))
+    {
+      return NSNotFound;
+    }
+  x = (NSUInteger)((p.x - NSMinX(bounds)) * columns / NSWidth(bounds));
+  y = (NSUInteger)((p.y - NSMinY(bounds)) * rows / NSHeight(bounds));
+  return MIN(y, rows - 1) * columns + MIN(x, columns - 1);
+}
+
+- (void) _columns: (NSRange*)c rows: (NSRange*)r forRect: (NSRect)rect
+{
+  NSUInteger x0;
+  NSUInteger x1;
+  NSUInteger y0;
+  NSUInteger y1;
+
+  x0 = (NSUInteger)((NSMinX(rect) - NSMinX(bounds)) * columns / NSWidth(bounds));
+  x1 = (NSUInteger)((NSMaxX(rect) - NSMinX(bounds)) * columns / NSWidth(bounds));
+  y0 = (NSUInteger)((NSMinY(rect) - NSMinY(bounds)) * rows / NSHeight(bounds));
+  y1 = (NSUInteger)((NSMaxY(rect) - NSMinY(bounds)) * rows / NSHeight(bounds));
+  x0 = MIN(x0, columns - 1);
+  x1 = MIN(x1, columns - 1);
+  y0 = MIN(y0, rows - 1);
+  y1 = MIN(y1, rows - 1);
+  *c = NSMakeRange(x0, x1 - x0 + 1);
+  *r = NSMakeRange(y0, y1 - y0 + 1);
+}
+
+@end
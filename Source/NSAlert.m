@@ -629,7 +629,8 @@ setKeyEquivalent(NSButton *button)
       rect.size =
 	[[messageField attributedStringValue]
 	  boundingRectWithSize: NSMakeSize(width, 1e6)
-		       options: 0].size;
+		       options: NSStringDrawingUsesLineFragmentOrigin
+				| NSStringDrawingUsesFontLeading].size;
       [messageField setFrame: rect];
 
       /*
@@ -737,7 +738,8 @@ setKeyEquivalent(NSButton *button)
 	  mrect.size =
 	    [[messageField attributedStringValue]
 	      boundingRectWithSize: NSMakeSize(width, 1e6)
-			   options: 0].size;
+			   options: NSStringDrawingUsesLineFragmentOrigin
+				    | NSStringDrawingUsesFontLeading].size;
 	  [messageField setFrame: mrect];
 	  [scroll setDocumentView: messageField];
 	}
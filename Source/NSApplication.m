@@ -413,6 +413,7 @@ struct _NSModalSession {
 
 @interface NSMenu (HorizontalPrivate)
 - (void) _organizeMenu;
+- (void) _updateVisibleMenus;
 @end
 
 /*
@@ -1622,11 +1623,11 @@ static BOOL _isAutolaunchChecked = NO;
 
 	      [self sendEvent: e];
 
-	      // update (en/disable) the services menu's items
+	      // update (en/disable) the items of the menus on screen
 	      if (type != NSPeriodic && type != NSMouseMoved)
 		{
 		  [_listener updateServicesMenu];
-		  [_main_menu update];
+		  [_main_menu _updateVisibleMenus];
 		}
 	    }
 	}
@@ -1935,11 +1936,11 @@ See Also: -runModalForWindow:
 
 	  [self sendEvent: _current_event];
 
-	  // update (en/disable) the services menu's items
+	  // update (en/disable) the items of the menus on screen
 	  if (type != NSPeriodic && type != NSMouseMoved)
 	    {
 	      [_listener updateServicesMenu];
-	      [_main_menu update];
+	      [_main_menu _updateVisibleMenus];
 	    }
 
 	  /*
@@ -30,11 +30,14 @@
 #import <Foundation/NSArchiver.h>
 #import <Foundation/NSArray.h>
 #import <Foundation/NSDictionary.h>
+#import <Foundation/NSEnumerator.h>
 #import <Foundation/NSIndexSet.h>
 #import <Foundation/NSKeyValueObserving.h>
 #import <Foundation/NSPredicate.h>
 #import <Foundation/NSSortDescriptor.h>
+#import <Foundation/NSSet.h>
 #import <Foundation/NSString.h>
+#import <Foundation/NSValue.h>
 
 #import "AppKit/NSArrayController.h"
 #import "AppKit/NSKeyValueBinding.h"
@@ -48,7 +51,7 @@
   self = [super init];
   if (self)
     {
-      ASSIGN(_array, array);
+      _array = [array mutableCopy];
     }
   return self;
 }
@@ -56,6 +59,7 @@
 - (void) dealloc
 {
   RELEASE(_array);
+  RELEASE(_observations);
   [super dealloc];
 }
 
@@ -122,6 +126,17 @@
 {
   NSIndexSet *indexes = [NSIndexSet indexSetWithIndexesInRange: NSMakeRange(0, [self count])];
 
+  if (_observations == nil)
+    {
+      _observations = [[NSMutableArray alloc] init];
+    }
+  [_observations addObject: [NSArray arrayWithObjects:
+    [NSValue valueWithNonretainedObject: anObserver],
+    aPath,
+    [NSNumber numberWithUnsignedInteger:
+      options & ~NSKeyValueObservingOptionInitial],
+    [NSValue valueWithPointer: aContext],
+    nil]];
   [self addObserver: anObserver
  toObjectsAtIndexes: indexes
 	 forKeyPath: aPath
@@ -132,12 +147,105 @@
 - (void) removeObserver: (NSObject*)anObserver forKeyPath: (NSString*)aPath
 {
   NSIndexSet *indexes = [NSIndexSet indexSetWithIndexesInRange: NSMakeRange(0, [self count])];
+  NSUInteger i = [_observations count];
 
+  while (i-- > 0)
+    {
+      NSArray *o = [_observations objectAtIndex: i];
+
+      if ([[o objectAtIndex: 0] nonretainedObjectValue] == anObserver
+	&& [[o objectAtIndex: 1] isEqualToString: aPath])
+	{
+	  [_observations removeObjectAtIndex: i];
+	  break;
+	}
+    }
   [self removeObserver: anObserver
   fromObjectsAtIndexes: indexes
 	    forKeyPath: aPath];
 }
 
+- (void) _insertObjects: (NSArray *)objects atIndexes: (NSIndexSet *)indexes
+{
+  NSEnumerator *e = [_observations objectEnumerator];
+  NSArray *o;
+
+  [_array insertObjects: objects atIndexes: indexes];
+  while ((o = [e nextObject]) != nil)
+    {
+      [_array addObserver: [[o objectAtIndex: 0] nonretainedObjectValue]
+       toObjectsAtIndexes: indexes
+	       forKeyPath: [o objectAtIndex: 1]
+		  options: [[o objectAtIndex: 2] unsignedIntegerValue]
+		  context: [[o objectAtIndex: 3] pointerValue]];
+    }
+}
+
+- (void) _removeObjectsAtIndexes: (NSIndexSet *)indexes
+{
+  NSEnumerator *e = [_observations objectEnumerator];
+  NSArray *o;
+
+  while ((o = [e nextObject]) != nil)
+    {
+      [_array removeObserver: [[o objectAtIndex: 0] nonretainedObjectValue]
+	fromObjectsAtIndexes: indexes
+		  forKeyPath: [o objectAtIndex: 1]];
+    }
+  [_array removeObjectsAtIndexes: indexes];
+}
+
+@end
+
+/* Compares two objects by a list of sort descriptors, the way
+ * -sortedArrayUsingDescriptors: orders them.
+ */
+static NSComparisonResult
+compareWithDescriptors(NSArray *descriptors, id a, id b)
+{
+  NSUInteger count = [descriptors count];
+  NSUInteger i;
+
+  for (i = 0; i < count; i++)
+    {
+      NSComparisonResult r;
+
+      r = [[descriptors objectAtIndex: i] compareObject: a toObject: b];
+      if (r != NSOrderedSame)
+	{
+	  return r;
+	}
+    }
+  return NSOrderedSame;
+}
+
+/* Returns the indexes of the objects in array which are members of set,
+ * in one pass over the array.
+ */
+static NSIndexSet *
+indexesOfMembers(NSArray *array, NSSet *set)
+{
+  NSMutableIndexSet *indexes = [NSMutableIndexSet indexSet];
+  NSUInteger count = [array count];
+  NSUInteger i;
+
+  for (i = 0; i < count; i++)
+    {
+      if ([set member: [array objectAtIndex: i]] != nil)
+	{
+	  [indexes addIndex: i];
+	}
+    }
+  return indexes;
+}
+
+@interface NSArrayController (GSIncrementalArrangement)
+- (NSUInteger) _arrangedIndexForObject: (id)obj after: (BOOL)after;
+- (NSIndexSet*) _arrangedIndexesOfObjects: (NSArray*)objects;
+- (void) _arrangeAddedObjects: (NSArray*)objects;
+- (void) _insertArrangedObjects: (NSArray*)objects
+		      atIndexes: (NSIndexSet*)indexes;
+- (void) _removeArrangedObjectsAtIndexes: (NSIndexSet*)indexes;
 @end
 
 @implementation NSArrayController
@@ -148,8 +256,10 @@
     {
       [self exposeBinding: NSContentArrayBinding];
       [self exposeBinding: NSSelectionIndexesBinding];
-      [self setKeys: [NSArray arrayWithObjects: NSContentBinding, NSContentObjectBinding, nil]
-	    triggerChangeNotificationsForDependentKey: @"arrangedObjects"];
+      /* The arranged objects are not made dependent on the content, as
+       * changes to the content are passed on to them incrementally by
+       * the methods below, with indexed notifications.
+       */
     }
 }
 
@@ -189,18 +299,7 @@
 {
   [self willChangeValueForKey: NSContentBinding];
   [_content addObject: obj];
-  if ([self automaticallyRearrangesObjects])
-    {
-      [self rearrangeObjects];
-    }
-  else
-    {
-      DESTROY(_arranged_objects);
-    }
-  if ([self selectsInsertedObjects])
-    {
-      [self addSelectedObjects: [NSArray arrayWithObject: obj]];
-    }
+  [self _arrangeAddedObjects: [NSArray arrayWithObject: obj]];
   [self didChangeValueForKey: NSContentBinding];
 }
 
@@ -208,50 +307,30 @@
 {
   [self willChangeValueForKey: NSContentBinding];
   [_content addObjectsFromArray: obj];
-  if ([self automaticallyRearrangesObjects])
-    {
-      [self rearrangeObjects];
-    }
-  else
-    {
-      DESTROY(_arranged_objects);
-    }
-  if ([self selectsInsertedObjects])
-    {
-      [self addSelectedObjects: obj];
-    }
+  [self _arrangeAddedObjects: obj];
   [self didChangeValueForKey: NSContentBinding];
 }
 
 - (void) removeObject: (id)obj
 {
+  NSIndexSet *indexes;
+
   [self willChangeValueForKey: NSContentBinding];
   [_content removeObject: obj];
-  [self removeSelectedObjects: [NSArray arrayWithObject: obj]];
-  if ([self automaticallyRearrangesObjects])
-    {
-      [self rearrangeObjects];
-    }
-  else
-    {
-      DESTROY(_arranged_objects);
-    }
+  indexes = [self _arrangedIndexesOfObjects: [NSArray arrayWithObject: obj]];
+  [self _removeArrangedObjectsAtIndexes: indexes];
   [self didChangeValueForKey: NSContentBinding];
 }
 
 - (void) removeObjects: (NSArray*)obj
 {
+  NSIndexSet *indexes;
+
   [self willChangeValueForKey: NSContentBinding];
-  [_content removeObjectsInArray: obj];
-  [self removeSelectedObjects: obj];
-  if ([self automaticallyRearrangesObjects])
-    {
-      [self rearrangeObjects];
-    }
-  else
-    {
-      DESTROY(_arranged_objects);
-    }
+  [_content removeObjectsAtIndexes:
+    indexesOfMembers(_content, [NSSet setWithArray: obj])];
+  indexes = [self _arrangedIndexesOfObjects: obj];
+  [self _removeArrangedObjectsAtIndexes: indexes];
   [self didChangeValueForKey: NSContentBinding];
 }
 
@@ -519,15 +598,22 @@
 - (void) insertObject: (id)obj
 atArrangedObjectIndex: (NSUInteger)idx
 {
-  // FIXME
-  [self addObject: obj];
+  [self insertObjects: [NSArray arrayWithObject: obj]
+    atArrangedObjectIndexes: [NSIndexSet indexSetWithIndex: idx]];
 }
 
 - (void) insertObjects: (NSArray*)obj
 atArrangedObjectIndexes: (NSIndexSet*)idx
 {
-  // FIXME
-  [self addObjects: obj];
+  if (_arranged_objects == nil)
+    {
+      [self addObjects: obj];
+      return;
+    }
+  [self willChangeValueForKey: NSContentBinding];
+  [_content addObjectsFromArray: obj];
+  [self _insertArrangedObjects: obj atIndexes: idx];
+  [self didChangeValueForKey: NSContentBinding];
 }
 
 - (void) removeObjectAtArrangedObjectIndex: (NSUInteger)idx
@@ -676,3 +762,180 @@ atArrangedObjectIndexes: (NSIndexSet*)idx
 }
 
 @end
+
+@implementation NSArrayController (GSIncrementalArrangement)
+
+/* Returns the index at which obj goes in the arranged objects by the sort
+ * descriptors, before or after any objects which compare the same.
+ */
+- (NSUInteger) _arrangedIndexForObject: (id)obj after: (BOOL)after
+{
+  NSUInteger low = 0;
+  NSUInteger high = [_arranged_objects count];
+
+  while (low < high)
+    {
+      NSUInteger mid = low + (high - low) / 2;
+      NSComparisonResult r;
+
+      r = compareWithDescriptors(_sort_descriptors,
+	[_arranged_objects objectAtIndex: mid], obj);
+      if (r == NSOrderedAscending || (after && r == NSOrderedSame))
+	{
+	  low = mid + 1;
+	}
+      else
+	{
+	  high = mid;
+	}
+    }
+  return low;
+}
+
+- (NSIndexSet*) _arrangedIndexesOfObjects: (NSArray*)objects
+{
+  if ([objects count] == 1 && [_sort_descriptors count] > 0)
+    {
+      NSMutableIndexSet *indexes = [NSMutableIndexSet indexSet];
+      id obj = [objects objectAtIndex: 0];
+      NSUInteger i = [self _arrangedIndexForObject: obj after: NO];
+      NSUInteger end = [self _arrangedIndexForObject: obj after: YES];
+
+      for (; i < end; i++)
+	{
+	  if ([obj isEqual: [_arranged_objects objectAtIndex: i]])
+	    {
+	      [indexes addIndex: i];
+	    }
+	}
+      if ([indexes count] > 0)
+	{
+	  return indexes;
+	}
+      /* The object may be filtered out, or its sort keys may have
+       * changed since it was arranged.
+       */
+    }
+  return indexesOfMembers(_arranged_objects, [NSSet setWithArray: objects]);
+}
+
+/* Puts objects just added to the content into the arranged objects.  Only
+ * the new objects are tested against the filter predicate, and they are
+ * inserted where the sort descriptors place them, after any objects which
+ * compare the same, or at the end when there are no sort descriptors.
+ */
+- (void) _arrangeAddedObjects: (NSArray*)objects
+{
+  NSMutableArray *accepted;
+  NSMutableIndexSet *indexes;
+  NSUInteger count;
+  NSUInteger i;
+
+  if (_arranged_objects == nil)
+    {
+      [self rearrangeObjects];
+      if ([self selectsInsertedObjects])
+	{
+	  [self addSelectedObjects: objects];
+	}
+      return;
+    }
+
+  count = [objects count];
+  accepted = [NSMutableArray arrayWithCapacity: count];
+  for (i = 0; i < count; i++)
+    {
+      id obj = [objects objectAtIndex: i];
+
+      if (_filter_predicate == nil
+	|| [_filter_predicate evaluateWithObject: obj])
+	{
+	  [accepted addObject: obj];
+	}
+    }
+  count = [accepted count];
+  if (count == 0)
+    {
+      return;
+    }
+
+  indexes = [NSMutableIndexSet indexSet];
+  if ([_sort_descriptors count] == 0)
+    {
+      [indexes addIndexesInRange:
+	NSMakeRange([_arranged_objects count], count)];
+    }
+  else
+    {
+      /* Placing the new objects in order against the old arrangement
+       * gives each its final index offset by the new objects before it.
+       */
+      [accepted setArray:
+	[accepted sortedArrayUsingDescriptors: _sort_descriptors]];
+      for (i = 0; i < count; i++)
+	{
+	  [indexes addIndex: i + [self _arrangedIndexForObject:
+	    [accepted objectAtIndex: i] after: YES]];
+	}
+    }
+  [self _insertArrangedObjects: accepted atIndexes: indexes];
+}
+
+- (void) _insertArrangedObjects: (NSArray*)objects
+		      atIndexes: (NSIndexSet*)indexes
+{
+  NSMutableIndexSet *selection;
+  NSUInteger idx;
+
+  [self willChange: NSKeyValueChangeInsertion
+   valuesAtIndexes: indexes
+	    forKey: @"arrangedObjects"];
+  [(GSObservableArray*)_arranged_objects _insertObjects: objects
+					      atIndexes: indexes];
+  [self didChange: NSKeyValueChangeInsertion
+  valuesAtIndexes: indexes
+	   forKey: @"arrangedObjects"];
+
+  /* Keep the same objects selected. */
+  selection = AUTORELEASE([_selection_indexes mutableCopy]);
+  for (idx = [indexes firstIndex]; idx != NSNotFound;
+    idx = [indexes indexGreaterThanIndex: idx])
+    {
+      [selection shiftIndexesStartingAtIndex: idx by: 1];
+    }
+  if ([self selectsInsertedObjects])
+    {
+      [selection addIndexes: indexes];
+    }
+  [self setSelectionIndexes: selection];
+}
+
+- (void) _removeArrangedObjectsAtIndexes: (NSIndexSet*)indexes
+{
+  NSMutableIndexSet *selection;
+  NSUInteger idx;
+
+  if ([indexes count] == 0)
+    {
+      return;
+    }
+
+  [self willChange: NSKeyValueChangeRemoval
+   valuesAtIndexes: indexes
+	    forKey: @"arrangedObjects"];
+  [(GSObservableArray*)_arranged_objects _removeObjectsAtIndexes: indexes];
+  [self didChange: NSKeyValueChangeRemoval
+  valuesAtIndexes: indexes
+	   forKey: @"arrangedObjects"];
+
+  selection = AUTORELEASE([_selection_indexes mutableCopy]);
+  [selection removeIndexes: indexes];
+  for (idx = [indexes lastIndex]; idx != NSNotFound;
+    idx = [indexes indexLessThanIndex: idx])
+    {
+      [selection shiftIndexesStartingAtIndex: idx + 1 by: -1];
+    }
+  [self setSelectionIndexes: selection];
+}
+
+@end
@@ -37,6 +37,9 @@
 + (BOOL) _bitmapIsJPEG: (NSData *)imageData;
 - (id) _initBitmapFromJPEG: (NSData *)imageData
 	      errorMessage: (NSString **)errorMsg;
+- (id) _initBitmapFromJPEG: (NSData *)imageData
+	      maxPixelSize: (NSUInteger)maxSize
+	      errorMessage: (NSString **)errorMsg;
 - (NSData *) _JPEGRepresentationWithProperties: (NSDictionary *) properties
                                   errorMessage: (NSString **)errorMsg;
 @end
@@ -411,6 +411,21 @@ static void gs_jpeg_memory_dest_destroy (j_compress_ptr cinfo)
  */
 - (id) _initBitmapFromJPEG: (NSData *)imageData
 	      errorMessage: (NSString **)errorMsg
+{
+  return [self _initBitmapFromJPEG: imageData
+		      maxPixelSize: 0
+		      errorMessage: errorMsg];
+}
+
+/* Read the jpeg image at a reduced resolution.  libjpeg scales the image
+ * down by 1/2, 1/4 or 1/8 while doing the inverse DCT, so only the
+ * reduced image is ever held in memory.  The largest of those factors is
+ * used that keeps the longer side at least maxSize pixels; zero means no
+ * reduction.
+ */
+- (id) _initBitmapFromJPEG: (NSData *)imageData
+	      maxPixelSize: (NSUInteger)maxSize
+	      errorMessage: (NSString **)errorMsg
 {
   struct jpeg_decompress_struct  cinfo;
   struct gs_jpeg_error_mgr  jerrMgr;
@@ -469,6 +484,19 @@ static void gs_jpeg_memory_dest_destroy (j_compress_ptr cinfo)
       cinfo.out_color_space = JCS_RGB;
       outColorSpace = NSCalibratedRGBColorSpace;
     }
+  if (maxSize > 0)
+    {
+      JDIMENSION longer = MAX(cinfo.image_width, cinfo.image_height);
+      unsigned int denom = 8;
+
+      while (denom > 1 && longer / denom < maxSize)
+	{
+	  denom /= 2;
+	}
+      cinfo.scale_num = 1;
+      cinfo.scale_denom = denom;
+    }
+
   /* decompress */
   jpeg_start_decompress(&cinfo);
 
@@ -515,7 +543,7 @@ static void gs_jpeg_memory_dest_destroy (j_compress_ptr cinfo)
         {
 	  // copy a row to the image buffer
 	  memcpy((imgbuffer + (i * rowSize)),
-	    *(sclbuffer + (j * rowSize)),
+	    *(sclbuffer + j),
 	    rowSize);
 	  i++;
         }
@@ -555,6 +583,13 @@ static void gs_jpeg_memory_dest_destroy (j_compress_ptr cinfo)
   [self setProperty: NSImageProgressive
           withValue: [NSNumber numberWithBool: isProgressive]];
 
+  /* A reduced image keeps the size of the whole one. */
+  if (cinfo.output_width != cinfo.image_width
+      || cinfo.output_height != cinfo.image_height)
+    {
+      [self setSize: NSMakeSize(cinfo.image_width, cinfo.image_height)];
+    }
+
   x_density = (double) cinfo.X_density;
   y_density = (double) cinfo.Y_density;
   if (x_density > 0 && y_density > 0)
@@ -574,8 +609,8 @@ static void gs_jpeg_memory_dest_destroy (j_compress_ptr cinfo)
         {
           NSSize pointSize;
 
-          pointSize = NSMakeSize((double)cinfo.output_width * 72.0 / x_density,
-                                 (double)cinfo.output_height * 72.0 / y_density);
+          pointSize = NSMakeSize((double)cinfo.image_width * 72.0 / x_density,
+                                 (double)cinfo.image_height * 72.0 / y_density);
           [self setSize: pointSize];
         }
     }
@@ -757,6 +792,14 @@ static void gs_jpeg_memory_dest_destroy (j_compress_ptr cinfo)
   RELEASE(self);
   return nil;
 }
+
+- (id) _initBitmapFromJPEG: (NSData *)imageData
+	      maxPixelSize: (NSUInteger)maxSize
+	      errorMessage: (NSString **)errorMsg
+{
+  RELEASE(self);
+  return nil;
+}
 - (NSData *) _JPEGRepresentationWithProperties: (NSDictionary *) properties
                                   errorMessage: (NSString **)errorMsg
 {
@@ -35,6 +35,8 @@
 @interface NSBitmapImageRep (PNG)
 + (BOOL) _bitmapIsPNG: (NSData *)imageData;
 - (id) _initBitmapFromPNG: (NSData *)imageData;
+- (id) _initBitmapFromPNG: (NSData *)imageData
+	     maxPixelSize: (NSUInteger)maxSize;
 - (NSData *) _PNGRepresentationWithProperties: (NSDictionary *) properties;
 @end
 
@@ -94,6 +94,19 @@ static void reader_func(png_structp png_struct, png_bytep data,
 }
 
 - (id) _initBitmapFromPNG: (NSData *)imageData
+{
+  return [self _initBitmapFromPNG: imageData maxPixelSize: 0];
+}
+
+/* Read the PNG image, reduced by the largest whole factor that keeps the
+ * longer side at least maxSize pixels; zero means no reduction.  A reduced
+ * image is averaged over boxes of pixels as its rows are read, weighting
+ * colours by alpha, so apart from interlaced images that have to be read
+ * whole, only one row of the full image is held at a time.  Its samples
+ * are eight bit.
+ */
+- (id) _initBitmapFromPNG: (NSData *)imageData
+	     maxPixelSize: (NSUInteger)maxSize
 {
   png_structp png_struct;
   png_infop png_info, png_end_info;
@@ -104,7 +117,11 @@ static void reader_func(png_structp png_struct, png_bytep data,
      longjmp restores to its value at the setjmp call. */
   unsigned char * volatile buf = NULL;
   png_bytep * volatile row_ptrs = NULL;
+  unsigned char * volatile scratch = NULL;
+  unsigned long long * volatile sums = NULL;
   unsigned char *plane;
+  int pixelsWide, pixelsHigh;
+  NSUInteger factor = 1;
   int bytes_per_row;
   size_t imageSize = 0;
   int type,channels,depth;
@@ -150,6 +167,14 @@ static void reader_func(png_structp png_struct, png_bytep data,
         {
           NSZoneFree([self zone], row_ptrs);
         }
+      if (scratch != NULL)
+        {
+          NSZoneFree([self zone], scratch);
+        }
+      if (sums != NULL)
+        {
+          NSZoneFree([self zone], sums);
+        }
       if (buf != NULL)
         {
           NSZoneFree([self zone], buf);
@@ -225,6 +250,170 @@ static void reader_func(png_structp png_struct, png_bytep data,
 	return nil;
     }
 
+  pixelsWide = width;
+  pixelsHigh = height;
+  if (maxSize > 0 && width > 0 && height > 0)
+    {
+      factor = (NSUInteger)MAX(width, height) / maxSize;
+    }
+  if (factor > 1)
+    {
+      int passes;
+      int spp;
+      int ai;
+      int x, y, i;
+      int oy = 0;
+      size_t sumsSize;
+
+      if (depth == 16)
+	{
+#ifdef PNG_READ_SCALE_16_TO_8_SUPPORTED
+	  png_set_scale_16(png_struct);
+#else
+	  png_set_strip_16(png_struct);
+#endif
+	}
+      else if (depth < 8)
+	{
+	  png_set_expand_gray_1_2_4_to_8(png_struct);
+	}
+      passes = png_set_interlace_handling(png_struct);
+      png_read_update_info(png_struct, png_info);
+      depth = 8;
+      spp = png_get_channels(png_struct, png_info);
+      bytes_per_row = png_get_rowbytes(png_struct, png_info);
+      channels = spp;
+      bpp = spp * 8;
+      ai = alpha ? spp - 1 : -1;
+
+      pixelsWide = (width + factor - 1) / factor;
+      pixelsHigh = (height + factor - 1) / factor;
+      imageSize = (size_t)pixelsWide * spp * pixelsHigh;
+      sumsSize = (size_t)pixelsWide * spp * sizeof(unsigned long long);
+      buf = NSZoneMalloc([self zone], imageSize);
+      sums = NSZoneMalloc([self zone], sumsSize);
+      if (passes > 1)
+	{
+	  /* Interlaced rows only come complete once every pass is read. */
+	  size_t fullSize = (size_t)bytes_per_row * (size_t)height;
+
+	  if (fullSize / (size_t)height == (size_t)bytes_per_row)
+	    {
+	      scratch = NSZoneMalloc([self zone], fullSize);
+	      row_ptrs = NSZoneMalloc([self zone],
+		sizeof(png_bytep) * (size_t)height);
+	    }
+	}
+      else
+	{
+	  scratch = NSZoneMalloc([self zone], bytes_per_row);
+	}
+      if (buf == NULL || sums == NULL || scratch == NULL
+	|| (passes > 1 && row_ptrs == NULL))
+	{
+	  png_error(png_struct, "out of memory");
+	}
+      if (passes > 1)
+	{
+	  for (i = 0; i < height; i++)
+	    {
+	      row_ptrs[i] = scratch + (size_t)i * (size_t)bytes_per_row;
+	    }
+	  png_read_image(png_struct, row_ptrs);
+	}
+
+      memset(sums, 0, sumsSize);
+      for (y = 0; y < height; y++)
+	{
+	  png_bytep src;
+	  int ox;
+
+	  if (passes > 1)
+	    {
+	      src = row_ptrs[y];
+	    }
+	  else
+	    {
+	      png_read_row(png_struct, scratch, NULL);
+	      src = scratch;
+	    }
+	  for (ox = 0; ox < pixelsWide; ox++)
+	    {
+	      unsigned long long *sum = sums + ox * spp;
+	      int end = MIN((ox + 1) * (int)factor, width);
+
+	      for (x = ox * factor; x < end; x++)
+		{
+		  png_bytep p = src + x * spp;
+
+		  if (ai < 0)
+		    {
+		      for (i = 0; i < spp; i++)
+			{
+			  sum[i] += p[i];
+			}
+		    }
+		  else
+		    {
+		      unsigned int a = p[ai];
+
+		      for (i = 0; i < ai; i++)
+			{
+			  sum[i] += p[i] * a;
+			}
+		      sum[ai] += a;
+		    }
+		}
+	    }
+
+	  if ((y + 1) % factor == 0 || y == height - 1)
+	    {
+	      unsigned char *dst = buf + (size_t)oy * pixelsWide * spp;
+	      int rows = y % factor + 1;
+
+	      for (ox = 0; ox < pixelsWide; ox++)
+		{
+		  unsigned long long *sum = sums + ox * spp;
+		  unsigned long long n;
+
+		  n = rows * (unsigned long long)(MIN((ox + 1) * (int)factor,
+		    width) - ox * (int)factor);
+		  if (ai < 0)
+		    {
+		      for (i = 0; i < spp; i++)
+			{
+			  dst[i] = (sum[i] + n / 2) / n;
+			}
+		    }
+		  else
+		    {
+		      unsigned long long a = sum[ai];
+
+		      for (i = 0; i < ai; i++)
+			{
+			  dst[i] = a ? (sum[i] + a / 2) / a : 0;
+			}
+		      dst[ai] = (a + n / 2) / n;
+		    }
+		  dst += spp;
+		}
+	      memset(sums, 0, sumsSize);
+	      oy++;
+	    }
+	}
+
+      NSZoneFree([self zone], sums);
+      sums = NULL;
+      NSZoneFree([self zone], scratch);
+      scratch = NULL;
+      if (row_ptrs != NULL)
+	{
+	  NSZoneFree([self zone], row_ptrs);
+	  row_ptrs = NULL;
+	}
+      bytes_per_row = pixelsWide * spp;
+    }
+  else
   {
     /* width, height and bytes_per_row are taken from the untrusted PNG
        header.  The buffer size was computed in int, so a large image wrapped
@@ -280,8 +469,8 @@ static void reader_func(png_structp png_struct, png_bytep data,
 
   plane = (unsigned char *)buf;
   self = [self initWithBitmapDataPlanes: &plane
-                             pixelsWide: width
-                             pixelsHigh: height
+                             pixelsWide: pixelsWide
+                             pixelsHigh: pixelsHigh
                           bitsPerSample: depth
                         samplesPerPixel: channels
                                hasAlpha: alpha
@@ -295,6 +484,12 @@ static void reader_func(png_structp png_struct, png_bytep data,
     initWithBytesNoCopy: buf
 		 length: imageSize];
 
+  /* A reduced image keeps the size of the whole one. */
+  if (factor > 1)
+    {
+      [self setSize: NSMakeSize(width, height)];
+    }
+
   if (png_get_valid(png_struct, png_info, PNG_INFO_gAMA))
   {
     double file_gamma = 2.2;
@@ -485,6 +680,12 @@ static void writer_func(png_structp png_struct, png_bytep data,
   RELEASE(self);
   return nil;
 }
+- (id) _initBitmapFromPNG: (NSData *)imageData
+	     maxPixelSize: (NSUInteger)maxSize
+{
+  RELEASE(self);
+  return nil;
+}
 - (NSData *) _PNGRepresentationWithProperties: (NSDictionary *) properties
 {
   return nil;
@@ -52,6 +52,7 @@
 #import "NSBitmapImageRep+PNM.h"
 #import "NSBitmapImageRep+ICNS.h"
 #import "NSBitmapImageRepPrivate.h"
+#import "GSBitmapKernels.h"
 #import "GSGuiPrivate.h"
 
 #include "nsimage-tiff.h"
@@ -286,6 +287,50 @@
   return nil;
 }
 
+/** Returns a newly allocated NSBitmapImageRep holding the first image in
+    imageData, decoded at a reduced resolution when it is much larger than
+    maxSize.  See -initWithData:maxPixelSize:
+*/
++ (id) imageRepWithData: (NSData *)imageData
+	   maxPixelSize: (NSUInteger)maxSize
+{
+  return AUTORELEASE([[self alloc] initWithData: imageData
+				   maxPixelSize: maxSize]);
+}
+
+/** <p>Loads the first image in imageData like -initWithData:, but scaled
+    down while it is decoded, so that drawing a large picture as a thumbnail
+    takes time and memory in proportion to the thumbnail.  The image is
+    reduced by as much as the decoder can while keeping its longer side at
+    least maxSize pixels, and keeps the size in points of the whole image.
+    </p><p>JPEG images are reduced by 1/2, 1/4 or 1/8 as they are
+    decompressed and PNG images by any whole factor as their rows are read.
+    Other images, and a maxSize of zero, are loaded whole.</p>
+*/
+- (id) initWithData: (NSData *)imageData
+       maxPixelSize: (NSUInteger)maxSize
+{
+  Class class;
+
+  if (imageData == nil)
+    {
+      RELEASE(self);
+      return nil;
+    }
+
+  class = [self class];
+  if ([class _bitmapIsPNG: imageData])
+    return [self _initBitmapFromPNG: imageData
+		       maxPixelSize: maxSize];
+
+  if ([class _bitmapIsJPEG: imageData])
+    return [self _initBitmapFromJPEG: imageData
+			maxPixelSize: maxSize
+			errorMessage: NULL];
+
+  return [self initWithData: imageData];
+}
+
 /** Initialize with bitmap data from a rect within the focused view */
 - (id) initWithFocusedViewRect: (NSRect)rect
 {
@@ -1895,6 +1940,50 @@ _set_bit_value(unsigned char *base, long msb_off, int bit_width,
 
 @end
 
+/* Whether the sixteen bit samples of a bitmap are in host byte order. */
+static BOOL
+hostOrder16(NSBitmapFormat format)
+{
+  if (NSHostByteOrder() == NS_BigEndian)
+    {
+      return (format & NSBitmapFormatSixteenBitLittleEndian) == 0;
+    }
+  return (format & NSBitmapFormatSixteenBitBigEndian) == 0;
+}
+
+/* Whether the rows of a bitmap can be handed to the row kernels: eight or
+ * sixteen bit integer samples in host order, with no padding between the
+ * samples of a pixel.
+ */
+static BOOL
+kernelRows(NSInteger bps, NSInteger spp, NSInteger bpp, BOOL planar,
+  NSInteger bytesPerRow, NSBitmapFormat format)
+{
+  if (format & NSFloatingPointSamplesBitmapFormat)
+    {
+      return NO;
+    }
+  if (bps == 16)
+    {
+      if (!hostOrder16(format) || (bytesPerRow % 2) != 0)
+        {
+          return NO;
+        }
+    }
+  else if (bps != 8)
+    {
+      return NO;
+    }
+  return (planar ? bpp == bps : bpp == bps * spp);
+}
+
+static BOOL
+isRGBSpace(NSString *name)
+{
+  return [name isEqualToString: NSDeviceRGBColorSpace]
+    || [name isEqualToString: NSCalibratedRGBColorSpace];
+}
+
 @implementation NSBitmapImageRep (GSPrivate)
 
 + (int) _localFromCompressionType: (NSTIFFCompression)type
@@ -2168,6 +2257,226 @@ _set_bit_value(unsigned char *base, long msb_off, int bit_width,
     }
 }
 
+- (BOOL) _premultiplyRows: (BOOL)premultiply alphaIndex: (NSInteger)ai
+{
+  NSInteger n = _pixelsWide;
+  NSInteger y;
+  NSInteger i;
+
+  if (!kernelRows(_bitsPerSample, _numColors, _bitsPerPixel, _isPlanar,
+                  _bytesPerRow, _format))
+    {
+      return NO;
+    }
+
+  for (y = 0; y < _pixelsHigh; y++)
+    {
+      NSInteger offset = y * _bytesPerRow;
+
+      if (_isPlanar)
+        {
+          unsigned char *rows[MAX_PLANES];
+
+          for (i = 0; i < _numColors; i++)
+            {
+              rows[i] = _imagePlanes[i] + offset;
+            }
+          if (_bitsPerSample == 8)
+            {
+              if (premultiply)
+                GSPremultiplyPlanarRow8(rows, n, _numColors, ai);
+              else
+                GSUnpremultiplyPlanarRow8(rows, n, _numColors, ai);
+            }
+          else
+            {
+              if (premultiply)
+                GSPremultiplyPlanarRow16((unsigned short**)rows, n,
+                  _numColors, ai);
+              else
+                GSUnpremultiplyPlanarRow16((unsigned short**)rows, n,
+                  _numColors, ai);
+            }
+        }
+      else
+        {
+          unsigned char *row = _imagePlanes[0] + offset;
+
+          if (_bitsPerSample == 8)
+            {
+              if (premultiply)
+                GSPremultiplyRow8(row, n, _numColors, ai);
+              else
+                GSUnpremultiplyRow8(row, n, _numColors, ai);
+            }
+          else
+            {
+              if (premultiply)
+                GSPremultiplyRow16((unsigned short*)row, n, _numColors, ai);
+              else
+                GSUnpremultiplyRow16((unsigned short*)row, n, _numColors, ai);
+            }
+        }
+    }
+  return YES;
+}
+
+/* Converts the samples into new row by row with the kernels: gather a
+ * row into meshed pixels with alpha last, change the premultiplication,
+ * the colour space and the sample size as needed, then put the alpha in
+ * place and scatter the row into new.  Returns NO when the formats need
+ * the pixel by pixel conversion.
+ */
+- (BOOL) _convertRowsTo: (NSBitmapImageRep*)new
+{
+  NSInteger n = _pixelsWide;
+  NSInteger sspp = _numColors;
+  NSInteger dspp = new->_numColors;
+  NSInteger dbps = new->_bitsPerSample;
+  BOOL gray = NO;
+  BOOL premul;
+  unsigned char *buffers;
+  NSUInteger size;
+  NSInteger y;
+  NSInteger i;
+
+  if (!kernelRows(_bitsPerSample, sspp, _bitsPerPixel, _isPlanar,
+                  _bytesPerRow, _format)
+      || !kernelRows(dbps, dspp, new->_bitsPerPixel, new->_isPlanar,
+                     new->_bytesPerRow, new->_format)
+      || _hasAlpha != new->_hasAlpha)
+    {
+      return NO;
+    }
+  if ([_colorSpace isEqualToString: new->_colorSpace]
+      || (isRGBSpace(_colorSpace) && isRGBSpace(new->_colorSpace)))
+    {
+      if (sspp != dspp)
+        {
+          return NO;
+        }
+    }
+  else if (([_colorSpace isEqualToString: NSCalibratedWhiteColorSpace]
+            || [_colorSpace isEqualToString: NSDeviceWhiteColorSpace])
+           && isRGBSpace(new->_colorSpace) && dspp == sspp + 2)
+    {
+      gray = YES;
+    }
+  else
+    {
+      return NO;
+    }
+  premul = _hasAlpha
+    && ((_format & NSAlphaNonpremultipliedBitmapFormat)
+        != (new->_format & NSAlphaNonpremultipliedBitmapFormat));
+
+  size = n * MAX(sspp, dspp) * 2;
+  buffers = NSZoneMalloc(NSDefaultMallocZone(), 2 * size);
+  for (y = 0; y < _pixelsHigh; y++)
+    {
+      unsigned char *cur = buffers;
+      unsigned char *other = buffers + size;
+      unsigned char *tmp;
+      NSInteger spp = sspp;
+      NSInteger bps = _bitsPerSample;
+
+      if (_isPlanar)
+        {
+          unsigned char *rows[MAX_PLANES];
+
+          for (i = 0; i < spp; i++)
+            {
+              rows[i] = _imagePlanes[i] + y * _bytesPerRow;
+            }
+          if (bps == 8)
+            GSMeshRow8(rows, cur, n, spp);
+          else
+            GSMeshRow16((unsigned short**)rows, (unsigned short*)cur, n, spp);
+        }
+      else
+        {
+          memcpy(cur, _imagePlanes[0] + y * _bytesPerRow, n * spp * bps / 8);
+        }
+
+      if (_hasAlpha && (_format & NSAlphaFirstBitmapFormat))
+        {
+          if (bps == 8)
+            GSAlphaLastRow8(cur, n, spp);
+          else
+            GSAlphaLastRow16((unsigned short*)cur, n, spp);
+        }
+
+      if (premul)
+        {
+          BOOL multiply = (_format & NSAlphaNonpremultipliedBitmapFormat) != 0;
+
+          if (bps == 8 && multiply)
+            GSPremultiplyRow8(cur, n, spp, spp - 1);
+          else if (bps == 8)
+            GSUnpremultiplyRow8(cur, n, spp, spp - 1);
+          else if (multiply)
+            GSPremultiplyRow16((unsigned short*)cur, n, spp, spp - 1);
+          else
+            GSUnpremultiplyRow16((unsigned short*)cur, n, spp, spp - 1);
+        }
+
+      if (gray)
+        {
+          if (bps == 8)
+            GSGrayToRGBRow8(cur, other, n, _hasAlpha);
+          else
+            GSGrayToRGBRow16((unsigned short*)cur, (unsigned short*)other,
+              n, _hasAlpha);
+          spp = dspp;
+          tmp = cur;
+          cur = other;
+          other = tmp;
+        }
+
+      if (bps != dbps)
+        {
+          if (bps == 8)
+            GSWidenRow8To16(cur, (unsigned short*)other, n * spp);
+          else
+            GSNarrowRow16To8((unsigned short*)cur, other, n * spp);
+          bps = dbps;
+          tmp = cur;
+          cur = other;
+          other = tmp;
+        }
+
+      if (_hasAlpha && (new->_format & NSAlphaFirstBitmapFormat))
+        {
+          if (bps == 8)
+            GSAlphaFirstRow8(cur, n, spp);
+          else
+            GSAlphaFirstRow16((unsigned short*)cur, n, spp);
+        }
+
+      if (new->_isPlanar)
+        {
+          unsigned char *rows[MAX_PLANES];
+
+          for (i = 0; i < spp; i++)
+            {
+              rows[i] = new->_imagePlanes[i] + y * new->_bytesPerRow;
+            }
+          if (bps == 8)
+            GSUnmeshRow8(cur, rows, n, spp);
+          else
+            GSUnmeshRow16((unsigned short*)cur, (unsigned short**)rows,
+              n, spp);
+        }
+      else
+        {
+          memcpy(new->_imagePlanes[0] + y * new->_bytesPerRow, cur,
+            n * spp * bps / 8);
+        }
+    }
+  NSZoneFree(NSDefaultMallocZone(), buffers);
+  return YES;
+}
+
 - (void) _premultiply
 {
   NSInteger x, y;
@@ -2194,6 +2503,12 @@ _set_bit_value(unsigned char *base, long msb_off, int bit_width,
       end = _numColors - 1;
     }
 
+  if ([self _premultiplyRows: YES alphaIndex: ai])
+    {
+      _format &= ~NSAlphaNonpremultipliedBitmapFormat;
+      return;
+    }
+
   if (_bitsPerSample == 8)
     {
       if (!_isPlanar)
@@ -2312,6 +2627,12 @@ _set_bit_value(unsigned char *base, long msb_off, int bit_width,
       end = _numColors - 1;
     }
 
+  if ([self _premultiplyRows: NO alphaIndex: ai])
+    {
+      _format |= NSAlphaNonpremultipliedBitmapFormat;
+      return;
+    }
+
   if (_bitsPerSample == 8)
     {
       if (!_isPlanar)
@@ -2466,7 +2787,12 @@ _set_bit_value(unsigned char *base, long msb_off, int bit_width,
                 bytesPerRow: rowBytes
                 bitsPerPixel: pixelBits];
 
-      if ([_colorSpace isEqualToString: colorSpaceName] ||
+      if ([self _convertRowsTo: new])
+        {
+          NSDebugLLog(@"NSImage", @"Converted %@ bitmap data by rows",
+                      _colorSpace);
+        }
+      else if ([_colorSpace isEqualToString: colorSpaceName] ||
           ([_colorSpace isEqualToString: NSDeviceRGBColorSpace] &&
            [colorSpaceName isEqualToString: NSCalibratedRGBColorSpace]) ||
           ([colorSpaceName isEqualToString: NSDeviceRGBColorSpace] &&
@@ -1079,7 +1079,8 @@
 
   return [titleToDisplay
 	   boundingRectWithSize: cellFrame.size
-			options: NSStringDrawingUsesLineFragmentOrigin];   
+			options: NSStringDrawingUsesLineFragmentOrigin
+				 | NSStringDrawingUsesFontLeading];
 }
 
 // Private helper method overridden in subclasses
@@ -34,6 +34,8 @@
 #import <Foundation/NSDictionary.h>
 #import <Foundation/NSMapTable.h>
 #import <Foundation/NSKeyedArchiver.h>
+#import <Foundation/NSNotification.h>
+#import <Foundation/NSValue.h>
 
 #import "AppKit/NSApplication.h"
 #import "AppKit/NSClipView.h"
@@ -72,6 +74,18 @@ APPKIT_DECLARE NSCollectionViewSupplementaryElementKind GSNoSupplementaryElement
  */
 #define OVERRIDDEN(sel) ([_collectionViewLayout methodForSelector: @selector(sel)] != [[NSCollectionViewLayout class] instanceMethodForSelector: @selector(sel)])
 
+/*
+ * Items are realised for the visible rect grown on every side by this
+ * fraction of its size, so that they are ready before they scroll in.
+ */
+#define GSCollectionViewPrefetchMargin 0.5
+
+/*
+ * Height of the horizontal bands of the content used to find the items
+ * in a rect.
+ */
+#define GSCollectionViewBandHeight 256.0
+
 /*
  * Class variables
  */
@@ -123,6 +137,182 @@ static NSString *_placeholderItem = nil;
 - (void) _updateSelectionIndexPaths;
 - (void) _updateSelectionIndexes;
 
+- (void) _prepareLayoutAttributes;
+- (NSArray *) _layoutAttributesForElementsInRect: (NSRect)rect;
+- (void) _relayoutItems;
+- (void) _updateVisibleItems;
+- (void) _loadItemAtIndexPath: (NSIndexPath *)path
+	       withAttributes: (NSCollectionViewLayoutAttributes *)attrs;
+- (void) _applyLayoutAttributes: (NSCollectionViewLayoutAttributes *)attrs
+			 toItem: (NSCollectionViewItem *)item;
+- (void) _recycleItem: (NSCollectionViewItem *)item;
+- (NSCollectionViewItem *) _dequeueItemWithIdentifier: (NSUserInterfaceItemIdentifier)identifier;
+- (NSCollectionViewItem *) _itemRegisteredWithIdentifier: (NSUserInterfaceItemIdentifier)identifier;
+
+@end
+
+/*
+ * The layout attributes of all the items of a collection view, computed in
+ * order by one layout pass, and the items found in each horizontal band of
+ * the content, so that those in a rect are found without looking at all.
+ */
+@interface GSCollectionViewLayoutCache : NSObject
+{
+  NSSize extent;
+  NSMutableArray *attributes;
+  NSMutableArray *sectionEnds;
+  NSMutableArray *bands;
+}
+- (void) addAttributes: (NSCollectionViewLayoutAttributes *)attrs;
+- (void) endSection;
+- (NSCollectionViewLayoutAttributes *) attributesForItemAtIndexPath: (NSIndexPath *)path;
+- (NSArray *) attributesInRect: (NSRect)rect;
+- (NSSize) extent;
+@end
+
+static inline NSUInteger
+bandForY(CGFloat y)
+{
+  return (y <= 0.0) ? 0 : (NSUInteger)floor(y / GSCollectionViewBandHeight);
+}
+
+@implementation GSCollectionViewLayoutCache
+
+- (id) init
+{
+  if ((self = [super init]) != nil)
+    {
+      extent = NSZeroSize;
+      attributes = [[NSMutableArray alloc] init];
+      sectionEnds = [[NSMutableArray alloc] init];
+      bands = [[NSMutableArray alloc] init];
+    }
+  return self;
+}
+
+- (void) dealloc
+{
+  RELEASE(attributes);
+  RELEASE(sectionEnds);
+  RELEASE(bands);
+  [super dealloc];
+}
+
+- (void) addAttributes: (NSCollectionViewLayoutAttributes *)attrs
+{
+  NSUInteger index = [attributes count];
+  NSRect f = [attrs frame];
+  NSUInteger first;
+  NSUInteger last;
+  NSUInteger b;
+
+  [attributes addObject: attrs];
+  if ([attrs isHidden] || NSIsEmptyRect(f))
+    {
+      return;
+    }
+
+  extent.width = MAX(extent.width, NSMaxX(f));
+  extent.height = MAX(extent.height, NSMaxY(f));
+
+  first = bandForY(NSMinY(f));
+  last = bandForY(NSMaxY(f));
+  while ([bands count] <= last)
+    {
+      NSMutableIndexSet *set = [[NSMutableIndexSet alloc] init];
+
+      [bands addObject: set];
+      RELEASE(set);
+    }
+  for (b = first; b <= last; b++)
+    {
+      [[bands objectAtIndex: b] addIndex: index];
+    }
+}
+
+- (void) endSection
+{
+  [sectionEnds addObject: [NSNumber numberWithUnsignedInteger:
+				      [attributes count]]];
+}
+
+- (NSCollectionViewLayoutAttributes *) attributesForItemAtIndexPath: (NSIndexPath *)path
+{
+  NSUInteger section = [path section];
+  NSUInteger item = [path item];
+  NSUInteger start;
+  NSUInteger end;
+
+  if (section >= [sectionEnds count])
+    {
+      return nil;
+    }
+  start = (section == 0) ? 0
+    : [[sectionEnds objectAtIndex: section - 1] unsignedIntegerValue];
+  end = [[sectionEnds objectAtIndex: section] unsignedIntegerValue];
+  if (item >= end - start)
+    {
+      return nil;
+    }
+  return [attributes objectAtIndex: start + item];
+}
+
+- (NSArray *) attributesInRect: (NSRect)rect
+{
+  NSMutableArray *result = [NSMutableArray array];
+  NSUInteger count = [bands count];
+  NSUInteger first;
+  NSUInteger last;
+  NSIndexSet *found;
+  NSUInteger index;
+
+  if (count == 0 || NSIsEmptyRect(rect))
+    {
+      return result;
+    }
+  first = bandForY(NSMinY(rect));
+  last = MIN(bandForY(NSMaxY(rect)), count - 1);
+  if (first > last)
+    {
+      return result;
+    }
+
+  if (first == last)
+    {
+      found = [bands objectAtIndex: first];
+    }
+  else
+    {
+      NSMutableIndexSet *set = [NSMutableIndexSet indexSet];
+      NSUInteger b;
+
+      for (b = first; b <= last; b++)
+	{
+	  [set addIndexes: [bands objectAtIndex: b]];
+	}
+      found = set;
+    }
+
+  index = [found firstIndex];
+  while (index != NSNotFound)
+    {
+      NSCollectionViewLayoutAttributes *attrs =
+	[attributes objectAtIndex: index];
+
+      if (NSIntersectsRect([attrs frame], rect))
+	{
+	  [result addObject: attrs];
+	}
+      index = [found indexGreaterThanIndex: index];
+    }
+  return result;
+}
+
+- (NSSize) extent
+{
+  return extent;
+}
+
 @end
 
 // Private class to track items so that we do not need to maintain multiple maps
@@ -311,6 +501,11 @@ static NSString *_placeholderItem = nil;
   DESTROY(_registeredNibs);
   DESTROY(_registeredClasses);
 
+  // Reuse and layout
+  DESTROY(_reuseQueues);
+  DESTROY(_layoutCache);
+  [[NSNotificationCenter defaultCenter] removeObserver: self];
+
   //DESTROY (_mouseDownEvent);
   [super dealloc];
 }
@@ -820,7 +1015,31 @@ static NSString *_placeholderItem = nil;
   //       - Put the tiling on a delay
   if (_collectionViewLayout)
     {
-      [self reloadData];
+      id sv = [self superview];
+      CGFloat width = [self bounds].size.width;
+
+      if (!_allowReload)
+	{
+	  return;
+	}
+      if ([sv isKindOfClass: [NSClipView class]])
+	{
+	  width = [sv frame].size.width;
+	}
+
+      // Lay the items out again only when the width changes...
+      if (_layoutCache == nil)
+	{
+	  [self reloadData];
+	}
+      else if (width != _tileWidth)
+	{
+	  [self _relayoutItems];
+	}
+      else
+	{
+	  [self _updateVisibleItems];
+	}
       return;
     }
 
@@ -907,6 +1126,55 @@ static NSString *_placeholderItem = nil;
     }
 }
 
+- (void) viewWillMoveToSuperview: (NSView *)newSuperview
+{
+  [super viewWillMoveToSuperview: newSuperview];
+  if ([_super_view isKindOfClass: [NSClipView class]])
+    {
+      NSNotificationCenter *nc = [NSNotificationCenter defaultCenter];
+
+      [nc removeObserver: self
+		    name: NSViewBoundsDidChangeNotification
+		  object: _super_view];
+      [nc removeObserver: self
+		    name: NSViewFrameDidChangeNotification
+		  object: _super_view];
+    }
+}
+
+- (void) viewDidMoveToSuperview
+{
+  [super viewDidMoveToSuperview];
+
+  // Follow scrolling and resizing of the clip view showing the items
+  if ([_super_view isKindOfClass: [NSClipView class]])
+    {
+      NSNotificationCenter *nc = [NSNotificationCenter defaultCenter];
+
+      [nc addObserver: self
+	     selector: @selector(_clipViewBoundsChanged:)
+		 name: NSViewBoundsDidChangeNotification
+	       object: _super_view];
+      [nc addObserver: self
+	     selector: @selector(_clipViewFrameChanged:)
+		 name: NSViewFrameDidChangeNotification
+	       object: _super_view];
+    }
+}
+
+- (void) _clipViewBoundsChanged: (NSNotification *)aNotification
+{
+  if (_allowReload)
+    {
+      [self _updateVisibleItems];
+    }
+}
+
+- (void) _clipViewFrameChanged: (NSNotification *)aNotification
+{
+  [self tile];
+}
+
 - (id) initWithCoder: (NSCoder *)aCoder
 {
   self = [super initWithCoder:aCoder];
@@ -1658,8 +1926,22 @@ static NSString *_placeholderItem = nil;
 - (NSCollectionViewItem *) makeItemWithIdentifier: (NSUserInterfaceItemIdentifier)identifier
 				     forIndexPath: (NSIndexPath *)indexPath
 {
-  NSCollectionViewItem *item = [_dataSource collectionView: self
-					    itemForRepresentedObjectAtIndexPath: indexPath];
+  NSCollectionViewItem *item = nil;
+
+  if (identifier == nil)
+    {
+      item = [_dataSource collectionView: self
+		     itemForRepresentedObjectAtIndexPath: indexPath];
+    }
+  else
+    {
+      // An item scrolled out of sight, else a new one as registered
+      item = [self _dequeueItemWithIdentifier: identifier];
+      if (item == nil)
+	{
+	  item = [self _itemRegisteredWithIdentifier: identifier];
+	}
+    }
 
   if (item != nil)
     {
@@ -1674,6 +1956,12 @@ static NSString *_placeholderItem = nil;
       RELEASE(view);
     }
 
+  /* So that the item is kept for reuse once it is scrolled away. */
+  if (identifier != nil && [[item view] identifier] == nil)
+    {
+      [[item view] setIdentifier: identifier];
+    }
+
   if (item != nil)
     {
       // Add to maps...
@@ -1794,6 +2082,13 @@ static NSString *_placeholderItem = nil;
 
 /* Reloading Content */
 - (void) _loadItemAtIndexPath: (NSIndexPath *)path
+{
+  [self _loadItemAtIndexPath: path
+	      withAttributes: [self layoutAttributesForItemAtIndexPath: path]];
+}
+
+- (void) _loadItemAtIndexPath: (NSIndexPath *)path
+	       withAttributes: (NSCollectionViewLayoutAttributes *)attrs
 {
   NSCollectionViewItem *item = [self makeItemWithIdentifier: nil
 					       forIndexPath: path];
@@ -1803,6 +2098,9 @@ static NSString *_placeholderItem = nil;
   if (item != nil)
     {
       NSView *v = [item view];
+      _GSCollectionViewItemTrackingView *tv = nil;
+      NSArray *subviews;
+      NSUInteger i;
 
       if (v == nil)
 	{
@@ -1810,41 +2108,52 @@ static NSString *_placeholderItem = nil;
 	  return;
 	}
 
-      NSRect f = [v frame];
-      _GSCollectionViewItemTrackingView *tv =
-	[[_GSCollectionViewItemTrackingView alloc]
-	  initWithFrame: NSMakeRect(0.0, 0.0, f.size.width, f.size.height)];
+      // A reused item already has its tracking view...
+      subviews = [v subviews];
+      for (i = 0; tv == nil && i < [subviews count]; i++)
+	{
+	  id sv = [subviews objectAtIndex: i];
+
+	  if ([sv isKindOfClass: [_GSCollectionViewItemTrackingView class]])
+	    {
+	      tv = sv;
+	    }
+	}
 
-      // Set up tracking view...
-      [v setNextResponder: tv];
-      [tv setAlphaValue: 0.0];
+      if (tv == nil)
+	{
+	  NSRect f = [v frame];
+
+	  tv = [[_GSCollectionViewItemTrackingView alloc]
+		 initWithFrame: NSMakeRect(0.0, 0.0,
+					   f.size.width, f.size.height)];
+
+	  // Set up tracking view...
+	  [v setNextResponder: tv];
+	  [tv setAlphaValue: 0.0];
+	  [tv setCollectionView: self];
+	  [v addSubview: tv positioned: NSWindowAbove relativeTo: nil];
+	  RELEASE(tv);
+	}
       [tv setItem: item];
-      [tv setCollectionView: self];
       [tv setIndexPath: path];
-      [v addSubview: tv positioned: NSWindowAbove relativeTo: nil];
-      RELEASE(tv);
 
       [_visibleItems addObject: item];
-      if (_collectionViewLayout)
+      [_itemsToIndexPaths setObject: path
+			     forKey: item];
+      [_indexPathsToItems setObject: item
+			     forKey: path];
+      if ([item respondsToSelector: @selector(setSelected:)])
 	{
-	  NSCollectionViewLayoutAttributes *attrs =
-	    [self layoutAttributesForItemAtIndexPath: path];
-	  NSRect frame = [attrs frame];
-	  BOOL hidden = [attrs isHidden];
-	  CGFloat alpha = [attrs alpha];
-	  NSSize sz = [attrs size];
+	  [item setSelected: [_selectionIndexPaths containsObject: path]];
+	}
 
+      if (_collectionViewLayout)
+	{
 	  // set attributes of item based on currently selected layout...
-	  frame.size = sz;
-	  [v setFrame: frame];
-	  [v setHidden: hidden];
-	  [v setAlphaValue: alpha];
-
-	  [_itemsToAttributes setObject: attrs
-				 forKey: item];
-
+	  [self _applyLayoutAttributes: attrs toItem: item];
 	  [self addSubview: v];
-	  NSDebugLog(@"NSCollectionView: Added item view %@ at frame %@", v, NSStringFromRect(frame));
+	  NSDebugLog(@"NSCollectionView: Added item view %@ at frame %@", v, NSStringFromRect([v frame]));
 	}
       else
 	{
@@ -1853,6 +2162,193 @@ static NSString *_placeholderItem = nil;
     }
 }
 
+- (void) _applyLayoutAttributes: (NSCollectionViewLayoutAttributes *)attrs
+			 toItem: (NSCollectionViewItem *)item
+{
+  NSView *v = [item view];
+  NSRect frame = [attrs frame];
+
+  frame.size = [attrs size];
+  if (!NSEqualRects([v frame], frame))
+    {
+      [v setFrame: frame];
+    }
+  [v setHidden: [attrs isHidden]];
+  [v setAlphaValue: [attrs alpha]];
+
+  [_itemsToAttributes setObject: attrs
+			 forKey: item];
+}
+
+/* Takes an item out of the collection view and keeps it for reuse by
+   -makeItemWithIdentifier:forIndexPath:.  Items whose view has no
+   identifier can't be asked for again, so they are let go.  */
+- (void) _recycleItem: (NSCollectionViewItem *)item
+{
+  NSIndexPath *path = [_itemsToIndexPaths objectForKey: item];
+  NSUserInterfaceItemIdentifier identifier = [[item view] identifier];
+
+  RETAIN(item);
+  [[item view] removeFromSuperview];
+  if ([item respondsToSelector: @selector(setSelected:)])
+    {
+      [item setSelected: NO];
+    }
+  [_visibleItems removeObjectIdenticalTo: item];
+  [_itemsToAttributes removeObjectForKey: item];
+  [_itemsToIndexPaths removeObjectForKey: item];
+  if (path != nil)
+    {
+      [_indexPathsToItems removeObjectForKey: path];
+    }
+
+  if (identifier != nil)
+    {
+      NSMutableArray *queue;
+
+      if (_reuseQueues == nil)
+	{
+	  _reuseQueues = [[NSMutableDictionary alloc] init];
+	}
+      queue = [_reuseQueues objectForKey: identifier];
+      if (queue == nil)
+	{
+	  queue = [[NSMutableArray alloc] init];
+	  [_reuseQueues setObject: queue forKey: identifier];
+	  RELEASE(queue);
+	}
+      [queue addObject: item];
+    }
+  RELEASE(item);
+}
+
+/* Returns an item kept for reuse with identifier, or nil. */
+- (NSCollectionViewItem *) _dequeueItemWithIdentifier: (NSUserInterfaceItemIdentifier)identifier
+{
+  NSMutableArray *queue = [_reuseQueues objectForKey: identifier];
+  NSCollectionViewItem *item;
+
+  if ([queue count] == 0)
+    {
+      return nil;
+    }
+  item = AUTORELEASE(RETAIN([queue lastObject]));
+  [queue removeLastObject];
+  if ([item respondsToSelector: @selector(prepareForReuse)])
+    {
+      [(id)item prepareForReuse];
+    }
+  return item;
+}
+
+/* Returns a new item of the class, or loaded from the nib, registered for
+   identifier, or nil if there is neither.  */
+- (NSCollectionViewItem *) _itemRegisteredWithIdentifier: (NSUserInterfaceItemIdentifier)identifier
+{
+  Class cls = [[_registeredClasses objectForKey: GSNoSupplementaryElement]
+		objectForKey: identifier];
+  NSNib *nib = [[_registeredNibs objectForKey: GSNoSupplementaryElement]
+		 objectForKey: identifier];
+  NSCollectionViewItem *item = nil;
+
+  if (cls != Nil)
+    {
+      item = AUTORELEASE([[cls alloc] init]);
+    }
+  else if (nib != nil)
+    {
+      NSArray *objects = nil;
+
+      if ([nib instantiateWithOwner: nil topLevelObjects: &objects])
+	{
+	  NSUInteger i;
+
+	  for (i = 0; item == nil && i < [objects count]; i++)
+	    {
+	      id o = [objects objectAtIndex: i];
+
+	      if ([o isKindOfClass: [NSCollectionViewItem class]])
+		{
+		  item = o;
+		}
+	    }
+	}
+      if (item == nil)
+	{
+	  NSLog(@"Could not load an item from %@", nib);
+	}
+    }
+
+  return item;
+}
+
+/* Asks the layout for the items in the visible rect, grown by the
+   prefetch margin, and makes sure that just those are realised: items
+   which left the rect are recycled, those which came in are loaded and the
+   others are moved to where the layout now puts them.  An item holding the
+   first responder stays, so that editing isn't interrupted.  */
+- (void) _updateVisibleItems
+{
+  NSRect visible = [self visibleRect];
+  NSRect rect = NSInsetRect(visible,
+			    -NSWidth(visible) * GSCollectionViewPrefetchMargin,
+			    -NSHeight(visible) * GSCollectionViewPrefetchMargin);
+  NSResponder *firstResponder = [_window firstResponder];
+  NSMutableDictionary *wanted;
+  NSArray *attributes;
+  NSArray *items;
+
+  if (_collectionViewLayout == nil || _layoutCache == nil)
+    {
+      return;
+    }
+
+  attributes = [_collectionViewLayout layoutAttributesForElementsInRect: rect];
+  wanted = [NSMutableDictionary dictionaryWithCapacity: [attributes count]];
+  FOR_IN(NSCollectionViewLayoutAttributes*, attrs, attributes)
+    {
+      NSIndexPath *p = [attrs indexPath];
+
+      if (p != nil
+	  && [attrs representedElementCategory] == NSCollectionElementCategoryItem)
+	{
+	  [wanted setObject: attrs forKey: p];
+	}
+    }
+  END_FOR_IN(attributes);
+
+  items = [NSArray arrayWithArray: _visibleItems];
+  FOR_IN(NSCollectionViewItem*, item, items)
+    {
+      NSIndexPath *p = [_itemsToIndexPaths objectForKey: item];
+      NSCollectionViewLayoutAttributes *attrs = [wanted objectForKey: p];
+
+      if (attrs != nil)
+	{
+	  [self _applyLayoutAttributes: attrs toItem: item];
+	  [wanted removeObjectForKey: p];
+	}
+      else if (![firstResponder isKindOfClass: [NSView class]]
+	       || ![(NSView *)firstResponder isDescendantOf: [item view]])
+	{
+	  [self _recycleItem: item];
+	}
+    }
+  END_FOR_IN(items);
+
+  // Load the new items in the order of the layout...
+  FOR_IN(NSCollectionViewLayoutAttributes*, attrs, attributes)
+    {
+      NSIndexPath *p = [attrs indexPath];
+
+      if (p != nil && [wanted objectForKey: p] == attrs)
+	{
+	  [self _loadItemAtIndexPath: p withAttributes: attrs];
+	}
+    }
+  END_FOR_IN(attributes);
+}
+
 - (void) _loadSectionAtIndex: (NSUInteger)cs
 {
   NSInteger ni = [self numberOfItemsInSection: cs];
@@ -1866,8 +2362,120 @@ static NSString *_placeholderItem = nil;
     }
 }
 
+/* Asks the layout to prepare, then, unless it finds the elements in a
+   rect itself, for the attributes of every item in order, and keeps them
+   so that the items in any rect are found quickly.  */
+- (void) _prepareLayoutAttributes
+{
+  GSCollectionViewLayoutCache *cache;
+  NSInteger ns;
+  NSInteger cs;
+
+  DESTROY(_layoutCache);
+  _tileWidth = [self bounds].size.width;
+  if (_collectionViewLayout == nil)
+    {
+      return;
+    }
+
+  [_collectionViewLayout prepareLayout];
+  cache = [[GSCollectionViewLayoutCache alloc] init];
+  _layoutCache = cache;
+  if (OVERRIDDEN(layoutAttributesForElementsInRect:))
+    {
+      return;
+    }
+
+  ns = [self numberOfSections];
+  for (cs = 0; cs < ns; cs++)
+    {
+      NSInteger ni = [self numberOfItemsInSection: cs];
+      NSInteger ci;
+
+      CREATE_AUTORELEASE_POOL(pool);
+
+      for (ci = 0; ci < ni; ci++)
+	{
+	  NSIndexPath *path = [NSIndexPath indexPathForItem: ci inSection: cs];
+	  NSCollectionViewLayoutAttributes *attrs =
+	    [_collectionViewLayout layoutAttributesForItemAtIndexPath: path];
+
+	  if (attrs == nil)
+	    {
+	      attrs = AUTORELEASE([[NSCollectionViewLayoutAttributes alloc] init]);
+	      [attrs setHidden: YES];
+	    }
+	  [attrs setIndexPath: path];
+	  [cache addAttributes: attrs];
+	  if ((ci + 1) % 1024 == 0)
+	    {
+	      RECREATE_AUTORELEASE_POOL(pool);
+	    }
+	}
+      RELEASE(pool);
+      [cache endSection];
+    }
+}
+
+- (NSArray *) _layoutAttributesForElementsInRect: (NSRect)rect
+{
+  if (_layoutCache == nil || OVERRIDDEN(layoutAttributesForElementsInRect:))
+    {
+      return nil;
+    }
+  return [_layoutCache attributesInRect: rect];
+}
+
+/* Lays the items out again for the current width without reloading the
+   data: the attributes of all items are computed again and only the
+   items now in sight are realised.  */
+- (void) _relayoutItems
+{
+  id sv = [self superview];
+  BOOL f = [self postsFrameChangedNotifications];
+
+  if (_layoutCache == nil)
+    {
+      [self reloadData];
+      return;
+    }
+  if (!_allowReload)
+    {
+      return;
+    }
+
+  _allowReload = NO;
+  [self setPostsFrameChangedNotifications: NO]; // prevent recursion...
+  if ([sv isKindOfClass: [NSClipView class]])
+    {
+      [self setFrameSize: [sv frame].size];
+    }
+  [self _prepareLayoutAttributes];
+  [self _updateParentViewFrame];
+  [self setPostsFrameChangedNotifications: f]; // reset
+
+  // Let the clip view keep the scroll position within the new size...
+  if (f)
+    {
+      [[NSNotificationCenter defaultCenter]
+	postNotificationName: NSViewFrameDidChangeNotification
+		      object: self];
+    }
+  [self _updateVisibleItems];
+  _allowReload = YES;
+}
+
 - (void) _clearMaps
 {
+  // Keep the items for reuse...
+  NSArray *items = [NSArray arrayWithArray: _visibleItems];
+
+  FOR_IN(NSCollectionViewItem*, item, items)
+    {
+      [self _recycleItem: item];
+    }
+  END_FOR_IN(items);
+
   // Remove objects from set/dict/maps
   [_visibleItems removeAllObjects];
   [_itemsToIndexPaths removeAllObjects];
@@ -1875,7 +2483,6 @@ static NSString *_placeholderItem = nil;
   [_itemsToAttributes removeAllObjects];
 
   [self setSubviews: [NSArray array]];
-  [_collectionViewLayout prepareLayout];
 
   // destroy maps...
   DESTROY(_indexPathsToItems);
@@ -1894,7 +2501,16 @@ static NSString *_placeholderItem = nil;
   NSCollectionViewLayoutAttributes *attrs = nil;
   NSRect cf = [self frame];
   NSSize ps = cf.size;
+  NSSize extent = NSZeroSize;
+
+  if (_layoutCache != nil)
+    {
+      extent = [_layoutCache extent];
+    }
 
+  // The extent of all items, and of those the layout placed itself...
+  ps.width = MAX(ps.width, extent.width);
+  ps.height = MAX(ps.height, extent.height);
   while ((attrs = [oe nextObject]) != nil)
     {
       NSRect f = [attrs frame];
@@ -1912,19 +2528,10 @@ static NSString *_placeholderItem = nil;
     }
   else
     {
-      NSLog(@"%@ does not override -collectionViewContentSize, some items may not be shown", NSStringFromClass([_collectionViewLayout class]));
+      NSDebugLog(@"%@ does not override -collectionViewContentSize, using the extent of the items", NSStringFromClass([_collectionViewLayout class]));
     }
 
-  cf.size = ps;
-  _frame = cf;
-
-  // Make certain that the view origin is reset properly...
-  id sv = [self superview];
-  if ([sv respondsToSelector: @selector(constrainScrollPoint:)])
-    {
-      NSPoint p = [sv constrainScrollPoint: NSZeroPoint];
-      [sv setBoundsOrigin: p]; // all views respond to this...
-    }
+  [self setFrameSize: ps];
 }
 
 - (void) reloadData
@@ -1938,10 +2545,12 @@ static NSString *_placeholderItem = nil;
       if (ns == 0)
 	{
 	  NSDebugLog(@"NSCollectionView: No sections to load - check dataSource implementation");
+	  // Nothing is left to show, so drop the attributes and the items...
+	  DESTROY(_layoutCache);
+	  [self _clearMaps];
 	  return;
 	}
 
-      NSInteger cs = 0;
       NSSize s = _itemSize;
       CGFloat h = s.height;
       CGFloat proposedHeight = ns * h;
@@ -1959,11 +2568,18 @@ static NSString *_placeholderItem = nil;
       [self _clearMaps];
       newRect.size.height = proposedHeight;
       [self setFrame: newRect];
-      for (cs = 0; cs < ns; cs++)
+      [self _prepareLayoutAttributes];
+      [self _updateParentViewFrame];
+
+      // Make certain that the view origin is reset properly...
+      if ([sv respondsToSelector: @selector(constrainScrollPoint:)])
 	{
-	  [self _loadSectionAtIndex: cs];
+	  NSPoint p = [sv constrainScrollPoint: NSZeroPoint];
+	  [sv setBoundsOrigin: p]; // all views respond to this...
 	}
-      [self _updateParentViewFrame];
+
+      // Realise only the items in sight...
+      [self _updateVisibleItems];
       [self setPostsFrameChangedNotifications: f]; // reset
       _allowReload = YES;
     }
@@ -1997,7 +2613,19 @@ static NSString *_placeholderItem = nil;
 {
   FOR_IN(NSIndexPath*, p, indexPaths)
     {
-      [self _loadItemAtIndexPath: p];
+      NSCollectionViewItem *item = [self itemAtIndexPath: p];
+
+      // Only the items in sight are loaded, the others are when they show...
+      if (item != nil)
+	{
+	  NSCollectionViewLayoutAttributes *attrs =
+	    [_itemsToAttributes objectForKey: item];
+
+	  RETAIN(attrs);
+	  [self _recycleItem: item];
+	  [self _loadItemAtIndexPath: p withAttributes: attrs];
+	  RELEASE(attrs);
+	}
     }
   END_FOR_IN(indexPaths);
 }
@@ -2094,32 +2722,28 @@ static NSString *_placeholderItem = nil;
 
 - (IBAction) selectAll: (id)sender
 {
-  NSMutableSet *paths = [NSMutableSet setWithCapacity: [_itemsToIndexPaths count]];
+  NSMutableSet *paths = [NSMutableSet set];
+  NSInteger ns = [self numberOfSections];
+  NSInteger cs;
 
-  FOR_IN(NSCollectionViewItem*, obj, _itemsToIndexPaths)
+  // All items, not only those which are realised...
+  for (cs = 0; cs < ns; cs++)
     {
-      NSIndexPath *p = [_itemsToIndexPaths objectForKey: obj];
+      NSInteger ni = [self numberOfItemsInSection: cs];
+      NSInteger ci;
 
-      [paths addObject: p];
+      for (ci = 0; ci < ni; ci++)
+	{
+	  [paths addObject: [NSIndexPath indexPathForItem: ci inSection: cs]];
+	}
     }
-  END_FOR_IN(_itemsToIndexPaths);
 
   [self setSelectionIndexPaths: paths];
 }
 
 - (IBAction) deselectAll: (id)sender
 {
-  NSMutableSet *paths = [NSMutableSet setWithCapacity: [_itemsToIndexPaths count]];
-
-  FOR_IN(NSCollectionViewItem*, obj, _itemsToIndexPaths)
-    {
-      NSIndexPath *p = [_itemsToIndexPaths objectForKey: obj];
-
-      [paths addObject: p];
-    }
-  END_FOR_IN(_itemsToIndexPaths);
-
-  [self deselectItemsAtIndexPaths: paths];
+  [self deselectItemsAtIndexPaths: _selectionIndexPaths];
 }
 
 - (void) selectItemsAtIndexPaths: (NSSet *)indexPaths
@@ -2154,7 +2778,13 @@ static NSString *_placeholderItem = nil;
 - (NSCollectionViewLayoutAttributes *) layoutAttributesForItemAtIndexPath: (NSIndexPath *)indexPath
 {
   NSCollectionViewLayoutAttributes *attrs =
-    [_collectionViewLayout layoutAttributesForItemAtIndexPath: indexPath];
+    [_layoutCache attributesForItemAtIndexPath: indexPath];
+
+  // Not kept when the layout finds the elements in a rect itself...
+  if (attrs == nil)
+    {
+      attrs = [_collectionViewLayout layoutAttributesForItemAtIndexPath: indexPath];
+    }
   return attrs;
 }
 
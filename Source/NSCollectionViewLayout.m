@@ -31,6 +31,11 @@
 - (NSMapTable *) itemsToAttributes;
 @end
 
+@interface NSCollectionView (GSLayoutAttributes)
+- (NSArray *) _layoutAttributesForElementsInRect: (NSRect)rect;
+- (void) _relayoutItems;
+@end
+
 @implementation NSCollectionView (__NSCollectionViewLayout__)  
 - (NSMapTable *) itemsToAttributes
 {
@@ -63,6 +68,12 @@
   return nil;
 }
 
+- (void) dealloc
+{
+  RELEASE(_indexPath);
+  [super dealloc];
+}
+
 // Properties
 - (NSRect) frame
 {
@@ -111,7 +122,7 @@
 
 - (void) setIndexPath: (NSIndexPath *)indexPath
 {
-  _indexPath = indexPath;
+  ASSIGN(_indexPath, indexPath);
 }
 
 - (NSInteger) zIndex
@@ -255,7 +266,7 @@
 - (void)invalidateLayout
 {
   _valid = NO;
-  [_collectionView reloadData];
+  [_collectionView _relayoutItems];
 }
 
 - (void)invalidateLayoutWithContext:(NSCollectionViewLayoutInvalidationContext *)context
@@ -309,10 +320,23 @@
 
 - (NSArray *) layoutAttributesForElementsInRect: (NSRect)rect
 {
-  NSMutableArray *result = [NSMutableArray array];
-  NSArray *items = [_collectionView visibleItems];
-  NSMapTable *itemsToAttributes = [_collectionView itemsToAttributes];
-  
+  NSArray *cached;
+  NSMutableArray *result;
+  NSArray *items;
+  NSMapTable *itemsToAttributes;
+
+  /* The collection view keeps the attributes of every item computed by
+     -layoutAttributesForItemAtIndexPath:, use them when it has them. */
+  cached = [_collectionView _layoutAttributesForElementsInRect: rect];
+  if (cached != nil)
+    {
+      return cached;
+    }
+
+  result = [NSMutableArray array];
+  items = [_collectionView visibleItems];
+  itemsToAttributes = [_collectionView itemsToAttributes];
+
   FOR_IN(NSCollectionViewItem*, i, items)
     {
       NSView *v = [i view];
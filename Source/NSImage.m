@@ -396,6 +396,143 @@ static NSArray *imagePasteboardTypes = nil;
 
 static NSArray *iterate_reps_for_types(NSArray *imageReps, SEL method);
 
+/* Template images are drawn through a mask filled with the current colour.
+ * The masks last drawn are kept, most recently used first, so that drawing
+ * a template image again in the same colour is a single composite.  A mask
+ * retains its representation, so the pointer can not be reused for another
+ * one while the mask is cached.
+ */
+#define	TEMPLATE_MASKS	64
+
+typedef struct _GSTemplateMask
+{
+  NSImageRep		*rep;
+  NSRect		srcRect;
+  CGFloat		color[4];
+  NSImageInterpolation	interpolation;
+  BOOL			flipped;
+  NSCachedImageRep	*mask;
+} GSTemplateMask;
+
+static GSTemplateMask	templateMasks[TEMPLATE_MASKS];
+static NSUInteger	templateMaskCount = 0;
+static NSUInteger	templateMaskHits = 0;
+static NSUInteger	templateMaskMisses = 0;
+
+static BOOL
+templateMaskMatches(GSTemplateMask *m, GSTemplateMask *k)
+{
+  return m->rep == k->rep
+    && NSEqualRects(m->srcRect, k->srcRect)
+    && m->color[0] == k->color[0] && m->color[1] == k->color[1]
+    && m->color[2] == k->color[2] && m->color[3] == k->color[3]
+    && m->interpolation == k->interpolation
+    && m->flipped == k->flipped;
+}
+
+/* Returns the cached mask for the key, moving it to the front, or nil. */
+static NSCachedImageRep *
+findTemplateMask(GSTemplateMask *key)
+{
+  NSCachedImageRep *mask = nil;
+  NSUInteger i;
+
+  [imageLock lock];
+  for (i = 0; i < templateMaskCount; i++)
+    {
+      if (templateMaskMatches(&templateMasks[i], key))
+	{
+	  GSTemplateMask found = templateMasks[i];
+
+	  memmove(&templateMasks[1], &templateMasks[0],
+	    i * sizeof(GSTemplateMask));
+	  templateMasks[0] = found;
+	  mask = AUTORELEASE(RETAIN(found.mask));
+	  templateMaskHits++;
+	  break;
+	}
+    }
+  if (mask == nil)
+    {
+      templateMaskMisses++;
+    }
+  [imageLock unlock];
+  return mask;
+}
+
+/* Puts a mask at the front of the cache, dropping the least recently used
+ * one when the cache is full.
+ */
+static void
+addTemplateMask(GSTemplateMask *key, NSCachedImageRep *mask)
+{
+  [imageLock lock];
+  if (templateMaskCount == TEMPLATE_MASKS)
+    {
+      templateMaskCount--;
+      RELEASE(templateMasks[templateMaskCount].rep);
+      RELEASE(templateMasks[templateMaskCount].mask);
+    }
+  memmove(&templateMasks[1], &templateMasks[0],
+    templateMaskCount * sizeof(GSTemplateMask));
+  templateMasks[0] = *key;
+  templateMasks[0].rep = RETAIN(key->rep);
+  templateMasks[0].mask = RETAIN(mask);
+  templateMaskCount++;
+  [imageLock unlock];
+}
+
+/* Drops the cached masks of the representations in reps, or all of them
+ * when reps is nil.
+ */
+static void
+removeTemplateMasks(NSArray *reps)
+{
+  NSUInteger i;
+  NSUInteger j = 0;
+
+  [imageLock lock];
+  for (i = 0; i < templateMaskCount; i++)
+    {
+      GSTemplateMask *m = &templateMasks[i];
+
+      if (reps == nil || [reps indexOfObjectIdenticalTo: m->rep] != NSNotFound)
+	{
+	  RELEASE(m->rep);
+	  RELEASE(m->mask);
+	}
+      else
+	{
+	  templateMasks[j++] = *m;
+	}
+    }
+  templateMaskCount = j;
+  [imageLock unlock];
+}
+
+NSDictionary *
+GSImageTemplateCacheStatistics(void)
+{
+  NSDictionary *d;
+
+  [imageLock lock];
+  d = [NSDictionary dictionaryWithObjectsAndKeys:
+    [NSNumber numberWithUnsignedInteger: templateMaskCount], @"Entries",
+    [NSNumber numberWithUnsignedInteger: templateMaskHits], @"Hits",
+    [NSNumber numberWithUnsignedInteger: templateMaskMisses], @"Misses",
+    nil];
+  [imageLock unlock];
+  return d;
+}
+
+void
+GSImageResetTemplateCacheStatistics(void)
+{
+  [imageLock lock];
+  templateMaskHits = templateMaskMisses = 0;
+  [imageLock unlock];
+}
+
 /* Find the GSRepData object holding a representation */
 static GSRepData*
 repd_for_rep(NSArray *_reps, NSImageRep *rep)
@@ -419,6 +556,7 @@ repd_for_rep(NSArray *_reps, NSImageRep *rep)
 
 @interface NSImage (Private)
 + (void) _clearFileTypeCaches: (NSNotification*)notif;
++ (void) _clearTemplateMasks: (NSNotification*)notif;
 + (void) _reloadCachedImages;
 - (void) _drawTemplateRep: (NSImageRep *)rep
 		  inRect: (NSRect)dstRect
@@ -466,6 +604,16 @@ repd_for_rep(NSArray *_reps, NSImageRep *rep)
 	   selector: @selector(_clearFileTypeCaches:)
 	       name: NSImageRepRegistryChangedNotification
 	     object: [NSImageRep class]];
+      [[NSNotificationCenter defaultCenter]
+	addObserver: self
+	   selector: @selector(_clearTemplateMasks:)
+	       name: GSThemeDidActivateNotification
+	     object: nil];
+      [[NSNotificationCenter defaultCenter]
+	addObserver: self
+	   selector: @selector(_clearTemplateMasks:)
+	       name: NSSystemColorsDidChangeNotification
+	     object: nil];
       [imageLock unlock];
     }
 }
@@ -686,6 +834,17 @@ repd_for_rep(NSArray *_reps, NSImageRep *rep)
 {
   if (_name == nil)
     {
+      if (templateMaskCount > 0)
+        {
+          NSMutableArray *reps = [NSMutableArray array];
+          NSUInteger i;
+
+          for (i = 0; i < [_reps count]; i++)
+            {
+              [reps addObject: ((GSRepData*)[_reps objectAtIndex: i])->rep];
+            }
+          removeTemplateMasks(reps);
+        }
       RELEASE(_reps);
       TEST_RELEASE(_fileName);
       RELEASE(_color);
@@ -958,6 +1117,10 @@ repd_for_rep(NSArray *_reps, NSImageRep *rep)
 {
   NSUInteger i;
 
+  if (templateMaskCount > 0)
+    {
+      removeTemplateMasks([self representations]);
+    }
   i = [_reps count];
   while (i--) 
     {
@@ -1275,9 +1438,14 @@ repd_for_rep(NSArray *_reps, NSImageRep *rep)
 
 - (void) removeRepresentation: (NSImageRep *)imageRep
 {
+  NSMutableArray *removed = nil;
   NSUInteger i;
   GSRepData *repd;
 
+  if (templateMaskCount > 0)
+    {
+      removed = [NSMutableArray arrayWithObject: imageRep];
+    }
   i = [_reps count];
   while (i-- > 0)
     {
@@ -1291,9 +1459,15 @@ repd_for_rep(NSArray *_reps, NSImageRep *rep)
           // Remove cached representations for this representation
           // instead of turning them into real ones
           //repd->original = nil;
+          [removed addObject: repd->rep];
           [_reps removeObjectAtIndex: i];
         }
     }
+  // Only the masks of the removed representations are dropped
+  if (removed != nil)
+    {
+      removeTemplateMasks(removed);
+    }
 }
 
 - (void) lockFocus
@@ -2266,6 +2440,11 @@ iterate_reps_for_types(NSArray* imageReps, SEL method)
   DESTROY(imagePasteboardTypes);
 }
 
++ (void) _clearTemplateMasks: (NSNotification*)notif
+{
+  removeTemplateMasks(nil);
+}
+
 /**
  * For all NSImage instances cached in nameDict, recompute the path using
  * +_pathForImageNamed: and reload the image contents using the new path.
@@ -2302,7 +2481,9 @@ iterate_reps_for_types(NSArray* imageReps, SEL method)
 	  respectFlipped: (BOOL)respectFlipped
 		   hints: (NSDictionary*)hints
 {
-  NSCachedImageRep *mask;
+  NSCachedImageRep *mask = nil;
+  GSTemplateMask key;
+  BOOL cacheable;
   NSRect maskRect;
   CGFloat red = 0.0;
   CGFloat green = 0.0;
@@ -2321,28 +2502,56 @@ iterate_reps_for_types(NSArray* imageReps, SEL method)
   DPScurrentalpha(ctxt, &alpha);
 
   maskRect = NSMakeRect(0, 0, repSrcRect.size.width, repSrcRect.size.height);
-  mask = [[NSCachedImageRep alloc]
-	    initWithSize: maskRect.size
-	      pixelsWide: ceil(maskRect.size.width)
-	      pixelsHigh: ceil(maskRect.size.height)
-		   depth: [[NSScreen mainScreen] depth]
-		separate: YES
-		   alpha: YES];
-
-  [[[mask window] contentView] lockFocus];
-  [[NSGraphicsContext currentContext]
-    setImageInterpolation: interpolation];
-  NSRectFillUsingOperation(maskRect, NSCompositeClear);
-  DPSsetrgbcolor(GSCurrentContext(), red, green, blue);
-  DPSsetalpha(GSCurrentContext(), alpha);
-  NSRectFill(maskRect);
-  [rep drawInRect: maskRect
-	 fromRect: repSrcRect
-	operation: NSCompositeDestinationIn
-	 fraction: 1.0
-   respectFlipped: respectFlipped
-	    hints: hints];
-  [[[mask window] contentView] unlockFocus];
+
+  /* Hints may change how the representation draws, so masks drawn with
+   * them are not cached.
+   */
+  cacheable = ([hints count] == 0);
+  if (cacheable)
+    {
+      key.rep = rep;
+      key.srcRect = repSrcRect;
+      key.color[0] = red;
+      key.color[1] = green;
+      key.color[2] = blue;
+      key.color[3] = alpha;
+      key.interpolation = interpolation;
+      key.flipped = respectFlipped;
+      key.mask = nil;
+      mask = findTemplateMask(&key);
+    }
+
+  if (mask == nil)
+    {
+      mask = [[NSCachedImageRep alloc]
+		initWithSize: maskRect.size
+		  pixelsWide: ceil(maskRect.size.width)
+		  pixelsHigh: ceil(maskRect.size.height)
+		       depth: [[NSScreen mainScreen] depth]
+		    separate: YES
+		       alpha: YES];
+      AUTORELEASE(mask);
+
+      [[[mask window] contentView] lockFocus];
+      [[NSGraphicsContext currentContext]
+	setImageInterpolation: interpolation];
+      NSRectFillUsingOperation(maskRect, NSCompositeClear);
+      DPSsetrgbcolor(GSCurrentContext(), red, green, blue);
+      DPSsetalpha(GSCurrentContext(), alpha);
+      NSRectFill(maskRect);
+      [rep drawInRect: maskRect
+	     fromRect: repSrcRect
+	    operation: NSCompositeDestinationIn
+	     fraction: 1.0
+       respectFlipped: respectFlipped
+		hints: hints];
+      [[[mask window] contentView] unlockFocus];
+
+      if (cacheable)
+	{
+	  addTemplateMask(&key, mask);
+	}
+    }
 
   [mask drawInRect: dstRect
 	  fromRect: maskRect
@@ -2350,8 +2559,6 @@ iterate_reps_for_types(NSArray* imageReps, SEL method)
 	  fraction: delta
     respectFlipped: respectFlipped
 	     hints: hints];
-
-  RELEASE(mask);
 }
 
 
@@ -33,6 +33,7 @@
 #import <Foundation/NSDictionary.h>
 #import <Foundation/NSEnumerator.h>
 #import <Foundation/NSException.h>
+#import <Foundation/NSIndexSet.h>
 #import <Foundation/NSInvocation.h>
 #import <Foundation/NSKeyValueObserving.h>
 #import <Foundation/NSKeyValueCoding.h>
@@ -406,8 +407,34 @@ void GSBindingInvokeAction(NSString *targetKey, NSString *argumentKey,
 
   if (change != nil)
     {
+      NSKeyValueChange kind;
+
+      kind = [[change objectForKey: NSKeyValueChangeKindKey] intValue];
       options = [info objectForKey: NSOptionsKey];
-      newValue = [change objectForKey: NSKeyValueChangeNewKey];
+      if (kind == NSKeyValueChangeSetting)
+        {
+          newValue = [change objectForKey: NSKeyValueChangeNewKey];
+        }
+      else
+        {
+          NSIndexSet *indexes;
+
+          /* Only some elements of a to-many value changed.  The new key
+           * holds just those, so let the source update the indexes if it
+           * can, or else set the whole value again.
+           */
+          indexes = [change objectForKey: NSKeyValueChangeIndexesKey];
+          if (indexes != nil
+            && [options objectForKey: NSValueTransformerBindingOption] == nil
+            && [options objectForKey: NSValueTransformerNameBindingOption] == nil
+            && [src respondsToSelector:
+              @selector(_updateBinding:change:atIndexes:)]
+            && [src _updateBinding: binding change: kind atIndexes: indexes])
+            {
+              return;
+            }
+          newValue = [object valueForKeyPath: keyPath];
+        }
       newValue = [self transformValue: newValue withOptions: options];
       NSDebugLLog(@"NSBinding", @"observeValueForKeyPath: binding %@, keyPath %@, source %@ value %@", binding, keyPath, src, newValue);
       [src setValue: newValue forKey: binding];
@@ -136,13 +136,26 @@ first. Remaining cases, highest priority first:
 @end
 
 @interface NSLayoutManager (LayoutHelpers)
--(void) _doLayoutToContainer: (int)cindex  point: (NSPoint)p;
+-(void) _doLayoutToContainer: (int)cindex  rect: (NSRect)rect;
 @end
 
 @implementation NSLayoutManager (LayoutHelpers)
--(void) _doLayoutToContainer: (int)cindex  point: (NSPoint)p
+/*
+Makes sure that everything in rect in text container cindex has been laid
+out. With non-contiguous layout, text above rect might only have estimated
+layout.
+*/
+-(void) _doLayoutToContainer: (int)cindex  rect: (NSRect)rect
+{
+  if ([self _usesNonContiguousLayout])
+    [self _doNonContiguousLayoutInRect: rect];
+  [self _doLayoutToContainer: cindex  maxY: NSMaxY(rect)];
+}
+
+-(BOOL) _usesNonContiguousLayout
 {
-  [self _doLayout];
+  return _allowsNonContiguousLayout && num_textcontainers == 1
+    && [textcontainers[0].textContainer isSimpleRectangularTextContainer];
 }
 @end
 
@@ -250,7 +263,7 @@ container? necessary? */
     if (tc->textContainer == container)
       break;
 //printf("container %i %@, %i+%i\n",i,tc->textContainer,tc->pos,tc->length);
-  [self _doLayoutToGlyph: NSMaxRange(glyphRange) - 1];
+  [self _doLayoutForGlyphRange: glyphRange];
 //printf("   now %i+%i\n",tc->pos,tc->length);
   if (i == num_textcontainers)
     {
@@ -508,7 +521,7 @@ line frag rect. */
     }
 
   [self _doLayoutToContainer: i
-    point: NSMakePoint(NSMaxX(bounds), NSMaxY(bounds))];
+			rect: bounds];
 
   tc = textcontainers + i;
 
@@ -646,13 +659,16 @@ anything visible
       return NSNotFound;
     }
 
-  [self _doLayoutToContainer: i  point: point];
+  [self _doLayoutToContainer: i
+			rect: NSMakeRect(point.x, point.y, 0, 0)];
 
   tc = textcontainers + i;
 
   /* Find the line frag rect that contains the point, and handle the case
-  where the point isn't inside a line frag rect. */
-  for (i = 0, lf = tc->linefrags; i < tc->num_linefrags; i++, lf++)
+  where the point isn't inside a line frag rect. Line frags that end above
+  the point can be skipped. */
+  i = linefrag_index_for_y(tc, point.y);
+  for (lf = tc->linefrags + i; i < tc->num_linefrags; i++, lf++)
     {
       /* The point is inside a rect; we're done. */
       if (NSPointInRect(point, lf->rect))
@@ -1139,7 +1155,8 @@ has the same y origin and height as the line frag rect it is in.
 
       tc = &textcontainers[from_tc];
       /* Find first line frag rect on the from line. */
-      for (i = 0, lf = tc->linefrags; i < tc->num_linefrags; i++, lf++)
+      i = linefrag_index_for_y(tc, from_rect.origin.y);
+      for (lf = tc->linefrags + i; i < tc->num_linefrags; i++, lf++)
 	{
 	  if (lf->rect.origin.y == from_rect.origin.y)
 	    break;
@@ -1155,7 +1172,7 @@ has the same y origin and height as the line frag rect it is in.
       if (direction == GSInsertionPointMoveDown)
 	{
 	  [self _doLayoutToContainer: from_tc
-		point: NSMakePoint(target, distance + NSMaxY(from_rect))];
+		rect: NSMakeRect(target, NSMaxY(from_rect), 0, distance)];
 	  tc = textcontainers + from_tc;
 	  /* Find the target line. Move at least (should be up to?)
 	  distance, and at least one line. */
@@ -1268,7 +1285,7 @@ has the same y origin and height as the line frag rect it is in.
 
 - (void) ensureLayoutForGlyphRange: (NSRange)glyphRange
 {
-  [self _doLayoutToGlyph: NSMaxRange(glyphRange) - 1];
+  [self _doLayoutForGlyphRange: glyphRange];
 }
 
 - (void) ensureLayoutForCharacterRange: (NSRange)charRange
@@ -1297,7 +1314,7 @@ has the same y origin and height as the line frag rect it is in.
 
   size = [container containerSize];
   [self _doLayoutToContainer: i
-                       point: NSMakePoint(size.width, size.height)];
+                        rect: NSMakeRect(0, 0, size.width, size.height)];
 }
 
 - (void) ensureLayoutForBoundingRect: (NSRect)bounds
@@ -1316,7 +1333,7 @@ has the same y origin and height as the line frag rect it is in.
     }
 
   [self _doLayoutToContainer: i
-                       point: NSMakePoint(NSMaxX(bounds), NSMaxY(bounds))];
+                        rect: bounds];
 }
 
 - (void) invalidateLayoutForCharacterRange: (NSRange)charRange
@@ -1339,11 +1356,25 @@ has the same y origin and height as the line frag rect it is in.
 
 - (void) setAllowsNonContiguousLayout: (BOOL)flag
 {
+  if (_allowsNonContiguousLayout == flag)
+    return;
   _allowsNonContiguousLayout = flag;
+  /* Estimated layout is only kept up to date with non-contiguous layout. */
+  if (!flag && [self hasNonContiguousLayout])
+    {
+      [self _invalidateLayoutFromContainer: 0];
+      [self _didInvalidateLayout];
+    }
 }
 
 - (BOOL) hasNonContiguousLayout
 {
+  int i;
+  textcontainer_t *tc;
+
+  for (i = 0, tc = textcontainers; i < num_textcontainers; i++, tc++)
+    if (tc->num_estimated)
+      return YES;
   return NO;
 }
 
@@ -1387,7 +1418,7 @@ container
 
   if (!range.length)
     return;
-  [self _doLayoutToGlyph: range.location + range.length - 1];
+  [self _doLayoutForGlyphRange: range];
 
   {
     int i;
@@ -1609,7 +1640,7 @@ attachmentSize(linefrag_t *lf, NSUInteger glyphIndex)
 
   if (!range.length)
     return;
-  [self _doLayoutToGlyph: range.location + range.length - 1];
+  [self _doLayoutForGlyphRange: range];
 
   /* Find the selected range of glyphs as it overlaps with the range we
    * are about to display.
@@ -2483,6 +2514,18 @@ TODO: not really clear what these should do
 }
 
 
+/* Let the text views grow to cover the text laid out in the background. */
+-(void) _didLayoutInBackgroundFromContainer: (int)idx
+{
+  int i;
+
+  for (i = idx; i < num_textcontainers; i++)
+    {
+      [[textcontainers[i].textContainer textView] _layoutManagerDidInvalidateLayout];
+    }
+}
+
+
 -(void) _dumpLayout
 {
   int i, j, k;
@@ -2732,6 +2775,8 @@ this file describes this.
 		{
 		  break;
 		}
+	      if (lf->estimated && i < tc->num_linefrags)
+		tc->num_estimated--;
 	      if (lf->points)
 		{
 		  free(lf->points);
@@ -2781,6 +2826,8 @@ this file describes this.
 	  i = new_num;
 	  lf = tc->linefrags + i;
 	}
+      tc->num_estimated -= linefrags_estimated(tc->linefrags + new_num,
+	tc->num_linefrags - new_num);
       tc->num_soft += tc->num_linefrags - new_num;
       tc->num_linefrags = new_num;
       tc->was_invalidated = YES;
@@ -2816,6 +2863,7 @@ this file describes this.
 	  lf = tc->linefrags;
 	  tc->num_soft += tc->num_linefrags;
 	  tc->num_linefrags = 0;
+	  tc->num_estimated = 0;
 	  tc->was_invalidated = YES;
 	  tc->complete = NO;
 	}
@@ -37,8 +37,11 @@
 #import <Foundation/NSCoder.h>
 #import <Foundation/NSArray.h>
 #import <Foundation/NSCharacterSet.h>
+#import <Foundation/NSDate.h>
 #import <Foundation/NSDebug.h>
 #import <Foundation/NSException.h>
+#import <Foundation/NSHashTable.h>
+#import <Foundation/NSMapTable.h>
 #import <Foundation/NSProcessInfo.h>
 #import <Foundation/NSString.h>
 #import <Foundation/NSNotification.h>
@@ -135,6 +138,106 @@ static NSString *NSEnqueuedMenuMoveName = @"EnqueuedMoveNotificationName";
 static NSNotificationCenter *nc;
 static BOOL menuBarVisible = YES;
 
+/* The items of a menu tree with key equivalents, by key equivalent, so that
+ * a key press does not have to walk the whole tree.  An index is built by
+ * the menu -performKeyEquivalent: is sent to.  Submenus with a delegate or
+ * their own -performKeyEquivalent: are left out and sent the event in turn
+ * instead, so that they are only filled in when they may match.  The index
+ * is thrown away when one of the menus in it has items added, removed or
+ * given another key equivalent or submenu since it was built.
+ */
+@interface GSMenuKeyIndex : NSObject
+{
+@public
+  NSUInteger generation;
+  NSMenu *servicesMenu;		/* Not retained, only compared.  */
+  NSMutableDictionary *items;	/* Arrays of items in menu order.  */
+  NSMutableArray *searched;	/* Submenus sent the event, in menu order.  */
+  NSMapTable *order;		/* Place of items and submenus in the tree.  */
+  NSHashTable *menus;		/* The menus indexed, not retained.  */
+}
+@end
+
+@implementation GSMenuKeyIndex
+
+- (id) init
+{
+  if ((self = [super init]) != nil)
+    {
+      items = [[NSMutableDictionary alloc] init];
+      searched = [[NSMutableArray alloc] init];
+      order = NSCreateMapTable(NSNonOwnedPointerMapKeyCallBacks,
+                               NSIntegerMapValueCallBacks, 64);
+      menus = NSCreateHashTable(NSNonOwnedPointerHashCallBacks, 16);
+    }
+  return self;
+}
+
+- (void) dealloc
+{
+  RELEASE(items);
+  RELEASE(searched);
+  NSFreeMapTable(order);
+  NSFreeHashTable(menus);
+  [super dealloc];
+}
+
+@end
+
+/* Counters of menu item validation, see +validationStatistics.  */
+static NSUInteger validations = 0;
+static NSUInteger updates = 0;
+static NSTimeInterval statisticsStart = 0.0;
+
+static NSMapTable *keyIndexes = NULL;
+/* When the key equivalents of each menu, or of all menus, last changed.  */
+static NSMapTable *keyEquivalentsChanged = NULL;
+static NSUInteger keyEquivalentsGeneration = 0;
+static NSUInteger allKeyEquivalentsChanged = 0;
+static IMP menuPerformKeyEquivalent = 0;
+
+static void
+noteKeyEquivalentsChanged(NSMenu *menu)
+{
+  if (keyEquivalentsChanged == NULL)
+    {
+      keyEquivalentsChanged
+        = NSCreateMapTable(NSNonOwnedPointerMapKeyCallBacks,
+                           NSIntegerMapValueCallBacks, 16);
+    }
+  NSMapInsert(keyEquivalentsChanged, menu,
+              (void *)(uintptr_t)++keyEquivalentsGeneration);
+}
+
+/* Whether none of the menus of index has changed since it was built.  */
+static BOOL
+keyIndexIsCurrent(GSMenuKeyIndex *index)
+{
+  NSHashEnumerator e;
+  NSMenu *menu;
+  BOOL current = YES;
+
+  if (index->generation < allKeyEquivalentsChanged
+    || index->servicesMenu != [NSApp servicesMenu])
+    {
+      return NO;
+    }
+  if (keyEquivalentsChanged == NULL)
+    {
+      return YES;
+    }
+  e = NSEnumerateHashTable(index->menus);
+  while (current && (menu = NSNextHashEnumeratorItem(&e)) != nil)
+    {
+      if ((uintptr_t)NSMapGet(keyEquivalentsChanged, menu) > index->generation)
+        {
+          current = NO;
+        }
+    }
+  NSEndHashTableEnumeration(&e);
+  return current;
+}
+
 @interface	NSMenu (GNUstepPrivate)
 
 - (NSString *) _name;
@@ -147,6 +250,10 @@ static BOOL menuBarVisible = YES;
 - (void) _organizeMenu;
 - (BOOL) _isVisible;
 - (BOOL) _isMain;
++ (void) _keyEquivalentsChanged;
+- (void) _keyEquivalentsChanged;
+- (void) _addKeyEquivalentsToIndex: (GSMenuKeyIndex *)index;
+- (GSMenuKeyIndex *) _keyEquivalentIndex;
 
 @end
 
@@ -392,6 +499,95 @@ static BOOL menuBarVisible = YES;
   return [NSApp mainMenu] == self;
 }
 
++ (void) _keyEquivalentsChanged
+{
+  allKeyEquivalentsChanged = ++keyEquivalentsGeneration;
+}
+
+- (void) _keyEquivalentsChanged
+{
+  noteKeyEquivalentsChanged(self);
+}
+
+- (void) _addKeyEquivalentsToIndex: (GSMenuKeyIndex *)index
+{
+  NSUInteger i;
+  NSUInteger count = [_items count];
+
+  NSHashInsert(index->menus, self);
+  for (i = 0; i < count; i++)
+    {
+      NSMenuItem *item = [_items objectAtIndex: i];
+
+      if ([item hasSubmenu])
+        {
+          /* Leave out the Services menu, see -performKeyEquivalent:. */
+          NSMenu *submenu = [item submenu];
+
+          if (submenu == index->servicesMenu)
+            {
+              continue;
+            }
+          if ([submenu delegate] != nil
+            || [submenu methodForSelector: @selector(performKeyEquivalent:)]
+              != menuPerformKeyEquivalent)
+            {
+              NSMapInsert(index->order, submenu,
+                          (void *)(uintptr_t)NSCountMapTable(index->order));
+              [index->searched addObject: submenu];
+            }
+          else
+            {
+              [submenu _addKeyEquivalentsToIndex: index];
+            }
+        }
+      else
+        {
+          NSString *key = [item keyEquivalent];
+
+          if ([key length] > 0)
+            {
+              NSMutableArray *a = [index->items objectForKey: key];
+
+              NSMapInsert(index->order, item,
+                          (void *)(uintptr_t)NSCountMapTable(index->order));
+              if (a == nil)
+                {
+                  a = [[NSMutableArray alloc] initWithObjects: item, nil];
+                  [index->items setObject: a forKey: key];
+                  RELEASE(a);
+                }
+              else
+                {
+                  [a addObject: item];
+                }
+            }
+        }
+    }
+}
+
+- (GSMenuKeyIndex *) _keyEquivalentIndex
+{
+  GSMenuKeyIndex *index;
+
+  if (keyIndexes == NULL)
+    {
+      keyIndexes = NSCreateMapTable(NSNonOwnedPointerMapKeyCallBacks,
+                                    NSObjectMapValueCallBacks, 8);
+    }
+  index = (GSMenuKeyIndex *)NSMapGet(keyIndexes, self);
+  if (index == nil || keyIndexIsCurrent(index) == NO)
+    {
+      index = [[GSMenuKeyIndex alloc] init];
+      index->generation = keyEquivalentsGeneration;
+      index->servicesMenu = [NSApp servicesMenu];
+      [self _addKeyEquivalentsToIndex: index];
+      NSMapInsert(keyIndexes, self, index);
+      RELEASE(index);
+    }
+  return index;
+}
+
 @end
 
 
@@ -406,6 +602,9 @@ static BOOL menuBarVisible = YES;
     {
       [self setVersion: 1];
       nc = [NSNotificationCenter defaultCenter];
+      menuPerformKeyEquivalent
+        = [self instanceMethodForSelector: @selector(performKeyEquivalent:)];
+      statisticsStart = [NSDate timeIntervalSinceReferenceDate];
     }
 }
 
@@ -440,6 +639,14 @@ static BOOL menuBarVisible = YES;
 - (void) dealloc
 {
   [nc removeObserver: self];
+  if (keyIndexes != NULL)
+    {
+      NSMapRemove(keyIndexes, self);
+    }
+  if (keyEquivalentsChanged != NULL)
+    {
+      NSMapRemove(keyEquivalentsChanged, self);
+    }
 
   // Now clean the pointer to us stored each _items element
   [_items makeObjectsPerformSelector: @selector(setMenu:) withObject: nil];
@@ -561,6 +768,7 @@ static BOOL menuBarVisible = YES;
     }
   
   [_items insertObject: newItem atIndex: index];
+  noteKeyEquivalentsChanged(self);
   _menu.needsSizing = YES;
   [(NSMenuView*)_view setNeedsSizing: YES];
   
@@ -635,6 +843,7 @@ static BOOL menuBarVisible = YES;
 
   [anItem setMenu: nil];
   [_items removeObjectAtIndex: index];
+  noteKeyEquivalentsChanged(self);
   _menu.needsSizing = YES;
   [(NSMenuView*)_view setNeedsSizing: YES];
   
@@ -942,6 +1151,23 @@ static BOOL menuBarVisible = YES;
     }
 }
 
+/* Called by NSApplication after each event.  Only the menus on screen are
+ * updated, the others are updated when they are displayed.  A main menu
+ * drawn in the windows of the application counts as being on screen.
+ */
+- (void) _updateVisibleMenus
+{
+  if ([self _isMain] && NSInterfaceStyleForKey(@"NSMenuInterfaceStyle", nil)
+    == NSWindows95InterfaceStyle)
+    {
+      [self update];
+    }
+  else
+    {
+      [self _updateSubmenu];
+    }
+}
+
 - (void) _updateMenuWithDelegate
 {
   if ([_delegate respondsToSelector: @selector(menuNeedsUpdate:)])
@@ -991,6 +1217,8 @@ static BOOL menuBarVisible = YES;
   BOOL	      wasEnabled = [item isEnabled];
   BOOL	      shouldBeEnabled;
 
+  validations++;
+
   // If there is no action - there can be no validator for the item.
   if (action)
     {
@@ -1058,6 +1286,8 @@ static BOOL menuBarVisible = YES;
       NSUInteger i;
       NSUInteger count = [_items count];
       
+      updates++;
+
       // Temporary disable automatic displaying of menu.
       [self setMenuChangedMessagesEnabled: NO];
 
@@ -1108,12 +1338,17 @@ static BOOL menuBarVisible = YES;
 //
 - (BOOL) performKeyEquivalent: (NSEvent*)theEvent
 {
-  NSUInteger i;
-  NSUInteger count = [_items count];
   NSEventType type = [theEvent type];
   NSUInteger modifiers = [theEvent modifierFlags];
   NSString *keyEquivalent = [theEvent charactersIgnoringModifiers];
   NSUInteger relevantModifiersMask = NSCommandKeyMask | NSAlternateKeyMask | NSControlKeyMask;
+  GSMenuKeyIndex *index;
+  NSArray *candidates;
+  NSMenuItem *found = nil;
+  NSUInteger place = NSNotFound;
+  NSMenu *menu;
+  NSUInteger count;
+  NSUInteger i;
 
   if ((type != NSKeyDown && type != NSKeyUp) || [keyEquivalent length] == 0)
     return NO;
@@ -1123,58 +1358,94 @@ static BOOL menuBarVisible = YES;
       || ([keyEquivalent length] > 0 && [[NSCharacterSet controlCharacterSet] characterIsMember:[keyEquivalent characterAtIndex:0]]))
     relevantModifiersMask |= NSShiftKeyMask;
 
-  if (![self _isVisible] && _delegate)
+  /* The automatic mechanism is switched off for menus which are not on
+     screen, so their delegates must fill them in.  A delegate which can
+     tell whether the menu has the key equivalent is asked that instead.  */
+  if (_delegate != nil && ![self _isVisible])
     {
-      // Need to enable items as the automatic mechanism is switched off for invisible menus 
-      [self update];
-    }
-  
-  for (i = 0; i < count; i++)
-    {
-      NSMenuItem *item = [_items objectAtIndex: i];
-                                    
-      if ([item hasSubmenu])
+      if ([_delegate respondsToSelector:
+        @selector(menuHasKeyEquivalent:forEvent:target:action:)])
         {
-	  /* Ignore the Services submenu during menu traversal so that its key
-	     equivalents do not accidentally shadow standard key equivalents
-	     in the application's own menus. NSApp calls -performKeyEquivalent:
-	     explicitly for the Services menu when no matching key equivalent
-	     was found here (see NSApplication -sendEvent:).
-	     Note: Shadowing is no problem for a standard OpenStep menu, where
-	     the Services menu appears close to the end of the main menu, but
-	     is very likely for Macintosh or Windows 95 interface styles, where
-	     the Services menu appears in the first submenu of the main menu. */
-	  // FIXME Should really remove conflicting key equivalents from the
-	  // menus so that users don't get confused.
-	  if ([item submenu] == [NSApp servicesMenu])
-	    continue;
-          // Recurse through submenus whether active or not.
-          if ([[item submenu] performKeyEquivalent: theEvent])
+          id target = nil;
+          SEL action = NULL;
+
+          if (![_delegate menuHasKeyEquivalent: self
+                                      forEvent: theEvent
+                                        target: &target
+                                        action: &action])
             {
-              // The event has been handled by an item in the submenu.
+              return NO;
+            }
+          if (action != NULL)
+            {
+              [NSApp sendAction: action to: target from: self];
               return YES;
             }
         }
-      else
+      [self _updateMenuWithDelegate];
+    }
+
+  /* The Services submenu is left out of the index so that its key
+     equivalents do not accidentally shadow standard key equivalents
+     in the application's own menus. NSApp calls -performKeyEquivalent:
+     explicitly for the Services menu when no matching key equivalent
+     was found here (see NSApplication -sendEvent:).
+     Note: Shadowing is no problem for a standard OpenStep menu, where
+     the Services menu appears close to the end of the main menu, but
+     is very likely for Macintosh or Windows 95 interface styles, where
+     the Services menu appears in the first submenu of the main menu. */
+  // FIXME Should really remove conflicting key equivalents from the
+  // menus so that users don't get confused.
+  index = RETAIN([self _keyEquivalentIndex]);
+  candidates = [index->items objectForKey: keyEquivalent];
+  count = [candidates count];
+  for (i = 0; i < count && found == nil; i++)
+    {
+      NSMenuItem *item = [candidates objectAtIndex: i];
+      NSUInteger mask = [item keyEquivalentModifierMask];
+
+      if ((modifiers & relevantModifiersMask) == (mask & relevantModifiersMask))
         {
-          NSUInteger mask = [item keyEquivalentModifierMask];
+          found = item;
+          place = (uintptr_t)NSMapGet(index->order, item);
+        }
+    }
 
-          if ([[item keyEquivalent] isEqualToString: keyEquivalent] 
-            && (modifiers & relevantModifiersMask) == (mask & relevantModifiersMask))
-            {
-              if (![self _isVisible] && !_delegate)
-                {
-                  // Need to enable item as the automatic mechanism is switched off for invisible menus
-                  [self _autoenableItem: item];
-                }
-              if ([item isEnabled])
-                {
-                  [_view performActionWithHighlightingForItemAtIndex: i];
-                }
-              return YES;
-            }
+  /* The submenus left out of the index which come before the item found
+     are sent the event first.  */
+  count = [index->searched count];
+  for (i = 0; i < count; i++)
+    {
+      menu = [index->searched objectAtIndex: i];
+      if ((uintptr_t)NSMapGet(index->order, menu) > place)
+        {
+          break;
+        }
+      if ([menu performKeyEquivalent: theEvent])
+        {
+          RELEASE(index);
+          return YES;
         }
     }
+  RELEASE(index);
+
+  if (found != nil)
+    {
+      menu = [found menu];
+      if (![menu _isVisible]
+        && ([menu delegate] == nil || [menu autoenablesItems]))
+        {
+          // Need to enable item as the automatic mechanism is switched off for invisible menus
+          [menu _autoenableItem: found];
+        }
+      if ([found isEnabled])
+        {
+          [[menu menuRepresentation]
+            performActionWithHighlightingForItemAtIndex:
+              [menu indexOfItem: found]];
+        }
+      return YES;
+    }
   return NO; 
 }
 
@@ -1249,6 +1520,15 @@ static BOOL menuBarVisible = YES;
 
 - (void) setDelegate: (id)delegate
 {
+  if (_delegate != delegate)
+    {
+      /* The supermenu indexes this menu or sends it the event. */
+      noteKeyEquivalentsChanged(self);
+      if (_superMenu != nil)
+        {
+          noteKeyEquivalentsChanged(_superMenu);
+        }
+    }
   _delegate = delegate;
 }
 
@@ -1638,6 +1918,27 @@ static BOOL menuBarVisible = YES;
 
 @implementation NSMenu (GNUstepExtra)
 
++ (NSDictionary *) validationStatistics
+{
+  NSTimeInterval seconds;
+
+  seconds = [NSDate timeIntervalSinceReferenceDate] - statisticsStart;
+  return [NSDictionary dictionaryWithObjectsAndKeys:
+    [NSNumber numberWithUnsignedInteger: validations], @"Validations",
+    [NSNumber numberWithUnsignedInteger: updates], @"Updates",
+    [NSNumber numberWithDouble: seconds], @"Seconds",
+    [NSNumber numberWithDouble: seconds > 0.0 ? validations / seconds : 0.0],
+    @"ValidationsPerSecond",
+    nil];
+}
+
++ (void) resetValidationStatistics
+{
+  validations = 0;
+  updates = 0;
+  statisticsStart = [NSDate timeIntervalSinceReferenceDate];
+}
+
 - (void) setTornOff: (BOOL)flag
 {
   NSMenu *supermenu;
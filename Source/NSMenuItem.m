@@ -47,6 +47,11 @@
 static BOOL usesUserKeyEquivalents = NO;
 static Class imageClass;
 
+@interface NSMenu (GSKeyEquivalentIndex)
++ (void) _keyEquivalentsChanged;
+- (void) _keyEquivalentsChanged;
+@end
+
 @interface GSMenuSeparator : NSMenuItem
 
 @end
@@ -95,7 +100,11 @@ static Class imageClass;
 
 + (void) setUsesUserKeyEquivalents: (BOOL)flag
 {
-  usesUserKeyEquivalents = flag;
+  if (usesUserKeyEquivalents != flag)
+    {
+      usesUserKeyEquivalents = flag;
+      [NSMenu _keyEquivalentsChanged];
+    }
 }
 
 + (BOOL) usesUserKeyEquivalents
@@ -241,6 +250,7 @@ static Class imageClass;
     }
   [self setTarget: _menu];
   [self setAction: @selector(submenuAction:)];
+  [_menu _keyEquivalentsChanged];
   [_menu itemChanged: self];
 }
 
@@ -291,6 +301,7 @@ static Class imageClass;
     return; // no change
 	
   ASSIGNCOPY(_keyEquivalent,  aKeyEquivalent);
+  [_menu _keyEquivalentsChanged];
   [_menu itemChanged: self];
 }
 
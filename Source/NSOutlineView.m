@@ -38,6 +38,7 @@
 #import <Foundation/NSDictionary.h>
 #import <Foundation/NSEnumerator.h>
 #import <Foundation/NSException.h>
+#import <Foundation/NSHashTable.h>
 #import <Foundation/NSIndexSet.h>
 #import <Foundation/NSMapTable.h>
 #import <Foundation/NSNotification.h>
@@ -73,6 +74,7 @@
 #include <math.h>
 
 static NSMapTableKeyCallBacks keyCallBacks;
+static NSHashTableCallBacks expandedCallBacks;
 static NSNotificationCenter *nc = nil;
 static const int current_version = 1;
 
@@ -96,6 +98,202 @@ static NSImage *collapsed = nil;
 static NSImage *expanded  = nil;
 static NSImage *unexpandable  = nil;
 
+/* The loaded items are kept in a tree with a node for each item.  A node
+ * keeps the number of rows taken by each of its children (the child itself
+ * and, if the child is expanded, the rows below it) in a Fenwick tree, so
+ * that the item at a row and the row of an item are found in
+ * O(depth * log(children)) time, and expanding or collapsing an item only
+ * updates the nodes above it.  The children of an item are only asked for
+ * when the item is expanded.
+ */
+typedef struct _GSOutlineNode
+{
+  id item;
+  struct _GSOutlineNode *parent;
+  NSUInteger index;	/* of the node in the children of its parent */
+  NSInteger level;
+  BOOL expanded;
+  BOOL loaded;
+  NSUInteger count;
+  struct _GSOutlineNode **children;
+  NSUInteger *rows;	/* Fenwick tree of the rows of the children */
+  NSUInteger total;	/* rows below the node when it is expanded */
+} GSOutlineNode;
+
+#define	ROOT	((GSOutlineNode *)_itemTree)
+
+/* Turns the rows of the children, in rows[1..count], into a Fenwick tree. */
+static void
+rows_build(NSUInteger *rows, NSUInteger count)
+{
+  NSUInteger i;
+
+  for (i = 1; i <= count; i++)
+    {
+      NSUInteger j = i + (i & -i);
+
+      if (j <= count)
+	{
+	  rows[j] += rows[i];
+	}
+    }
+}
+
+static void
+rows_add(NSUInteger *rows, NSUInteger count, NSUInteger index, NSInteger delta)
+{
+  for (index++; index <= count; index += index & -index)
+    {
+      rows[index] += delta;
+    }
+}
+
+/* Returns the rows taken by the first index children. */
+static NSUInteger
+rows_prefix(NSUInteger *rows, NSUInteger index)
+{
+  NSUInteger sum = 0;
+
+  for (; index > 0; index -= index & -index)
+    {
+      sum += rows[index];
+    }
+  return sum;
+}
+
+/* Returns the index of the child whose rows hold *row, and sets *row to
+ * the position of the row in them.
+ */
+static NSUInteger
+rows_search(NSUInteger *rows, NSUInteger count, NSUInteger *row)
+{
+  NSUInteger pos = 0;
+  NSUInteger step = 1;
+  NSUInteger r = *row;
+
+  while (step * 2 <= count)
+    {
+      step *= 2;
+    }
+  for (; step > 0; step /= 2)
+    {
+      if (pos + step <= count && rows[pos + step] <= r)
+	{
+	  pos += step;
+	  r -= rows[pos];
+	}
+    }
+  *row = r;
+  return pos;
+}
+
+static GSOutlineNode *
+node_new(id item, GSOutlineNode *parent, NSUInteger index)
+{
+  GSOutlineNode *node;
+
+  node = NSZoneCalloc(NSDefaultMallocZone(), 1, sizeof(GSOutlineNode));
+  node->item = RETAIN(item);
+  node->parent = parent;
+  node->index = index;
+  node->level = (parent == NULL) ? -1 : parent->level + 1;
+  return node;
+}
+
+static void
+node_free_children(GSOutlineNode *node, NSMapTable *itemDict)
+{
+  NSUInteger i;
+
+  for (i = 0; i < node->count; i++)
+    {
+      GSOutlineNode *child = node->children[i];
+
+      node_free_children(child, itemDict);
+      if (NSMapGet(itemDict, child->item) == child)
+	{
+	  NSMapRemove(itemDict, child->item);
+	}
+      RELEASE(child->item);
+      NSZoneFree(NSDefaultMallocZone(), child);
+    }
+  if (node->children != NULL)
+    {
+      NSZoneFree(NSDefaultMallocZone(), node->children);
+      NSZoneFree(NSDefaultMallocZone(), node->rows);
+    }
+  node->children = NULL;
+  node->rows = NULL;
+  node->count = 0;
+  node->total = 0;
+  node->loaded = NO;
+}
+
+/* Adds delta to the rows the node takes in its parent, and so on up to
+ * the first item which is collapsed.
+ */
+static void
+node_add_rows(GSOutlineNode *node, NSInteger delta)
+{
+  while (delta != 0 && node->parent != NULL)
+    {
+      GSOutlineNode *parent = node->parent;
+
+      rows_add(parent->rows, parent->count, node->index, delta);
+      parent->total += delta;
+      if (parent->expanded == NO)
+	{
+	  break;
+	}
+      node = parent;
+    }
+}
+
+/* Returns the row of the node, or -1 if it is inside a collapsed item. */
+static NSInteger
+node_row(GSOutlineNode *node)
+{
+  NSInteger row = 0;
+
+  while (node->parent != NULL)
+    {
+      GSOutlineNode *parent = node->parent;
+
+      if (parent->expanded == NO)
+	{
+	  return -1;
+	}
+      row += rows_prefix(parent->rows, node->index);
+      if (parent->parent != NULL)
+	{
+	  row++;
+	}
+      node = parent;
+    }
+  return row;
+}
+
+static GSOutlineNode *
+node_at_row(GSOutlineNode *node, NSUInteger row)
+{
+  if (node == NULL || row >= node->total)
+    {
+      return NULL;
+    }
+  while (YES)
+    {
+      GSOutlineNode *child;
+
+      child = node->children[rows_search(node->rows, node->count, &row)];
+      if (row == 0)
+	{
+	  return child;
+	}
+      row--;
+      node = child;
+    }
+}
+
 @interface NSOutlineView (NotificationRequestMethods)
 - (void) _postSelectionIsChangingNotification;
 - (void) _postSelectionDidChangeNotification;
@@ -127,13 +325,11 @@ static NSImage *unexpandable  = nil;
 - (void) _initOutlineDefaults;
 - (void) _autosaveExpandedItems;
 - (void) _autoloadExpandedItems;
-- (void) _collectItemsStartingWith: (id)startitem
-			      into: (NSMutableArray *)allChildren;
-- (void) _loadDictionaryStartingWith: (id) startitem
-			     atLevel: (NSInteger) level;
+- (NSArray *) _childrenOfItem: (id)item;
+- (void) _loadChildrenOfNode: (GSOutlineNode *)node;
+- (NSArray *) _loadedChildrenOfItem: (id)item;
 - (void) _openItem: (id)item;
 - (void) _closeItem: (id)item;
-- (void) _removeChildren: (id)startitem;
 - (void) _noteNumberOfRowsChangedBelowItem: (id)item by: (NSInteger)n;
 @end
 
@@ -148,6 +344,11 @@ static NSImage *unexpandable  = nil;
 - (void) _drawCellViewRow: (NSInteger)rowIndex
 		 clipRect: (NSRect)clipRect;
 - (void) _sendDoubleActionForColumn: (NSInteger)columnIndex;
+- (void) _noteRowHeightsChanged;
+- (void) _noteRowHeightsOfRowsAtIndexes: (NSIndexSet *)indexes
+			       inserted: (BOOL)inserted;
+- (void) _updateNumberOfRows;
+- (void) _recycleRowsOutsideRange: (NSRange)rows;
 @end
 
 @interface NSTableColumn (Private)
@@ -182,6 +383,8 @@ static NSImage *unexpandable  = nil;
        */
       keyCallBacks = NSObjectMapKeyCallBacks;
       keyCallBacks.isEqual = NSOwnedPointerMapKeyCallBacks.isEqual;
+      expandedCallBacks = NSObjectHashCallBacks;
+      expandedCallBacks.isEqual = NSOwnedPointerHashCallBacks.isEqual;
 #if 0
 /* Old Interface Builder style. */
       collapsed    = [NSImage imageNamed: @"common_outlineCollapsed"];
@@ -225,11 +428,10 @@ static NSImage *unexpandable  = nil;
 
 - (void) dealloc
 {
-  RELEASE(_items);
-  RELEASE(_expandedItems);
-
+  node_free_children(ROOT, _itemDict);
+  NSZoneFree(NSDefaultMallocZone(), _itemTree);
   NSFreeMapTable(_itemDict);
-  NSFreeMapTable(_levelOfItems);
+  NSFreeHashTable(_expandedItems);
 
   if (_autosaveExpandedItems)
     {
@@ -313,10 +515,9 @@ static NSImage *unexpandable  = nil;
       if (collapseChildren) // collapse all
 	{
 	  int index, numChildren;
-	  NSMutableArray *allChildren;
-	  id sitem = (item == nil) ? (id)[NSNull null] : (id)item;
+	  NSArray *allChildren;
 
-	  allChildren = NSMapGet(_itemDict, sitem);
+	  allChildren = [self _loadedChildrenOfItem: item];
 	  numChildren = [allChildren count];
 
 	  for (index = 0; index < numChildren; index++)
@@ -342,10 +543,11 @@ static NSImage *unexpandable  = nil;
       // Should only mark the rect below the closed item for redraw
       [self setNeedsDisplay: YES];
 
-      // If it is view based, then refresh the outline view...
+      // If it is view based, the rows below the item have moved, so
+      // lay out their views again...
       if (_viewBased)
 	{
-	  [self reloadData];
+	  [self _recycleRowsOutsideRange: NSMakeRange(0, 0)];
 	}
     }
 }
@@ -405,10 +607,9 @@ static NSImage *unexpandable  = nil;
       if (expandChildren) // expand all
 	{
 	  int index, numChildren;
-	  NSMutableArray *allChildren;
-	  id sitem = (item == nil) ? (id)[NSNull null] : (id)item;
+	  NSArray *allChildren;
 
-	  allChildren = NSMapGet(_itemDict, sitem);
+	  allChildren = [self _loadedChildrenOfItem: item];
 	  numChildren = [allChildren count];
 
 	  for (index = 0; index < numChildren; index++)
@@ -425,10 +626,11 @@ static NSImage *unexpandable  = nil;
       // Should only mark the rect below the expanded item for redraw
       [self setNeedsDisplay: YES];
 
-      // If it is view based, then refresh the outline view...
+      // If it is view based, the rows below the item have moved, so
+      // lay out their views again...
       if (_viewBased)
 	{
-	  [self reloadData];
+	  [self _recycleRowsOutsideRange: NSMakeRange(0, 0)];
 	}
     }
 }
@@ -540,12 +742,7 @@ static NSImage *unexpandable  = nil;
     {
       return YES;
     }
-  // Check the array to determine if it is expanded.
-  if ([_expandedItems indexOfObjectIdenticalTo: item] == NSNotFound)
-    {
-      return NO;
-    }
-  return YES;
+  return (NSHashGet(_expandedItems, item) != NULL);
 }
 
 /**
@@ -554,11 +751,14 @@ static NSImage *unexpandable  = nil;
  */
 - (id) itemAtRow: (NSInteger)row
 {
-  if ((row >= [_items count]) || (row < 0))
+  GSOutlineNode *node;
+
+  if (row < 0)
     {
       return nil;
     }
-  return [_items objectAtIndex: row];
+  node = node_at_row(ROOT, row);
+  return (node == NULL) ? nil : node->item;
 }
 
 /**
@@ -568,8 +768,9 @@ static NSImage *unexpandable  = nil;
 {
   if (item != nil)
     {
-      id object = NSMapGet(_levelOfItems, item);
-      return [object integerValue];
+      GSOutlineNode *node = NSMapGet(_itemDict, item);
+
+      return (node == NULL) ? 0 : node->level;
     }
 
   return -1;
@@ -580,7 +781,9 @@ static NSImage *unexpandable  = nil;
  */
 - (NSInteger) levelForRow: (NSInteger)row
 {
-  return [self levelForItem: [self itemAtRow: row]];
+  GSOutlineNode *node = (row < 0) ? NULL : node_at_row(ROOT, row);
+
+  return (node == NULL) ? -1 : node->level;
 }
 
 /**
@@ -596,22 +799,13 @@ static NSImage *unexpandable  = nil;
  */
 - (id) parentForItem: (id)item
 {
-  NSArray *allKeys = NSAllMapTableKeys(_itemDict);
-  NSEnumerator *en = [allKeys objectEnumerator];
-  NSInteger index;
-  id parent;
+  GSOutlineNode *node = (item == nil) ? NULL : NSMapGet(_itemDict, item);
 
-  while ((parent = [en nextObject]))
+  if (node == NULL || node->parent == ROOT)
     {
-      NSMutableArray *childArray = NSMapGet(_itemDict, parent);
-
-      if ((index = [childArray indexOfObjectIdenticalTo: item]) != NSNotFound)
-	{
-	  return (parent == [NSNull null]) ? (id)nil : (id)parent;
-	}
+      return nil;
     }
-
-  return nil;
+  return node->parent->item;
 }
 
 /**
@@ -630,47 +824,58 @@ static NSImage *unexpandable  = nil;
  */
 - (void) reloadItem: (id)item reloadChildren: (BOOL)reloadChildren
 {
-  NSInteger index;
-  id parent;
-  BOOL expanded;
-  id dsobj = nil;
-  id object = (item == nil) ? (id)[NSNull null] : (id)item;
-  NSArray *allKeys = NSAllMapTableKeys(_itemDict);
-  NSEnumerator *en = [allKeys objectEnumerator];
+  GSOutlineNode *node = (item == nil) ? ROOT : NSMapGet(_itemDict, item);
 
-  expanded = [self isItemExpanded: item];
+  if (node == NULL)
+    {
+      return;
+    }
 
-  // find the parent of the item
-  while ((parent = [en nextObject]))
+  if (node != ROOT && [_dataSource respondsToSelector:
+			      @selector(outlineView:child:ofItem:)])
     {
-      NSMutableArray *childArray = NSMapGet(_itemDict, parent);
+      id dsobj = [_dataSource outlineView: self
+				    child: node->index
+				   ofItem: node->parent->item];
 
-      if ((index = [childArray indexOfObjectIdenticalTo: object]) != NSNotFound)
+      if (dsobj != nil && dsobj != item)
 	{
-	  parent = (parent == [NSNull null]) ? (id)nil : (id)parent;
-	  dsobj = [_dataSource outlineView: self
-			       child: index
-			       ofItem: parent];
-
-	  if (dsobj != item)
+	  if (NSMapGet(_itemDict, item) == node)
 	    {
-	      [childArray replaceObjectAtIndex: index withObject: dsobj];
-	      // FIXME We need to correct _items, _itemDict, _levelOfItems,
-	      // _expandedItems and _selectedItems
+	      NSMapRemove(_itemDict, item);
 	    }
-	  break;
+	  NSMapInsert(_itemDict, dsobj, node);
+	  if (NSHashGet(_expandedItems, item) != NULL)
+	    {
+	      NSHashRemove(_expandedItems, item);
+	      NSHashInsert(_expandedItems, dsobj);
+	    }
+	  ASSIGN(node->item, dsobj);
 	}
     }
 
   if (reloadChildren)
     {
-      [self _removeChildren: dsobj];
-      [self _loadDictionaryStartingWith: dsobj
-	    atLevel: [self levelForItem: dsobj]];
+      NSUInteger numChildren = node->total;
+      BOOL visible = node->expanded
+	&& (node == ROOT || node_row(node) != -1);
 
-      if (expanded)
+      node_free_children(node, _itemDict);
+      if (node->expanded)
 	{
-	  [self _openItem: dsobj];
+	  node_add_rows(node, -(NSInteger)numChildren);
+	  if (visible)
+	    {
+	      [self _noteNumberOfRowsChangedBelowItem: node->item
+						   by: -numChildren];
+	    }
+	  [self _loadChildrenOfNode: node];
+	  node_add_rows(node, node->total);
+	  if (visible)
+	    {
+	      [self _noteNumberOfRowsChangedBelowItem: node->item
+						   by: node->total];
+	    }
 	}
     }
   [self setNeedsDisplay: YES];
@@ -682,12 +887,13 @@ static NSImage *unexpandable  = nil;
  */
 - (NSInteger) rowForItem: (id)item
 {
-  NSInteger row;
+  GSOutlineNode *node;
+
   if (item == nil)
     return -1;
 
-  row = [_items indexOfObjectIdenticalTo: item];
-  return (row == NSNotFound) ? -1 : row;
+  node = NSMapGet(_itemDict, item);
+  return (node == NULL) ? -1 : node_row(node);
 }
 
 /**
@@ -834,30 +1040,10 @@ static NSImage *unexpandable  = nil;
 	}
     }
 
-  // release the old array
-  if (_items != nil)
-    {
-      RELEASE(_items);
-    }
-
-  if (_itemDict != NULL)
-    {
-      NSFreeMapTable(_itemDict);
-    }
-
-  if (_levelOfItems != NULL)
-    {
-      NSFreeMapTable(_levelOfItems);
-    }
-
-  // create a new empty one
-  _items = [[NSMutableArray alloc] init];
-  _itemDict = NSCreateMapTable(keyCallBacks,
-			       NSObjectMapValueCallBacks,
-			       64);
-  _levelOfItems = NSCreateMapTable(keyCallBacks,
-				   NSObjectMapValueCallBacks,
-				   64);
+  // release the old items, whose rows' heights are asked for again
+  node_free_children(ROOT, _itemDict);
+  NSResetMapTable(_itemDict);
+  [self _noteRowHeightsChanged];
 
   // reload all the open items...
   [self _openItem: nil];
@@ -891,6 +1077,7 @@ static NSImage *unexpandable  = nil;
   SET_DELEGATE_NOTIFICATION(ItemWillCollapse);
 
   _del_responds = [_delegate respondsToSelector: sel];
+  [self _noteRowHeightsChanged];
 }
 
 - (void) encodeWithCoder: (NSCoder*)aCoder
@@ -1080,8 +1267,10 @@ static NSImage *unexpandable  = nil;
 
   if (_autoResizesOutlineColumn)
     {
+      NSRange rows = [self rowsInRect: aRect];
       CGFloat widest = 0;
-      for (index = 0; index < _numberOfRows; index++)
+
+      for (index = rows.location; index < NSMaxRange(rows); index++)
 	{
 	  CGFloat offset = [self levelForRow: index] *
 	    [self indentationPerLevel];
@@ -1099,7 +1288,7 @@ static NSImage *unexpandable  = nil;
 - (void) setDropItem: (id)item
       dropChildIndex: (NSInteger)childIndex
 {
-  if (item != nil && [_items indexOfObjectIdenticalTo: item] == NSNotFound)
+  if (item != nil && [self rowForItem: item] == -1)
     {
       /* FIXME raise an exception, or perhaps we should support
        * setting an item which is not visible (inside a collapsed
@@ -1221,7 +1410,7 @@ static NSImage *unexpandable  = nil;
 // TODO: Move a method common to -drapOnRootIndicator and the one below to GSTheme
 - (void) drawDropOnIndicatorWithDropItem: (id)currentDropItem
 {
-  NSInteger row = [_items indexOfObjectIdenticalTo: currentDropItem];
+  NSInteger row = [self rowForItem: currentDropItem];
   NSInteger level = [self levelForItem: currentDropItem];
   NSRect newRect = [self frameOfCellAtColumn: 0
 					 row: row];
@@ -1489,7 +1678,7 @@ Also returns the child index relative to this parent. */
        */
       if (lastDragChange != nil && [lastDragUpdate timeIntervalSinceDate: lastDragChange] >= 0.5)
 	{
-	  id item = [_items objectAtIndex: row];
+	  id item = [self itemAtRow: row];
 	  if ([self isExpandable: item] && ![self isItemExpanded: item])
 	    {
 	      [self expandItem: item expandChildren: NO];
@@ -1748,54 +1937,26 @@ Also returns the child index relative to this parent. */
 
 @implementation NSOutlineView (NotificationRequestMethods)
 
-- (NSIndexPath *) _findIndexPathForItem: (id)item
-			     parentItem: (id)pItem
+- (NSIndexPath *) _indexPathForItem: (id)item
 {
-  id parentItem = (pItem == nil) ? (id)[NSNull null] : (id)pItem;
-  NSArray *children = NSMapGet(_itemDict, parentItem);
-  NSInteger childCount = [children count];
-  NSInteger index = 0;
-  
-  for (index = 0; index < childCount; index++)
+  GSOutlineNode *node = (item == nil) ? NULL : NSMapGet(_itemDict, item);
+
+  if (node == NULL)
     {
-      id childItem = [children objectAtIndex: index];
+      return nil;
+    }
+  else
+    {
+      NSUInteger length = node->level + 1;
+      NSUInteger indexes[length];
+      NSUInteger i = length;
 
-      if (childItem == item)
-	{
-	  return [NSIndexPath indexPathWithIndex: index];
-	}
-      else
+      for (; node != ROOT; node = node->parent)
 	{
-	  NSIndexPath *foundPath = [self _findIndexPathForItem: item
-						    parentItem: childItem];
-
-	  if (foundPath != nil)
-	    {
-	      NSIndexPath *newPath = [NSIndexPath indexPathWithIndex: index];
-	      NSUInteger length = [foundPath length];
-	      NSUInteger indexes[length + 1];
-	      NSUInteger i = 0;
-
-	      [foundPath getIndexes: indexes];
-
-	      // Iterate over existing indexes...
-	      for (i = 0; i < length; i++)
-		{
-		  newPath = [newPath indexPathByAddingIndex: indexes[i]];
-		}
-
-	      return newPath;
-	    }
+	  indexes[--i] = node->index;
 	}
+      return [NSIndexPath indexPathWithIndexes: indexes length: length];
     }
-
-  return nil;
-}
-
-- (NSIndexPath *) _indexPathForItem: (id)item
-{
-  return [self _findIndexPathForItem: item
-			  parentItem: nil];
 }
 
 - (NSArray *) _indexPathsFromSelectedRows
@@ -1806,7 +1967,7 @@ Also returns the child index relative to this parent. */
   // Regenerate the array...
   while (index != NSNotFound)
     {
-      id item = [_items objectAtIndex: index];
+      id item = [self itemAtRow: index];
       NSIndexPath *path = nil;
 
       if ([item respondsToSelector: @selector(indexPath)])
@@ -2031,7 +2192,7 @@ Also returns the child index relative to this parent. */
 
   if (keyPath != nil)
     {
-      id theItem = [_items objectAtIndex: index];
+      id theItem = [self itemAtRow: index];
       result = [theItem valueForKeyPath: keyPath];
     }
   else
@@ -2060,7 +2221,7 @@ Also returns the child index relative to this parent. */
   // like a delegate
   if (keyPath != nil)
     {
-      id theItem = [_items objectAtIndex: index];
+      id theItem = [self itemAtRow: index];
 
       // Set the value on the keyPath.
       [theItem setValue: value
@@ -2083,7 +2244,7 @@ Also returns the child index relative to this parent. */
 
 - (NSInteger) _numRows
 {
-  return [_items count];
+  return (ROOT == NULL) ? 0 : ROOT->total;
 }
 
 - (BOOL) _usesVariableRowHeights
@@ -2092,22 +2253,14 @@ Also returns the child index relative to this parent. */
     @selector(outlineView:heightOfRowByItem:)] == YES);
 }
 
-- (CGFloat) _rowHeightForRow: (NSInteger)rowIndex
+- (CGFloat) _delegateHeightOfRow: (NSInteger)rowIndex
 {
-  if (rowIndex < 0 || rowIndex >= _numberOfRows)
-    {
-      return [self rowHeight];
-    }
+  id item = [self itemAtRow: rowIndex];
+  CGFloat height = [_delegate outlineView: self heightOfRowByItem: item];
 
-  if ([_delegate respondsToSelector:
-    @selector(outlineView:heightOfRowByItem:)] == YES)
+  if (height > 0.0)
     {
-      id item = [self itemAtRow: rowIndex];
-      CGFloat height = [_delegate outlineView: self heightOfRowByItem: item];
-      if (height > 0.0)
-        {
-          return height;
-        }
+      return height;
     }
 
   return [self rowHeight];
@@ -2142,13 +2295,11 @@ Also returns the child index relative to this parent. */
 - (void) _initOutlineDefaults
 {
   _itemDict = NSCreateMapTable(keyCallBacks,
-			       NSObjectMapValueCallBacks,
+			       NSNonOwnedPointerMapValueCallBacks,
 			       64);
-  _items = [[NSMutableArray alloc] init];
-  _expandedItems = [[NSMutableArray alloc] init];
-  _levelOfItems = NSCreateMapTable(keyCallBacks,
-				   NSObjectMapValueCallBacks,
-				   64);
+  _expandedItems = NSCreateHashTable(expandedCallBacks, 64);
+  _itemTree = node_new(nil, NULL, 0);
+  ROOT->expanded = YES;
 
   _indentationMarkerFollowsCell = YES;
   _autoResizesOutlineColumn = YES;
@@ -2166,7 +2317,8 @@ Also returns the child index relative to this parent. */
       defaults  = [NSUserDefaults standardUserDefaults];
       tableKey = [NSString stringWithFormat: @"NSOutlineView Expanded Items %@",
 			   _autosaveName];
-      [defaults setObject: _expandedItems  forKey: tableKey];
+      [defaults setObject: NSAllHashTableObjects(_expandedItems)
+		   forKey: tableKey];
       [defaults synchronize];
     }
 }
@@ -2196,54 +2348,13 @@ Also returns the child index relative to this parent. */
     }
 }
 
-// Collect all of the items under a given element.
-- (void)_collectItemsStartingWith: (id)startitem
-			     into: (NSMutableArray *)allChildren
-{
-  NSUInteger num;
-  NSUInteger i;
-  id sitem = (startitem == nil) ? (id)[NSNull null] : (id)startitem;
-  NSMutableArray *anarray;
-
-  anarray = NSMapGet(_itemDict, sitem);
-  num = [anarray count];
-  for (i = 0; i < num; i++)
-    {
-      id anitem = [anarray objectAtIndex: i];
-
-      // Only collect the children if the item is expanded
-      if ([self isItemExpanded: startitem])
-	{
-	  [allChildren addObject: anitem];
-	}
-
-      [self _collectItemsStartingWith: anitem
-	    into: allChildren];
-    }
-}
-
-- (BOOL) _isItemLoaded: (id)item
-{
-  id sitem = (item == nil) ? (id)[NSNull null] : (id)item;
-  id object = NSMapGet(_itemDict, sitem);
-
-  // NOTE: We could store the loaded items in a map to ensure we only load
-  // the children of item when it gets expanded for the first time. This would
-  // allow to write: return (NSMapGet(_loadedItemDict, sitem) != nil);
-  // The last line isn't truly correct because it implies an item without
-  // children will get incorrectly reloaded automatically on each
-  // expand/collapse.
-  return ([object count] != 0);
-}
-
-- (void) _loadDictionaryStartingWith: (id) startitem
-			     atLevel: (NSInteger) level
+// Get the children of an item from the data source or the content binding.
+- (NSArray *) _childrenOfItem: (id)item
 {
   GSKeyValueBinding *theBinding = nil;
+  NSMutableArray *result = nil;
   NSInteger num = 0;
   NSInteger i = 0;
-  id sitem = (startitem == nil) ? (id)[NSNull null] : (id)startitem;
-  NSMutableArray *anarray = nil;
 
   theBinding = [GSKeyValueBinding getBinding: NSContentBinding
 				   forObject: self];
@@ -2266,7 +2377,7 @@ Also returns the child index relative to this parent. */
 	{
 	  NSTreeController *tc = (NSTreeController *)observedObject;
 
-	  if (startitem == nil)
+	  if (item == nil)
 	    {
 	      NSTreeNode *node = (NSTreeNode *)[theBinding destinationValue];
 
@@ -2286,198 +2397,179 @@ Also returns the child index relative to this parent. */
 	       * from whether there are children present on a given node.  See
 	       * the documentation for NSTreeController for more info.
 	       */
-	      if ([self isExpandable: startitem]
-		  && [self isItemExpanded: startitem])
+	      NSString *childrenKeyPath = [tc childrenKeyPathForNode: item];
+
+	      if (childrenKeyPath != nil)
 		{
-		  NSString *childrenKeyPath = [tc childrenKeyPathForNode: startitem];
+		  NSString *countKeyPath = [tc countKeyPathForNode: item];
 
-		  if (childrenKeyPath != nil)
+		  children = [item valueForKeyPath: childrenKeyPath];
+		  if (countKeyPath == nil)
+		    {
+		      num = [children count]; // get the count directly...
+		    }
+		  else
 		    {
-		      NSString *countKeyPath = [tc countKeyPathForNode: startitem];
-
-		      children = [sitem valueForKeyPath: childrenKeyPath];
-		      if (countKeyPath == nil)
-			{
-			  num = [children count]; // get the count directly...
-			}
-		      else
-			{
-			  NSNumber *countValue = [sitem valueForKeyPath: countKeyPath];
-			  num = [countValue integerValue];
-			}
+		      NSNumber *countValue = [item valueForKeyPath: countKeyPath];
+		      num = [countValue integerValue];
 		    }
 		}
 	    }
 
-	  if (num > 0)
-	    {
-	      anarray = [NSMutableArray arrayWithCapacity: num];
-	      NSMapInsert(_itemDict, sitem, anarray);
-	    }
-
-	  NSMapInsert(_levelOfItems, sitem, [NSNumber numberWithInteger: level]);
-
+	  result = [NSMutableArray arrayWithCapacity: num];
 	  for (i = 0; i < num; i++)
 	    {
 	      id anitem = [children objectAtIndex: i];
 
 	      if ([anitem respondsToSelector: @selector(_setParentNode:)])
 		{
-		  [anitem _setParentNode: startitem];
+		  [anitem _setParentNode: item];
 		}
-	      [anarray addObject: anitem];
-	      [self _loadDictionaryStartingWith: anitem
-					atLevel: level + 1];
+	      [result addObject: anitem];
 	    }
 	}
     }
   else
     {
-      /* Check to see if item is expandable and expanded before getting the number
-       * of items. For macos compatibility the topmost item (startitem==nil)
-       * is always considered expandable and must not be checked.
-       * We must load the item only if expanded, otherwise an outline view is not
-       * usable with a big tree structure. For example, an outline view to browse
-       * file system would try to traverse every file/directory on -reloadData.
-       */
-      if (startitem == nil
-	  || ([self isExpandable: startitem]
-	      && [self isItemExpanded: startitem]))
+      num = [_dataSource outlineView: self
+	      numberOfChildrenOfItem: item];
+      result = [NSMutableArray arrayWithCapacity: num];
+      for (i = 0; i < num; i++)
 	{
-	  num = [_dataSource outlineView: self
-		  numberOfChildrenOfItem: startitem];
+	  [result addObject: [_dataSource outlineView: self
+						child: i
+					       ofItem: item]];
 	}
+    }
 
-      if (num > 0)
-	{
-	  anarray = [NSMutableArray arrayWithCapacity: num];
-	  NSMapInsert(_itemDict, sitem, anarray);
-	}
+  return result;
+}
 
-      NSMapInsert(_levelOfItems, sitem, [NSNumber numberWithInteger: level]);
+/* Loads the children of the node, and those of the children which are
+ * expanded.  We must only load the items below expanded items, otherwise
+ * an outline view is not usable with a big tree structure.  For example,
+ * an outline view to browse the file system would try to traverse every
+ * file/directory on -reloadData.
+ */
+- (void) _loadChildrenOfNode: (GSOutlineNode *)node
+{
+  NSArray *children = [self _childrenOfItem: node->item];
+  NSUInteger num = [children count];
+  NSUInteger i;
 
-      for (i = 0; i < num; i++)
+  node_free_children(node, _itemDict);
+  node->loaded = YES;
+  if (num == 0)
+    {
+      return;
+    }
+
+  node->children = NSZoneMalloc(NSDefaultMallocZone(),
+				num * sizeof(GSOutlineNode *));
+  node->rows = NSZoneCalloc(NSDefaultMallocZone(),
+			    num + 1, sizeof(NSUInteger));
+  node->count = num;
+  for (i = 0; i < num; i++)
+    {
+      id anitem = [children objectAtIndex: i];
+      GSOutlineNode *child = node_new(anitem, node, i);
+
+      node->children[i] = child;
+      NSMapInsert(_itemDict, anitem, child);
+      if (NSHashGet(_expandedItems, anitem) != NULL
+	  && [self isExpandable: anitem])
 	{
-	  id anitem = [_dataSource outlineView: self
-					 child: i
-					ofItem: startitem];
-	  [anarray addObject: anitem];
-	  [self _loadDictionaryStartingWith: anitem
-				    atLevel: level + 1];
+	  child->expanded = YES;
+	  [self _loadChildrenOfNode: child];
 	}
+      node->rows[i + 1] = 1 + (child->expanded ? child->total : 0);
+      node->total += node->rows[i + 1];
     }
+  rows_build(node->rows, num);
 }
 
-- (void)_closeItem: (id)item
+// The loaded children of an item.
+- (NSArray *) _loadedChildrenOfItem: (id)item
 {
-  NSUInteger i, numChildren;
-  NSMutableArray *removeAll = [NSMutableArray array];
+  GSOutlineNode *node = (item == nil) ? ROOT : NSMapGet(_itemDict, item);
+  NSMutableArray *result = [NSMutableArray array];
+  NSUInteger i;
 
-  [self _collectItemsStartingWith: item into: removeAll];
-  numChildren = [removeAll count];
+  for (i = 0; node != NULL && i < node->count; i++)
+    {
+      [result addObject: node->children[i]->item];
+    }
+  return result;
+}
+
+- (void)_closeItem: (id)item
+{
+  GSOutlineNode *node = (item == nil) ? ROOT : NSMapGet(_itemDict, item);
+  NSUInteger numChildren;
+  BOOL visible;
 
   // close the item...
   if (item != nil)
     {
-      [_expandedItems removeObjectIdenticalTo: item];
+      NSHashRemove(_expandedItems, item);
+    }
+  if (node == NULL || node == ROOT || node->expanded == NO)
+    {
+      return;
     }
 
-  // For the close method it doesn't matter what order they are
-  // removed in.
-  for (i = 0; i < numChildren; i++)
+  // The rows below the item stay loaded, so that they come back as they
+  // were when it is opened again.
+  visible = (node_row(node) != -1);
+  numChildren = node->total;
+  node->expanded = NO;
+  node_add_rows(node, -(NSInteger)numChildren);
+  if (visible)
     {
-      id child = [removeAll objectAtIndex: i];
-      [_items removeObjectIdenticalTo: child];
+      [self _noteNumberOfRowsChangedBelowItem: item by: -numChildren];
     }
-  [self _noteNumberOfRowsChangedBelowItem: item by: -numChildren];
 }
 
 - (void)_openItem: (id)item
 {
-  NSUInteger insertionPoint, numChildren, numDescendants;
-  NSInteger i;
-  id object;
-  id sitem = (item == nil) ? (id)[NSNull null] : (id)item;
+  GSOutlineNode *node = (item == nil) ? ROOT : NSMapGet(_itemDict, item);
+  BOOL visible;
 
   // open the item...
   if (item != nil)
     {
-      [_expandedItems addObject: item];
+      NSHashInsert(_expandedItems, item);
     }
-
-  // Load the children of the item if needed
-  if ([self _isItemLoaded: item] == NO)
+  // An item which isn't loaded is shown open once its parent is.
+  if (node == NULL || (node != ROOT && node->expanded))
     {
-      [self _loadDictionaryStartingWith: item
-				atLevel: [self levelForItem: item]];
+      return;
     }
 
-  object = NSMapGet(_itemDict, sitem);
-  numChildren = numDescendants = [object count];
+  visible = (node == ROOT || node_row(node) != -1);
 
-  insertionPoint = [_items indexOfObjectIdenticalTo: item];
-  if (insertionPoint == NSNotFound)
+  // Load the children of the item if needed.  Items without children are
+  // asked again, in case they have some now.
+  if (node->loaded == NO || node->count == 0)
     {
-      insertionPoint = 0;
-    }
-  else
-    {
-      insertionPoint++;
+      [self _loadChildrenOfNode: node];
     }
 
-  for (i = numChildren-1; i >= 0; i--)
+  if (node != ROOT)
     {
-      id obj = NSMapGet(_itemDict, sitem);
-      id child = [obj objectAtIndex: i];
-
-      // Add all of the children...
-      if ([self isItemExpanded: child])
-	{
-	  NSUInteger numItems;
-	  NSInteger j;
-	  NSMutableArray *insertAll = [NSMutableArray array];
-
-	  [self _collectItemsStartingWith: child into: insertAll];
-	  numItems = [insertAll count];
-	  numDescendants += numItems;
-	  for (j = numItems-1; j >= 0; j--)
-	    {
-	      [_items insertObject: [insertAll objectAtIndex: j]
-		      atIndex: insertionPoint];
-	    }
-	}
-
-      // Add the parent
-      [_items insertObject: child atIndex: insertionPoint];
+      node->expanded = YES;
+      node_add_rows(node, node->total);
     }
-
-  [self _noteNumberOfRowsChangedBelowItem: item by: numDescendants];
-}
-
-- (void) _removeChildren: (id)startitem
-{
-  NSUInteger i, numChildren;
-  id sitem = (startitem == nil) ? (id)[NSNull null] : (id)startitem;
-  NSMutableArray *anarray;
-
-  anarray = NSMapGet(_itemDict, sitem);
-  numChildren = [anarray count];
-  for (i = 0; i < numChildren; i++)
+  if (visible)
     {
-      id child = [anarray objectAtIndex: i];
-
-      [self _removeChildren: child];
-      NSMapRemove(_itemDict, child);
-      [_items removeObjectIdenticalTo: child];
-      [_expandedItems removeObjectIdenticalTo: child];
+      [self _noteNumberOfRowsChangedBelowItem: item by: node->total];
     }
-  [anarray removeAllObjects];
-  [self _noteNumberOfRowsChangedBelowItem: startitem by: -numChildren];
 }
 
 - (void) _noteNumberOfRowsChangedBelowItem: (id)item by: (NSInteger)numItems
 {
   BOOL selectionDidChange = NO;
+  NSInteger row;
   NSUInteger rowIndex, nextIndex;
 
   // check for trivial case
@@ -2488,8 +2580,23 @@ Also returns the child index relative to this parent. */
   /* Note: We update the selected row indexes directly instead of calling
    * -selectRowIndexes:extendingSelection: to avoid posting bogus selection
    * did change notifications. */
-  rowIndex = [_items indexOfObjectIdenticalTo: item];
-  rowIndex = (rowIndex == NSNotFound) ? 0 : rowIndex + 1;
+  row = [self rowForItem: item];
+  rowIndex = (row == -1) ? 0 : row + 1;
+
+  // the rows of the other items keep their heights
+  if (item != nil)
+    {
+      NSRange rows = NSMakeRange(rowIndex, (numItems > 0) ? numItems : -numItems);
+
+      [self _noteRowHeightsOfRowsAtIndexes:
+	      [NSIndexSet indexSetWithIndexesInRange: rows]
+				  inserted: numItems > 0];
+    }
+  else
+    {
+      [self _noteRowHeightsChanged];
+    }
+
   nextIndex = [_selectedRows indexGreaterThanOrEqualToIndex: rowIndex];
   if (nextIndex != NSNotFound)
     {
@@ -2552,7 +2659,7 @@ Also returns the child index relative to this parent. */
 	}
     }
 
-  [self noteNumberOfRowsChanged];
+  [self _updateNumberOfRows];
   if (selectionDidChange)
     {
       [self _postSelectionDidChangeNotification];
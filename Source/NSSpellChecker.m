@@ -38,10 +38,12 @@
 #import <Foundation/NSDistantObject.h>
 #import <Foundation/NSEnumerator.h>
 #import <Foundation/NSException.h>
+#import <Foundation/NSLock.h>
 #import <Foundation/NSNotification.h>
 #import <Foundation/NSProxy.h>
 #import <Foundation/NSSet.h>
 #import <Foundation/NSSpellServer.h>
+#import <Foundation/NSThread.h>
 #import <Foundation/NSUserDefaults.h>
 #import <Foundation/NSValue.h>
 #import "AppKit/NSBrowser.h"
@@ -83,6 +85,61 @@ extern NSString *GSSpellServerName(NSString *checkerDictionary, NSString *langua
 
 - (NSArray *) _suggestGuessesForWord: (NSString *)word
 			  inLanguage: (NSString *)language;
+
+- (bycopy NSArray *) _findMisspelledWordsInString: (NSString *)stringToCheck
+					 language: (NSString *)language
+				     ignoredWords: (NSArray *)ignoredWords;
+@end
+
+/* The spell server answers -_findMisspelledWordsInString:language:
+ * ignoredWords: by finding every misspelled word of the string itself, so
+ * a client gets them all in one round trip.  This lives here rather than
+ * in the spell server tool so that servers linked against any version of
+ * the library get it.
+ */
+@interface NSSpellServer (GSBatchChecking)
+- (bycopy NSArray *) _findMisspelledWordsInString: (NSString *)stringToCheck
+					 language: (NSString *)language
+				     ignoredWords: (NSArray *)ignoredWords;
+@end
+
+@implementation NSSpellServer (GSBatchChecking)
+
+- (bycopy NSArray *) _findMisspelledWordsInString: (NSString *)stringToCheck
+					 language: (NSString *)language
+				     ignoredWords: (NSArray *)ignoredWords
+{
+  NSMutableArray *ranges = [NSMutableArray array];
+  NSUInteger length = [stringToCheck length];
+  NSUInteger offset = 0;
+
+  while (offset < length)
+    {
+      NSString *rest = stringToCheck;
+      NSRange r;
+      int count = 0;
+
+      if (offset > 0)
+	{
+	  rest = [stringToCheck substringFromIndex: offset];
+	}
+      r = [(id<NSSpellServerPrivateProtocol>)self
+	    _findMisspelledWordInString: rest
+				   language: language
+			       ignoredWords: ignoredWords
+				  wordCount: &count
+				  countOnly: NO];
+      if (r.location == NSNotFound || r.length == 0)
+	{
+	  break;
+	}
+      r.location += offset;
+      [ranges addObject: [NSValue valueWithRange: r]];
+      offset = NSMaxRange(r);
+    }
+  return ranges;
+}
+
 @end
 
 // Methods needed to get the GSServicesManager
@@ -227,22 +284,31 @@ static int __documentTag = 0;
     {
       NSLog(@"Failed to get the spellserver");
     }
-  else
-    {
-      // remove any previous notifications we are observing.
-      [[NSNotificationCenter defaultCenter] removeObserver: self];
-      
-      // Make sure that we handle the death of the server correctly.
-      [[NSNotificationCenter defaultCenter]
-	addObserver: self
-	selector: @selector(_handleServerDeath:)
-	name: NSConnectionDidDieNotification
-	object: [(NSDistantObject *)proxy connectionForProxy]];
-    }
 
   return proxy;
 }
 
+// Support function to talk to the spell server through proxy
+- (void)_setServerProxy: (id)proxy
+{
+  NSConnection *connection = [(NSDistantObject *)proxy connectionForProxy];
+
+  // remove any previous notifications we are observing.
+  [[NSNotificationCenter defaultCenter] removeObserver: self];
+
+  // Make sure that we handle the death of the server correctly.
+  [[NSNotificationCenter defaultCenter]
+    addObserver: self
+    selector: @selector(_handleServerDeath:)
+    name: NSConnectionDidDieNotification
+    object: connection];
+
+  // Continuous spell checking uses the connection from another thread.
+  [connection enableMultipleThreads];
+
+  ASSIGN(_serverProxy, proxy);
+}
+
 - (id)_serverProxy
 {
   if (_serverProxy == nil)
@@ -252,8 +318,7 @@ static int __documentTag = 0;
       id<NSSpellServerPrivateProtocol> proxy = [self _startServerForLanguage: _language];
       if (proxy != nil)
 	{
-	  _serverProxy = proxy;
-	  RETAIN(_serverProxy);
+	  [self _setServerProxy: proxy];
 	}
     }
   return _serverProxy;
@@ -669,7 +734,7 @@ inSpellDocumentWithTag:(int)tag
       if (proxy != nil)
 	{
 	  ASSIGN(_language, language);
-	  ASSIGN(_serverProxy, (id)proxy);
+	  [self _setServerProxy: proxy];
 	}
       else
 	{
@@ -775,3 +840,237 @@ inSpellDocumentWithTag:(int)tag
   return NO;
 }
 @end
+
+/* Continuous spell checking hands chunks of text to a single background
+ * thread, which asks the spell server for all the misspelled words of a
+ * chunk in one call and sends the result back to the main thread.
+ */
+@interface GSSpellCheckRequest : NSObject
+{
+@public
+  NSString *text;
+  NSUInteger location;
+  NSString *language;
+  NSArray *ignoredWords;
+  id proxy;
+  id target;
+  SEL selector;
+}
+@end
+
+@implementation GSSpellCheckRequest
+
+- (void) dealloc
+{
+  RELEASE(text);
+  RELEASE(language);
+  RELEASE(ignoredWords);
+  RELEASE(proxy);
+  RELEASE(target);
+  [super dealloc];
+}
+
+@end
+
+@interface GSSpellCheckQueue : NSObject
+{
+  NSMutableArray *requests;
+  NSConditionLock *lock;
+  id oneByOneProxy;	/* A server which can't check whole strings. */
+}
+- (void) addRequest: (GSSpellCheckRequest *)request;
+- (void) work: (id)sender;
+@end
+
+@implementation GSSpellCheckQueue
+
+- (id) init
+{
+  if (!(self = [super init]))
+    return nil;
+  requests = [[NSMutableArray alloc] init];
+  lock = [[NSConditionLock alloc] initWithCondition: 0];
+  [NSThread detachNewThreadSelector: @selector(work:)
+			   toTarget: self
+			 withObject: nil];
+  return self;
+}
+
+- (void) dealloc
+{
+  DESTROY(requests);
+  DESTROY(lock);
+  DESTROY(oneByOneProxy);
+  [super dealloc];
+}
+
+- (void) addRequest: (GSSpellCheckRequest *)request
+{
+  [lock lock];
+  [requests addObject: request];
+  [lock unlockWithCondition: 1];
+}
+
+/* Asks for the misspelled words one at a time, for spell servers which
+ * predate -_findMisspelledWordsInString:language:ignoredWords:.
+ */
+- (NSArray *) _rangesOneByOne: (GSSpellCheckRequest *)request
+{
+  NSMutableArray *ranges = [NSMutableArray array];
+  NSUInteger length = [request->text length];
+  NSUInteger offset = 0;
+
+  while (offset < length)
+    {
+      NSRange r;
+      int count = 0;
+
+      r = [request->proxy _findMisspelledWordInString:
+			    [request->text substringFromIndex: offset]
+					 language: request->language
+				     ignoredWords: request->ignoredWords
+					wordCount: &count
+					countOnly: NO];
+      if (r.location == NSNotFound || r.length == 0)
+	{
+	  break;
+	}
+      r.location += offset;
+      [ranges addObject: [NSValue valueWithRange: r]];
+      offset = NSMaxRange(r);
+    }
+  return ranges;
+}
+
+- (void) _check: (GSSpellCheckRequest *)request
+{
+  NSArray *ranges = nil;
+  NSDictionary *result;
+
+  NS_DURING
+    {
+      if (request->proxy != oneByOneProxy)
+	{
+	  ranges = [request->proxy
+		     _findMisspelledWordsInString: request->text
+					 language: request->language
+				     ignoredWords: request->ignoredWords];
+	}
+    }
+  NS_HANDLER
+    {
+      /* A server which doesn't know the method is asked one word at a
+       * time from now on.  Other errors only affect this request.
+       */
+      if ([[localException name] isEqualToString: NSInvalidArgumentException])
+	{
+	  NSDebugLLog(@"NSSpellChecker",
+	    @"Spell server does not check whole strings: %@", localException);
+	  ASSIGN(oneByOneProxy, request->proxy);
+	}
+      else
+	{
+	  NSLog(@"%@", [localException reason]);
+	}
+    }
+  NS_ENDHANDLER
+
+  if (ranges == nil)
+    {
+      NS_DURING
+	{
+	  ranges = [self _rangesOneByOne: request];
+	}
+      NS_HANDLER
+	{
+	  NSLog(@"%@", [localException reason]);
+	}
+      NS_ENDHANDLER
+    }
+  /* The target is told even when the check failed, without ranges, so
+   * that it can check the string again later.  This also lets the target
+   * be released on the main thread.
+   */
+  if (ranges == nil)
+    {
+      result = [NSDictionary dictionaryWithObjectsAndKeys:
+	request->text, @"String",
+	[NSNumber numberWithUnsignedInteger: request->location], @"Location",
+	nil];
+    }
+  else
+    {
+      result = [NSDictionary dictionaryWithObjectsAndKeys:
+	request->text, @"String",
+	[NSNumber numberWithUnsignedInteger: request->location], @"Location",
+	ranges, @"Ranges",
+	nil];
+    }
+  [request->target performSelectorOnMainThread: request->selector
+				    withObject: result
+				 waitUntilDone: NO];
+}
+
+- (void) work: (id)sender
+{
+  while (1)
+    {
+      CREATE_AUTORELEASE_POOL(pool);
+      GSSpellCheckRequest *request;
+
+      [lock lockWhenCondition: 1];
+      request = RETAIN([requests objectAtIndex: 0]);
+      [requests removeObjectAtIndex: 0];
+      [lock unlockWithCondition: [requests count] ? 1 : 0];
+
+      [self _check: request];
+      RELEASE(request);
+      [pool drain];
+    }
+}
+
+@end
+
+@implementation NSSpellChecker (GSBatchChecking)
+
+/* Checks the spelling of string, which starts at location in a document,
+ * on a background thread.  The misspelled words are sent back to target on
+ * the main thread, as the argument of selector: a dictionary holding the
+ * string (String), its location (Location) and an array of the ranges of
+ * the misspelled words within the string (Ranges).  The ranges are left
+ * out when the spell server could not check the string.  Returns NO when
+ * there is no spell server to ask.
+ */
+- (BOOL) _requestCheckingOfString: (NSString *)string
+		       atLocation: (NSUInteger)location
+	   inSpellDocumentWithTag: (int)tag
+			   target: (id)target
+			 selector: (SEL)selector
+{
+  static GSSpellCheckQueue *queue = nil;
+  GSSpellCheckRequest *request;
+  id proxy = [self _serverProxy];
+
+  if (proxy == nil)
+    {
+      return NO;
+    }
+  if (queue == nil)
+    {
+      queue = [[GSSpellCheckQueue alloc] init];
+    }
+
+  request = [[GSSpellCheckRequest alloc] init];
+  request->text = [string copy];
+  request->location = location;
+  request->language = [_language copy];
+  request->ignoredWords = RETAIN([self ignoredWordsInSpellDocumentWithTag: tag]);
+  request->proxy = RETAIN(proxy);
+  request->target = RETAIN(target);
+  request->selector = selector;
+  [queue addRequest: request];
+  RELEASE(request);
+  return YES;
+}
+
+@end
@@ -31,18 +31,25 @@
 */
 
 #include <math.h>
+#include <string.h>
 
+#import <Foundation/NSCharacterSet.h>
+#import <Foundation/NSDictionary.h>
 #import <Foundation/NSException.h>
-#import <Foundation/NSLock.h>
+#import <Foundation/NSThread.h>
+#import <Foundation/NSUserDefaults.h>
+#import <Foundation/NSValue.h>
 
 #import "AppKit/NSAffineTransform.h"
 #import "AppKit/NSAttributedString.h"
+#import "AppKit/NSFont.h"
 #import "AppKit/NSLayoutManager.h"
 #import "AppKit/NSParagraphStyle.h"
 #import "AppKit/NSStringDrawing.h"
 #import "AppKit/NSTextContainer.h"
 #import "AppKit/NSTextStorage.h"
 #import "AppKit/DPSOperators.h"
+#import "GNUstepGUI/GSFontInfo.h"
 
 /*
 Apple uses this as the maximum width of an NSTextContainer.
@@ -54,20 +61,28 @@ For bigger values the width gets ignored.
 /*
 A size of 16 and these constants give a hit rate of 80%-90% for normal app
 use (based on real world statistics gathered with the help of some users
-from #GNUstep).
+from #GNUstep).  Views drawing many distinct strings (eg. table views) do
+better with more entries, so the default is larger and it can be changed
+with the GSStringDrawingCacheSize user default or GSStringDrawingSetCacheSize().
+Each thread has its own cache, so threads drawing strings don't wait for
+each other.
 We use the last entry of the cache as a scratch element to set up an initial 
 text network.
 */
-#define NUM_CACHE_ENTRIES 16
+#define NUM_CACHE_ENTRIES 64
 #define HIT_BOOST         2
 #define MISS_COST         1
+#define MAX_USED          8
 
 
 typedef struct
 {
   int used;
   NSUInteger string_hash;
-  BOOL hasSize, useScreenFonts;
+  NSUInteger key_hash;
+  int next;		/* Next entry in the same bucket, or -1. */
+  BOOL hasSize, useScreenFonts, useFontLeading;
+  NSUInteger maxLines;
 
   NSTextStorage *textStorage;
   NSLayoutManager *layoutManager;
@@ -78,46 +93,67 @@ typedef struct
 } cache_t;
 
 
-static BOOL did_init = NO;
-static cache_t cache[NUM_CACHE_ENTRIES + 1];
-
+/* The entries are found through a hash table on their key_hash, whose
+   buckets hold the index of the first entry with that hash modulo
+   num_buckets.  The scratch entry is never in the table.  */
+@interface GSStringDrawingCache : NSObject
+{
+@public
+  unsigned num_entries;
+  cache_t *cache;
+  unsigned num_buckets;
+  int *buckets;
+  unsigned hand;
+
+  NSUInteger total, hits, misses, hash_hits, fast_hits;
+}
+- (id) initWithEntries: (unsigned)count;
+@end
 
-static NSRecursiveLock *cacheLock = nil;
 
-/* For collecting statistics. */
-//#define STATS
+static NSUInteger cache_size = 0;
 
-#ifdef STATS
-static int total, hits, misses, hash_hits;
+/* Names of the counters in GSStringDrawingCacheStatistics(). */
+#define STATS_TOTAL @"Total"
+#define STATS_HITS @"Hits"
+#define STATS_MISSES @"Misses"
+#define STATS_HASH_HITS @"HashHits"
+#define STATS_FAST_HITS @"FastPath"
 
-static void NSStringDrawing_dump_stats(void)
+static NSUInteger desired_cache_size(void)
 {
-#define P(x) printf("%15i %s\n", x, #x);
-  P(total)
-  P(hits)
-  P(misses)
-  P(hash_hits)
-#undef P
-  printf("%15.8f hit ratio\n", hits / (double)total);
+  if (cache_size == 0)
+    {
+      NSInteger n = [[NSUserDefaults standardUserDefaults]
+                      integerForKey: @"GSStringDrawingCacheSize"];
+
+      cache_size = n > 0 ? n : NUM_CACHE_ENTRIES;
+    }
+  return cache_size;
 }
-#endif
 
-static void init_string_drawing(void)
+@implementation GSStringDrawingCache
+
+- (id) initWithEntries: (unsigned)count
 {
-  int i;
+  unsigned i;
   NSTextStorage *textStorage;
   NSLayoutManager *layoutManager;
   NSTextContainer *textContainer;
 
-  if (did_init)
-    return;
-  did_init = YES;
+  if ((self = [super init]) == nil)
+    return nil;
 
-#ifdef STATS
-  atexit(NSStringDrawing_dump_stats);
-#endif
-  
-  for (i = 0; i < NUM_CACHE_ENTRIES + 1; i++)
+  num_entries = count;
+  cache = calloc(num_entries + 1, sizeof(cache_t));
+  num_buckets = num_entries * 2 + 1;
+  buckets = malloc(sizeof(int) * num_buckets);
+  for (i = 0; i < num_buckets; i++)
+    {
+      buckets[i] = -1;
+    }
+
+  for (i = 0; i < num_entries + 1; i++)
     {
       textStorage = [[NSTextStorage alloc] init];
       layoutManager = [[NSLayoutManager alloc] init];
@@ -130,30 +166,46 @@ static void init_string_drawing(void)
       [textContainer release];
 
       cache[i].used = 0;
+      cache[i].next = -1;
       cache[i].textStorage = textStorage;
       cache[i].layoutManager = layoutManager;
       cache[i].textContainer = textContainer;
     }
+  return self;
 }
 
-static inline void cache_lock()
+- (void) dealloc
 {
-  // FIXME: Put all the init code into an +initialize method
-  // to let the runtime take care of it.
-  if (cacheLock == nil)
-    {
-      cacheLock = [[NSRecursiveLock alloc] init];
-    }
-  [cacheLock lock];
-  if (!did_init)
+  unsigned i;
+
+  for (i = 0; i < num_entries + 1; i++)
     {
-      init_string_drawing();
+      [cache[i].textStorage release];
     }
+  free(cache);
+  free(buckets);
+  [super dealloc];
 }
 
-static inline void cache_unlock()
+@end
+
+/* Returns the cache of the current thread, with the number of entries last
+   asked for.  */
+static GSStringDrawingCache *current_cache(void)
 {
-  [cacheLock unlock];
+  NSMutableDictionary *threadDict =
+    [[NSThread currentThread] threadDictionary];
+  GSStringDrawingCache *sc =
+    [threadDict objectForKey: @"GSStringDrawingCache"];
+  NSUInteger size = desired_cache_size();
+
+  if (sc == nil || sc->num_entries != size)
+    {
+      sc = [[GSStringDrawingCache alloc] initWithEntries: size];
+      [threadDict setObject: sc forKey: @"GSStringDrawingCache"];
+      RELEASE(sc);
+    }
+  return sc;
 }
 
 static inline BOOL is_size_match(cache_t *c, cache_t *scratch)
@@ -170,125 +222,184 @@ static inline BOOL is_size_match(cache_t *c, cache_t *scratch)
     }
 }
 
-static inline BOOL is_match(cache_t *c, cache_t *scratch)
+static inline BOOL is_match(GSStringDrawingCache *sc, cache_t *c,
+  cache_t *scratch)
 {
-  if (c->string_hash != scratch->string_hash
-      || c->useScreenFonts != scratch->useScreenFonts)
+  if (c->key_hash != scratch->key_hash
+      || c->string_hash != scratch->string_hash
+      || c->useScreenFonts != scratch->useScreenFonts
+      || c->useFontLeading != scratch->useFontLeading
+      || c->maxLines != scratch->maxLines
+      || !is_size_match(c, scratch))
     return NO;
 
-#ifdef STATS
-  hash_hits++;
-#endif
+  sc->hash_hits++;
 
-  if (![scratch->textStorage isEqualToAttributedString: c->textStorage])
-    return NO;
-
-  /* String and attributes match, check size. */
-  return is_size_match(c, scratch);
+  /* Hash and size match, check string and attributes. */
+  return [scratch->textStorage isEqualToAttributedString: c->textStorage];
 }
 
-static cache_t *cache_match(cache_t *scratch, BOOL *matched)
+/* Removes the entry at index from its bucket.  */
+static void cache_unlink(GSStringDrawingCache *sc, int index)
 {
-  int i, j;
-  cache_t *c;
-  int least_used = -1;
-  int replace = -1;
-
-#ifdef STATS
-  total++;
-#endif
+  int *p = &sc->buckets[sc->cache[index].key_hash % sc->num_buckets];
 
-  /*
-  A deterministic pattern for replacing cache entries can hit ugly worst
-  cases on certain matching use patterns (where the cache is full of old
-  unused entries, but the new entries keep replacing each other).
-
-  By starting at a random index, we avoid this kind of problem.
-  */
-  j = rand() % NUM_CACHE_ENTRIES;
-  for (i = 0; i < NUM_CACHE_ENTRIES; i++, j++)
+  while (*p != -1)
     {
-      if (j == NUM_CACHE_ENTRIES)
+      if (*p == index)
         {
-          j = 0;
+          *p = sc->cache[index].next;
+          break;
         }
-      c = cache + j;
-      if (least_used == -1 || c->used < least_used)
-	{
-	  least_used = c->used;
-	  replace = j;
-	}
+      p = &sc->cache[*p].next;
+    }
+  sc->cache[index].next = -1;
+}
+
+static cache_t *cache_match(GSStringDrawingCache *sc, cache_t *scratch,
+  BOOL *matched)
+{
+  int i;
+  cache_t *c;
 
-      if (!c->used)
-	continue;
+  sc->total++;
 
-      if (is_match(c, scratch))
+  for (i = sc->buckets[scratch->key_hash % sc->num_buckets]; i != -1;
+       i = sc->cache[i].next)
+    {
+      c = sc->cache + i;
+      if (is_match(sc, c, scratch))
 	{
-#ifdef STATS
-	  hits++;
-#endif
-
+	  sc->hits++;
 	  c->used += HIT_BOOST;
+          if (c->used > MAX_USED)
+            {
+              c->used = MAX_USED;
+            }
           *matched = YES;
 	  return c;
 	}
-      else
+    }
+
+  sc->misses++;
+  *matched = NO;
+
+  /*
+  We did not find a matching entry, replace one that wasn't used recently.
+  Sweeping round the entries and wearing down their use counts finds one
+  in a bounded number of steps.
+  */
+  while (1)
+    {
+      i = sc->hand;
+      c = sc->cache + i;
+      sc->hand = (sc->hand + 1) % sc->num_entries;
+      if (c->used <= MISS_COST)
         {
-          if (c->used > MISS_COST)
-            {
-              c->used -= MISS_COST;
-            }
-          else
-            {
-              c->used = 1;
-            }
+          break;
         }
+      c->used -= MISS_COST;
     }
+  if (c->used)
+    {
+      cache_unlink(sc, i);
+    }
+  return c;
+}
 
-  NSCAssert(replace != -1, @"Couldn't find a cache entry to replace.");
+static NSUInteger attributes_hash(NSTextStorage *textStorage)
+{
+  if ([textStorage length] == 0)
+    {
+      return 0;
+    }
+  return [[textStorage attribute: NSFontAttributeName
+                         atIndex: 0
+                  effectiveRange: NULL] hash];
+}
 
-#ifdef STATS
-  misses++;
-#endif
-  *matched = NO;
+/* Hashes the bits of a coordinate, as converting it to an integer is
+   undefined for negative and huge values.  0 and -0 are equal, so they
+   hash the same. */
+static inline NSUInteger coordinate_hash(CGFloat f)
+{
+  unsigned char bytes[sizeof(CGFloat)];
+  NSUInteger h = 0;
+  NSUInteger i;
 
-  /* We did not find a matching entry, return the least used one */
-  return cache + replace;
+  if (f == 0)
+    {
+      return 0;
+    }
+  memcpy(bytes, &f, sizeof(CGFloat));
+  for (i = 0; i < sizeof(CGFloat); i++)
+    {
+      h = h * 257 + bytes[i];
+    }
+  return h;
 }
 
-static cache_t *cache_lookup(BOOL hasSize, NSSize size, BOOL useScreenFonts)
+/*
+Looks up the string in the scratch entry, laying it out if it isn't in the
+cache.  Of the options, only NSStringDrawingUsesFontLeading affects layout.
+A width or height of 0 or less in a given size doesn't limit the layout in
+that direction.  Layout stops at the height of the given size or after
+maxLines lines (if not 0), so measuring the first lines of a long string
+doesn't lay out the rest of it.
+*/
+static cache_t *cache_lookup(GSStringDrawingCache *sc, BOOL hasSize,
+  NSSize size, BOOL useScreenFonts, NSStringDrawingOptions options,
+  NSUInteger maxLines)
 {
   BOOL hit;
   cache_t *c;
-  cache_t *scratch = cache + NUM_CACHE_ENTRIES;
+  cache_t *scratch = sc->cache + sc->num_entries;
+  BOOL useFontLeading = (options & NSStringDrawingUsesFontLeading) != 0;
 
   scratch->used = 1;
   scratch->string_hash = [[scratch->textStorage string] hash];
   scratch->hasSize = hasSize;
   scratch->useScreenFonts = useScreenFonts;
+  scratch->useFontLeading = useFontLeading;
+  scratch->maxLines = maxLines;
   scratch->givenSize = size;
+  scratch->key_hash = scratch->string_hash
+    ^ (attributes_hash(scratch->textStorage) * 31)
+    ^ (hasSize ? (coordinate_hash(size.width) * 131
+      + coordinate_hash(size.height)) : 0)
+    ^ (useScreenFonts ? 1 : 0) ^ (useFontLeading ? 2 : 0)
+    ^ (maxLines << 2);
   
-  c = cache_match(scratch, &hit);
+  c = cache_match(sc, scratch, &hit);
   if (!hit)
     {
       // Swap c and scratch
       cache_t temp;
+      int index = c - sc->cache;
+      NSUInteger bucket = scratch->key_hash % sc->num_buckets;
 
       temp = *c;
       *c = *scratch;
       *scratch = temp;
 
+      c->next = sc->buckets[bucket];
+      sc->buckets[bucket] = index;
+
       // Cache miss, need to set up the text system
       if (hasSize)
         {
-          [c->textContainer setContainerSize: NSMakeSize(size.width, size.height)];
+          [c->textContainer setContainerSize:
+            NSMakeSize(size.width > 0 ? size.width : LARGE_SIZE,
+                       size.height > 0 ? size.height : LARGE_SIZE)];
         }
       else
         {
           [c->textContainer setContainerSize: NSMakeSize(LARGE_SIZE, LARGE_SIZE)];
         }
+      [c->textContainer setMaximumNumberOfLines: maxLines];
       [c->layoutManager setUsesScreenFonts: useScreenFonts];
-      // Layout the whole container
+      [c->layoutManager setUsesFontLeading: useFontLeading];
+      // Layout what fits in the container
       [c->layoutManager glyphRangeForTextContainer: c->textContainer];
       c->usedRect = [c->layoutManager usedRectForTextContainer: c->textContainer];
     }
@@ -296,9 +407,10 @@ static cache_t *cache_lookup(BOOL hasSize, NSSize size, BOOL useScreenFonts)
   return c;
 }
 
-static inline void prepare_string(NSString *string, NSDictionary *attributes)
+static inline void prepare_string(GSStringDrawingCache *sc, NSString *string,
+  NSDictionary *attributes)
 {
-  cache_t *scratch = cache + NUM_CACHE_ENTRIES;
+  cache_t *scratch = sc->cache + sc->num_entries;
   NSTextStorage *scratchTextStorage = scratch->textStorage;
 
   [scratchTextStorage beginEditing];
@@ -312,15 +424,218 @@ static inline void prepare_string(NSString *string, NSDictionary *attributes)
   [scratchTextStorage endEditing];
 }
 
-static inline void prepare_attributed_string(NSAttributedString *string)
+static inline void prepare_attributed_string(GSStringDrawingCache *sc,
+  NSAttributedString *string)
 {
-  cache_t *scratch = cache + NUM_CACHE_ENTRIES;
+  cache_t *scratch = sc->cache + sc->num_entries;
   NSTextStorage *scratchTextStorage = scratch->textStorage;
 
   [scratchTextStorage replaceCharactersInRange: NSMakeRange(0, [scratchTextStorage length])
                           withAttributedString: string];
 }
 
+/*
+Measuring a string that fits on one line in a single font doesn't need the
+text system.  The glyph generator gives each character the glyph of the font
+for it and the typesetter places the glyphs one after the other on a line
+as high as the font, so we can add up the advancements ourselves.  We only
+do this when we know that the text system would do the same: the attributes
+don't affect layout apart from the font, there are no line breaks, tabs or
+other control characters, every character is printable ASCII with a glyph
+in the font, and there are no possible ligatures.
+*/
+static BOOL fast_path_size(GSStringDrawingCache *sc, NSString *string,
+  NSDictionary *attributes, NSStringDrawingOptions options, NSRect *result)
+{
+  NSUInteger length = [string length];
+  NSFont *font = [attributes objectForKey: NSFontAttributeName];
+  NSUInteger count = [attributes count];
+  NSFont *screenFont;
+  GSFontInfo *fi;
+  unichar buf[64];
+  CGFloat width = 0.0;
+  CGFloat height;
+  NSUInteger i;
+
+  if (font == nil || length == 0 || length > 64)
+    return NO;
+  if (count > 2 || (count == 2
+      && [attributes objectForKey: NSForegroundColorAttributeName] == nil))
+    return NO;
+
+  fi = [font fontInfo];
+  screenFont = [font screenFont];
+  if (screenFont == nil)
+    screenFont = font;
+
+  [string getCharacters: buf range: NSMakeRange(0, length)];
+  for (i = 0; i < length; i++)
+    {
+      unichar ch = buf[i];
+      NSGlyph g;
+
+      if (ch < 0x20 || ch > 0x7e)
+        return NO;
+      if (ch == 'f' && i + 1 < length
+          && (buf[i + 1] == 'f' || buf[i + 1] == 'i' || buf[i + 1] == 'l'))
+        return NO;
+      g = [fi glyphForCharacter: ch];
+      if (g == NSNullGlyph)
+        return NO;
+      width += [screenFont advancementForGlyph: g].width;
+    }
+
+  height = [screenFont ascender] - [screenFont descender];
+  if ((options & NSStringDrawingUsesFontLeading)
+      && [screenFont defaultLineHeightForFont] > height)
+    height = [screenFont defaultLineHeightForFont];
+
+  sc->fast_hits++;
+  *result = NSMakeRect(0, 0, width, height);
+  return YES;
+}
+
+/* Returns the ellipsis to end a truncated line in the font of attributes
+   with, and its width.  */
+static CGFloat ellipsis_width(NSDictionary *attributes, BOOL useScreenFonts,
+  NSString **ellipsis)
+{
+  NSFont *font = [attributes objectForKey: NSFontAttributeName];
+  NSFont *screenFont = nil;
+  unichar ch = 0x2026;
+  NSGlyph g;
+
+  if (font == nil)
+    font = [NSFont userFontOfSize: 0];
+  if (useScreenFonts)
+    screenFont = [font screenFont];
+  if (screenFont == nil)
+    screenFont = font;
+
+  g = [[font fontInfo] glyphForCharacter: ch];
+  if (g != NSNullGlyph)
+    {
+      *ellipsis = [NSString stringWithCharacters: &ch length: 1];
+      return [screenFont advancementForGlyph: g].width;
+    }
+  *ellipsis = @"...";
+  g = [[font fontInfo] glyphForCharacter: '.'];
+  return 3 * [screenFont advancementForGlyph: g].width;
+}
+
+/*
+Returns the string laid out in c up to its last laid out line, with that
+line shortened so that it fits in width with an ellipsis at its end, or nil
+if everything but white space was laid out.  The lines before the last one
+are kept as they are, so laying out the result gives the same lines.
+*/
+static NSAttributedString *truncated_string(cache_t *c, CGFloat width,
+  BOOL useScreenFonts)
+{
+  NSLayoutManager *layoutManager = c->layoutManager;
+  NSTextStorage *textStorage = c->textStorage;
+  NSString *string = [textStorage string];
+  NSUInteger length = [string length];
+  NSUInteger laid = [layoutManager firstUnlaidCharacterIndex];
+  NSCharacterSet *space = [NSCharacterSet whitespaceAndNewlineCharacterSet];
+  NSRange glyphs, lineGlyphs, lineChars;
+  NSRect lineRect;
+  NSDictionary *attributes;
+  NSString *ellipsis;
+  NSMutableAttributedString *result;
+  NSAttributedString *tail;
+  CGFloat limit;
+  NSUInteger cut, g;
+
+  if (laid >= length
+      || [string rangeOfCharacterFromSet: [space invertedSet]
+                                 options: 0
+                                   range: NSMakeRange(laid, length - laid)]
+        .location == NSNotFound)
+    {
+      return nil;
+    }
+
+  glyphs = [layoutManager glyphRangeForTextContainer: c->textContainer];
+  if (glyphs.length == 0)
+    {
+      return nil;
+    }
+  lineRect = [layoutManager lineFragmentRectForGlyphAtIndex: NSMaxRange(glyphs) - 1
+                                             effectiveRange: &lineGlyphs];
+  lineChars = [layoutManager characterRangeForGlyphRange: lineGlyphs
+                                        actualGlyphRange: NULL];
+
+  attributes = [textStorage attributesAtIndex: NSMaxRange(lineChars) - 1
+                               effectiveRange: NULL];
+  limit = width - ellipsis_width(attributes, useScreenFonts, &ellipsis);
+
+  /* Keep as much of the line as ends before the ellipsis has to start. */
+  if (NSMaxX([layoutManager lineFragmentUsedRectForGlyphAtIndex:
+                              lineGlyphs.location
+                                                 effectiveRange: NULL])
+      <= limit)
+    {
+      cut = NSMaxRange(lineChars);
+    }
+  else
+    {
+      cut = lineChars.location;
+      for (g = NSMaxRange(lineGlyphs); g-- > lineGlyphs.location;)
+        {
+          if (NSMinX(lineRect) + [layoutManager locationForGlyphAtIndex: g].x
+              <= limit)
+            {
+              cut = [layoutManager characterIndexForGlyphAtIndex: g];
+              break;
+            }
+        }
+    }
+  while (cut > lineChars.location
+         && [space characterIsMember: [string characterAtIndex: cut - 1]])
+    {
+      cut--;
+    }
+
+  result = AUTORELEASE([[textStorage attributedSubstringFromRange:
+                                       NSMakeRange(0, cut)] mutableCopy]);
+  tail = [[NSAttributedString alloc] initWithString: ellipsis
+                                         attributes: attributes];
+  [result appendAttributedString: tail];
+  RELEASE(tail);
+  return result;
+}
+
+/*
+If the options ask for it and the string in c doesn't fit, looks up the
+string truncated at the last visible line instead.  Everything needed from
+c is taken before the lookup, which may reuse c.
+*/
+static cache_t *truncate_last_line(GSStringDrawingCache *sc, cache_t *c,
+  BOOL hasSize, NSSize size, BOOL useScreenFonts,
+  NSStringDrawingOptions options, NSUInteger maxLines)
+{
+  NSAttributedString *truncated;
+  CGFloat width = LARGE_SIZE;
+
+  if (!(options & NSStringDrawingTruncatesLastVisibleLine)
+      || !(options & NSStringDrawingUsesLineFragmentOrigin))
+    {
+      return c;
+    }
+  if (hasSize && size.width > 0)
+    {
+      width = size.width;
+    }
+  truncated = truncated_string(c, width, useScreenFonts);
+  if (truncated == nil)
+    {
+      return c;
+    }
+  prepare_attributed_string(sc, truncated);
+  return cache_lookup(sc, hasSize, size, useScreenFonts, options, maxLines);
+}
+
 static BOOL use_screen_fonts(void)
 {
   NSGraphicsContext		*ctxt = GSCurrentContext();
@@ -444,90 +759,90 @@ static void draw_in_rect(cache_t *c, NSRect rect)
 
 - (void) drawAtPoint: (NSPoint)point
 {
+  GSStringDrawingCache *sc = current_cache();
   cache_t *c;
 
-  cache_lock();
-  NS_DURING
-    {
-      prepare_attributed_string(self);
-      c = cache_lookup(NO, NSZeroSize, use_screen_fonts());
-
-      draw_at_point(c, point);
-    }
-  NS_HANDLER
-    {
-      cache_unlock();
-      [localException raise];
-    }
-  NS_ENDHANDLER;
-  cache_unlock();
+  prepare_attributed_string(sc, self);
+  c = cache_lookup(sc, NO, NSZeroSize, use_screen_fonts(),
+                   NSStringDrawingUsesFontLeading, 0);
+  draw_at_point(c, point);
 }
 
 - (void) drawInRect: (NSRect)rect
 {
   [self drawWithRect: rect
-             options: NSStringDrawingUsesLineFragmentOrigin];
+             options: NSStringDrawingUsesLineFragmentOrigin
+                      | NSStringDrawingUsesFontLeading];
 }
 
 - (void) drawWithRect: (NSRect)rect
               options: (NSStringDrawingOptions)options
 {
-  // FIXME: This ignores options
+  // FIXME: Without NSStringDrawingUsesLineFragmentOrigin, rect.origin
+  // should be the baseline of a single line.
+  GSStringDrawingCache *sc;
   cache_t *c;
+  BOOL useScreenFonts;
 
   if (rect.size.width <= 0 || rect.size.height <= 0)
     return;
-      
-  cache_lock();
-  NS_DURING
-    {
-      prepare_attributed_string(self);
-      c = cache_lookup(YES, rect.size, use_screen_fonts());
-      draw_in_rect(c, rect);
-    }
-  NS_HANDLER
-    {
-      cache_unlock();
-      [localException raise];
-    }
-  NS_ENDHANDLER;
-  cache_unlock();
+
+  sc = current_cache();
+  useScreenFonts = use_screen_fonts();
+  prepare_attributed_string(sc, self);
+  c = cache_lookup(sc, YES, rect.size, useScreenFonts, options, 0);
+  c = truncate_last_line(sc, c, YES, rect.size, useScreenFonts, options, 0);
+  draw_in_rect(c, rect);
 }
 
 - (NSSize) size
 {
   NSRect usedRect = [self boundingRectWithSize: NSZeroSize
-                                       options: NSStringDrawingUsesLineFragmentOrigin];
+                                       options: NSStringDrawingUsesLineFragmentOrigin
+                                                | NSStringDrawingUsesFontLeading];
   return usedRect.size;
 }
 
 - (NSRect) boundingRectWithSize: (NSSize)size
                         options: (NSStringDrawingOptions)options
 {
-  // FIXME: This ignores options
+  return [self boundingRectWithSize: size
+                            options: options
+               maximumNumberOfLines: 0];
+}
+
+- (NSRect) boundingRectWithSize: (NSSize)size
+                        options: (NSStringDrawingOptions)options
+           maximumNumberOfLines: (NSUInteger)lines
+{
+  // FIXME: Without NSStringDrawingUsesLineFragmentOrigin, the rect should
+  // be relative to the baseline of a single line.
+  GSStringDrawingCache *sc = current_cache();
   cache_t *c;
   NSRect result = NSZeroRect;
   BOOL hasSize = !NSEqualSizes(NSZeroSize, size);
 
-  cache_lock();
-  NS_DURING
-    {    
-      prepare_attributed_string(self);
-      c = cache_lookup(hasSize, size, YES);
-      result = c->usedRect;
-      /* A paragraph head indent shifts the laid out glyphs to the right, so it
-         appears in the used rect origin.  AppKit does not fold that offset into
-         the rectangle reported by the convenience methods: the origin stays at
-         zero (the indent still moves the drawn glyphs, see draw_in_rect).  */
-      result.origin.x = 0.0;
-    }
-  NS_HANDLER
+  if (!hasSize && [self length] > 0)
     {
-      cache_unlock();
-      [localException raise];
+      NSRange r;
+      NSDictionary *attrs = [self attributesAtIndex: 0 effectiveRange: &r];
+
+      if (r.length == [self length]
+          && fast_path_size(sc, [self string], attrs, options, &result))
+        {
+          return result;
+        }
     }
-  NS_ENDHANDLER;
-  cache_unlock();
+
+  prepare_attributed_string(sc, self);
+  c = cache_lookup(sc, hasSize, size, YES, options, lines);
+  c = truncate_last_line(sc, c, hasSize, size, YES, options, lines);
+  result = c->usedRect;
+  /* A paragraph head indent shifts the laid out glyphs to the right, so it
+     appears in the used rect origin.  AppKit does not fold that offset into
+     the rectangle reported by the convenience methods: the origin stays at
+     zero (the indent still moves the drawn glyphs, see draw_in_rect).  */
+  result.origin.x = 0.0;
 
   return result;
 }
@@ -539,28 +854,20 @@ static void draw_in_rect(cache_t *c, NSRect rect)
 
 - (void) drawAtPoint: (NSPoint)point withAttributes: (NSDictionary *)attrs
 {
+  GSStringDrawingCache *sc = current_cache();
   cache_t *c;
 
-  cache_lock();
-  NS_DURING
-    {
-      prepare_string(self, attrs);
-      c = cache_lookup(NO, NSZeroSize, use_screen_fonts());
-      draw_at_point(c, point);
-    }
-  NS_HANDLER
-    {
-      cache_unlock();
-      [localException raise];
-    }
-  NS_ENDHANDLER;
-  cache_unlock();
+  prepare_string(sc, self, attrs);
+  c = cache_lookup(sc, NO, NSZeroSize, use_screen_fonts(),
+                   NSStringDrawingUsesFontLeading, 0);
+  draw_at_point(c, point);
 }
 
 - (void) drawInRect: (NSRect)rect withAttributes: (NSDictionary *)attrs
 {
   [self drawWithRect: rect
              options: NSStringDrawingUsesLineFragmentOrigin
+                      | NSStringDrawingUsesFontLeading
           attributes: attrs];
 }
 
@@ -568,32 +875,28 @@ static void draw_in_rect(cache_t *c, NSRect rect)
               options: (NSStringDrawingOptions)options
            attributes: (NSDictionary *)attrs
 {
-  // FIXME: This ignores options
+  // FIXME: Without NSStringDrawingUsesLineFragmentOrigin, rect.origin
+  // should be the baseline of a single line.
+  GSStringDrawingCache *sc;
   cache_t *c;
+  BOOL useScreenFonts;
 
   if (rect.size.width <= 0 || rect.size.height <= 0)
     return;
-  
-  cache_lock();
-  NS_DURING
-    {    
-      prepare_string(self, attrs);
-      c = cache_lookup(YES, rect.size, use_screen_fonts());
-      draw_in_rect(c, rect);
-    }
-  NS_HANDLER
-    {
-      cache_unlock();
-      [localException raise];
-    }
-  NS_ENDHANDLER;
-  cache_unlock();
+
+  sc = current_cache();
+  useScreenFonts = use_screen_fonts();
+  prepare_string(sc, self, attrs);
+  c = cache_lookup(sc, YES, rect.size, useScreenFonts, options, 0);
+  c = truncate_last_line(sc, c, YES, rect.size, useScreenFonts, options, 0);
+  draw_in_rect(c, rect);
 }
 
 - (NSSize) sizeWithAttributes: (NSDictionary *)attrs
 {
   NSRect usedRect = [self boundingRectWithSize: NSZeroSize
                                        options: NSStringDrawingUsesLineFragmentOrigin
+                                                | NSStringDrawingUsesFontLeading
                                     attributes: attrs];
   return usedRect.size;
 }
@@ -602,25 +905,33 @@ static void draw_in_rect(cache_t *c, NSRect rect)
                         options: (NSStringDrawingOptions)options
                      attributes: (NSDictionary *)attrs
 {
-  // FIXME: This ignores options
+  return [self boundingRectWithSize: size
+                            options: options
+                         attributes: attrs
+               maximumNumberOfLines: 0];
+}
+
+- (NSRect) boundingRectWithSize: (NSSize)size
+                        options: (NSStringDrawingOptions)options
+                     attributes: (NSDictionary *)attrs
+           maximumNumberOfLines: (NSUInteger)lines
+{
+  // FIXME: Without NSStringDrawingUsesLineFragmentOrigin, the rect should
+  // be relative to the baseline of a single line.
+  GSStringDrawingCache *sc = current_cache();
   cache_t *c;
   NSRect result = NSZeroRect;
   BOOL hasSize = !NSEqualSizes(NSZeroSize, size);
 
-  cache_lock();
-  NS_DURING
+  if (!hasSize && fast_path_size(sc, self, attrs, options, &result))
     {
-      prepare_string(self, attrs);
-      c = cache_lookup(hasSize, size, YES);
-      result = c->usedRect;
+      return result;
     }
-  NS_HANDLER
-    {
-      cache_unlock();
-      [localException raise];
-    }
-  NS_ENDHANDLER;
-  cache_unlock();
+
+  prepare_string(sc, self, attrs);
+  c = cache_lookup(sc, hasSize, size, YES, options, lines);
+  c = truncate_last_line(sc, c, hasSize, size, YES, options, lines);
+  result = c->usedRect;
 
   return result;
 }
@@ -628,6 +939,37 @@ static void draw_in_rect(cache_t *c, NSRect rect)
 @end
 
 
+void GSStringDrawingSetCacheSize(NSUInteger entries)
+{
+  cache_size = entries > 0 ? entries : NUM_CACHE_ENTRIES;
+}
+
+NSUInteger GSStringDrawingCacheSize(void)
+{
+  return desired_cache_size();
+}
+
+NSDictionary *GSStringDrawingCacheStatistics(void)
+{
+  GSStringDrawingCache *sc = current_cache();
+
+  return [NSDictionary dictionaryWithObjectsAndKeys:
+    [NSNumber numberWithUnsignedInteger: sc->total], STATS_TOTAL,
+    [NSNumber numberWithUnsignedInteger: sc->hits], STATS_HITS,
+    [NSNumber numberWithUnsignedInteger: sc->misses], STATS_MISSES,
+    [NSNumber numberWithUnsignedInteger: sc->hash_hits], STATS_HASH_HITS,
+    [NSNumber numberWithUnsignedInteger: sc->fast_hits], STATS_FAST_HITS,
+    nil];
+}
+
+void GSStringDrawingResetCacheStatistics(void)
+{
+  GSStringDrawingCache *sc = current_cache();
+
+  sc->total = sc->hits = sc->misses = sc->hash_hits = sc->fast_hits = 0;
+}
+
+
 /*
 Dummy function; see comment in NSApplication.m, +initialize.
 */
@@ -75,6 +75,8 @@
 
 @interface NSTableView (__NSTableColumnPrivate__)
 - (void) _registerPrototypeViews: (NSArray *)prototypeViews;
+- (BOOL) _noteRowsChanged: (NSKeyValueChange)kind
+		atIndexes: (NSIndexSet *)indexes;
 @end
 
 
@@ -791,4 +793,15 @@ to YES. */
       return [super valueForKey: aKey];
     }
 }
+
+- (BOOL) _updateBinding: (NSString *)binding
+		 change: (NSKeyValueChange)kind
+	      atIndexes: (NSIndexSet *)indexes
+{
+  if ([binding isEqual: NSValueBinding] && _tableView != nil)
+    {
+      return [_tableView _noteRowsChanged: kind atIndexes: indexes];
+    }
+  return NO;
+}
 @end
@@ -89,6 +89,69 @@ static NSInteger currentDropRow;
 static NSInteger lastQuarterPosition;
 static NSDragOperation currentDragOperation;
 
+/*
+ * Row height sums.  When the delegate gives the height of each row, the
+ * heights are kept in a Fenwick tree: sums[i] (for 1 <= i <= count) holds
+ * the sum of the heights of the rows i - (i & -i) to i - 1.  This finds
+ * the origin of a row, or the row at a position, in O(log n), and updates
+ * the height of a row in O(log n).
+ */
+
+/* Turns sums[i] = height of row i - 1 into the tree in O(n). */
+static void sums_build (CGFloat *sums, NSInteger count)
+{
+  NSInteger i, j;
+
+  for (i = 1; i <= count; i++)
+    {
+      j = i + (i & -i);
+      if (j <= count)
+	sums[j] += sums[i];
+    }
+}
+
+static void sums_add (CGFloat *sums, NSInteger count, NSInteger row,
+		      CGFloat delta)
+{
+  NSInteger i;
+
+  for (i = row + 1; i <= count; i += i & -i)
+    sums[i] += delta;
+}
+
+/* Returns the sum of the heights of the rows before row. */
+static CGFloat sums_prefix (CGFloat *sums, NSInteger count, NSInteger row)
+{
+  CGFloat sum = 0.0;
+  NSInteger i;
+
+  if (row > count)
+    row = count;
+  for (i = row; i > 0; i -= i & -i)
+    sum += sums[i];
+  return sum;
+}
+
+/* Returns the row whose rows before it are at most y high, ie. the row
+   at y, or count if y is below the last row. */
+static NSInteger sums_search (CGFloat *sums, NSInteger count, CGFloat y)
+{
+  NSInteger row = 0;
+  NSInteger step = 1;
+
+  while (step * 2 <= count)
+    step *= 2;
+  for (; step > 0; step /= 2)
+    {
+      if (row + step <= count && sums[row + step] <= y)
+	{
+	  row += step;
+	  y -= sums[row];
+	}
+    }
+  return row;
+}
+
 /*
  * Nib compatibility struct.  This structure is used to
  * pull the attributes out of the nib that we need to fill
@@ -163,7 +226,16 @@ typedef struct _tableViewFlags
 - (BOOL) _isCellEditableColumn: (NSInteger)columnIndex
 			   row: (NSInteger)rowIndex;
 - (NSInteger) _numRows;
+- (BOOL) _noteRowsChanged: (NSKeyValueChange)kind
+		atIndexes: (NSIndexSet *)indexes;
 - (BOOL) _usesVariableRowHeights;
+- (CGFloat) _delegateHeightOfRow: (NSInteger)rowIndex;
+- (void) _noteRowHeightsChanged;
+- (void) _noteRowHeightsOfRowsAtIndexes: (NSIndexSet *)indexes
+			       inserted: (BOOL)inserted;
+- (void) _updateNumberOfRows;
+- (void) _buildRowHeightSums;
+- (void) _validateRowHeights;
 - (CGFloat) _rowHeightForRow: (NSInteger)rowIndex;
 - (CGFloat) _rowsHeight;
 - (CGFloat) _yOriginForRow: (NSInteger)rowIndex;
@@ -175,6 +247,11 @@ typedef struct _tableViewFlags
 - (NSView*)  _renderedViewForPath: (NSIndexPath*)path;
 - (void) _setRenderedView: (NSView*)view forPath: (NSIndexPath*)path;
 - (void) _layoutViewBasedRows;
+- (NSView *) _dequeueViewWithIdentifier: (NSUserInterfaceItemIdentifier)identifier;
+- (void) _enqueueView: (NSView *)view  limit: (NSUInteger)limit;
+- (void) _recycleRowsOutsideRange: (NSRange)rows;
+- (void) _recycleViewsOutsideRect: (NSRect)rect;
+- (void) _clipViewBoundsChanged: (NSNotification *)aNotification;
 @end
 
 @interface NSTableView (SelectionHelper)
@@ -2078,6 +2155,8 @@ static void computeNewSelection
   _registeredNibs = nil;
   _registeredViews = nil;
   _rowViews = nil;
+  _reuseQueues = nil;
+  _reusableRowViews = nil;
   _dataSource_editable = YES;
 }
 
@@ -2122,6 +2201,9 @@ static void computeNewSelection
       [nc removeObserver: _delegate  name: nil  object: self];
       _delegate = nil;
     }
+  [nc removeObserver: self
+		name: NSViewBoundsDidChangeNotification
+	      object: nil];
 
   RELEASE (_gridColor);
   RELEASE (_backgroundColor);
@@ -2134,6 +2216,8 @@ static void computeNewSelection
   RELEASE (_registeredNibs);
   RELEASE (_registeredViews);
   RELEASE (_rowViews);
+  RELEASE (_reuseQueues);
+  RELEASE (_reusableRowViews);
   TEST_RELEASE (_headerView);
   TEST_RELEASE (_cornerView);
 
@@ -2142,6 +2226,11 @@ static void computeNewSelection
     {
       NSZoneFree (NSDefaultMallocZone (), _columnOrigins);
     }
+  if (_rowHeights != NULL)
+    {
+      NSZoneFree (NSDefaultMallocZone (), _rowHeights);
+      NSZoneFree (NSDefaultMallocZone (), _rowHeightSums);
+    }
 
   [super dealloc];
 }
@@ -2442,6 +2531,8 @@ static void computeNewSelection
   /* We do *not* retain the dataSource, it's like a delegate */
   _dataSource = anObject;
 
+  /* The rows of another data source have other heights. */
+  [self _noteRowHeightsChanged];
   [self tile];
   [self reloadData];
 }
@@ -2454,11 +2545,16 @@ static void computeNewSelection
 {
   if (_viewBased)
     {
-      // Remove all existing row views from the table view
-      NSArray *subviews = [[self subviews] copy];
-      NSEnumerator *enumerator = [subviews objectEnumerator];
+      // Keep the views of all rows for reuse, then remove any other
+      // row views from the table view
+      NSArray *subviews;
+      NSEnumerator *enumerator;
       NSView *subview;
-      
+
+      [self _recycleRowsOutsideRange: NSMakeRange(0, 0)];
+      subviews = [[self subviews] copy];
+      enumerator = [subviews objectEnumerator];
+
       while ((subview = [enumerator nextObject]) != nil)
         {
           if ([subview isKindOfClass: [NSTableRowView class]])
@@ -2667,6 +2763,7 @@ static void computeNewSelection
 - (void) setRowHeight: (CGFloat)rowHeight
 {
   _rowHeight = rowHeight;
+  [self _noteRowHeightsChanged];
   [self tile];
 }
 
@@ -4709,10 +4806,38 @@ This method is deprecated, use -columnIndexesInRect:. */
 - (void) viewWillMoveToSuperview:(NSView *)newSuper
 {
   [super viewWillMoveToSuperview: newSuper];
+  if ([_super_view isKindOfClass: [NSClipView class]])
+    {
+      [nc removeObserver: self
+		    name: NSViewBoundsDidChangeNotification
+		  object: _super_view];
+    }
   /* need to potentially enlarge to fill the documentRect of the clip view */
   [self setFrame: _frame];
 }
 
+- (void) viewDidMoveToSuperview
+{
+  [super viewDidMoveToSuperview];
+
+  /* Recycle the views of the rows scrolled out of sight. */
+  if ([_super_view isKindOfClass: [NSClipView class]])
+    {
+      [nc addObserver: self
+	     selector: @selector(_clipViewBoundsChanged:)
+		 name: NSViewBoundsDidChangeNotification
+	       object: _super_view];
+    }
+}
+
+- (void) _clipViewBoundsChanged: (NSNotification *)aNotification
+{
+  if (_viewBased)
+    {
+      [self _recycleViewsOutsideRect: [self visibleRect]];
+    }
+}
+
 - (void) sizeToFit
 {
   NSTableColumn *tb;
@@ -4921,6 +5046,17 @@ This method is deprecated, use -columnIndexesInRect:. */
 }
 
 - (void) noteNumberOfRowsChanged
+{
+  /* The data source may have changed any row, so all heights are asked
+     for again. */
+  [self _noteRowHeightsChanged];
+  [self _updateNumberOfRows];
+}
+
+/* Takes the new number of rows into account.  The heights of the rows
+   are kept, callers which know which rows were inserted or removed note
+   that with -_noteRowHeightsOfRowsAtIndexes:inserted: first. */
+- (void) _updateNumberOfRows
 {
   NSRect newFrame;
 
@@ -5065,6 +5201,7 @@ This method is deprecated, use -columnIndexesInRect:. */
 
   if (_viewBased)
     {
+      [self _recycleViewsOutsideRect: [self visibleRect]];
       [self _layoutViewBasedRows];
     }
 }
@@ -5210,7 +5347,27 @@ This method is deprecated, use -columnIndexesInRect:. */
 
 - (void) noteHeightOfRowsWithIndexesChanged: (NSIndexSet*)indexes
 {
-  // FIXME
+  if (_rowHeightsValid && [self _usesVariableRowHeights])
+    {
+      NSUInteger row;
+
+      /* Only ask for the heights of these rows again. */
+      [self _validateRowHeights];
+      for (row = [indexes firstIndex];
+	   row != NSNotFound && row < (NSUInteger)_rowHeightsCount;
+	   row = [indexes indexGreaterThanIndex: row])
+	{
+	  CGFloat height = [self _delegateHeightOfRow: row];
+
+	  if (height != _rowHeights[row])
+	    {
+	      sums_add (_rowHeightSums, _rowHeightsCount, row,
+			height - _rowHeights[row]);
+	      _rowHeights[row] = height;
+	    }
+	}
+    }
+  [self tile];
 }
 
 - (void) drawGridInClipRect: (NSRect)aRect
@@ -5498,6 +5655,7 @@ This method is deprecated, use -columnIndexesInRect:. */
 
   /* Cache */
   _del_responds = [_delegate respondsToSelector: sel];
+  [self _noteRowHeightsChanged];
 
   /* Preserve the table's configured mode.  Legacy cell-based tables may have
      delegates which respond to view-based selectors for other purposes; that
@@ -6564,36 +6722,26 @@ view to drag. */
 
 - (NSInteger) _computedRowAtPoint: (NSPoint)p
 {
-	if ([self _usesVariableRowHeights] == NO)
-		{
-			return (NSInteger)(p.y - _bounds.origin.y) / (NSInteger)_rowHeight;
-		}
+  CGFloat y;
 
-	if (_numberOfRows <= 0)
-		{
-			return 0;
-		}
-
-	CGFloat y = p.y - _bounds.origin.y;
-	if (y <= 0.0)
-		{
-			return 0;
-		}
+  if ([self _usesVariableRowHeights] == NO)
+    {
+      return (NSInteger)(p.y - _bounds.origin.y) / (NSInteger)_rowHeight;
+    }
 
-	CGFloat currentY = 0.0;
-	NSInteger rowIndex;
+  if (_numberOfRows <= 0)
+    {
+      return 0;
+    }
 
-	for (rowIndex = 0; rowIndex < _numberOfRows; rowIndex++)
-		{
-			CGFloat height = [self _rowHeightForRow: rowIndex];
-			if (y < currentY + height)
-				{
-					return rowIndex;
-				}
-			currentY += height;
-		}
+  y = p.y - _bounds.origin.y;
+  if (y <= 0.0)
+    {
+      return 0;
+    }
 
-	return _numberOfRows;
+  [self _validateRowHeights];
+  return sums_search (_rowHeightSums, _rowHeightsCount, y);
 }
 
 - (void) _setDropOperationAndRow: (NSInteger)row
@@ -7084,112 +7232,277 @@ For a more detailed explanation, -setSortDescriptors:. */
     }
 }
 
+/* Called when bound content changed at indexes only.  Rows above the first
+ * index keep their place, so only the rows from there on are redisplayed.
+ * Returns NO when the table has to be reloaded instead.
+ */
+- (BOOL) _noteRowsChanged: (NSKeyValueChange)kind
+		atIndexes: (NSIndexSet *)indexes
+{
+  NSUInteger first = [indexes firstIndex];
+  NSRect rect;
+
+  if (_viewBased || first == NSNotFound)
+    {
+      return NO;
+    }
+
+  if (kind == NSKeyValueChangeReplacement)
+    {
+      NSUInteger row;
+
+      for (row = first; row != NSNotFound;
+	row = [indexes indexGreaterThanIndex: row])
+	{
+	  [self setNeedsDisplayInRect: [self rectOfRow: row]];
+	}
+      return YES;
+    }
+
+  if (kind == NSKeyValueChangeInsertion || kind == NSKeyValueChangeRemoval)
+    {
+      [self _noteRowHeightsOfRowsAtIndexes: indexes
+				  inserted: kind == NSKeyValueChangeInsertion];
+    }
+  [self _updateNumberOfRows];
+  rect = _bounds;
+  rect.origin.y = [self _yOriginForRow: MIN((NSInteger)first, _numberOfRows)];
+  rect.size.height = NSMaxY(_bounds) - NSMinY(rect);
+  if (rect.size.height > 0)
+    {
+      [self setNeedsDisplayInRect: rect];
+    }
+  return YES;
+}
+
 - (BOOL) _usesVariableRowHeights
 {
-	return NO;
+  return [_delegate respondsToSelector: @selector(tableView:heightOfRow:)];
 }
 
-- (CGFloat) _rowHeightForRow: (NSInteger)rowIndex
+- (CGFloat) _delegateHeightOfRow: (NSInteger)rowIndex
 {
-	return _rowHeight;
+  CGFloat height = [_delegate tableView: self heightOfRow: rowIndex];
+
+  if (height > 0.0)
+    {
+      return height;
+    }
+  return _rowHeight;
 }
 
-- (CGFloat) _rowsHeight
+/* Makes the heights of all rows be asked for again when they are next
+   needed. */
+- (void) _noteRowHeightsChanged
 {
-	if ([self _usesVariableRowHeights] == NO)
-		{
-			return _numberOfRows * _rowHeight;
-		}
+  _rowHeightsValid = NO;
+}
 
-	if (_numberOfRows <= 0)
-		{
-			return 0.0;
-		}
+/* Notes that the rows at indexes were inserted (or removed), so that the
+   other rows keep their heights.  Only the inserted rows are asked for
+   their heights. */
+- (void) _noteRowHeightsOfRowsAtIndexes: (NSIndexSet *)indexes
+			       inserted: (BOOL)inserted
+{
+  NSInteger count = _rowHeightsCount;
+  NSInteger n = [indexes count];
+  NSInteger i, j;
+  NSUInteger row;
+  CGFloat *heights;
 
-	CGFloat totalHeight = 0.0;
-	NSInteger i;
+  if (_rowHeightsValid == NO || n == 0)
+    {
+      return;
+    }
+  if (inserted)
+    {
+      count += n;
+    }
+  else
+    {
+      count -= n;
+    }
+  if (count < 0
+      || (NSInteger)[indexes lastIndex] >= (inserted ? count : _rowHeightsCount))
+    {
+      _rowHeightsValid = NO;
+      return;
+    }
 
-	for (i = 0; i < _numberOfRows; i++)
-		{
-			totalHeight += [self _rowHeightForRow: i];
-		}
+  heights = NSZoneMalloc (NSDefaultMallocZone (),
+			  sizeof (CGFloat) * (count + 1));
+  if (inserted)
+    {
+      for (i = j = 0; i < count; i++)
+	{
+	  if ([indexes containsIndex: i])
+	    heights[i] = _rowHeight;
+	  else
+	    heights[i] = _rowHeights[j++];
+	}
+    }
+  else
+    {
+      for (i = j = 0; i < _rowHeightsCount; i++)
+	{
+	  if (![indexes containsIndex: i])
+	    heights[j++] = _rowHeights[i];
+	}
+    }
+  NSZoneFree (NSDefaultMallocZone (), _rowHeights);
+  _rowHeights = heights;
+  _rowHeightsCount = count;
+  _rowHeightSums = NSZoneRealloc (NSDefaultMallocZone (), _rowHeightSums,
+				  sizeof (CGFloat) * (count + 1));
+  [self _buildRowHeightSums];
 
-	return totalHeight;
+  if (inserted)
+    {
+      for (row = [indexes firstIndex]; row != NSNotFound;
+	   row = [indexes indexGreaterThanIndex: row])
+	{
+	  CGFloat height = [self _delegateHeightOfRow: row];
+
+	  if (height != _rowHeights[row])
+	    {
+	      sums_add (_rowHeightSums, _rowHeightsCount, row,
+			height - _rowHeights[row]);
+	      _rowHeights[row] = height;
+	    }
+	}
+    }
 }
 
-- (CGFloat) _yOriginForRow: (NSInteger)rowIndex
+/* Builds the sums of the heights in O(n), without asking the delegate. */
+- (void) _buildRowHeightSums
 {
-	if (rowIndex <= 0)
-		{
-			return _bounds.origin.y;
-		}
+  NSInteger i;
 
-	if ([self _usesVariableRowHeights] == NO)
-		{
-			return _bounds.origin.y + (_rowHeight * rowIndex);
-		}
+  _rowHeightSums[0] = 0.0;
+  for (i = 0; i < _rowHeightsCount; i++)
+    {
+      _rowHeightSums[i + 1] = _rowHeights[i];
+    }
+  sums_build (_rowHeightSums, _rowHeightsCount);
+}
 
-	CGFloat y = _bounds.origin.y;
-	NSInteger i;
+/* Asks the delegate for the height of each row if the heights aren't known,
+   and builds the sums of the heights. */
+- (void) _validateRowHeights
+{
+  NSInteger count = (_numberOfRows > 0) ? _numberOfRows : 0;
+  NSInteger i;
 
-	for (i = 0; i < rowIndex && i < _numberOfRows; i++)
-		{
-			y += [self _rowHeightForRow: i];
-		}
+  if (_rowHeightsValid && _rowHeightsCount == count)
+    {
+      return;
+    }
 
-	return y;
+  _rowHeightsCount = count;
+  _rowHeights = NSZoneRealloc (NSDefaultMallocZone (), _rowHeights,
+			       sizeof (CGFloat) * (count + 1));
+  _rowHeightSums = NSZoneRealloc (NSDefaultMallocZone (), _rowHeightSums,
+				  sizeof (CGFloat) * (count + 1));
+  for (i = 0; i < count; i++)
+    {
+      _rowHeights[i] = [self _delegateHeightOfRow: i];
+    }
+  [self _buildRowHeightSums];
+  _rowHeightsValid = YES;
+}
+
+- (CGFloat) _rowHeightForRow: (NSInteger)rowIndex
+{
+  if (rowIndex < 0 || rowIndex >= _numberOfRows
+      || [self _usesVariableRowHeights] == NO)
+    {
+      return _rowHeight;
+    }
+
+  [self _validateRowHeights];
+  return _rowHeights[rowIndex];
+}
+
+- (CGFloat) _rowsHeight
+{
+  if ([self _usesVariableRowHeights] == NO)
+    {
+      return _numberOfRows * _rowHeight;
+    }
+
+  if (_numberOfRows <= 0)
+    {
+      return 0.0;
+    }
+
+  [self _validateRowHeights];
+  return sums_prefix (_rowHeightSums, _rowHeightsCount, _rowHeightsCount);
+}
+
+- (CGFloat) _yOriginForRow: (NSInteger)rowIndex
+{
+  if (rowIndex <= 0)
+    {
+      return _bounds.origin.y;
+    }
+
+  if ([self _usesVariableRowHeights] == NO)
+    {
+      return _bounds.origin.y + (_rowHeight * rowIndex);
+    }
+
+  [self _validateRowHeights];
+  return _bounds.origin.y
+    + sums_prefix (_rowHeightSums, _rowHeightsCount, rowIndex);
 }
 
 - (NSInteger) _rowAtPointUsingVariableHeights: (NSPoint)aPoint
 {
-	if ((NSMouseInRect (aPoint, _bounds, YES)) == NO)
-		{
-			return -1;
-		}
+  CGFloat y;
+  NSInteger row;
 
-	if (_numberOfRows <= 0)
-		{
-			return -1;
-		}
+  if ((NSMouseInRect (aPoint, _bounds, YES)) == NO)
+    {
+      return -1;
+    }
 
-	if ([self _usesVariableRowHeights] == NO)
-		{
-			if (_rowHeight == 0.0)
-				{
-					return -1;
-				}
+  if (_numberOfRows <= 0)
+    {
+      return -1;
+    }
 
-			aPoint.y -= _bounds.origin.y;
-			NSInteger row = (NSInteger)(aPoint.y / _rowHeight);
+  if ([self _usesVariableRowHeights] == NO)
+    {
+      if (_rowHeight == 0.0)
+	{
+	  return -1;
+	}
 
-			if (row >= _numberOfRows)
-				{
-					return -1;
-				}
+      aPoint.y -= _bounds.origin.y;
+      row = (NSInteger)(aPoint.y / _rowHeight);
 
-			return row;
-		}
+      if (row >= _numberOfRows)
+	{
+	  return -1;
+	}
 
-	CGFloat y = aPoint.y - _bounds.origin.y;
-	if (y < 0.0)
-		{
-			return -1;
-		}
+      return row;
+    }
 
-	CGFloat currentY = 0.0;
-	NSInteger rowIndex;
+  y = aPoint.y - _bounds.origin.y;
+  if (y < 0.0)
+    {
+      return -1;
+    }
 
-	for (rowIndex = 0; rowIndex < _numberOfRows; rowIndex++)
-		{
-			CGFloat height = [self _rowHeightForRow: rowIndex];
-			if (y < currentY + height)
-				{
-					return rowIndex;
-				}
-			currentY += height;
-		}
+  [self _validateRowHeights];
+  row = sums_search (_rowHeightSums, _rowHeightsCount, y);
+  if (row >= _numberOfRows)
+    {
+      return -1;
+    }
 
-	return -1;
+  return row;
 }
 
 - (CGFloat) _positionInRowAtPoint: (NSPoint)aPoint
@@ -7278,11 +7591,17 @@ For a more detailed explanation, -setSortDescriptors:. */
 
 - (NSView *) makeViewWithIdentifier: (NSUserInterfaceItemIdentifier)identifier owner: (id)owner
 {
-  NSView *view = [_registeredViews objectForKey: identifier];
+  NSView *view = [self _dequeueViewWithIdentifier: identifier];
+
+  if (view != nil)
+    {
+      return view;
+    }
 
+  view = [_registeredViews objectForKey: identifier];
   if (view != nil)
     {
-      view = [view copy];
+      view = AUTORELEASE([view copy]);
       [view awakeFromNib];
       [owner awakeFromNib];
     }
@@ -7316,6 +7635,12 @@ For a more detailed explanation, -setSortDescriptors:. */
 	}
     }
 
+  /* So that the view is kept for reuse once it is scrolled away. */
+  if (view != nil && [view identifier] == nil)
+    {
+      [view setIdentifier: identifier];
+    }
+
   return view;
 }
 
@@ -7328,7 +7653,16 @@ For a more detailed explanation, -setSortDescriptors:. */
   if ([protoCellViews count] > 0)
     {
       view = [protoCellViews objectAtIndex: 0];
-      view = [view copy]; // instantiate the prototype...
+      if ([view identifier] != nil)
+	{
+	  id reused = [self _dequeueViewWithIdentifier: [view identifier]];
+
+	  if (reused != nil)
+	    {
+	      return reused;
+	    }
+	}
+      view = AUTORELEASE([view copy]); // instantiate the prototype...
     }
 
   return view;
@@ -7350,6 +7684,15 @@ For a more detailed explanation, -setSortDescriptors:. */
 	    {
 	      rv = [_delegate tableView: self rowViewForRow: row];
 	    }
+	  if (rv == nil && [_reusableRowViews count] > 0)
+	    {
+	      rv = AUTORELEASE(RETAIN([_reusableRowViews lastObject]));
+	      [_reusableRowViews removeLastObject];
+	      if ([rv respondsToSelector: @selector(prepareForReuse)])
+		{
+		  [rv prepareForReuse];
+		}
+	    }
 	  if (rv == nil)
 	    {
 	      rv = AUTORELEASE([[NSTableRowView alloc] init]);
@@ -7516,6 +7859,155 @@ For a more detailed explanation, -setSortDescriptors:. */
   [_pathsToViews setObject: path forKey: view];
 }
 
+/* Returns a view kept for reuse with identifier, or nil. */
+- (NSView *) _dequeueViewWithIdentifier: (NSUserInterfaceItemIdentifier)identifier
+{
+  NSMutableArray *queue;
+  NSView *view;
+
+  if (identifier == nil)
+    {
+      return nil;
+    }
+  queue = [_reuseQueues objectForKey: identifier];
+  if ([queue count] == 0)
+    {
+      return nil;
+    }
+  view = AUTORELEASE(RETAIN([queue lastObject]));
+  [queue removeLastObject];
+  if ([view respondsToSelector: @selector(prepareForReuse)])
+    {
+      [view prepareForReuse];
+    }
+  return view;
+}
+
+/* Keeps a view that is no longer shown for reuse by
+   -makeViewWithIdentifier:owner:, unless limit views with its identifier
+   are kept already.  Views without an identifier can't be asked for again,
+   so they are let go.  */
+- (void) _enqueueView: (NSView *)view  limit: (NSUInteger)limit
+{
+  NSUserInterfaceItemIdentifier identifier = [view identifier];
+  NSMutableArray *queue;
+
+  if (identifier == nil)
+    {
+      return;
+    }
+  if (_reuseQueues == nil)
+    {
+      _reuseQueues = [[NSMutableDictionary alloc] init];
+    }
+  queue = [_reuseQueues objectForKey: identifier];
+  if (queue == nil)
+    {
+      queue = [[NSMutableArray alloc] init];
+      [_reuseQueues setObject: queue forKey: identifier];
+      RELEASE(queue);
+    }
+  if ([queue count] < limit)
+    {
+      [queue addObject: view];
+    }
+}
+
+/* Takes the row views of the rows outside the range, and their cell views,
+   out of the table and keeps them for reuse.  A row containing the first
+   responder stays, so that editing isn't interrupted.  No more views of
+   each kind are kept than there are rows in sight, as scrolling by a page
+   doesn't need more.  */
+- (void) _recycleRowsOutsideRange: (NSRange)rows
+{
+  NSResponder *firstResponder = [_window firstResponder];
+  NSUInteger limit = [self rowsInRect: [self visibleRect]].length + 1;
+  NSEnumerator *enumerator;
+  NSNumber *rowNumber;
+
+  enumerator = [[_rowViews allKeys] objectEnumerator];
+  while ((rowNumber = [enumerator nextObject]) != nil)
+    {
+      NSInteger row = [rowNumber integerValue];
+      NSTableRowView *rowView = [_rowViews objectForKey: rowNumber];
+      NSInteger column;
+
+      if (row >= 0 && NSLocationInRange(row, rows))
+	{
+	  continue;
+	}
+      if ([firstResponder isKindOfClass: [NSView class]]
+	  && [(NSView *)firstResponder isDescendantOf: rowView])
+	{
+	  continue;
+	}
+
+      RETAIN(rowView);
+      for (column = 0; column < _numberOfColumns; column++)
+	{
+	  NSIndexPath *path = [NSIndexPath indexPathForItem: column
+						 inSection: row];
+	  NSView *view = [self _renderedViewForPath: path];
+
+	  if (view != nil)
+	    {
+	      RETAIN(view);
+	      [_renderedViewPaths removeObjectForKey: path];
+	      [_pathsToViews removeObjectForKey: view];
+	      [view removeFromSuperview];
+	      [self _enqueueView: view  limit: limit];
+	      RELEASE(view);
+	    }
+	}
+      [_rowViews removeObjectForKey: rowNumber];
+      [rowView removeFromSuperview];
+      if ([_delegate respondsToSelector: @selector(tableView:rowViewForRow:)])
+	{
+	  [self _enqueueView: rowView  limit: limit];
+	}
+      else
+	{
+	  if (_reusableRowViews == nil)
+	    {
+	      _reusableRowViews = [[NSMutableArray alloc] init];
+	    }
+	  if ([_reusableRowViews count] < limit)
+	    {
+	      [_reusableRowViews addObject: rowView];
+	    }
+	}
+      RELEASE(rowView);
+    }
+}
+
+/* Recycles the views of the rows that are not in rect. */
+- (void) _recycleViewsOutsideRect: (NSRect)rect
+{
+  NSRange rows = NSMakeRange(0, 0);
+
+  if ([_rowViews count] == 0)
+    {
+      return;
+    }
+  if (_numberOfRows > 0 && NSIsEmptyRect(rect) == NO)
+    {
+      NSInteger first = [self rowAtPoint:
+	NSMakePoint(NSMinX(_bounds), NSMinY(rect))];
+      NSInteger last = [self rowAtPoint:
+	NSMakePoint(NSMinX(_bounds), NSMaxY(rect))];
+
+      if (first != -1)
+	{
+	  if (last == -1)
+	    {
+	      last = _numberOfRows - 1;
+	    }
+	  rows = NSMakeRange(first, last - first + 1);
+	}
+    }
+  [self _recycleRowsOutsideRange: rows];
+}
+
 - (void) _initViewBasedSupport
 {
   if (_renderedViewPaths == nil)
@@ -7728,4 +8220,15 @@ For a more detailed explanation, -setSortDescriptors:. */
     }
 }
 
+- (BOOL) _updateBinding: (NSString *)binding
+		 change: (NSKeyValueChange)kind
+	      atIndexes: (NSIndexSet *)indexes
+{
+  if ([binding isEqual: NSContentBinding])
+    {
+      return [self _noteRowsChanged: kind atIndexes: indexes];
+    }
+  return NO;
+}
+
 @end
@@ -109,6 +109,7 @@ use bounds rectangle instead of frame? */
   _containerRect.size = aSize;
   // Tests on Cocoa indicate the default value is 5.
   _lineFragmentPadding = 5.0; 
+  _maximumNumberOfLines = 0;
   _observingFrameChanges = NO;
   _widthTracksTextView = NO;
   _heightTracksTextView = NO;
@@ -352,6 +353,22 @@ framework intact.
   return _lineFragmentPadding;
 }
 
+- (void) setMaximumNumberOfLines: (NSUInteger)lines
+{
+  if (lines == _maximumNumberOfLines)
+    return;
+
+  _maximumNumberOfLines = lines;
+
+  if (_layoutManager)
+    [_layoutManager textContainerChangedGeometry: self];
+}
+
+- (NSUInteger) maximumNumberOfLines
+{
+  return _maximumNumberOfLines;
+}
+
 - (NSRect) lineFragmentRectForProposedRect: (NSRect)proposedRect
                             sweepDirection: (NSLineSweepDirection)sweepDir
                          movementDirection: (NSLineMovementDirection)moveDir
@@ -485,6 +502,11 @@ framework intact.
 	  // Mac OS X doesn't seem to save this flag
           _observingFrameChanges = _widthTracksTextView | _heightTracksTextView;
         }
+      if ([aDecoder containsValueForKey: @"NSMaximumNumberOfLines"])
+        {
+          _maximumNumberOfLines =
+            [aDecoder decodeIntegerForKey: @"NSMaximumNumberOfLines"];
+        }
 
       // decoding the manager adds this text container automatically...
       if ([aDecoder containsValueForKey: @"NSLayoutManager"])
@@ -513,6 +535,11 @@ framework intact.
       [coder encodeObject: _layoutManager forKey: @"NSLayoutManager"];
       [coder encodeFloat: size.width forKey: @"NSWidth"];
       [coder encodeInt: flags forKey: @"NSTCFlags"];
+      if (_maximumNumberOfLines != 0)
+        {
+          [coder encodeInteger: _maximumNumberOfLines
+                        forKey: @"NSMaximumNumberOfLines"];
+        }
     }
 }
 
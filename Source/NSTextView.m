@@ -136,6 +136,28 @@ a new internal method called from NSLayoutManager when text has changed.
 - (NSTextView *) bestTextViewForTextStorage: (NSTextStorage *)aTextStorage;
 @end
 
+/* Undoes a change made to several ranges at once.  The ranges are those
+ * of the new text, in ascending order, and the attributed strings are the
+ * text they replaced.
+ */
+@interface NSTextViewRangesUndoObject : NSTextViewUndoObject
+{
+  NSArray *ranges;
+  NSArray *strings;
+}
+- (id) initWithRanges: (NSArray *)someRanges
+    attributedStrings: (NSArray *)someStrings;
+@end
+
+
+@interface NSSpellChecker (GSBatchChecking)
+- (BOOL) _requestCheckingOfString: (NSString *)string
+		       atLocation: (NSUInteger)location
+	   inSpellDocumentWithTag: (int)tag
+			   target: (id)target
+			 selector: (SEL)selector;
+@end
+
 
 /*
 Interface for a bunch of internal methods that need to be cleaned up.
@@ -168,12 +190,20 @@ Interface for a bunch of internal methods that need to be cleaned up.
 - (void) _scheduleTextCheckingInVisibleRectIfNeeded;
 - (void) _textDidChange: (NSNotification*)notif;
 - (void) _textCheckingTimerFired: (NSTimer *)t;
+- (void) _spellingChecked: (NSDictionary *)result;
 
 /*
  * helper method for ruler view
  */
 - (void) _becomeRulerClient;
 - (void) _resignRulerClient;
+
+/*
+ * Replacing the text in many ranges at once
+ */
+- (BOOL) _shouldBeginEditing;
+- (void) _replaceCharactersInRanges: (NSArray *)ranges
+			withStrings: (NSArray *)strings;
 @end
 
 
@@ -2749,26 +2779,9 @@ TextDidEndEditing notification _without_ asking the delegate
 {
   BOOL result = YES;
 
-  if (_tf.is_editable == NO)
+  if ([self _shouldBeginEditing] == NO)
     return NO;
 
-  /*
-  We need to send the textShouldBeginEditing: /
-  textDidBeginEditingNotification only once.
-  */
-
-  if (BEGAN_EDITING == NO)
-    {
-      if (([_delegate respondsToSelector: @selector(textShouldBeginEditing:)])
-	  && ([_delegate textShouldBeginEditing: _notifObject] == NO))
-	return NO;
-      
-      SET_BEGAN_EDITING(YES);
-      
-      [notificationCenter postNotificationName: NSTextDidBeginEditingNotification
-	object: _notifObject];
-    }
-
   if (_tf.delegate_responds_to_should_change)
     {
       result = [_delegate textView: self
@@ -2864,15 +2877,82 @@ TextDidEndEditing notification _without_ asking the delegate
   return result;
 }
 
+/*
+The ranges must be in ascending order and must not overlap.  The delegate
+is asked once, with -textView:shouldChangeTextInRanges:replacementStrings:
+if it implements it, and the change is undone as a single action.
+*/
 - (BOOL) shouldChangeTextInRanges: (NSArray *)ranges
                replacementStrings: (NSArray *)strings
 {
-  // FIXME
-  NSRange range;
+  NSUInteger count = [ranges count];
+  NSUInteger i;
+  BOOL result = YES;
 
-  range = [(NSValue*)[ranges objectAtIndex: 0] rangeValue];
-  return [self shouldChangeTextInRange: range  
-               replacementString: [strings objectAtIndex: 0]];
+  if (count == 1)
+    {
+      return [self shouldChangeTextInRange: [[ranges objectAtIndex: 0]
+					      rangeValue]
+			 replacementString: [strings objectAtIndex: 0]];
+    }
+
+  if ([self _shouldBeginEditing] == NO)
+    return NO;
+
+  if ([_delegate respondsToSelector:
+    @selector(textView:shouldChangeTextInRanges:replacementStrings:)])
+    {
+      result = [_delegate textView: self
+	  shouldChangeTextInRanges: ranges
+		replacementStrings: strings];
+    }
+  else if (_tf.delegate_responds_to_should_change)
+    {
+      for (i = 0; i < count && result; i++)
+	{
+	  result = [_delegate textView: self
+	       shouldChangeTextInRange: [[ranges objectAtIndex: i] rangeValue]
+		     replacementString: [strings objectAtIndex: i]];
+	}
+    }
+
+  if (result && count > 0 && [self allowsUndo])
+    {
+      NSMutableArray *undoRanges;
+      NSMutableArray *undoStrings;
+      NSTextViewRangesUndoObject *undoObject;
+      NSInteger delta = 0;
+
+      DESTROY(_undoObject);
+      undoRanges = [[NSMutableArray alloc] initWithCapacity: count];
+      undoStrings = [[NSMutableArray alloc] initWithCapacity: count];
+      for (i = 0; i < count; i++)
+	{
+	  NSRange range = [[ranges objectAtIndex: i] rangeValue];
+	  NSUInteger length = range.length;
+
+	  if (strings != nil)
+	    {
+	      length = [[strings objectAtIndex: i] length];
+	    }
+	  [undoRanges addObject: [NSValue valueWithRange:
+	    NSMakeRange(range.location + delta, length)]];
+	  [undoStrings addObject:
+	    [self attributedSubstringFromRange: range]];
+	  delta += (NSInteger)length - (NSInteger)range.length;
+	}
+      undoObject = [[NSTextViewRangesUndoObject alloc]
+		     initWithRanges: undoRanges
+		  attributedStrings: undoStrings];
+      [[self undoManager] registerUndoWithTarget: _textStorage
+					selector: @selector(_undoTextChange:)
+					  object: undoObject];
+      RELEASE(undoObject);
+      RELEASE(undoStrings);
+      RELEASE(undoRanges);
+    }
+
+  return result;
 }
 
 /*
@@ -6486,13 +6566,53 @@ or add guards
  * Text checking
  */
 
+/* The number of characters, give or take a word, handed to the spell
+ * checker at a time.
+ */
+#define GSSpellCheckChunkSize 4096
+
 - (void) _checkTextInRange: (NSRange)aRange
 {
+  NSString *string = [self string];
+  NSUInteger length = [string length];
+  NSCharacterSet *boundary = [NSCharacterSet whitespaceAndNewlineCharacterSet];
+  NSSpellChecker *sp;
   NSRange longestRange;
-  id value = [_layoutManager temporaryAttribute: @"NSTextChecked" 
-			       atCharacterIndex: aRange.location
-			  longestEffectiveRange: &longestRange
-					inRange: aRange];
+  NSUInteger end;
+  id value;
+
+  /* Words never span white space, so widening the range to it keeps the
+   * words at either end whole.
+   */
+  if (aRange.location > 0)
+    {
+      NSRange r = [string rangeOfCharacterFromSet: boundary
+					  options: NSBackwardsSearch
+					    range: NSMakeRange(0, aRange.location)];
+
+      end = NSMaxRange(aRange);
+      aRange.location = (r.length == 0) ? 0 : NSMaxRange(r);
+      aRange.length = end - aRange.location;
+    }
+  if (NSMaxRange(aRange) < length)
+    {
+      NSRange r = [string rangeOfCharacterFromSet: boundary
+					  options: 0
+					    range: NSMakeRange(NSMaxRange(aRange),
+							       length - NSMaxRange(aRange))];
+
+      end = (r.length == 0) ? length : r.location;
+      aRange.length = end - aRange.location;
+    }
+  if (aRange.length == 0)
+    {
+      return;
+    }
+
+  value = [_layoutManager temporaryAttribute: @"NSTextChecked" 
+			    atCharacterIndex: aRange.location
+		       longestEffectiveRange: &longestRange
+				     inRange: aRange];
   longestRange = NSIntersectionRange(longestRange, aRange);
   
   if ([value boolValue] && NSEqualRanges(longestRange, aRange))
@@ -6500,62 +6620,106 @@ or add guards
       //NSLog(@"No need to check in range %@", NSStringFromRange(aRange));
       return;
     }
-  
-  // Check all of aRange
 
-  [_layoutManager removeTemporaryAttribute: NSSpellingStateAttributeName
-			 forCharacterRange: aRange];
-  
-  {
-    NSSpellChecker *sp = [NSSpellChecker sharedSpellChecker];
-    NSInteger start = 0;
-    int count;
-    // FIXME: doing the spellcheck on this substring could create false-positives
-    // if a word is split in half.. so the range should be expanded to the 
-    // nearest word boundary
-    NSString *substring = [[self string] substringWithRange: aRange];
-    
-    if (sp == nil)
-      {
-        return;
-      }
+  sp = [NSSpellChecker sharedSpellChecker];
+  if (sp == nil)
+    {
+      return;
+    }
 
-    do {
-      NSRange errorRange = [sp checkSpellingOfString: substring
-					  startingAt: start
-					    language: [sp language]
-						wrap: YES
-			      inSpellDocumentWithTag: [self spellCheckerDocumentTag]
-					   wordCount: &count];
-      
-      if (errorRange.location < start)
+  /* Hand the text to the spell checker in chunks ending at white space.
+   * The misspelled words come back to -_spellingChecked: later, meanwhile
+   * the range counts as checked so that it is not asked for again.
+   */
+  end = NSMaxRange(aRange);
+  while (aRange.location < end)
+    {
+      NSRange chunk = NSMakeRange(aRange.location, end - aRange.location);
+
+      if (chunk.length > GSSpellCheckChunkSize)
 	{
-	  break;
+	  NSRange r = [string rangeOfCharacterFromSet: boundary
+					      options: 0
+						range: NSMakeRange(aRange.location
+								   + GSSpellCheckChunkSize,
+								   end - aRange.location
+								   - GSSpellCheckChunkSize)];
+
+	  if (r.length > 0)
+	    {
+	      chunk.length = NSMaxRange(r) - chunk.location;
+	    }
 	}
-      
-      if (errorRange.length > 0)
+
+      if (![sp _requestCheckingOfString: [string substringWithRange: chunk]
+			     atLocation: chunk.location
+		 inSpellDocumentWithTag: [self spellCheckerDocumentTag]
+				 target: self
+			       selector: @selector(_spellingChecked:)])
 	{
-	  start = NSMaxRange(errorRange);
+	  return;
 	}
-      else
+      [_layoutManager addTemporaryAttribute: @"NSTextChecked"
+				      value: [NSNumber numberWithBool: YES]
+			  forCharacterRange: chunk];
+      aRange.location = NSMaxRange(chunk);
+    }
+}
+
+/* Called on the main thread with the misspelled words found in a chunk of
+ * text.  If the text has changed since it was handed out the result is
+ * dropped and the chunk is checked again.
+ */
+- (void) _spellingChecked: (NSDictionary *)result
+{
+  NSString *checked = [result objectForKey: @"String"];
+  NSRange range = NSMakeRange([[result objectForKey: @"Location"]
+				unsignedIntegerValue], [checked length]);
+  NSString *string = [self string];
+  NSArray *ranges = [result objectForKey: @"Ranges"];
+  NSEnumerator *e;
+  NSValue *v;
+
+  if (_layoutManager == nil || !_tf.continuous_spell_checking)
+    {
+      return;
+    }
+  if (ranges == nil)
+    {
+      /* The check failed, leave the text to be checked again. */
+      range = NSIntersectionRange(range, NSMakeRange(0, [string length]));
+      if (range.length > 0)
 	{
-	  break;
+	  [_layoutManager removeTemporaryAttribute: @"NSTextChecked"
+				 forCharacterRange: range];
 	}
-      
-      errorRange = NSMakeRange(aRange.location + errorRange.location, errorRange.length);
-      
-      //NSLog(@"highlighting mistake: %@", [[self string] substringWithRange: errorRange]);
-      
+      return;
+    }
+  if (NSMaxRange(range) > [string length]
+    || ![checked isEqualToString: [string substringWithRange: range]])
+    {
+      range = NSIntersectionRange(range, NSMakeRange(0, [string length]));
+      if (range.length > 0)
+	{
+	  [_layoutManager removeTemporaryAttribute: @"NSTextChecked"
+				 forCharacterRange: range];
+	}
+      [self _scheduleTextCheckingTimer];
+      return;
+    }
+
+  [_layoutManager removeTemporaryAttribute: NSSpellingStateAttributeName
+			 forCharacterRange: range];
+  e = [ranges objectEnumerator];
+  while ((v = [e nextObject]) != nil)
+    {
+      NSRange errorRange = [v rangeValue];
+
+      errorRange.location += range.location;
       [_layoutManager addTemporaryAttribute: NSSpellingStateAttributeName
 				      value: [NSNumber numberWithInteger: NSSpellingStateSpellingFlag]
 			  forCharacterRange: errorRange];
-      
-    } while (1);
-    
-    [_layoutManager addTemporaryAttribute: @"NSTextChecked"
-				    value: [NSNumber numberWithBool: YES]
-			forCharacterRange: aRange];
-  }
+    }
 }
 
 - (void) _textCheckingTimerFired: (NSTimer *)t
@@ -6707,6 +6871,130 @@ or add guards
     }
 }
 
+
+- (BOOL) _shouldBeginEditing
+{
+  if (_tf.is_editable == NO)
+    return NO;
+
+  /*
+  We need to send the textShouldBeginEditing: /
+  textDidBeginEditingNotification only once.
+  */
+
+  if (BEGAN_EDITING == NO)
+    {
+      if (([_delegate respondsToSelector: @selector(textShouldBeginEditing:)])
+	  && ([_delegate textShouldBeginEditing: _notifObject] == NO))
+	return NO;
+      
+      SET_BEGAN_EDITING(YES);
+      
+      [notificationCenter postNotificationName: NSTextDidBeginEditingNotification
+	object: _notifObject];
+    }
+  return YES;
+}
+
+/*
+Replaces the text in each of the ranges, which are in ascending order, with
+the string at the same index.  The strings may be attributed; plain strings
+take the attributes of the text they replace.  The text from the start of
+the first range to the end of the last is built up once and put into the
+text storage in a single edit, so the layout is invalidated only once
+however many ranges there are.  Callers are responsible for
+-shouldChangeTextInRanges:replacementStrings: and -didChangeText.
+*/
+- (void) _replaceCharactersInRanges: (NSArray *)ranges
+			withStrings: (NSArray *)strings
+{
+  NSUInteger count = [ranges count];
+  NSUInteger i;
+  NSUInteger pos;
+  NSRange span;
+  BOOL plain = !_tf.is_rich_text;
+  NSString *text = [_textStorage string];
+
+  if (count == 0)
+    return;
+
+  span = [[ranges objectAtIndex: 0] rangeValue];
+  span.length = NSMaxRange([[ranges objectAtIndex: count - 1] rangeValue])
+    - span.location;
+  for (i = 0; i < count && plain; i++)
+    {
+      plain = ![[strings objectAtIndex: i] isKindOfClass:
+		  [NSAttributedString class]];
+    }
+
+  [_textStorage beginEditing];
+  if (plain)
+    {
+      NSMutableString *s = [[NSMutableString alloc] init];
+
+      pos = span.location;
+      for (i = 0; i < count; i++)
+	{
+	  NSRange r = [[ranges objectAtIndex: i] rangeValue];
+
+	  if (r.location > pos)
+	    {
+	      [s appendString: [text substringWithRange:
+		NSMakeRange(pos, r.location - pos)]];
+	    }
+	  [s appendString: [strings objectAtIndex: i]];
+	  pos = NSMaxRange(r);
+	}
+      [_textStorage replaceCharactersInRange: span withString: s];
+      RELEASE(s);
+    }
+  else
+    {
+      NSMutableAttributedString *s = [[NSMutableAttributedString alloc] init];
+
+      [s beginEditing];
+      pos = span.location;
+      for (i = 0; i < count; i++)
+	{
+	  NSRange r = [[ranges objectAtIndex: i] rangeValue];
+	  id string = [strings objectAtIndex: i];
+
+	  if (r.location > pos)
+	    {
+	      [s appendAttributedString: [_textStorage
+		attributedSubstringFromRange:
+		  NSMakeRange(pos, r.location - pos)]];
+	    }
+	  if ([string isKindOfClass: [NSAttributedString class]])
+	    {
+	      [s appendAttributedString: string];
+	    }
+	  else if ([string length] > 0)
+	    {
+	      NSDictionary *attributes;
+	      NSAttributedString *as;
+
+	      if (r.length > 0)
+		attributes = [_textStorage attributesAtIndex: r.location
+					      effectiveRange: NULL];
+	      else if (r.location > 0)
+		attributes = [_textStorage attributesAtIndex: r.location - 1
+					      effectiveRange: NULL];
+	      else
+		attributes = [self typingAttributes];
+	      as = [[NSAttributedString alloc] initWithString: string
+						   attributes: attributes];
+	      [s appendAttributedString: as];
+	      RELEASE(as);
+	    }
+	  pos = NSMaxRange(r);
+	}
+      [s endEditing];
+      [_textStorage replaceCharactersInRange: span withAttributedString: s];
+      RELEASE(s);
+    }
+  [_textStorage endEditing];
+}
 @end
 
 @implementation NSTextViewUndoObject
@@ -6815,6 +7103,58 @@ or add guards
 
 @end
 
+@implementation NSTextViewRangesUndoObject
+
+- (id) initWithRanges: (NSArray *)someRanges
+    attributedStrings: (NSArray *)someStrings
+{
+  NSRange first = [[someRanges objectAtIndex: 0] rangeValue];
+  NSRange last = [[someRanges lastObject] rangeValue];
+
+  if ((self = [super initWithRange: NSUnionRange(first, last)
+		  attributedString: nil]) != nil)
+    {
+      ranges = RETAIN(someRanges);
+      strings = RETAIN(someStrings);
+    }
+  return self;
+}
+
+- (void) dealloc
+{
+  RELEASE(ranges);
+  RELEASE(strings);
+  [super dealloc];
+}
+
+- (void) performUndo: (NSTextStorage *)aTextStorage
+{
+  NSTextView *tv = [self bestTextViewForTextStorage: aTextStorage];
+  NSMutableArray *plain;
+  NSUInteger count = [strings count];
+  NSUInteger i;
+
+  plain = [NSMutableArray arrayWithCapacity: count];
+  for (i = 0; i < count; i++)
+    {
+      [plain addObject: [[strings objectAtIndex: i] string]];
+    }
+  if ([tv shouldChangeTextInRanges: ranges replacementStrings: plain])
+    {
+      NSRange first = [[ranges objectAtIndex: 0] rangeValue];
+
+      [tv _replaceCharactersInRanges: ranges withStrings: strings];
+      first.length = [[strings objectAtIndex: 0] length];
+      if ([[tv undoManager] isUndoing])
+	[tv setSelectedRange: first];
+      else
+	[tv setSelectedRange: NSMakeRange(NSMaxRange(first), 0)];
+      [tv didChangeText];
+    }
+}
+
+@end
+
 @implementation NSTextStorage(NSTextViewUndoSupport)
 
 - (void) _undoTextChange: (NSTextViewUndoObject *)anObject
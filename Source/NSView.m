@@ -83,6 +83,7 @@
 #import "GSBindingHelpers.h"
 #import "GSFastEnumeration.h"
 #import "GSGuiPrivate.h"
+#import "GSRegion.h"
 #import "GSAutoLayoutEngine.h"
 #import "GSAutoLayoutAnchorPrivate.h"
 #import "NSAutoresizingMaskLayoutConstraint.h"
@@ -113,6 +114,11 @@
 */
 NSView *viewIsPrinting = nil;
 
+/* The part of the rect given to the next view displayed or focused which
+   is to be drawn, when it isn't all of it.  In the coordinates of that
+   view. */
+static const GSRegion *drawingRegion = NULL;
+
 const CGFloat NSViewNoInstrinsicMetric = -1;
 const CGFloat NSViewNoIntrinsicMetric = -1;
 
@@ -256,6 +262,7 @@ GSSetDragTypes(NSView* obj, NSArray *types)
       NSUInteger count;
 
       _coordinates_valid = NO;
+      [_window _invalidateTrackingIndex];
       if (_rFlags.valid_rects != 0)
         {
           [_window invalidateCursorRectsForView: self];
@@ -433,6 +440,8 @@ GSSetDragTypes(NSView* obj, NSArray *types)
   BOOL old_allocate_gstate;
 
   [self viewWillMoveToWindow: newWindow];
+  [_window _invalidateTrackingIndex];
+  [newWindow _invalidateTrackingIndex];
   if (_coordinates_valid)
     {
       (*invalidateImp)(self, invalidateSel);
@@ -799,6 +808,12 @@ GSSetDragTypes(NSView* obj, NSArray *types)
       _nextKeyView = 0;
     }
 
+  if (_invalidRegion != NULL)
+    {
+      NSZoneFree(NSDefaultMallocZone(), _invalidRegion);
+      _invalidRegion = NULL;
+    }
+
   /*
    * Now remove our subviews, AFTER cleaning up the view chain, in case
    * any of our subviews were in the chain.
@@ -2215,9 +2230,12 @@ static void autoresize(CGFloat oldContainerSize,
 
 - (void) _lockFocusInContext: (NSGraphicsContext *)ctxt inRect: (NSRect)rect
 {
+  const GSRegion *region = drawingRegion;
   NSRect wrect;
   NSInteger window_gstate = 0;
 
+  drawingRegion = NULL;
+
   if (viewIsPrinting == nil)
     {
       NSAssert(_window != nil, NSInternalInconsistencyException);
@@ -2256,7 +2274,29 @@ static void autoresize(CGFloat oldContainerSize,
 	      NSStringFromRect(_frame), [self isFlipped]);
   if (viewIsPrinting == nil)
     {
-      [_window->_rectsBeingDrawn addObject: [NSValue valueWithRect: wrect]];
+      GSRegion wregion;
+
+      GSRegionInit(&wregion);
+      if (region != NULL)
+        {
+          NSUInteger i;
+
+          for (i = 0; i < region->count; i++)
+            {
+              NSRect r = NSIntersectionRect(region->rects[i], rect);
+
+              if (NSIsEmptyRect(r) == NO)
+                {
+                  GSRegionAddRect(&wregion, [self convertRect: r toView: nil]);
+                }
+            }
+        }
+      else
+        {
+          GSRegionAddRect(&wregion, wrect);
+        }
+      [_window->_rectsBeingDrawn addObject:
+        [NSValue valueWithBytes: &wregion objCType: @encode(GSRegion)]];
     }
 
   /* Make sure we don't modify superview's gstate */
@@ -2339,6 +2379,19 @@ static void autoresize(CGFloat oldContainerSize,
           [bp addClip];
           RELEASE(matrix);
         }
+      else if (region != NULL && region->count > 1)
+        {
+          // Only draw in the rectangles of the region.
+          NSBezierPath *bp = [NSBezierPath bezierPath];
+          NSUInteger i;
+
+          for (i = 0; i < region->count; i++)
+            {
+              [bp appendBezierPathWithRect:
+                NSIntersectionRect(region->rects[i], rect)];
+            }
+          [bp addClip];
+        }
       else
         { 
           // FIXME: Should we use _bounds or visibleRect here?
@@ -2387,12 +2440,12 @@ static void autoresize(CGFloat oldContainerSize,
 
   if (viewIsPrinting == nil)
     {
-      NSRect        rect;
+      GSRegion      region;
       if (flush && !_rFlags.ignores_backing)
         {
-          rect = [[_window->_rectsBeingDrawn lastObject] rectValue];
+          [[_window->_rectsBeingDrawn lastObject] getValue: &region];
           _window->_rectNeedingFlush =
-              NSUnionRect(_window->_rectNeedingFlush, rect);
+              NSUnionRect(_window->_rectNeedingFlush, region.bounds);
           _window->_f.needs_flush = YES;
         }
       [_window->_rectsBeingDrawn removeLastObject];
@@ -2591,12 +2644,25 @@ static void autoresize(CGFloat oldContainerSize,
   if (_rFlags.needs_display == YES)
     {
       NSRect rect;
+      GSRegion region;
         
       /*
-       * Restrict the drawing of self onto the invalid rectangle.
+       * Restrict the drawing of self onto the invalid rectangle, or onto
+       * the rectangles of the invalid region when there are several.
        */
       rect = NSIntersectionRect(aRect, _invalidRect);
+      if (_invalidRegion != NULL && ((GSRegion *)_invalidRegion)->count > 1)
+        {
+          region = *(GSRegion *)_invalidRegion;
+          GSRegionIntersectRect(&region, aRect);
+          rect = region.bounds;
+          if (region.count > 1)
+            {
+              drawingRegion = &region;
+            }
+        }
       [self displayRectIgnoringOpacity: rect];
+      drawingRegion = NULL;
 
       /*
        * If we still need display after displaying the invalid rectangle,
@@ -2674,7 +2740,9 @@ static void autoresize(CGFloat oldContainerSize,
   NSGraphicsContext *wContext;
   BOOL flush = NO;
   BOOL subviewNeedsDisplay = NO;
+  const GSRegion *region = drawingRegion;
 
+  drawingRegion = NULL;
   if (![self canDraw])
     {
       return;
@@ -2699,14 +2767,45 @@ static void autoresize(CGFloat oldContainerSize,
       /*
        * If the rect we are going to display contains the _invalidRect
        * then we can empty _invalidRect. Do this before the drawing,
-       * as drawRect: may change this value.
-       * FIXME: If the drawn rectangle cuts of a complete part of the
-       * _invalidRect, we should try to reduce this.
+       * as drawRect: may change this value.  When only the rects of a
+       * region are drawn, they must contain it too.
+       * Otherwise remove the rectangles we draw from the invalid region.
        */
-      if (NSEqualRects(aRect, NSUnionRect(neededRect, aRect)) == YES)
+      if (NSEqualRects(aRect, NSUnionRect(neededRect, aRect)) == YES
+        && (region == NULL || NSIsEmptyRect(neededRect)
+          || GSRegionContainsRect(region, neededRect)))
         {
           _invalidRect = NSZeroRect;
           _rFlags.needs_display = NO;
+          if (_invalidRegion != NULL)
+            {
+              GSRegionInit(_invalidRegion);
+            }
+        }
+      else if (_invalidRegion != NULL && NSIsEmptyRect(aRect) == NO)
+        {
+          GSRegion *invalid = (GSRegion *)_invalidRegion;
+
+          GSRegionIntersectRect(invalid, visibleRect);
+          if (region != NULL)
+            {
+              NSUInteger i;
+
+              for (i = 0; i < region->count; i++)
+                {
+                  GSRegionSubtractRect(invalid,
+                    NSIntersectionRect(region->rects[i], aRect));
+                }
+            }
+          else
+            {
+              GSRegionSubtractRect(invalid, aRect);
+            }
+          _invalidRect = invalid->bounds;
+          if (invalid->count == 0)
+            {
+              _rFlags.needs_display = NO;
+            }
         }
     }
   
@@ -2715,7 +2814,9 @@ static void autoresize(CGFloat oldContainerSize,
       /*
        * Now we draw this view.
        */
+      drawingRegion = region;
       [self _lockFocusInContext: context inRect: aRect];
+      drawingRegion = NULL;
       [self drawRect: aRect];
       [self unlockFocusNeedsFlush: flush];
     }
@@ -2746,7 +2847,35 @@ static void autoresize(CGFloat oldContainerSize,
                * subviews overlapping the area are redrawn.
                */
               isect = NSIntersectionRect(aRect, subviewFrame);
-              if (NSIsEmptyRect(isect) == NO)
+              if (NSIsEmptyRect(isect) == NO && region != NULL)
+                {
+                  GSRegion subregion;
+                  NSUInteger j;
+
+                  /* Only where we have drawn. */
+                  GSRegionInit(&subregion);
+                  for (j = 0; j < region->count; j++)
+                    {
+                      NSRect r = NSIntersectionRect(region->rects[j], isect);
+
+                      if (NSIsEmptyRect(r) == NO)
+                        {
+                          GSRegionAddRect(&subregion,
+                            [subview convertRect: r fromView: self]);
+                        }
+                    }
+                  if (subregion.count > 0)
+                    {
+                      if (subregion.count > 1)
+                        {
+                          drawingRegion = &subregion;
+                        }
+                      [subview displayRectIgnoringOpacity: subregion.bounds
+                                                inContext: context];
+                      drawingRegion = NULL;
+                    }
+                }
+              else if (NSIsEmptyRect(isect) == NO)
                 {
                   isect = [subview convertRect: isect fromView: self];
                   [subview displayRectIgnoringOpacity: isect
@@ -2853,20 +2982,30 @@ static void autoresize(CGFloat oldContainerSize,
 
 - (void) getRectsBeingDrawn: (const NSRect **)rects count: (NSInteger *)count
 {
-  // FIXME
-  static NSRect rect;
+  static NSRect rectsBeingDrawn[GS_REGION_MAX_RECTS];
+  NSInteger n = 0;
+
+  if ([_window->_rectsBeingDrawn count] > 0)
+    {
+      GSRegion region;
+      NSUInteger i;
 
-  rect = [[_window->_rectsBeingDrawn lastObject] rectValue];
-  rect = [self convertRect: rect fromView: nil];
+      [[_window->_rectsBeingDrawn lastObject] getValue: &region];
+      for (i = 0; i < region.count; i++)
+        {
+          rectsBeingDrawn[n++] = [self convertRect: region.rects[i]
+                                          fromView: nil];
+        }
+    }
 
   if (rects != NULL)
     {
-      *rects = &rect;
+      *rects = rectsBeingDrawn;
     }
 
   if (count != NULL)
     {
-      *count = 1;
+      *count = n;
     }
 }
 
@@ -2920,6 +3059,111 @@ in the main thread.
     {
       _rFlags.needs_display = NO;
       _invalidRect = NSZeroRect;
+      if (_invalidRegion != NULL)
+        {
+          GSRegionInit(_invalidRegion);
+        }
+    }
+}
+
+/*
+Rects marked from other threads are kept in _pendingInvalidRect until the
+main thread drains them.  The lock only guards the union of the rect, the
+view is pushed onto the list of pending views without locking.  A view on
+the list is retained and isn't pushed again until it has been drained, and
+the main thread is only asked once to drain the list until it has done so.
+The window of a view is only looked at in the main thread, as it may go
+away while another thread marks the view.
+*/
+
+static NSView *pendingViews = nil;
+static int pendingScheduled = 0;
+
+/* Stands for the bounds of a view marked from another thread, which may
+   change while the view is marked.  The main thread limits it to the
+   bounds. */
+static const NSRect wholeViewRect = {{-1.0e12, -1.0e12}, {2.0e12, 2.0e12}};
+
+static inline void
+pendingLock(int *lock)
+{
+  while (__sync_lock_test_and_set(lock, 1))
+    {
+      while (*(volatile int *)lock)
+        ;
+    }
+}
+
+static inline void
+pendingUnlock(int *lock)
+{
+  __sync_lock_release(lock);
+}
+
+- (void) _postNeedsDisplayInRect: (NSRect)invalidRect
+{
+  BOOL queued;
+
+  pendingLock(&_pendingLock);
+  queued = !NSIsEmptyRect(_pendingInvalidRect);
+  _pendingInvalidRect = NSUnionRect(_pendingInvalidRect, invalidRect);
+  pendingUnlock(&_pendingLock);
+
+  if (queued == NO)
+    {
+      NSView *head;
+
+      RETAIN(self);
+      do
+        {
+          head = pendingViews;
+          _nextPendingView = head;
+        }
+      while (!__sync_bool_compare_and_swap(&pendingViews, head, self));
+    }
+  if (__sync_lock_test_and_set(&pendingScheduled, 1) == 0)
+    {
+      [NSView performSelectorOnMainThread: @selector(_displayPendingViews)
+                               withObject: nil
+                            waitUntilDone: NO];
+    }
+}
+
+/* Mark the views which other threads have marked as needing display.
+   Called in the main thread, at most once for any number of rects marked
+   in between, and before each autodisplay. */
++ (void) _displayPendingViews
+{
+  NSView *view;
+
+  /* Views pushed from now on need another drain, even if the list is
+     already empty because an earlier drain took them.  */
+  __sync_lock_release(&pendingScheduled);
+  if (pendingViews == nil)
+    {
+      return;
+    }
+  do
+    {
+      view = pendingViews;
+    }
+  while (!__sync_bool_compare_and_swap(&pendingViews, view, nil));
+
+  while (view != nil)
+    {
+      NSView *next;
+      NSRect rect;
+
+      pendingLock(&view->_pendingLock);
+      next = view->_nextPendingView;
+      rect = view->_pendingInvalidRect;
+      view->_pendingInvalidRect = NSZeroRect;
+      view->_nextPendingView = nil;
+      pendingUnlock(&view->_pendingLock);
+
+      [view _setNeedsDisplayInRect: rect];
+      RELEASE(view);
+      view = next;
     }
 }
 
@@ -2932,60 +3176,89 @@ in the main thread.
  */
 - (void) setNeedsDisplay: (BOOL)flag
 {
-  NSNumber *n = [[NSNumber alloc] initWithBool: flag];
-  if (GSCurrentThread() != GSAppKitThread)
+  if (flag)
     {
+      if (GSCurrentThread() != GSAppKitThread)
+        {
+          [self _postNeedsDisplayInRect: wholeViewRect];
+        }
+      else
+        {
+          [self setNeedsDisplayInRect: _bounds];
+        }
+    }
+  else if (GSCurrentThread() != GSAppKitThread)
+    {
+      NSNumber *n = [[NSNumber alloc] initWithBool: flag];
+
       NSDebugMLLog (@"MacOSXCompatibility", 
                     @"setNeedsDisplay: called on secondary thread");
       [self performSelectorOnMainThread: @selector(_setNeedsDisplay_real:)
             withObject: n
             waitUntilDone: NO];
+      DESTROY(n);
     }
   else
     {
-      [self _setNeedsDisplay_real: n];
+      _rFlags.needs_display = NO;
+      _invalidRect = NSZeroRect;
+      if (_invalidRegion != NULL)
+        {
+          GSRegionInit(_invalidRegion);
+        }
     }
-  DESTROY(n);
 }
 
 
 - (void) _setNeedsDisplayInRect_real: (NSValue *)v
 {
-  NSRect invalidRect;
-  NSView *currentView = _super_view;
-
   if (nil == v)
     return;
 
-  invalidRect = [v rectValue];
+  [self _setNeedsDisplayInRect: [v rectValue]];
+}
+
+- (void) _setNeedsDisplayInRect: (NSRect)invalidRect
+{
+  NSView *currentView = _super_view;
 
   /*
-   *	Limit to bounds, combine with old _invalidRect, and then check to see
-   *	if the result is the same as the old _invalidRect - if it isn't then
-   *	set the new _invalidRect.
+   *	Limit to bounds, and check to see if it is already in the invalid
+   *	region - if it isn't then add it to the region and enlarge
+   *	_invalidRect to include it.  The region keeps small areas far
+   *	apart from each other separate, so that only they are drawn.
    */
   invalidRect = NSIntersectionRect(invalidRect, _bounds);
-  invalidRect = NSUnionRect(_invalidRect, invalidRect);
-  if (NSEqualRects(invalidRect, _invalidRect) == NO)
+  if (_invalidRegion == NULL)
+    {
+      _invalidRegion = NSZoneMalloc(NSDefaultMallocZone(), sizeof(GSRegion));
+      GSRegionInit(_invalidRegion);
+    }
+  if (NSIsEmptyRect(invalidRect) == NO
+      && GSRegionContainsRect(_invalidRegion, invalidRect) == NO)
     {
       NSView	*firstOpaque = [self opaqueAncestor];
 
       _rFlags.needs_display = YES;
-      _invalidRect = invalidRect;
       if (firstOpaque == self)
         {
 	  /**
-	   * Enlarge (if necessary) _invalidRect so it lies on integral device pixels 
+	   * Enlarge (if necessary) the rect so it lies on integral device pixels 
 	   */
-	  const NSRect inBase =  [self convertRectToBase: _invalidRect];
+	  const NSRect inBase =  [self convertRectToBase: invalidRect];
 	  const NSRect inBaseRounded = NSIntegralRect(inBase);
-	  _invalidRect = [self convertRectFromBase: inBaseRounded];
+
+	  invalidRect = [self convertRectFromBase: inBaseRounded];
+	  GSRegionAddRect(_invalidRegion, invalidRect);
+	  _invalidRect = ((GSRegion *)_invalidRegion)->bounds;
 
           [_window setViewsNeedDisplay: YES];
         }
       else
         {
-          invalidRect = [firstOpaque convertRect: _invalidRect fromView: self];
+	  GSRegionAddRect(_invalidRegion, invalidRect);
+	  _invalidRect = ((GSRegion *)_invalidRegion)->bounds;
+          invalidRect = [firstOpaque convertRect: invalidRect fromView: self];
           [firstOpaque setNeedsDisplayInRect: invalidRect];
         }
     }
@@ -3017,28 +3290,19 @@ in the main thread.
  */
 - (void) setNeedsDisplayInRect: (NSRect)invalidRect
 {
-  NSValue *v;
-
   if (NSIsEmptyRect(invalidRect))
     return; // avoid unnecessary work when rectangle is empty
 	
-  v = [[NSValue alloc]
-		 initWithBytes: &invalidRect
-		 objCType: @encode(NSRect)];
-
   if (GSCurrentThread() != GSAppKitThread)
     {
       NSDebugMLLog (@"MacOSXCompatibility", 
                     @"setNeedsDisplayInRect: called on secondary thread");
-      [self performSelectorOnMainThread: @selector(_setNeedsDisplayInRect_real:)
-            withObject: v
-            waitUntilDone: NO];
+      [self _postNeedsDisplayInRect: invalidRect];
     }
   else
     {
-      [self _setNeedsDisplayInRect_real: v];
+      [self _setNeedsDisplayInRect: invalidRect];
     }
-  DESTROY(v);
 }
 
 + (NSFocusRingType) defaultFocusRingType
@@ -3097,6 +3361,7 @@ in the main thread.
   notify = (_super_view == nil) || ![_super_view isHiddenOrHasHiddenAncestor];
 
   _is_hidden = flag;
+  [_window _invalidateTrackingIndex];
 
   if (_is_hidden)
     {
@@ -3397,6 +3662,7 @@ Returns YES iff any scrolling was done.
       RELEASE(m);
       _rFlags.has_currects = 1;
       _rFlags.valid_rects = 1;
+      [_window _invalidateTrackingIndex];
     }
 }
 
@@ -3434,6 +3700,7 @@ Returns YES iff any scrolling was done.
 	  [_cursor_rects removeAllObjects];
 	}
       _rFlags.has_currects = 0;
+      [_window _invalidateTrackingIndex];
     }
 }
 
@@ -3457,6 +3724,7 @@ Returns YES iff any scrolling was done.
 	    }
 	  [o invalidate];
 	  [_cursor_rects removeObject: o];
+	  [_window _invalidateTrackingIndex];
 	  if ([_cursor_rects count] == 0)
 	    {
 	      _rFlags.has_currects = 0;
@@ -3697,6 +3965,7 @@ static NSView* findByTag(NSView *view, NSInteger aTag, NSUInteger *level)
 	{
 	  [m invalidate];
 	  [_tracking_rects removeObjectAtIndex: i];
+	  [_window _invalidateTrackingIndex];
 	  if ([_tracking_rects count] == 0)
 	    {
 	      _rFlags.has_trkrects = 0;
@@ -3738,6 +4007,7 @@ static NSView* findByTag(NSView *view, NSInteger aTag, NSUInteger *level)
   [_tracking_rects addObject: m];
   RELEASE(m);
   _rFlags.has_trkrects = 1;
+  [_window _invalidateTrackingIndex];
   return t;
 }
 
@@ -88,6 +88,8 @@
 #import "GNUstepGUI/GSWindowDecorationView.h"
 #import "GSBindingHelpers.h"
 #import "GSGuiPrivate.h"
+#import "GSRegion.h"
+#import "GSTrackingIndex.h"
 #import "GSToolTips.h"
 #import "GSIconManager.h"
 #import "GSAutoLayoutEngine.h"
@@ -174,6 +176,10 @@ static GSWindowAnimationDelegate *animationDelegate;
 - (void) _moveChildWindowsByOffset: (NSSize)offset;
 @end
 
+@interface NSView (GSPendingDisplay)
++ (void) _displayPendingViews;
+@end
+
 @interface NSDrawer (GNUstepPrivate)
 + (NSArray *) _drawersForParentWindow: (NSWindow *)window;
 @end
@@ -193,6 +199,7 @@ static GSWindowAnimationDelegate *animationDelegate;
 /* Window autodisplay machinery. */
 - (void) _handleAutodisplay
 {
+  [NSView _displayPendingViews];
   if (_f.is_autodisplay && _f.views_need_display)
     {
       [self disableFlushWindow];
@@ -949,6 +956,8 @@ many times.
   DESTROY(_miniaturizedImage);
   DESTROY(_windowTitle);
   DESTROY(_rectsBeingDrawn);
+  DESTROY(_trackingIndex);
+  DESTROY(_cursorIndex);
   DESTROY(_initialFirstResponder);
   DESTROY(_defaultButtonCell);
   DESTROY(_cachedImage);
@@ -2738,8 +2747,10 @@ titleWithRepresentedFilename(NSString *representedFilename)
   i = [_rectsBeingDrawn count];
   while (i-- > 0)
     {
-      _rectNeedingFlush = NSUnionRect(_rectNeedingFlush,
-        [[_rectsBeingDrawn objectAtIndex: i] rectValue]);
+      GSRegion region;
+
+      [[_rectsBeingDrawn objectAtIndex: i] getValue: &region];
+      _rectNeedingFlush = NSUnionRect(_rectNeedingFlush, region.bounds);
     }
 
   if (_windowNum > 0)
@@ -3023,6 +3034,12 @@ discardCursorRectsForView(NSView *theView)
   discardCursorRectsForView(_wv);
 }
 
+- (void) _invalidateTrackingIndex
+{
+  DESTROY(_trackingIndex);
+  DESTROY(_cursorIndex);
+}
+
 - (void) enableCursorRects
 {
   _f.cursor_rects_enabled = YES;
@@ -3081,6 +3098,44 @@ resetCursorRectsForView(NSView *theView)
     }
 }
 
+/* Posts a cursor update event for r if the mouse has entered it (when
+   entered is YES) or left it (when entered is NO).  */
+static void
+checkCursorRect(GSTrackingRect *r, NSEvent *theEvent, NSPoint lastPoint,
+  BOOL entered)
+{
+  NSPoint loc = [theEvent locationInWindow];
+  BOOL last;
+  BOOL now;
+
+  if ([r isValid] == NO)
+    {
+      return;
+    }
+
+  /*
+   * Check for presence of point in rectangle.
+   */
+  last = NSMouseInRect(lastPoint, r->rectangle, NO);
+  now = NSMouseInRect(loc, r->rectangle, NO);
+
+  if (entered ? ((!last) && (now)) : ((last) && (!now)))
+    {
+      NSEvent *e;
+
+      e = [NSEvent enterExitEventWithType: NSCursorUpdate
+        location: loc
+        modifierFlags: [theEvent modifierFlags]
+        timestamp: 0
+        windowNumber: [theEvent windowNumber]
+        context: [theEvent context]
+        eventNumber: 0
+        trackingNumber: (int)entered
+        userData: (void*)r];
+      [NSApp postEvent: e atStart: YES];
+    }
+}
+
 static void
 checkCursorRectanglesEntered(NSView *theView,  NSEvent *theEvent, NSPoint lastPoint)
 {
@@ -3118,45 +3173,13 @@ checkCursorRectanglesEntered(NSView *theView,  NSEvent *theEvent, NSPoint lastPo
       if (count > 0)
         {
           GSTrackingRect *rects[count];
-          NSPoint loc = [theEvent locationInWindow];
           NSUInteger i;
 
           [tr getObjects: rects];
 
           for (i = 0; i < count; ++i)
             {
-              GSTrackingRect *r = rects[i];
-              BOOL last;
-              BOOL now;
-
-              if ([r isValid] == NO)
-                {
-                  continue;
-                }
-
-              /*
-               * Check for presence of point in rectangle.
-               */
-              last = NSMouseInRect(lastPoint, r->rectangle, NO);
-              now = NSMouseInRect(loc, r->rectangle, NO);
-
-              // Mouse entered
-              if ((!last) && (now))
-                {
-                  NSEvent *e;
-
-                  e = [NSEvent enterExitEventWithType: NSCursorUpdate
-                    location: loc
-                    modifierFlags: [theEvent modifierFlags]
-                    timestamp: 0
-                    windowNumber: [theEvent windowNumber]
-                    context: [theEvent context]
-                    eventNumber: 0
-                    trackingNumber: (int)YES
-                    userData: (void*)r];
-                  [NSApp postEvent: e atStart: YES];
-                  //NSLog(@"Add enter event %@ for view %@ rect %@", e, theView, NSStringFromRect(r->rectangle));
-                }
+              checkCursorRect(rects[i], theEvent, lastPoint, YES);
             }
         }
     }
@@ -3174,46 +3197,13 @@ checkCursorRectanglesExited(NSView *theView,  NSEvent *theEvent, NSPoint lastPoi
       if (count > 0)
         {
           GSTrackingRect *rects[count];
-          NSPoint loc = [theEvent locationInWindow];
           NSUInteger i;
 
           [tr getObjects: rects];
 
           for (i = 0; i < count; ++i)
             {
-              GSTrackingRect *r = rects[i];
-              BOOL last;
-              BOOL now;
-
-              if ([r isValid] == NO)
-                {
-                  continue;
-                }
-
-              /*
-               * Check for presence of point in rectangle.
-               */
-              last = NSMouseInRect(lastPoint, r->rectangle, NO);
-              now = NSMouseInRect(loc, r->rectangle, NO);
-
-              // Mouse exited
-              if ((last) && (!now))
-                {
-                  NSEvent *e;
-
-                  e = [NSEvent enterExitEventWithType: NSCursorUpdate
-                    location: loc
-                    modifierFlags: [theEvent modifierFlags]
-                    timestamp: 0
-                    windowNumber: [theEvent windowNumber]
-                    context: [theEvent context]
-                    eventNumber: 0
-                    trackingNumber: (int)NO
-                    userData: (void*)r];
-                  [NSApp postEvent: e atStart: YES];
-                  //[NSApp postEvent: e atStart: NO];
-                  //NSLog(@"Add exit event %@ for view %@ rect %@", e, theView, NSStringFromRect(r->rectangle));
-                }
+              checkCursorRect(rects[i], theEvent, lastPoint, NO);
             }
         }
     }
@@ -3934,6 +3924,93 @@ checkCursorRectanglesExited(NSView *theView,  NSEvent *theEvent, NSPoint lastPoi
   [NSApp postEvent: event atStart: flag];
 }
 
+static void
+checkTrackingRect(GSTrackingRect *r, NSEvent *theEvent, NSRect vr,
+  NSPoint lastPoint, NSPoint loc, BOOL isFlipped)
+{
+  BOOL last;
+  BOOL now;
+  NSRect tr = NSIntersectionRect(vr, r->rectangle);
+
+  if ([r isValid] == NO)
+    {
+      return;
+    }
+  /* Check mouse at last point */
+  last = NSMouseInRect(lastPoint, tr, isFlipped);
+  /* Check mouse at current point */
+  now = NSMouseInRect(loc, tr, isFlipped);
+
+  if ((!last) && (now))                // Mouse entered event
+    {
+      if (r->flags.checked == NO)
+        {
+          if ([r->owner respondsToSelector:
+            @selector(mouseEntered:)])
+            {
+              r->flags.ownerRespondsToMouseEntered = YES;
+            }
+          if ([r->owner respondsToSelector:
+            @selector(mouseExited:)])
+            {
+              r->flags.ownerRespondsToMouseExited = YES;
+            }
+          r->flags.checked = YES;
+        }
+      if (r->flags.ownerRespondsToMouseEntered)
+        {
+          NSEvent        *e;
+
+          e = [NSEvent enterExitEventWithType: NSMouseEntered
+            location: loc
+            modifierFlags: [theEvent modifierFlags]
+            timestamp: 0
+            windowNumber: [theEvent windowNumber]
+            context: NULL
+            eventNumber: 0
+            trackingNumber: r->tag
+            userData: r->user_data];
+          [r->owner mouseEntered: e];
+        }
+    }
+
+  if ((last) && (!now))                // Mouse exited event
+    {
+      if (r->flags.checked == NO)
+        {
+          if ([r->owner respondsToSelector:
+            @selector(mouseEntered:)])
+            {
+              r->flags.ownerRespondsToMouseEntered = YES;
+            }
+          if ([r->owner respondsToSelector:
+            @selector(mouseExited:)])
+            {
+              r->flags.ownerRespondsToMouseExited = YES;
+            }
+          r->flags.checked = YES;
+        }
+      if (r->flags.ownerRespondsToMouseExited)
+        {
+          NSEvent        *e;
+
+          e = [NSEvent enterExitEventWithType: NSMouseExited
+            location: loc
+            modifierFlags: [theEvent modifierFlags]
+            timestamp: 0
+            windowNumber: [theEvent windowNumber]
+            context: NULL
+            eventNumber: 0
+            trackingNumber: r->tag
+            userData: r->user_data];
+          [r->owner mouseExited: e];
+        }
+    }
+}
+
+/* The rects found near a point usually fit on the stack. */
+#define FOUND_ON_STACK 32
+
 - (void) _checkTrackingRectangles: (NSView*)theView
                          forEvent: (NSEvent*)theEvent
 {
@@ -3941,6 +4018,51 @@ checkCursorRectanglesExited(NSView *theView,  NSEvent *theEvent, NSPoint lastPoi
     {
       return;
     }
+  if (theView == _wv)
+    {
+      /* Only look at the rects near the last and the current point. */
+      NSPoint loc;
+      NSUInteger count;
+
+      if (_trackingIndex == nil)
+        {
+          _trackingIndex = [[GSTrackingIndex alloc] initWithView: _wv
+                                                     cursorRects: NO];
+        }
+      loc = [theEvent locationInWindow];
+      count = [_trackingIndex countNear: _lastPoint and: loc];
+      if (count > 0)
+        {
+          GSTrackingEntry buf[FOUND_ON_STACK];
+          GSTrackingEntry *found = buf;
+          NSUInteger n;
+          NSUInteger i;
+
+          if (count > FOUND_ON_STACK)
+            {
+              found = NSZoneMalloc(NSDefaultMallocZone(),
+                count * sizeof(GSTrackingEntry));
+            }
+          n = [_trackingIndex getEntries: found
+                                    near: _lastPoint
+                                     and: loc
+                               postOrder: NO];
+          for (i = 0; i < n; i++)
+            {
+              NSView *view = found[i].view;
+
+              checkTrackingRect(found[i].rect, theEvent, [view visibleRect],
+                [view convertPoint: _lastPoint fromView: nil],
+                [view convertPoint: loc fromView: nil],
+                [view isFlipped]);
+            }
+          if (found != buf)
+            {
+              NSZoneFree(NSDefaultMallocZone(), found);
+            }
+        }
+      return;
+    }
   if (theView->_rFlags.has_trkrects)
     {
       BOOL isFlipped = [theView isFlipped];
@@ -3964,85 +4086,8 @@ checkCursorRectanglesExited(NSView *theView,  NSEvent *theEvent, NSPoint lastPoi
 
           for (i = 0; i < count; ++i)
             {
-              BOOL last;
-              BOOL now;
-              GSTrackingRect *r = rects[i];
-	      NSRect tr = NSIntersectionRect(vr, r->rectangle);
-
-              if ([r isValid] == NO)
-                {
-                  continue;
-                }
-              /* Check mouse at last point */
-              last = NSMouseInRect(lastPoint, tr, isFlipped);
-              /* Check mouse at current point */
-              now = NSMouseInRect(loc, tr, isFlipped);
-
-              if ((!last) && (now))                // Mouse entered event
-                {
-                  if (r->flags.checked == NO)
-                    {
-                      if ([r->owner respondsToSelector:
-                        @selector(mouseEntered:)])
-                        {
-                          r->flags.ownerRespondsToMouseEntered = YES;
-                        }
-                      if ([r->owner respondsToSelector:
-                        @selector(mouseExited:)])
-                        {
-                          r->flags.ownerRespondsToMouseExited = YES;
-                        }
-                      r->flags.checked = YES;
-                    }
-                  if (r->flags.ownerRespondsToMouseEntered)
-                    {
-                      NSEvent        *e;
-
-                      e = [NSEvent enterExitEventWithType: NSMouseEntered
-                        location: loc
-                        modifierFlags: [theEvent modifierFlags]
-                        timestamp: 0
-                        windowNumber: [theEvent windowNumber]
-                        context: NULL
-                        eventNumber: 0
-                        trackingNumber: r->tag
-                        userData: r->user_data];
-                      [r->owner mouseEntered: e];
-                    }
-                }
-
-              if ((last) && (!now))                // Mouse exited event
-                {
-                  if (r->flags.checked == NO)
-                    {
-                      if ([r->owner respondsToSelector:
-                        @selector(mouseEntered:)])
-                        {
-                          r->flags.ownerRespondsToMouseEntered = YES;
-                        }
-                      if ([r->owner respondsToSelector:
-                        @selector(mouseExited:)])
-                        {
-                          r->flags.ownerRespondsToMouseExited = YES;
-                        }
-                      r->flags.checked = YES;
-                    }
-                  if (r->flags.ownerRespondsToMouseExited)
-                    {
-                      NSEvent        *e;
-
-                      e = [NSEvent enterExitEventWithType: NSMouseExited
-                        location: loc
-                        modifierFlags: [theEvent modifierFlags]
-                        timestamp: 0
-                        windowNumber: [theEvent windowNumber]
-                        context: NULL
-                        eventNumber: 0
-                        trackingNumber: r->tag
-                        userData: r->user_data];
-                      [r->owner mouseExited: e];
-                    }
-                }
+              checkTrackingRect(rects[i], theEvent, vr, lastPoint, loc,
+                isFlipped);
             }
         }
     }
@@ -4077,6 +4122,54 @@ checkCursorRectanglesExited(NSView *theView,  NSEvent *theEvent, NSPoint lastPoi
   // As we add the events to the front of the queue, we need to add the last
   // events first. That is, first the enter events from inner to outer and
   // then the exit events
+  if (theView == _wv)
+    {
+      NSPoint loc;
+      NSUInteger count;
+
+      if (_cursorIndex == nil)
+        {
+          _cursorIndex = [[GSTrackingIndex alloc] initWithView: _wv
+                                                   cursorRects: YES];
+        }
+      loc = [theEvent locationInWindow];
+      count = [_cursorIndex countNear: _lastPoint and: loc];
+      if (count > 0)
+        {
+          GSTrackingEntry buf[FOUND_ON_STACK];
+          GSTrackingEntry *found = buf;
+          NSUInteger n;
+          NSUInteger i;
+
+          if (count > FOUND_ON_STACK)
+            {
+              found = NSZoneMalloc(NSDefaultMallocZone(),
+                count * sizeof(GSTrackingEntry));
+            }
+
+          n = [_cursorIndex getEntries: found
+                                  near: _lastPoint
+                                   and: loc
+                             postOrder: YES];
+          for (i = 0; i < n; i++)
+            {
+              checkCursorRect(found[i].rect, theEvent, _lastPoint, YES);
+            }
+          n = [_cursorIndex getEntries: found
+                                  near: _lastPoint
+                                   and: loc
+                             postOrder: NO];
+          for (i = 0; i < n; i++)
+            {
+              checkCursorRect(found[i].rect, theEvent, _lastPoint, NO);
+            }
+          if (found != buf)
+            {
+              NSZoneFree(NSDefaultMallocZone(), found);
+            }
+        }
+      return;
+    }
   checkCursorRectanglesEntered(theView, theEvent, _lastPoint);
   checkCursorRectanglesExited(theView, theEvent, _lastPoint);
   //[GSServerForWindow(self) _printEventQueue];
@@ -33,4 +33,13 @@
 
 @end
 
+@interface NSWindow (GSTrackingIndex)
+
+/* Forgets the index of the tracking and cursor rects of the window, after
+ * a view or its rects have changed.  It is built again when needed.
+ */
+- (void) _invalidateTrackingIndex;
+
+@end
+
 #endif // _GNUstep_H_NSWindowPrivate
@@ -0,0 +1,130 @@
+/* Reports the time taken and the area drawn by frames of scattered updates
+ * to a large view, marking the updated areas separately, which keeps them
+ * as a region, and marking the single rect enclosing them, which is what
+ * was drawn before views kept a region.  The results are checked by
+ * Tests/gui/NSView.
+ *
+ * This needs a window, so the backend has to be installed and a display
+ * available.
+ */
+#import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSDate.h>
+#import <Foundation/NSException.h>
+#import <Foundation/NSGeometry.h>
+
+#import <AppKit/NSApplication.h>
+#import <AppKit/NSColor.h>
+#import <AppKit/NSGraphics.h>
+#import <AppKit/NSView.h>
+#import <AppKit/NSWindow.h>
+
+#include <stdio.h>
+
+#define	SIZE	2000
+#define	FRAMES	1000
+#define	MARKS	2
+
+@interface Filler : NSView
+{
+@public
+  CGFloat area;
+}
+@end
+
+@implementation Filler
+- (BOOL) isOpaque
+{
+  return YES;
+}
+- (void) drawRect: (NSRect)r
+{
+  const NSRect *rects;
+  NSInteger n;
+  NSInteger i;
+
+  [self getRectsBeingDrawn: &rects count: &n];
+  [[NSColor whiteColor] set];
+  NSRectFillList(rects, n);
+  for (i = 0; i < n; i++)
+    {
+      area += NSWidth(rects[i]) * NSHeight(rects[i]);
+    }
+}
+@end
+
+/* The areas updated in a frame, spread over the whole view. */
+static NSRect
+mark(int frame, int i)
+{
+  static const int	xs[MARKS] = { 37, 71 };
+  static const int	ys[MARKS] = { 53, 13 };
+
+  return NSMakeRect((frame * xs[i]) % (SIZE - 20),
+    (frame * ys[i]) % (SIZE - 20), 20, 20);
+}
+
+static void
+run(const char *what, Filler *v, BOOL enclosing)
+{
+  NSDate *start = [NSDate date];
+  int frame;
+  int i;
+
+  v->area = 0;
+  for (frame = 0; frame < FRAMES; frame++)
+    {
+      CREATE_AUTORELEASE_POOL(pool);
+      NSRect u = NSZeroRect;
+
+      for (i = 0; i < MARKS; i++)
+        {
+          if (enclosing)
+            u = NSUnionRect(u, mark(frame, i));
+          else
+            [v setNeedsDisplayInRect: mark(frame, i)];
+        }
+      if (enclosing)
+        [v setNeedsDisplayInRect: u];
+      [v displayIfNeeded];
+      [pool drain];
+    }
+  printf("%-24s %8.3fms %12.0f pixels\n", what,
+    -[start timeIntervalSinceNow] * 1000.0 / FRAMES, v->area / FRAMES);
+}
+
+int
+main(int argc, char **argv)
+{
+  CREATE_AUTORELEASE_POOL(arp);
+  NSWindow *window;
+  Filler *v;
+
+  NS_DURING
+    {
+      [NSApplication sharedApplication];
+      window = AUTORELEASE([[NSWindow alloc]
+        initWithContentRect: NSMakeRect(0, 0, SIZE, SIZE)
+                  styleMask: NSWindowStyleMaskBorderless
+                    backing: NSBackingStoreBuffered
+                      defer: NO]);
+      v = AUTORELEASE([[Filler alloc]
+        initWithFrame: NSMakeRect(0, 0, SIZE, SIZE)]);
+      [window setContentView: v];
+      [v display];
+
+      printf("%dx%d view, %d areas of 20x20 a frame, average of %d frames\n",
+        SIZE, SIZE, MARKS, FRAMES);
+      run("separate areas", v, NO);
+      run("enclosing rect", v, YES);
+    }
+  NS_HANDLER
+    {
+      printf("The backend and a display are needed to run this benchmark\n");
+      [arp drain];
+      return 1;
+    }
+  NS_ENDHANDLER
+
+  [arp drain];
+  return 0;
+}
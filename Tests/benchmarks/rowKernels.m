@@ -0,0 +1,142 @@
+/* Reports the time taken to premultiply a large bitmap and to convert it
+ * between formats, which work a row at a time for eight and sixteen bit
+ * samples.  The results are checked by Tests/gui/NSBitmapImageRep.
+ *
+ * None of this needs a backend, so it runs anywhere.
+ */
+#import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSDate.h>
+#import <AppKit/NSBitmapImageRep.h>
+#import <AppKit/NSGraphics.h>
+
+#include <stdio.h>
+
+#define	SIZE	2048
+#define	RUNS	10
+
+@interface NSBitmapImageRep (GSPrivate)
+- (void) _premultiply;
+- (void) _unpremultiply;
+- (NSBitmapImageRep *) _convertToFormatBitsPerSample: (NSInteger)bps
+                                     samplesPerPixel: (NSInteger)spp
+                                            hasAlpha: (BOOL)alpha
+                                            isPlanar: (BOOL)isPlanar
+                                      colorSpaceName: (NSString*)colorSpaceName
+                                        bitmapFormat: (NSBitmapFormat)bitmapFormat
+                                         bytesPerRow: (NSInteger)rowBytes
+                                        bitsPerPixel: (NSInteger)pixelBits;
+@end
+
+static NSBitmapImageRep *
+newRep(int bps, int spp, BOOL alpha, NSString *space, NSBitmapFormat format)
+{
+  return AUTORELEASE([[NSBitmapImageRep alloc]
+    initWithBitmapDataPlanes: NULL
+                  pixelsWide: SIZE
+                  pixelsHigh: SIZE
+               bitsPerSample: bps
+             samplesPerPixel: spp
+                    hasAlpha: alpha
+                    isPlanar: NO
+              colorSpaceName: space
+                bitmapFormat: format
+                 bytesPerRow: 0
+                bitsPerPixel: 0]);
+}
+
+static NSBitmapImageRep *
+convert(NSBitmapImageRep *rep, int bps, int spp, BOOL planar,
+  NSString *space, NSBitmapFormat format)
+{
+  return [rep _convertToFormatBitsPerSample: bps
+                            samplesPerPixel: spp
+                                   hasAlpha: [rep hasAlpha]
+                                   isPlanar: planar
+                             colorSpaceName: space
+                               bitmapFormat: format
+                                bytesPerRow: 0
+                               bitsPerPixel: 0];
+}
+
+static void
+fill(NSBitmapImageRep *rep)
+{
+  unsigned char *data = [rep bitmapData];
+  NSInteger length = [rep bytesPerRow] * [rep pixelsHigh];
+  NSInteger i;
+
+  for (i = 0; i < length; i++)
+    {
+      data[i] = (i * 7) % 256;
+    }
+}
+
+/* Runs expr RUNS times and prints the average time it takes. */
+#define	TIME(what, expr) \
+  do { \
+    NSDate *start = [NSDate date]; \
+    int run; \
+    for (run = 0; run < RUNS; run++) \
+      { \
+        CREATE_AUTORELEASE_POOL(pool); \
+        expr; \
+        [pool drain]; \
+      } \
+    printf("%-36s %8.3fms\n", what, \
+      -[start timeIntervalSinceNow] * 1000.0 / RUNS); \
+  } while (0)
+
+int
+main(int argc, char **argv)
+{
+  CREATE_AUTORELEASE_POOL(arp);
+  NSBitmapImageRep *rgba;
+  NSBitmapImageRep *argb;
+  NSBitmapImageRep *wide;
+  NSBitmapImageRep *planar;
+  NSBitmapImageRep *gray;
+  NSBitmapImageRep *copy;
+
+  rgba = newRep(8, 4, YES, NSDeviceRGBColorSpace,
+    NSAlphaNonpremultipliedBitmapFormat);
+  fill(rgba);
+  gray = newRep(8, 2, YES, NSDeviceWhiteColorSpace,
+    NSAlphaNonpremultipliedBitmapFormat);
+  fill(gray);
+  wide = convert(rgba, 16, 4, NO, NSDeviceRGBColorSpace,
+    NSAlphaNonpremultipliedBitmapFormat);
+  argb = convert(rgba, 8, 4, NO, NSDeviceRGBColorSpace,
+    NSAlphaNonpremultipliedBitmapFormat | NSAlphaFirstBitmapFormat);
+  planar = convert(rgba, 8, 4, YES, NSDeviceRGBColorSpace,
+    NSAlphaNonpremultipliedBitmapFormat);
+
+  printf("%dx%d pixels, average of %d runs\n", SIZE, SIZE, RUNS);
+  TIME("premultiply 8 bit RGBA",
+    copy = AUTORELEASE([rgba copy]); [copy _premultiply]);
+  copy = AUTORELEASE([rgba copy]);
+  [copy _premultiply];
+  TIME("unpremultiply 8 bit RGBA",
+    [AUTORELEASE([copy copy]) _unpremultiply]);
+  TIME("premultiply 16 bit RGBA",
+    [AUTORELEASE([wide copy]) _premultiply]);
+  TIME("8 to 16 bit RGBA", convert(rgba, 16, 4, NO,
+    NSDeviceRGBColorSpace, NSAlphaNonpremultipliedBitmapFormat));
+  TIME("16 to 8 bit RGBA", convert(wide, 8, 4, NO,
+    NSDeviceRGBColorSpace, NSAlphaNonpremultipliedBitmapFormat));
+  TIME("RGBA to ARGB", convert(rgba, 8, 4, NO,
+    NSDeviceRGBColorSpace,
+    NSAlphaNonpremultipliedBitmapFormat | NSAlphaFirstBitmapFormat));
+  TIME("ARGB to RGBA", convert(argb, 8, 4, NO,
+    NSDeviceRGBColorSpace, NSAlphaNonpremultipliedBitmapFormat));
+  TIME("meshed to planar", convert(rgba, 8, 4, YES,
+    NSDeviceRGBColorSpace, NSAlphaNonpremultipliedBitmapFormat));
+  TIME("planar to meshed", convert(planar, 8, 4, NO,
+    NSDeviceRGBColorSpace, NSAlphaNonpremultipliedBitmapFormat));
+  TIME("non-premultiplied to premultiplied", convert(rgba, 8, 4, NO,
+    NSDeviceRGBColorSpace, 0));
+  TIME("gray to RGB", convert(gray, 8, 4, NO,
+    NSDeviceRGBColorSpace, NSAlphaNonpremultipliedBitmapFormat));
+
+  [arp drain];
+  return 0;
+}
@@ -0,0 +1,152 @@
+/* Reports the time taken by edits to a text with many attribute runs in a
+   text storage, which keeps its runs in a gap buffer, and in a plain
+   mutable attributed string, which keeps them in an array.  The results
+   are checked by Tests/gui/NSTextStorage.  Ending the edits of the text
+   storage fixes attributes, which needs the font system, so the backend
+   has to be installed.
+*/
+#import <Foundation/NSAttributedString.h>
+#import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSDate.h>
+#import <Foundation/NSDictionary.h>
+#import <Foundation/NSException.h>
+#import <Foundation/NSString.h>
+#import <Foundation/NSValue.h>
+
+#import <AppKit/NSApplication.h>
+#import <AppKit/NSFont.h>
+#import <AppKit/NSTextStorage.h>
+
+#include <stdio.h>
+
+#define	RUNS	100000
+#define	EDITS	5000
+
+static unsigned seed = 1;
+
+static unsigned
+next(unsigned limit)
+{
+  seed = seed * 1103515245 + 12345;
+  return ((seed >> 8) & 0xffffff) % limit;
+}
+
+static NSDictionary *
+style(NSFont *font, unsigned i)
+{
+  return [NSDictionary dictionaryWithObjectsAndKeys:
+    font, NSFontAttributeName,
+    [NSNumber numberWithUnsignedInt: i % 7], @"GSTestRun", nil];
+}
+
+/* Build a text with a run of attributes every five characters.  */
+static NSTimeInterval
+fill(NSMutableAttributedString *s, NSFont *font)
+{
+  NSDate *start = [NSDate date];
+  unsigned i;
+
+  [s replaceCharactersInRange: NSMakeRange(0, [s length])
+                   withString: [@"" stringByPaddingToLength: RUNS * 5
+                                                 withString: @"abcde"
+                                            startingAtIndex: 0]];
+  for (i = 0; i < RUNS; i++)
+    {
+      [s setAttributes: style(font, i) range: NSMakeRange(i * 5, 5)];
+    }
+  return -[start timeIntervalSinceNow];
+}
+
+static NSTimeInterval
+typeAt(NSMutableAttributedString *s, NSUInteger loc)
+{
+  NSDate *start = [NSDate date];
+  unsigned i;
+
+  for (i = 0; i < EDITS; i++)
+    {
+      [s replaceCharactersInRange: NSMakeRange(loc, 0) withString: @"k"];
+    }
+  return -[start timeIntervalSinceNow];
+}
+
+static NSTimeInterval
+editAnywhere(NSMutableAttributedString *s, NSFont *font)
+{
+  NSDate *start = [NSDate date];
+  unsigned i;
+
+  for (i = 0; i < EDITS; i++)
+    {
+      NSUInteger length = [s length];
+      NSRange r = NSMakeRange(next(length - 10), next(10));
+
+      switch (i % 3)
+        {
+          case 0:
+            [s replaceCharactersInRange: NSMakeRange(r.location, 0)
+                             withString: @"xyz"];
+            break;
+          case 1:
+            [s deleteCharactersInRange: r];
+            break;
+          default:
+            [s setAttributes: style(font, i) range: r];
+            break;
+        }
+    }
+  return -[start timeIntervalSinceNow];
+}
+
+static void
+report(const char *what, NSTimeInterval ts, NSTimeInterval as)
+{
+  printf("%-28s %10.3fms %10.3fms\n", what, ts * 1000.0, as * 1000.0);
+}
+
+int
+main(int argc, char **argv)
+{
+  CREATE_AUTORELEASE_POOL(arp);
+  NSTextStorage *ts;
+  NSMutableAttributedString *as;
+  NSFont *font;
+  unsigned saved;
+
+  NS_DURING
+    {
+      [NSApplication sharedApplication];
+    }
+  NS_HANDLER
+    {
+      printf("The backend is needed to run this benchmark\n");
+      [arp drain];
+      return 1;
+    }
+  NS_ENDHANDLER
+
+  font = [NSFont userFontOfSize: 12.0];
+  ts = AUTORELEASE([[NSTextStorage alloc] init]);
+  as = AUTORELEASE([[NSMutableAttributedString alloc] init]);
+
+  printf("%d runs, %d edits\n", RUNS, EDITS);
+  printf("%-28s %12s %12s\n", "", "text storage", "attr string");
+  [ts beginEditing];
+  report("setting the runs", fill(ts, font), fill(as, font));
+  report("typing at the start", typeAt(ts, 12), typeAt(as, 12));
+  report("typing in the middle",
+    typeAt(ts, [ts length] / 2), typeAt(as, [as length] / 2));
+  report("typing at the end",
+    typeAt(ts, [ts length]), typeAt(as, [as length]));
+  saved = seed;
+  {
+    NSTimeInterval t = editAnywhere(ts, font);
+
+    seed = saved;
+    report("editing anywhere", t, editAnywhere(as, font));
+  }
+  [ts endEditing];
+
+  [arp drain];
+  return 0;
+}
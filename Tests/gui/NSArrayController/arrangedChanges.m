@@ -0,0 +1,133 @@
+/* Objects added to or removed from an NSArrayController are placed in or
+   taken out of the arranged objects one by one, and observers are told the
+   indexes which changed rather than given a new array.  Check the kind and
+   indexes of the notifications, that the result is the same as arranging
+   the whole content, and that the selection stays with the same objects.  */
+#include "Testing.h"
+
+#include <Foundation/NSAutoreleasePool.h>
+#include <Foundation/NSArray.h>
+#include <Foundation/NSDictionary.h>
+#include <Foundation/NSIndexSet.h>
+#include <Foundation/NSKeyValueObserving.h>
+#include <Foundation/NSPredicate.h>
+#include <Foundation/NSSortDescriptor.h>
+#include <Foundation/NSString.h>
+#include <Foundation/NSValue.h>
+
+#include <AppKit/NSArrayController.h>
+
+#define COUNT 10000
+
+@interface Watcher : NSObject
+{
+@public
+  NSKeyValueChange kind;
+  NSIndexSet *indexes;
+  int changes;
+}
+@end
+
+@implementation Watcher
+- (void) observeValueForKeyPath: (NSString *)keyPath
+                       ofObject: (id)object
+                         change: (NSDictionary *)change
+                        context: (void *)context
+{
+  kind = [[change objectForKey: NSKeyValueChangeKindKey] intValue];
+  ASSIGN(indexes, [change objectForKey: NSKeyValueChangeIndexesKey]);
+  changes++;
+}
+- (void) dealloc
+{
+  RELEASE(indexes);
+  [super dealloc];
+}
+@end
+
+static NSNumber *
+num(int i)
+{
+  return [NSNumber numberWithInt: i];
+}
+
+int main()
+{
+  START_SET("NSArrayController arrangedChanges")
+  NSArrayController *ac;
+  Watcher *w;
+  NSSortDescriptor *sd;
+  NSArray *whole;
+  int i;
+
+  ac = AUTORELEASE([[NSArrayController alloc] init]);
+  w = AUTORELEASE([[Watcher alloc] init]);
+  sd = AUTORELEASE([[NSSortDescriptor alloc]
+    initWithKey: @"self" ascending: YES selector: @selector(compare:)]);
+  [ac setSortDescriptors: [NSArray arrayWithObject: sd]];
+  [ac setFilterPredicate: [NSPredicate predicateWithFormat: @"self < 1000"]];
+  [ac setSelectsInsertedObjects: NO];
+  [ac addObjects: [NSArray arrayWithObjects: num(10), num(30), num(20), nil]];
+  [ac rearrangeObjects];
+  [ac addObserver: w
+       forKeyPath: @"arrangedObjects"
+          options: NSKeyValueObservingOptionNew
+          context: NULL];
+
+  [ac setSelectionIndex: 1];
+  [ac addObject: num(15)];
+  PASS(w->changes == 1 && w->kind == NSKeyValueChangeInsertion
+    && [w->indexes isEqual: [NSIndexSet indexSetWithIndex: 1]],
+       "adding an object is an insertion at its sorted index");
+  PASS([[ac arrangedObjects] isEqual: [NSArray arrayWithObjects:
+    num(10), num(15), num(20), num(30), nil]],
+       "the object is inserted in order");
+  PASS([[ac selectedObjects] isEqual: [NSArray arrayWithObject: num(20)]],
+       "the selection stays with the same object");
+
+  [ac addObject: num(5000)];
+  PASS(w->changes == 1 && [[ac content] count] == 5,
+       "an object the filter rejects is kept but not arranged");
+
+  [ac addObjects: [NSArray arrayWithObjects: num(40), num(1), num(25), nil]];
+  PASS(w->changes == 2 && w->kind == NSKeyValueChangeInsertion
+    && [w->indexes count] == 3
+    && [w->indexes containsIndex: 0] && [w->indexes containsIndex: 4]
+    && [w->indexes containsIndex: 6],
+       "adding objects is one insertion at their final indexes");
+
+  [ac removeObject: num(20)];
+  PASS(w->changes == 3 && w->kind == NSKeyValueChangeRemoval
+    && [w->indexes isEqual: [NSIndexSet indexSetWithIndex: 3]],
+       "removing an object is a removal at its index");
+  PASS([[ac selectedObjects] count] == 0,
+       "a removed object is no longer selected");
+
+  [ac setSelectionIndex: 4];
+  [ac removeObjects: [NSArray arrayWithObjects: num(1), num(10), nil]];
+  PASS(w->changes == 4 && w->kind == NSKeyValueChangeRemoval
+    && [w->indexes count] == 2,
+       "removing objects is one removal");
+  PASS([[ac selectedObjects] isEqual: [NSArray arrayWithObject: num(30)]],
+       "the selection moves down over removed objects");
+
+  whole = [ac arrangeObjects: [ac content]];
+  PASS([[ac arrangedObjects] isEqual: whole],
+       "the arranged objects match arranging the whole content");
+  [ac removeObserver: w forKeyPath: @"arrangedObjects"];
+
+  ac = AUTORELEASE([[NSArrayController alloc] init]);
+  [ac setSortDescriptors: [NSArray arrayWithObject: sd]];
+  [ac setAutomaticallyRearrangesObjects: YES];
+  [ac setSelectsInsertedObjects: NO];
+  for (i = 0; i < COUNT; i++)
+    {
+      [ac addObject: num((i * 7919) % COUNT)];
+    }
+  whole = [ac arrangeObjects: [ac content]];
+  PASS([[ac arrangedObjects] isEqual: whole],
+       "objects added one at a time end up sorted");
+
+  END_SET("NSArrayController arrangedChanges")
+  return 0;
+}
@@ -0,0 +1,102 @@
+#include "Testing.h"
+
+#include <math.h>
+
+#include <Foundation/NSAutoreleasePool.h>
+#include <Foundation/NSDictionary.h>
+#include <Foundation/NSException.h>
+#include <Foundation/NSGeometry.h>
+#include <Foundation/NSString.h>
+#include <Foundation/NSValue.h>
+#include <AppKit/NSApplication.h>
+#include <AppKit/NSAttributedString.h>
+#include <AppKit/NSStringDrawing.h>
+#include <AppKit/NSFont.h>
+
+/* The string drawing methods keep laid out strings in a per thread cache
+   whose counters and size can be read and set, and measure single line
+   strings in one font without laying them out.  The fast path must give
+   the same size as the text system.  */
+
+static NSUInteger
+counter(NSString *key)
+{
+  return [[GSStringDrawingCacheStatistics() objectForKey: key]
+           unsignedIntegerValue];
+}
+
+static BOOL
+sameSize(NSSize a, NSSize b)
+{
+  return fabs(a.width - b.width) < 0.001 && fabs(a.height - b.height) < 0.001;
+}
+
+int
+main(int argc, char **argv)
+{
+  START_SET("NSStringDrawing cache")
+
+  NS_DURING
+    {
+      [NSApplication sharedApplication];
+    }
+  NS_HANDLER
+    {
+      if ([[localException name] isEqualToString: NSInternalInconsistencyException])
+        SKIP("It looks like GNUstep backend is not yet installed")
+    }
+  NS_ENDHANDLER
+
+  NS_DURING
+    {
+      NSDictionary *attrs = [NSDictionary dictionaryWithObject:
+        [NSFont systemFontOfSize: 12] forKey: NSFontAttributeName];
+      NSSize big = NSMakeSize(1e6, 1e6);
+      NSSize fast, full;
+      int i;
+
+      GSStringDrawingResetCacheStatistics();
+      fast = [@"Column title" sizeWithAttributes: attrs];
+      PASS(counter(@"FastPath") == 1 && counter(@"Total") == 0,
+           "a single line string is measured without layout");
+      full = [@"Column title" boundingRectWithSize: big
+                                           options: NSStringDrawingUsesFontLeading
+                                        attributes: attrs].size;
+      PASS(counter(@"Misses") == 1, "a constrained size is laid out");
+      PASS(sameSize(fast, full), "the fast path matches the text system");
+
+      fast = [@"affluent fields" sizeWithAttributes: attrs];
+      PASS(counter(@"FastPath") == 1,
+           "a string with possible ligatures is laid out");
+
+      [@"Column title" boundingRectWithSize: big
+                                    options: NSStringDrawingUsesFontLeading
+                                 attributes: attrs];
+      PASS(counter(@"Hits") == 1, "the laid out string is found again");
+
+      GSStringDrawingSetCacheSize(4);
+      PASS(GSStringDrawingCacheSize() == 4, "the cache size can be set");
+      GSStringDrawingResetCacheStatistics();
+      for (i = 0; i < 6; i++)
+        {
+          [[NSString stringWithFormat: @"row %d", i]
+            boundingRectWithSize: big options: 0 attributes: attrs];
+        }
+      [@"row 0" boundingRectWithSize: big options: 0 attributes: attrs];
+      PASS(counter(@"Misses") == 7,
+           "strings are evicted from a small cache");
+      GSStringDrawingSetCacheSize(0);
+      PASS(GSStringDrawingCacheSize() == 64, "zero restores the default size");
+    }
+  NS_HANDLER
+    {
+      if ([[localException name] isEqualToString: NSInternalInconsistencyException]
+        || [[localException name] isEqualToString: @"NSWindowServerCommunicationException"])
+        SKIP("No display available");
+    }
+  NS_ENDHANDLER
+
+  END_SET("NSStringDrawing cache")
+
+  return 0;
+}
@@ -0,0 +1,127 @@
+#include "Testing.h"
+
+#include <math.h>
+
+#include <Foundation/NSAutoreleasePool.h>
+#include <Foundation/NSDictionary.h>
+#include <Foundation/NSException.h>
+#include <Foundation/NSGeometry.h>
+#include <Foundation/NSString.h>
+#include <AppKit/NSApplication.h>
+#include <AppKit/NSAttributedString.h>
+#include <AppKit/NSStringDrawing.h>
+#include <AppKit/NSFont.h>
+
+/* The string drawing methods honour NSStringDrawingUsesFontLeading and
+   NSStringDrawingTruncatesLastVisibleLine, and can stop measuring a long
+   string after a number of lines.  Measuring the first lines of a long
+   string should give the same height as measuring them in a rect just as
+   high.  */
+
+static BOOL
+near(CGFloat a, CGFloat b)
+{
+  return fabs(a - b) < 0.001;
+}
+
+int
+main(int argc, char **argv)
+{
+  START_SET("NSStringDrawing options")
+
+  NS_DURING
+    {
+      [NSApplication sharedApplication];
+    }
+  NS_HANDLER
+    {
+      if ([[localException name] isEqualToString: NSInternalInconsistencyException])
+        SKIP("It looks like GNUstep backend is not yet installed")
+    }
+  NS_ENDHANDLER
+
+  NS_DURING
+    {
+      NSFont *font = [NSFont systemFontOfSize: 12];
+      NSDictionary *attrs = [NSDictionary dictionaryWithObject: font
+                                                        forKey: NSFontAttributeName];
+      NSStringDrawingOptions lf = NSStringDrawingUsesLineFragmentOrigin;
+      NSStringDrawingOptions lead = lf | NSStringDrawingUsesFontLeading;
+      NSString *tip = [@"" stringByPaddingToLength: 10000
+                                        withString: @"a long tool tip text "
+                                   startingAtIndex: 0];
+      NSSize big = NSMakeSize(1e6, 1e6);
+      NSRect fast, full, one, three, high, r;
+      CGFloat line;
+
+      fast = [@"Title" boundingRectWithSize: NSZeroSize
+                                    options: lf
+                                 attributes: attrs];
+      full = [@"Title" boundingRectWithSize: big
+                                    options: lf
+                                 attributes: attrs];
+      PASS(near(NSHeight(fast), NSHeight(full))
+           && near(NSHeight(full), [font ascender] - [font descender]),
+           "without font leading a line is as high as the font");
+      fast = [@"Title" boundingRectWithSize: NSZeroSize
+                                    options: lead
+                                 attributes: attrs];
+      full = [@"Title" boundingRectWithSize: big
+                                    options: lead
+                                 attributes: attrs];
+      PASS(near(NSHeight(fast), NSHeight(full))
+           && NSHeight(full) >= [font ascender] - [font descender]
+           && NSHeight(full) >= [font defaultLineHeightForFont] - 0.001,
+           "with font leading a line is at least the default line height");
+
+      one = [tip boundingRectWithSize: NSMakeSize(200, 0)
+                              options: lead
+                           attributes: attrs
+                 maximumNumberOfLines: 1];
+      three = [tip boundingRectWithSize: NSMakeSize(200, 0)
+                                options: lead
+                             attributes: attrs
+                   maximumNumberOfLines: 3];
+      line = NSHeight(one);
+      PASS(line > 0 && near(NSHeight(three), 3 * line),
+           "measuring stops after the maximum number of lines");
+      PASS(NSWidth(three) <= 200, "the lines are wrapped at the width");
+
+      high = [tip boundingRectWithSize: NSMakeSize(200, 3.5 * line)
+                               options: lead
+                            attributes: attrs];
+      PASS(near(NSHeight(high), NSHeight(three)),
+           "measuring stops at the height of the bounding size");
+
+      r = [tip boundingRectWithSize: NSMakeSize(200, 0)
+                            options: lead
+                         attributes: attrs];
+      PASS(NSHeight(r) > 100 * line,
+           "a height of zero doesn't limit the layout");
+
+      r = [tip boundingRectWithSize: NSMakeSize(200, 3.5 * line)
+                            options: lead | NSStringDrawingTruncatesLastVisibleLine
+                         attributes: attrs];
+      PASS(near(NSHeight(r), NSHeight(three)) && NSWidth(r) <= 200,
+           "a truncated string keeps its visible lines");
+
+      full = [@"Title" boundingRectWithSize: NSMakeSize(200, 100)
+                                    options: lead
+                                 attributes: attrs];
+      r = [@"Title" boundingRectWithSize: NSMakeSize(200, 100)
+                                 options: lead | NSStringDrawingTruncatesLastVisibleLine
+                              attributes: attrs];
+      PASS(NSEqualRects(r, full), "a string that fits isn't truncated");
+    }
+  NS_HANDLER
+    {
+      if ([[localException name] isEqualToString: NSInternalInconsistencyException]
+        || [[localException name] isEqualToString: @"NSWindowServerCommunicationException"])
+        SKIP("No display available");
+    }
+  NS_ENDHANDLER
+
+  END_SET("NSStringDrawing options")
+
+  return 0;
+}
@@ -0,0 +1,98 @@
+/* -[NSBitmapImageRep initWithData:maxPixelSize:] decodes JPEG and PNG
+ * images at a reduced resolution.  Encode a large bitmap both ways, load it
+ * back whole and reduced, and check the pixel size, the size in points and
+ * the averaged colour of the reduced images.
+ *
+ * None of this needs a backend, so it runs anywhere there is libjpeg and
+ * libpng.
+ */
+#import <Foundation/NSObject.h>
+#import "Testing.h"
+
+#import <Foundation/NSDictionary.h>
+#import <AppKit/NSBitmapImageRep.h>
+#import <AppKit/NSGraphics.h>
+
+#define	WIDE	3000
+#define	HIGH	2000
+
+/* Vertical stripes of red and blue two pixels wide, opaque on the left
+ * half and transparent on the right.
+ */
+static NSBitmapImageRep *
+stripes(void)
+{
+  NSBitmapImageRep *rep = AUTORELEASE([[NSBitmapImageRep alloc]
+    initWithBitmapDataPlanes: NULL pixelsWide: WIDE pixelsHigh: HIGH
+                bitsPerSample: 8 samplesPerPixel: 4 hasAlpha: YES isPlanar: NO
+               colorSpaceName: NSDeviceRGBColorSpace
+                 bitmapFormat: NSAlphaNonpremultipliedBitmapFormat
+                  bytesPerRow: 0 bitsPerPixel: 0]);
+  unsigned char *d = [rep bitmapData];
+  NSInteger x;
+  NSInteger y;
+
+  for (y = 0; y < HIGH; y++)
+    {
+      for (x = 0; x < WIDE; x++)
+        {
+          unsigned char *p = d + (y * WIDE + x) * 4;
+          BOOL red = (x / 2) % 2 == 0;
+
+          p[0] = red ? 255 : 0;
+          p[1] = 0;
+          p[2] = red ? 0 : 255;
+          p[3] = (x < WIDE / 2) ? 255 : 0;
+        }
+    }
+  return rep;
+}
+
+int
+main(int argc, char **argv)
+{
+  START_SET("NSBitmapImageRep maxPixelSize")
+  NSBitmapImageRep *src = stripes();
+  NSBitmapImageRep *rep;
+  NSData *data;
+  NSUInteger p[4];
+
+  data = [src representationUsingType: NSPNGFileType
+                           properties: [NSDictionary dictionary]];
+  if (data == nil)
+    SKIP("PNG support is not available")
+  rep = [NSBitmapImageRep imageRepWithData: data maxPixelSize: 0];
+  PASS([rep pixelsWide] == WIDE && [rep pixelsHigh] == HIGH,
+       "a maximum of zero loads a PNG whole");
+  rep = [NSBitmapImageRep imageRepWithData: data maxPixelSize: 128];
+  PASS([rep pixelsWide] == 131 && [rep pixelsHigh] == 87,
+       "a PNG is reduced by the largest whole factor");
+  PASS(NSEqualSizes([rep size], NSMakeSize(WIDE, HIGH)),
+       "a reduced PNG keeps the size of the whole image");
+  [rep getPixel: p atX: 10 y: 10];
+  PASS(p[0] > 100 && p[0] < 155 && p[2] > 100 && p[2] < 155 && p[3] == 255,
+       "opaque stripes are averaged");
+  [rep getPixel: p atX: 120 y: 10];
+  PASS(p[3] == 0, "transparent pixels stay transparent");
+  rep = [NSBitmapImageRep imageRepWithData: data maxPixelSize: 5000];
+  PASS([rep pixelsWide] == WIDE, "a PNG smaller than the maximum is whole");
+
+  data = [src representationUsingType: NSJPEGFileType
+                           properties: [NSDictionary dictionary]];
+  if (data == nil)
+    SKIP("JPEG support is not available")
+  rep = [NSBitmapImageRep imageRepWithData: data maxPixelSize: 0];
+  PASS([rep pixelsWide] == WIDE && [rep pixelsHigh] == HIGH,
+       "a maximum of zero loads a JPEG whole");
+  rep = [NSBitmapImageRep imageRepWithData: data maxPixelSize: 128];
+  PASS([rep pixelsWide] == WIDE / 8 && [rep pixelsHigh] == HIGH / 8,
+       "a JPEG is reduced by an eighth at most");
+  PASS(NSEqualSizes([rep size], NSMakeSize(WIDE, HIGH)),
+       "a reduced JPEG keeps the size of the whole image");
+  rep = [NSBitmapImageRep imageRepWithData: data maxPixelSize: 1000];
+  PASS([rep pixelsWide] == WIDE / 2,
+       "a JPEG is reduced no further than the maximum");
+
+  END_SET("NSBitmapImageRep maxPixelSize")
+  return 0;
+}
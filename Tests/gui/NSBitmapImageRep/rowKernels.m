@@ -0,0 +1,218 @@
+/* Premultiplying a bitmap and converting it between formats work a row at
+ * a time for eight and sixteen bit samples.  Check that the results match
+ * the sample values the pixel by pixel code gives, that conversions there
+ * and back return the original data on a large bitmap.
+ *
+ * None of this needs a backend, so it runs anywhere.
+ */
+#import <Foundation/NSObject.h>
+#import "Testing.h"
+
+#import <AppKit/NSBitmapImageRep.h>
+#import <AppKit/NSGraphics.h>
+
+#include <string.h>
+
+#define	SIZE	1024
+
+@interface NSBitmapImageRep (GSPrivate)
+- (void) _premultiply;
+- (void) _unpremultiply;
+- (NSBitmapImageRep *) _convertToFormatBitsPerSample: (NSInteger)bps
+                                     samplesPerPixel: (NSInteger)spp
+                                            hasAlpha: (BOOL)alpha
+                                            isPlanar: (BOOL)isPlanar
+                                      colorSpaceName: (NSString*)colorSpaceName
+                                        bitmapFormat: (NSBitmapFormat)bitmapFormat
+                                         bytesPerRow: (NSInteger)rowBytes
+                                        bitsPerPixel: (NSInteger)pixelBits;
+@end
+
+static NSBitmapImageRep *
+newRep(int bps, int spp, BOOL alpha, BOOL planar, NSString *space,
+  NSBitmapFormat format)
+{
+  return AUTORELEASE([[NSBitmapImageRep alloc]
+    initWithBitmapDataPlanes: NULL
+                  pixelsWide: SIZE
+                  pixelsHigh: SIZE
+               bitsPerSample: bps
+             samplesPerPixel: spp
+                    hasAlpha: alpha
+                    isPlanar: planar
+              colorSpaceName: space
+                bitmapFormat: format
+                 bytesPerRow: 0
+                bitsPerPixel: 0]);
+}
+
+static NSBitmapImageRep *
+convert(NSBitmapImageRep *rep, int bps, int spp, BOOL planar,
+  NSString *space, NSBitmapFormat format)
+{
+  return [rep _convertToFormatBitsPerSample: bps
+                            samplesPerPixel: spp
+                                   hasAlpha: [rep hasAlpha]
+                                   isPlanar: planar
+                             colorSpaceName: space
+                               bitmapFormat: format
+                                bytesPerRow: 0
+                               bitsPerPixel: 0];
+}
+
+/* Fill an RGBA bitmap with colour samples no greater than the alpha, so
+ * that the data is the same premultiplied or not where alpha is 255.
+ */
+static void
+fill(NSBitmapImageRep *rep)
+{
+  NSInteger x;
+  NSInteger y;
+  NSUInteger p[4];
+
+  for (y = 0; y < SIZE; y++)
+    {
+      for (x = 0; x < SIZE; x++)
+        {
+          p[3] = (x + y) % 256;
+          p[0] = (x * 3) % (p[3] + 1);
+          p[1] = (y * 5) % (p[3] + 1);
+          p[2] = (x ^ y) % (p[3] + 1);
+          [rep setPixel: p atX: x y: y];
+        }
+    }
+}
+
+static BOOL
+samePixels(NSBitmapImageRep *a, NSBitmapImageRep *b)
+{
+  NSInteger x;
+  NSInteger y;
+  NSInteger i;
+  NSInteger n = [a samplesPerPixel];
+  NSUInteger pa[5];
+  NSUInteger pb[5];
+
+  for (y = 0; y < SIZE; y++)
+    {
+      for (x = 0; x < SIZE; x++)
+        {
+          [a getPixel: pa atX: x y: y];
+          [b getPixel: pb atX: x y: y];
+          for (i = 0; i < n; i++)
+            {
+              if (pa[i] != pb[i])
+                return NO;
+            }
+        }
+    }
+  return YES;
+}
+
+static BOOL
+sameData(NSBitmapImageRep *a, NSBitmapImageRep *b)
+{
+  return memcmp([a bitmapData], [b bitmapData],
+    [a bytesPerRow] * [a pixelsHigh]) == 0;
+}
+
+int
+main(int argc, char **argv)
+{
+  START_SET("NSBitmapImageRep rowKernels")
+  NSBitmapImageRep *src;
+  NSBitmapImageRep *copy;
+  NSBitmapImageRep *other;
+  NSBitmapImageRep *back;
+  NSUInteger p[4];
+  BOOL ok;
+  NSInteger x;
+
+  src = newRep(8, 4, YES, NO, NSDeviceRGBColorSpace,
+    NSAlphaNonpremultipliedBitmapFormat);
+  fill(src);
+  copy = AUTORELEASE([src copy]);
+
+  [copy _premultiply];
+  PASS(([copy bitmapFormat] & NSAlphaNonpremultipliedBitmapFormat) == 0,
+       "premultiplying changes the format");
+  ok = YES;
+  for (x = 0; x < 256 && ok; x++)
+    {
+      NSUInteger s[4];
+
+      [src getPixel: s atX: x y: 0];
+      [copy getPixel: p atX: x y: 0];
+      ok = (p[0] == (s[0] * s[3] + 127) / 255 && p[3] == s[3]);
+    }
+  PASS(ok, "8 bit samples are multiplied by alpha with rounding");
+  [copy _unpremultiply];
+  ok = YES;
+  for (x = 0; x < SIZE && ok; x++)
+    {
+      NSUInteger s[4];
+
+      /* Opaque pixels lie on the diagonal x + y == 255. */
+      [src getPixel: s atX: x y: (255 + SIZE - x) % 256];
+      [copy getPixel: p atX: x y: (255 + SIZE - x) % 256];
+      ok = (s[3] == 255 && memcmp(s, p, sizeof(s)) == 0);
+    }
+  PASS(ok, "opaque pixels come back unchanged");
+  back = convert(src, 16, 4, NO,
+    NSDeviceRGBColorSpace, NSAlphaNonpremultipliedBitmapFormat);
+  [back getPixel: p atX: 255 y: 0];
+  PASS([back bitsPerSample] == 16 && p[3] == 65535,
+       "widening scales 255 to 65535");
+  other = convert(back, 8, 4, NO,
+    NSDeviceRGBColorSpace, NSAlphaNonpremultipliedBitmapFormat);
+  PASS(sameData(src, other), "8 to 16 bit and back gives the same data");
+  [back _premultiply];
+  [back _unpremultiply];
+
+  other = convert(src, 8, 4, NO,
+    NSDeviceRGBColorSpace,
+    NSAlphaNonpremultipliedBitmapFormat | NSAlphaFirstBitmapFormat);
+  [src getPixel: p atX: 7 y: 3];
+  {
+    NSUInteger q[4];
+
+    [other getPixel: q atX: 7 y: 3];
+    PASS(q[0] == p[3] && q[1] == p[0] && q[2] == p[1] && q[3] == p[2],
+         "ARGB holds the samples of RGBA");
+  }
+  back = convert(other, 8, 4, NO,
+    NSDeviceRGBColorSpace, NSAlphaNonpremultipliedBitmapFormat);
+  PASS(sameData(src, back), "RGBA to ARGB and back gives the same data");
+
+  other = convert(src, 8, 4, YES,
+    NSDeviceRGBColorSpace, NSAlphaNonpremultipliedBitmapFormat);
+  PASS([other isPlanar] && samePixels(src, other),
+       "planar data has the same pixels");
+  back = convert(other, 8, 4, NO,
+    NSDeviceRGBColorSpace, NSAlphaNonpremultipliedBitmapFormat);
+  PASS(sameData(src, back), "meshed to planar and back gives the same data");
+
+  other = convert(src, 8, 4, NO,
+    NSDeviceRGBColorSpace, 0);
+  copy = AUTORELEASE([src copy]);
+  [copy _premultiply];
+  PASS(sameData(copy, other),
+       "converting to premultiplied matches premultiplying");
+
+  src = newRep(8, 2, YES, NO, NSDeviceWhiteColorSpace,
+    NSAlphaNonpremultipliedBitmapFormat);
+  p[0] = 77;
+  p[1] = 200;
+  for (x = 0; x < SIZE; x++)
+    {
+      [src setPixel: p atX: x y: x];
+    }
+  other = convert(src, 8, 4, NO,
+    NSDeviceRGBColorSpace, NSAlphaNonpremultipliedBitmapFormat);
+  [other getPixel: p atX: 9 y: 9];
+  PASS(p[0] == 77 && p[1] == 77 && p[2] == 77 && p[3] == 200,
+       "gray samples are copied to red, green and blue");
+
+  END_SET("NSBitmapImageRep rowKernels")
+  return 0;
+}
@@ -0,0 +1,186 @@
+/* A collection view with a layout realises only the items in sight, plus a
+   margin, and recycles those scrolled away through
+   -makeItemWithIdentifier:forIndexPath:.  Show a grid of many items in a
+   small scroll view and check that few items are made, that scrolling
+   reuses them rather than making new ones, that the items in sight are
+   where the layout puts them, and that resizing lays the items out again
+   without reloading them.  Reloading with no sections leaves no items.
+   The views use the theme and font backend, so the set is skipped when
+   the backend is unavailable.
+*/
+#include "Testing.h"
+
+#include <Foundation/NSAutoreleasePool.h>
+#include <Foundation/NSGeometry.h>
+#include <Foundation/NSIndexPath.h>
+
+#include <AppKit/NSApplication.h>
+#include <AppKit/NSClipView.h>
+#include <AppKit/NSCollectionView.h>
+#include <AppKit/NSCollectionViewGridLayout.h>
+#include <AppKit/NSCollectionViewItem.h>
+#include <AppKit/NSScrollView.h>
+
+#define COUNT 100000
+#define STEPS 1000
+
+static int made = 0;
+
+@interface Photo : NSCollectionViewItem
+@end
+@implementation Photo
+- (id) init
+{
+  if ((self = [super init]) != nil)
+    {
+      made++;
+    }
+  return self;
+}
+- (void) loadView
+{
+  [self setView: AUTORELEASE([[NSView alloc]
+    initWithFrame: NSMakeRect(0, 0, 100, 100)])];
+}
+@end
+
+@interface Photos : NSObject <NSCollectionViewDataSource>
+{
+@public
+  int asked;
+  BOOL empty;
+}
+@end
+@implementation Photos
+- (NSInteger) numberOfSectionsInCollectionView: (NSCollectionView *)cv
+{
+  return empty ? 0 : 1;
+}
+- (NSInteger) collectionView: (NSCollectionView *)cv
+       numberOfItemsInSection: (NSInteger)section
+{
+  return COUNT;
+}
+- (NSCollectionViewItem *) collectionView: (NSCollectionView *)cv
+        itemForRepresentedObjectAtIndexPath: (NSIndexPath *)indexPath
+{
+  asked++;
+  return [cv makeItemWithIdentifier: @"Photo" forIndexPath: indexPath];
+}
+@end
+
+int
+main(int argc, char **argv)
+{
+  START_SET("NSCollectionView virtualItems")
+
+  NS_DURING
+    {
+      [NSApplication sharedApplication];
+    }
+  NS_HANDLER
+    {
+      if ([[localException name] isEqualToString: NSInternalInconsistencyException])
+        SKIP("It looks like GNUstep backend is not yet installed")
+    }
+  NS_ENDHANDLER
+
+  NS_DURING
+    {
+      Photos *photos = AUTORELEASE([Photos new]);
+      NSCollectionViewGridLayout *grid;
+      NSCollectionView *cv;
+      NSScrollView *sv;
+      NSClipView *clip;
+      NSCollectionViewItem *first;
+      NSCollectionViewItem *item;
+      NSIndexPath *p;
+      NSUInteger most = 0;
+      int before;
+      int i;
+
+      sv = AUTORELEASE([[NSScrollView alloc]
+        initWithFrame: NSMakeRect(0, 0, 400, 300)]);
+      cv = AUTORELEASE([[NSCollectionView alloc]
+        initWithFrame: NSMakeRect(0, 0, 400, 300)]);
+      [sv setDocumentView: cv];
+      clip = [sv contentView];
+
+      grid = AUTORELEASE([[NSCollectionViewGridLayout alloc] init]);
+      [grid setMinimumItemSize: NSMakeSize(100, 100)];
+      [grid setMaximumItemSize: NSMakeSize(100, 100)];
+      [cv registerClass: [Photo class] forItemWithIdentifier: @"Photo"];
+      [cv setCollectionViewLayout: grid];
+
+      [cv setDataSource: photos];
+      PASS([[cv visibleItems] count] > 0 && [[cv visibleItems] count] < 100,
+           "only the items in sight and a margin are realised");
+      PASS(made == (int)[[cv visibleItems] count]
+           && photos->asked == made,
+           "an item is made for each of them only");
+      PASS(NSHeight([cv frame]) >= (COUNT / 4) * 100.0,
+           "the view is as tall as all the items");
+
+      for (i = 1; i <= STEPS; i++)
+        {
+          CREATE_AUTORELEASE_POOL(pool);
+
+          [clip scrollToPoint: NSMakePoint(0, i * 100.0)];
+          most = MAX(most, [[cv visibleItems] count]);
+          [pool drain];
+        }
+      PASS(most < 100, "scrolling keeps few items realised");
+      PASS(made <= (int)(2 * most) && photos->asked > made,
+           "items scrolled away are reused");
+
+      /* Row 1000 is in sight at the end. */
+      p = [NSIndexPath indexPathForItem: 4001 inSection: 0];
+      item = [cv itemAtIndexPath: p];
+      PASS(item != nil
+           && NSEqualRects([[item view] frame],
+                           NSMakeRect(100, 100000, 100, 100)),
+           "an item in sight is where the layout puts it");
+      PASS([[cv indexPathsForVisibleItems] containsObject: p],
+           "its index path is among those of the visible items");
+      PASS([cv itemAtIndexPath: [NSIndexPath indexPathForItem: 0
+                                                    inSection: 0]] == nil,
+           "an item scrolled away is not realised");
+
+      [clip scrollToPoint: NSZeroPoint];
+      first = [cv itemAtIndexPath: [NSIndexPath indexPathForItem: 0
+                                                       inSection: 0]];
+      before = photos->asked;
+      [sv setFrameSize: NSMakeSize(600, 300)];
+      item = [cv itemAtIndexPath: [NSIndexPath indexPathForItem: 5
+                                                      inSection: 0]];
+      PASS(first != nil
+           && [cv itemAtIndexPath: [NSIndexPath indexPathForItem: 0
+                                                       inSection: 0]] == first,
+           "resizing keeps the items in sight");
+      PASS(item != nil && NSMinX([[item view] frame]) == 500.0
+           && NSMinY([[item view] frame]) == 0.0,
+           "resizing lays the items out for the new width");
+      PASS(photos->asked - before < (int)[[cv visibleItems] count],
+           "resizing asks only for the items coming in sight");
+
+      photos->empty = YES;
+      [cv reloadData];
+      PASS([[cv visibleItems] count] == 0 && [[cv subviews] count] == 0,
+           "reloading with no sections removes the items");
+
+      [cv setDataSource: nil];
+    }
+  NS_HANDLER
+    {
+      if ([[localException name] isEqualToString: NSInternalInconsistencyException]
+        || [[localException name] isEqualToString: @"NSWindowServerCommunicationException"])
+        SKIP("No display available")
+      else
+        [localException raise];
+    }
+  NS_ENDHANDLER
+
+  END_SET("NSCollectionView virtualItems")
+
+  return 0;
+}
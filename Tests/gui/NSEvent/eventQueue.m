@@ -0,0 +1,137 @@
+/* The display server keeps its events in a ring buffer and can merge mouse
+   motion and scroll wheel events posted one after the other.  Post many of
+   them and check that one event with the summed deltas comes out, that
+   other events keep their order, and that the queue counters add up.  */
+#include "Testing.h"
+
+#include <Foundation/NSAutoreleasePool.h>
+#include <Foundation/NSDate.h>
+#include <Foundation/NSDictionary.h>
+#include <Foundation/NSString.h>
+#include <Foundation/NSValue.h>
+
+#include <AppKit/NSApplication.h>
+#include <AppKit/NSEvent.h>
+#include <GNUstepGUI/GSDisplayServer.h>
+
+static NSEvent *
+motion(NSEventType type, CGFloat x, CGFloat dx)
+{
+  return [NSEvent mouseEventWithType: type
+                            location: NSMakePoint(x, 0)
+                       modifierFlags: 0
+                           timestamp: 0
+                        windowNumber: 0
+                             context: nil
+                         eventNumber: 0
+                          clickCount: 0
+                            pressure: 0
+                        buttonNumber: 0
+                              deltaX: dx
+                              deltaY: 1.0
+                              deltaZ: 0];
+}
+
+static NSEvent *
+next(void)
+{
+  return [NSApp nextEventMatchingMask: NSAnyEventMask
+                            untilDate: [NSDate distantPast]
+                               inMode: NSDefaultRunLoopMode
+                              dequeue: YES];
+}
+
+static NSUInteger
+counter(GSDisplayServer *server, NSString *key)
+{
+  return [[[server eventQueueStatistics] objectForKey: key]
+           unsignedIntegerValue];
+}
+
+int
+main(int argc, char **argv)
+{
+  START_SET("NSEvent eventQueue")
+
+  NS_DURING
+    {
+      [NSApplication sharedApplication];
+    }
+  NS_HANDLER
+    {
+      if ([[localException name] isEqualToString: NSInternalInconsistencyException])
+        SKIP("It looks like GNUstep backend is not yet installed")
+    }
+  NS_ENDHANDLER
+
+  NS_DURING
+    {
+      GSDisplayServer *server = GSCurrentServer();
+      NSEvent *e;
+      int i;
+
+      while (next() != nil)
+        ;
+      [server setCoalescesEvents: YES];
+      [server resetEventQueueStatistics];
+      for (i = 1; i <= 1000; i++)
+        {
+          [NSApp postEvent: motion(NSMouseMoved, i, 1.0) atStart: NO];
+        }
+      PASS(counter(server, @"Depth") == 1,
+           "consecutive mouse moves are merged");
+      PASS(counter(server, @"Posted") == 1000
+        && counter(server, @"Coalesced") == 999,
+           "the merged events are counted");
+      e = next();
+      PASS([e type] == NSMouseMoved && [e locationInWindow].x == 1000
+        && [e deltaX] == 1000.0 && [e deltaY] == 1000.0,
+           "the merged event is at the last location with summed deltas");
+
+      [NSApp postEvent: motion(NSScrollWheel, 0, 2.0) atStart: NO];
+      [NSApp postEvent: motion(NSScrollWheel, 0, 3.0) atStart: NO];
+      [NSApp postEvent: motion(NSLeftMouseDragged, 5, 1.0) atStart: NO];
+      [NSApp postEvent: motion(NSScrollWheel, 0, 4.0) atStart: NO];
+      PASS(counter(server, @"Depth") == 3,
+           "only events following a like event are merged");
+      e = next();
+      PASS([e type] == NSScrollWheel && [e deltaX] == 5.0,
+           "scroll wheel deltas are summed");
+      PASS([next() type] == NSLeftMouseDragged
+        && [next() deltaX] == 4.0, "other events keep their order");
+
+      [server setCoalescesEvents: NO];
+      for (i = 0; i < 1000; i++)
+        {
+          [NSApp postEvent: motion(NSMouseMoved, i, 1.0) atStart: (i % 2)];
+        }
+      PASS(counter(server, @"Depth") == 1000
+        && counter(server, @"MaxDepth") == 1000,
+           "without merging every event is queued");
+      for (i = 0; i < 500; i++)
+        {
+          e = next();
+          if ([e locationInWindow].x != 999 - 2 * i)
+            break;
+        }
+      PASS(i == 500, "events posted at the start come first");
+      for (i = 0; i < 500; i++)
+        {
+          e = next();
+          if ([e locationInWindow].x != 2 * i)
+            break;
+        }
+      PASS(i == 500 && next() == nil, "events posted at the end come last");
+    }
+  NS_HANDLER
+    {
+      if ([[localException name] isEqualToString: NSInternalInconsistencyException]
+        || [[localException name] isEqualToString: @"NSWindowServerCommunicationException"])
+        SKIP("No display available");
+    }
+  NS_ENDHANDLER
+
+  END_SET("NSEvent eventQueue")
+
+  return 0;
+}
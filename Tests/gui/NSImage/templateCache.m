@@ -0,0 +1,166 @@
+/* A template image is drawn through a mask filled with the current colour,
+ * and the masks are cached.  Draw a template image many times and check
+ * that the mask is drawn once per colour, that the cached mask still has
+ * the right colour, that removing a representation or deallocating an
+ * image drops only its masks, and that the cache is emptied when a theme
+ * is activated.
+ */
+#import <Foundation/NSObject.h>
+#import "Testing.h"
+
+#import <AppKit/AppKit.h>
+#import <GNUstepGUI/GSTheme.h>
+
+#define	DRAWS	1000
+
+static NSUInteger
+counter(NSString *key)
+{
+  return [[GSImageTemplateCacheStatistics() objectForKey: key]
+	   unsignedIntegerValue];
+}
+
+/* A black template shape, opaque in the left half only. */
+static NSImage *
+templateImage(int n)
+{
+  NSBitmapImageRep *rep = [[NSBitmapImageRep alloc]
+    initWithBitmapDataPlanes: NULL pixelsWide: n pixelsHigh: n
+                bitsPerSample: 8 samplesPerPixel: 4 hasAlpha: YES isPlanar: NO
+               colorSpaceName: NSDeviceRGBColorSpace
+                 bitmapFormat: NSAlphaNonpremultipliedBitmapFormat
+                  bytesPerRow: n * 4 bitsPerPixel: 32];
+  unsigned char *d = [rep bitmapData];
+  NSImage *img;
+  int x;
+  int y;
+
+  for (y = 0; y < n; y++)
+    {
+      for (x = 0; x < n; x++)
+        {
+          unsigned char *p = d + (y * n + x) * 4;
+
+          p[0] = p[1] = p[2] = 0;
+          p[3] = (x < n / 2) ? 255 : 0;
+        }
+    }
+  img = [[NSImage alloc] initWithSize: NSMakeSize(n, n)];
+  [img addRepresentation: rep];
+  [img setTemplate: YES];
+  [rep release];
+  return AUTORELEASE(img);
+}
+
+static void
+drawIn(NSImage *img, NSColor *color, int times)
+{
+  int i;
+
+  [color set];
+  for (i = 0; i < times; i++)
+    {
+      [img drawInRect: NSMakeRect(0, 0, 20, 20)
+             fromRect: NSZeroRect
+            operation: NSCompositeSourceOver
+             fraction: 1.0];
+    }
+}
+
+int
+main(int argc, const char **argv)
+{
+  START_SET("NSImage templateCache")
+
+  NS_DURING
+    {
+      [NSApplication sharedApplication];
+    }
+  NS_HANDLER
+    {
+      SKIP("It looks like GNUstep backend is not yet installed")
+    }
+  NS_ENDHANDLER
+
+  NS_DURING
+    {
+      NSImage *img = templateImage(20);
+      NSImage *dst = AUTORELEASE([[NSImage alloc]
+        initWithSize: NSMakeSize(20, 20)]);
+      NSBitmapImageRep *rep;
+      NSImageRep *drawn;
+      NSColor *c;
+
+      [[NSNotificationCenter defaultCenter]
+        postNotificationName: GSThemeDidActivateNotification
+                      object: nil];
+      GSImageResetTemplateCacheStatistics();
+      PASS(counter(@"Entries") == 0, "the cache starts empty");
+
+      [dst lockFocus];
+      [[NSColor whiteColor] set];
+      NSRectFill(NSMakeRect(0, 0, 20, 20));
+      drawIn(img, [NSColor redColor], DRAWS);
+      PASS(counter(@"Misses") == 1 && counter(@"Hits") == DRAWS - 1,
+           "the mask is drawn once for many draws in one colour");
+
+      drawIn(img, [NSColor blueColor], 1);
+      PASS(counter(@"Misses") == 2 && counter(@"Entries") == 2,
+           "another colour needs another mask");
+      drawIn(img, [NSColor redColor], 1);
+      PASS(counter(@"Misses") == 2, "the first mask is still cached");
+
+      [[NSGraphicsContext currentContext] flushGraphics];
+      rep = AUTORELEASE([[NSBitmapImageRep alloc]
+        initWithFocusedViewRect: NSMakeRect(0, 0, 20, 20)]);
+      [dst unlockFocus];
+      c = [[rep colorAtX: 5 y: 10]
+        colorUsingColorSpaceName: NSDeviceRGBColorSpace];
+      PASS([c redComponent] > 0.95 && [c blueComponent] < 0.05,
+           "a cached mask draws in its colour");
+      c = [[rep colorAtX: 15 y: 10]
+        colorUsingColorSpaceName: NSDeviceRGBColorSpace];
+      PASS([c greenComponent] > 0.95,
+           "a cached mask keeps the shape of the image");
+
+      [dst lockFocus];
+      {
+        CREATE_AUTORELEASE_POOL(pool);
+
+        drawIn(templateImage(20), [NSColor redColor], 1);
+        PASS(counter(@"Entries") == 3, "another image needs another mask");
+        [pool drain];
+      }
+      [dst unlockFocus];
+      PASS(counter(@"Entries") == 2,
+           "the masks of a deallocated image are dropped");
+
+      drawn = [[img representations] objectAtIndex: 0];
+      [img addRepresentation: rep];
+      [img removeRepresentation: rep];
+      PASS(counter(@"Entries") == 2,
+           "removing a representation keeps the masks of the others");
+      RETAIN(drawn);
+      [img removeRepresentation: drawn];
+      PASS(counter(@"Entries") == 0,
+           "removing a representation drops its masks");
+      [img addRepresentation: drawn];
+      RELEASE(drawn);
+
+      [[NSNotificationCenter defaultCenter]
+        postNotificationName: GSThemeDidActivateNotification
+                      object: nil];
+      PASS(counter(@"Entries") == 0,
+           "activating a theme empties the cache");
+    }
+  NS_HANDLER
+    {
+      if ([[localException name] isEqualToString: NSInternalInconsistencyException]
+        || [[localException name] isEqualToString: @"NSWindowServerCommunicationException"])
+        SKIP("No display available");
+    }
+  NS_ENDHANDLER
+
+  END_SET("NSImage templateCache")
+  return 0;
+}
@@ -0,0 +1,130 @@
+/* With background layout enabled, a layout manager lays out its text from
+   timers in the run loop rather than when the text is set, and tells its
+   delegate once the text container is complete.  Asking for the used rect
+   in the meantime doesn't force the rest of the layout.  The typesetter
+   uses the font backend, so the set is skipped when the backend is
+   unavailable.
+*/
+#include "Testing.h"
+
+#include <Foundation/NSAutoreleasePool.h>
+#include <Foundation/NSDate.h>
+#include <Foundation/NSDictionary.h>
+#include <Foundation/NSGeometry.h>
+#include <Foundation/NSRunLoop.h>
+#include <Foundation/NSString.h>
+
+#include <AppKit/NSApplication.h>
+#include <AppKit/NSFont.h>
+#include <AppKit/NSLayoutManager.h>
+#include <AppKit/NSTextContainer.h>
+#include <AppKit/NSTextStorage.h>
+
+@interface Watcher : NSObject
+{
+@public
+  int completions;
+  BOOL atEnd;
+}
+@end
+
+@implementation Watcher
+- (void) layoutManager: (NSLayoutManager *)lm
+  didCompleteLayoutForTextContainer: (NSTextContainer *)tc
+                 atEnd: (BOOL)flag
+{
+  completions++;
+  atEnd = flag;
+}
+@end
+
+int
+main(int argc, char **argv)
+{
+  START_SET("NSLayoutManager backgroundLayout")
+
+  NS_DURING
+    {
+      [NSApplication sharedApplication];
+    }
+  NS_HANDLER
+    {
+      if ([[localException name] isEqualToString: NSInternalInconsistencyException])
+        SKIP("It looks like GNUstep backend is not yet installed")
+    }
+  NS_ENDHANDLER
+
+  NS_DURING
+    {
+      const NSUInteger length = 20000;
+      NSFont *font = [NSFont userFontOfSize: 12.0];
+      NSDictionary *attrs = [NSDictionary dictionaryWithObjectsAndKeys:
+        font, NSFontAttributeName, nil];
+      NSString *s = [@"" stringByPaddingToLength: length
+                                      withString: @"some words\n"
+                                 startingAtIndex: 0];
+      NSTextStorage *ts = AUTORELEASE([[NSTextStorage alloc]
+        initWithString: s attributes: attrs]);
+      NSLayoutManager *lm = AUTORELEASE([[NSLayoutManager alloc] init]);
+      NSTextContainer *tc = AUTORELEASE([[NSTextContainer alloc]
+        initWithContainerSize: NSMakeSize(300, 1.0e7)]);
+      Watcher *w = AUTORELEASE([[Watcher alloc] init]);
+      NSDate *limit;
+      NSRect used;
+
+      PASS([lm backgroundLayoutEnabled] == NO,
+           "background layout is disabled by default");
+      [lm setBackgroundLayoutEnabled: YES];
+      PASS([lm backgroundLayoutEnabled] == YES,
+           "backgroundLayoutEnabled round-trips");
+
+      [lm setDelegate: w];
+      [lm addTextContainer: tc];
+      [ts addLayoutManager: lm];
+
+      used = [lm usedRectForTextContainer: tc];
+      PASS([lm firstUnlaidCharacterIndex] == 0,
+           "nothing is laid out until the run loop runs");
+      PASS(NSEqualRects(used, NSZeroRect),
+           "the used rect covers only the text laid out so far");
+
+      limit = [NSDate dateWithTimeIntervalSinceNow: 30.0];
+      while (w->completions == 0 && [limit timeIntervalSinceNow] > 0)
+        {
+          [[NSRunLoop currentRunLoop]
+            runMode: NSDefaultRunLoopMode
+            beforeDate: [NSDate dateWithTimeIntervalSinceNow: 0.1]];
+        }
+
+      PASS(w->completions == 1 && w->atEnd,
+           "the delegate is told when background layout reaches the end");
+      PASS([lm firstUnlaidCharacterIndex] == length,
+           "background layout lays out all the text");
+      used = [lm usedRectForTextContainer: tc];
+      PASS(NSHeight(used) > 1000.0,
+           "the used rect grows with background layout");
+
+      [ts replaceCharactersInRange: NSMakeRange(0, 0) withString: @"x"];
+      PASS([lm firstUnlaidCharacterIndex] < length + 1,
+           "an edit invalidates layout");
+      limit = [NSDate dateWithTimeIntervalSinceNow: 30.0];
+      while (w->completions == 1 && [limit timeIntervalSinceNow] > 0)
+        {
+          [[NSRunLoop currentRunLoop]
+            runMode: NSDefaultRunLoopMode
+            beforeDate: [NSDate dateWithTimeIntervalSinceNow: 0.1]];
+        }
+      PASS([lm firstUnlaidCharacterIndex] == length + 1,
+           "background layout resumes after an edit");
+    }
+  NS_HANDLER
+    {
+      if ([[localException name] isEqualToString: NSInternalInconsistencyException]
+        || [[localException name] isEqualToString: @"NSWindowServerCommunicationException"])
+        SKIP("No display available");
+    }
+  NS_ENDHANDLER
+
+  END_SET("NSLayoutManager backgroundLayout")
+  return 0;
+}
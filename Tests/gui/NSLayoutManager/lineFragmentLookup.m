@@ -0,0 +1,103 @@
+/* Line frags are looked up by glyph and by point with binary searches.
+   Check that the lookups agree with each other over many lines, also for
+   points on the boundary between two lines and after an edit has soft
+   invalidated the layout.  The typesetter uses the font backend, so the
+   set is skipped when the backend is unavailable.
+*/
+#include "Testing.h"
+
+#include <Foundation/NSAutoreleasePool.h>
+#include <Foundation/NSDictionary.h>
+#include <Foundation/NSGeometry.h>
+#include <Foundation/NSString.h>
+
+#include <AppKit/NSApplication.h>
+#include <AppKit/NSFont.h>
+#include <AppKit/NSLayoutManager.h>
+#include <AppKit/NSTextContainer.h>
+#include <AppKit/NSTextStorage.h>
+
+static BOOL
+lookupsAgree(NSLayoutManager *lm, NSTextContainer *tc, NSUInteger lines)
+{
+  NSUInteger line;
+
+  for (line = 0; line < lines; line += 97)
+    {
+      NSUInteger glyph = line * 11;
+      NSRange r;
+      NSRect rect;
+      NSUInteger hit;
+
+      rect = [lm lineFragmentRectForGlyphAtIndex: glyph effectiveRange: &r];
+      if (!NSLocationInRange(glyph, r))
+        return NO;
+      hit = [lm glyphIndexForPoint: NSMakePoint(NSMinX(rect) + 1.0,
+                                                NSMidY(rect))
+                   inTextContainer: tc];
+      if (!NSLocationInRange(hit, r))
+        return NO;
+      /* A point on the top edge of a line is in that line, not the one
+         above it. */
+      hit = [lm glyphIndexForPoint: NSMakePoint(NSMinX(rect) + 1.0,
+                                                NSMinY(rect))
+                   inTextContainer: tc];
+      if (!NSLocationInRange(hit, r))
+        return NO;
+    }
+  return YES;
+}
+
+int
+main(int argc, char **argv)
+{
+  START_SET("NSLayoutManager lineFragmentLookup")
+
+  NS_DURING
+    {
+      [NSApplication sharedApplication];
+    }
+  NS_HANDLER
+    {
+      if ([[localException name] isEqualToString: NSInternalInconsistencyException])
+        SKIP("It looks like GNUstep backend is not yet installed")
+    }
+  NS_ENDHANDLER
+
+  NS_DURING
+    {
+      const NSUInteger lines = 5000;
+      NSFont *font = [NSFont userFontOfSize: 12.0];
+      NSDictionary *attrs = [NSDictionary dictionaryWithObjectsAndKeys:
+        font, NSFontAttributeName, nil];
+      NSString *s = [@"" stringByPaddingToLength: lines * 11
+                                      withString: @"some words\n"
+                                 startingAtIndex: 0];
+      NSTextStorage *ts = AUTORELEASE([[NSTextStorage alloc]
+        initWithString: s attributes: attrs]);
+      NSLayoutManager *lm = AUTORELEASE([[NSLayoutManager alloc] init]);
+      NSTextContainer *tc = AUTORELEASE([[NSTextContainer alloc]
+        initWithContainerSize: NSMakeSize(300, 1.0e7)]);
+
+      [lm addTextContainer: tc];
+      [ts addLayoutManager: lm];
+
+      PASS(lookupsAgree(lm, tc, lines),
+           "line frag lookups by glyph and by point agree");
+
+      /* Same length, so the glyphs of each line stay put. */
+      [ts replaceCharactersInRange: NSMakeRange(22, 4) withString: @"WORD"];
+      PASS(lookupsAgree(lm, tc, lines),
+           "they still agree after soft invalidation");
+    }
+  NS_HANDLER
+    {
+      if ([[localException name] isEqualToString: NSInternalInconsistencyException]
+        || [[localException name] isEqualToString: @"NSWindowServerCommunicationException"])
+        SKIP("No display available");
+    }
+  NS_ENDHANDLER
+
+  END_SET("NSLayoutManager lineFragmentLookup")
+  return 0;
+}
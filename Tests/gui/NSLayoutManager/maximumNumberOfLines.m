@@ -0,0 +1,133 @@
+/* A text container with a maximum number of lines is full once it holds
+   that many lines.  In a text container with a column gap each line is cut
+   into two line frags on the same baseline, which count as one line.  The
+   maximum is kept when the text container is archived.  The
+   typesetter uses the font backend, so the set is skipped when the backend
+   is unavailable.
+*/
+#include "Testing.h"
+
+#include <Foundation/NSAutoreleasePool.h>
+#include <Foundation/NSData.h>
+#include <Foundation/NSKeyedArchiver.h>
+#include <Foundation/NSGeometry.h>
+#include <Foundation/NSString.h>
+
+#include <AppKit/NSApplication.h>
+#include <AppKit/NSLayoutManager.h>
+#include <AppKit/NSTextContainer.h>
+#include <AppKit/NSTextStorage.h>
+
+@interface TwoColumns : NSTextContainer
+@end
+
+@implementation TwoColumns
+
+- (BOOL) isSimpleRectangularTextContainer
+{
+  return NO;
+}
+
+- (NSRect) lineFragmentRectForProposedRect: (NSRect)proposedRect
+                            sweepDirection: (NSLineSweepDirection)sweepDirection
+                         movementDirection: (NSLineMovementDirection)movementDirection
+                             remainingRect: (NSRect *)remainingRect
+{
+  NSRect r = [super lineFragmentRectForProposedRect: proposedRect
+                                     sweepDirection: sweepDirection
+                                  movementDirection: movementDirection
+                                      remainingRect: remainingRect];
+  CGFloat mid = [self containerSize].width / 2;
+
+  if (!NSIsEmptyRect(r) && NSMinX(r) < mid - 10 && NSMaxX(r) > mid + 10)
+    {
+      *remainingRect = NSMakeRect(mid + 10, NSMinY(r),
+                                  NSMaxX(r) - mid - 10, NSHeight(r));
+      r.size.width = mid - 10 - NSMinX(r);
+    }
+  return r;
+}
+
+@end
+
+int
+main(int argc, char **argv)
+{
+  START_SET("NSLayoutManager maximumNumberOfLines")
+
+  NS_DURING
+    {
+      [NSApplication sharedApplication];
+    }
+  NS_HANDLER
+    {
+      if ([[localException name] isEqualToString: NSInternalInconsistencyException])
+        SKIP("It looks like GNUstep backend is not yet installed")
+    }
+  NS_ENDHANDLER
+
+  NS_DURING
+    {
+      NSString *s = [@"" stringByPaddingToLength: 5000
+                                      withString: @"some words "
+                                 startingAtIndex: 0];
+      NSTextStorage *ts = AUTORELEASE([[NSTextStorage alloc]
+        initWithString: s]);
+      NSLayoutManager *lm = AUTORELEASE([[NSLayoutManager alloc] init]);
+      TwoColumns *tc = AUTORELEASE([[TwoColumns alloc]
+        initWithContainerSize: NSMakeSize(300, 1.0e7)]);
+      NSTextContainer *copy;
+      NSData *data;
+      NSRange laidOut, r;
+      NSUInteger g, frags = 0, lines = 0;
+      CGFloat y = -1.0;
+
+      [tc setMaximumNumberOfLines: 3];
+      PASS([tc maximumNumberOfLines] == 3,
+           "maximumNumberOfLines round-trips");
+      [lm addTextContainer: tc];
+      [ts addLayoutManager: lm];
+
+      laidOut = [lm glyphRangeForTextContainer: tc];
+      for (g = laidOut.location; g < NSMaxRange(laidOut); g = NSMaxRange(r))
+        {
+          NSRect rect = [lm lineFragmentRectForGlyphAtIndex: g
+                                             effectiveRange: &r];
+
+          frags++;
+          if (NSMinY(rect) != y)
+            lines++;
+          y = NSMinY(rect);
+        }
+      PASS(laidOut.length > 0 && laidOut.length < [lm numberOfGlyphs],
+           "the text container is full before the end of the text");
+      PASS(frags == 6, "each line has two line frags");
+      PASS(lines == 3, "the text container holds three lines");
+
+      [tc setMaximumNumberOfLines: 0];
+      PASS([tc maximumNumberOfLines] == 0
+           && NSMaxRange([lm glyphRangeForTextContainer: tc])
+              == [lm numberOfGlyphs],
+           "without a maximum all text is laid out");
+
+      copy = AUTORELEASE([[NSTextContainer alloc]
+        initWithContainerSize: NSMakeSize(300, 300)]);
+      [copy setMaximumNumberOfLines: 4];
+      data = [NSKeyedArchiver archivedDataWithRootObject: copy];
+      copy = [NSKeyedUnarchiver unarchiveObjectWithData: data];
+      PASS([copy maximumNumberOfLines] == 4,
+           "the maximum number of lines is archived");
+    }
+  NS_HANDLER
+    {
+      if ([[localException name] isEqualToString: NSInternalInconsistencyException]
+        || [[localException name] isEqualToString: @"NSWindowServerCommunicationException"])
+        SKIP("No display available")
+      else
+        [localException raise];
+    }
+  NS_ENDHANDLER
+
+  END_SET("NSLayoutManager maximumNumberOfLines")
+  return 0;
+}
@@ -0,0 +1,112 @@
+/* With non-contiguous layout, asking for layout far into a long text lays
+   out the paragraphs that were asked for and estimates the height of the
+   text in between instead of laying it out.  The estimate is filled in
+   when layout is asked for inside it.  An edit above the estimate leaves
+   it soft invalidated, where it doesn't count as layout until layout is
+   asked for below it again.  The typesetter uses the font
+   backend, so the set is skipped when the backend is unavailable.
+*/
+#include "Testing.h"
+
+#include <Foundation/NSAutoreleasePool.h>
+#include <Foundation/NSDictionary.h>
+#include <Foundation/NSGeometry.h>
+#include <Foundation/NSString.h>
+
+#include <AppKit/NSApplication.h>
+#include <AppKit/NSFont.h>
+#include <AppKit/NSLayoutManager.h>
+#include <AppKit/NSTextContainer.h>
+#include <AppKit/NSTextStorage.h>
+
+int
+main(int argc, char **argv)
+{
+  START_SET("NSLayoutManager nonContiguousLayout")
+
+  NS_DURING
+    {
+      [NSApplication sharedApplication];
+    }
+  NS_HANDLER
+    {
+      if ([[localException name] isEqualToString: NSInternalInconsistencyException])
+        SKIP("It looks like GNUstep backend is not yet installed")
+    }
+  NS_ENDHANDLER
+
+  NS_DURING
+    {
+      const NSUInteger length = 200000;
+      NSFont *font = [NSFont userFontOfSize: 12.0];
+      NSDictionary *attrs = [NSDictionary dictionaryWithObjectsAndKeys:
+        font, NSFontAttributeName, nil];
+      NSString *s = [@"" stringByPaddingToLength: length
+                                      withString: @"some words\n"
+                                 startingAtIndex: 0];
+      NSTextStorage *ts = AUTORELEASE([[NSTextStorage alloc]
+        initWithString: s attributes: attrs]);
+      NSLayoutManager *lm = AUTORELEASE([[NSLayoutManager alloc] init]);
+      NSTextContainer *tc = AUTORELEASE([[NSTextContainer alloc]
+        initWithContainerSize: NSMakeSize(300, 1.0e7)]);
+      NSUInteger glyph;
+      NSRange r;
+      NSRect used, line, first;
+
+      [lm addTextContainer: tc];
+      [ts addLayoutManager: lm];
+      [lm setAllowsNonContiguousLayout: YES];
+      PASS([lm allowsNonContiguousLayout] == YES,
+           "allowsNonContiguousLayout round-trips");
+
+      glyph = length / 2;
+      line = [lm lineFragmentRectForGlyphAtIndex: glyph effectiveRange: &r];
+      PASS([lm hasNonContiguousLayout],
+           "layout far into the text leaves a gap");
+      PASS([lm firstUnlaidCharacterIndex] < length,
+           "text after the glyph isn't laid out");
+      PASS(NSLocationInRange(glyph, r) && NSHeight(line) > 0.0
+           && NSHeight(line) < 100.0,
+           "the line of the glyph is laid out for real");
+      PASS(NSMinY(line) > 50000.0,
+           "the line is placed below the estimated text");
+
+      used = [lm usedRectForTextContainer: tc];
+      PASS(NSMaxY(used) >= NSMaxY(line),
+           "the used rect covers the estimated text");
+
+      first = [lm lineFragmentRectForGlyphAtIndex: length / 4
+                                   effectiveRange: &r];
+      PASS(NSLocationInRange(length / 4, r) && NSHeight(first) < 100.0,
+           "layout inside the gap fills it in");
+      PASS(NSMinY(first) < NSMinY(line),
+           "filled in text stays above later text");
+
+      [ts replaceCharactersInRange: NSMakeRange(0, 1) withString: @"x"];
+      PASS(![lm hasNonContiguousLayout],
+           "an edit above the gaps soft invalidates them");
+      [lm lineFragmentRectForGlyphAtIndex: glyph effectiveRange: NULL];
+      PASS([lm hasNonContiguousLayout],
+           "layout far into the text after an edit leaves a gap again");
+
+      [lm ensureLayoutForCharacterRange: NSMakeRange(0, length)];
+      PASS(![lm hasNonContiguousLayout],
+           "ensuring layout for all the text fills in every gap");
+
+      [lm setAllowsNonContiguousLayout: NO];
+      [ts replaceCharactersInRange: NSMakeRange(0, 0) withString: @"x"];
+      [lm lineFragmentRectForGlyphAtIndex: length / 2 effectiveRange: NULL];
+      PASS(![lm hasNonContiguousLayout],
+           "without non-contiguous layout, layout is contiguous");
+    }
+  NS_HANDLER
+    {
+      if ([[localException name] isEqualToString: NSInternalInconsistencyException]
+        || [[localException name] isEqualToString: @"NSWindowServerCommunicationException"])
+        SKIP("No display available");
+    }
+  NS_ENDHANDLER
+
+  END_SET("NSLayoutManager nonContiguousLayout")
+  return 0;
+}
@@ -0,0 +1,139 @@
+/* Parallel layout stacks up paragraphs laid out in worker threads.  The
+   result should be the same as laying the text out in one go, also when
+   only the layout up to a glyph is asked for, and when the layout manager
+   doesn't use the leading of the fonts.  The typesetter uses the font
+   backend, so the set is skipped when the backend is unavailable.
+*/
+#include "Testing.h"
+
+#include <Foundation/NSAutoreleasePool.h>
+#include <Foundation/NSDictionary.h>
+#include <Foundation/NSGeometry.h>
+#include <Foundation/NSString.h>
+
+#include <AppKit/NSApplication.h>
+#include <AppKit/NSFont.h>
+#include <AppKit/NSLayoutManager.h>
+#include <AppKit/NSParagraphStyle.h>
+#include <AppKit/NSTextContainer.h>
+#include <AppKit/NSTextStorage.h>
+
+static NSLayoutManager *
+makeLayoutManager(NSTextStorage *ts, BOOL parallel, BOOL leading)
+{
+  NSLayoutManager *lm = AUTORELEASE([[NSLayoutManager alloc] init]);
+  NSTextContainer *tc = AUTORELEASE([[NSTextContainer alloc]
+    initWithContainerSize: NSMakeSize(200, 1.0e7)]);
+
+  [lm setParallelLayoutEnabled: parallel];
+  [lm setUsesFontLeading: leading];
+  [lm addTextContainer: tc];
+  [ts addLayoutManager: lm];
+  return lm;
+}
+
+static NSLayoutManager *
+layOut(NSTextStorage *ts, BOOL parallel, BOOL leading)
+{
+  NSLayoutManager *lm = makeLayoutManager(ts, parallel, leading);
+
+  [lm usedRectForTextContainer: [[lm textContainers] objectAtIndex: 0]];
+  return lm;
+}
+
+int
+main(int argc, char **argv)
+{
+  START_SET("NSLayoutManager parallelLayout")
+
+  NS_DURING
+    {
+      [NSApplication sharedApplication];
+    }
+  NS_HANDLER
+    {
+      if ([[localException name] isEqualToString: NSInternalInconsistencyException])
+        SKIP("It looks like GNUstep backend is not yet installed")
+    }
+  NS_ENDHANDLER
+
+  NS_DURING
+    {
+      NSMutableParagraphStyle *style = AUTORELEASE([[NSParagraphStyle
+        defaultParagraphStyle] mutableCopy]);
+      NSFont *font = [NSFont userFontOfSize: 12.0];
+      NSDictionary *attrs;
+      NSString *s;
+      NSTextStorage *ts;
+      NSLayoutManager *sequential, *parallel, *partial;
+      NSRange r1, r2;
+      NSRect a, b;
+      NSUInteger n, g;
+      BOOL same = YES;
+
+      [style setParagraphSpacing: 3.0];
+      attrs = [NSDictionary dictionaryWithObjectsAndKeys:
+        font, NSFontAttributeName, style, NSParagraphStyleAttributeName, nil];
+      s = [@"" stringByPaddingToLength: 150000
+                            withString: @"a paragraph that wraps onto a second line\n"
+                       startingAtIndex: 0];
+      ts = AUTORELEASE([[NSTextStorage alloc]
+        initWithString: s attributes: attrs]);
+
+      sequential = layOut(ts, NO, YES);
+      parallel = layOut(ts, YES, YES);
+      PASS([parallel parallelLayoutEnabled],
+           "parallelLayoutEnabled round-trips");
+
+      n = [sequential numberOfGlyphs];
+      PASS([parallel numberOfGlyphs] == n, "both have the same glyphs");
+      for (g = 0; g < n && same; g += 37)
+        {
+          NSRange r1, r2;
+          NSRect a = [sequential lineFragmentRectForGlyphAtIndex: g
+                                                  effectiveRange: &r1];
+          NSRect b = [parallel lineFragmentRectForGlyphAtIndex: g
+                                                effectiveRange: &r2];
+
+          same = NSEqualRects(a, b) && NSEqualRanges(r1, r2)
+            && NSEqualPoints([sequential locationForGlyphAtIndex: g],
+                             [parallel locationForGlyphAtIndex: g]);
+        }
+      PASS(same, "parallel layout matches sequential layout");
+      PASS(NSEqualRects([sequential usedRectForTextContainer:
+                           [[sequential textContainers] objectAtIndex: 0]],
+                        [parallel usedRectForTextContainer:
+                           [[parallel textContainers] objectAtIndex: 0]]),
+           "the used rects match");
+
+      /* Asking for the layout of one glyph uses parallel layout too. */
+      partial = makeLayoutManager(ts, YES, YES);
+      g = n / 2;
+      a = [sequential lineFragmentRectForGlyphAtIndex: g
+                                       effectiveRange: &r1];
+      b = [partial lineFragmentRectForGlyphAtIndex: g
+                                    effectiveRange: &r2];
+      PASS(NSEqualRects(a, b) && NSEqualRanges(r1, r2),
+           "parallel layout up to a glyph matches sequential layout");
+
+      sequential = layOut(ts, NO, NO);
+      parallel = layOut(ts, YES, NO);
+      g = n - 1;
+      a = [sequential lineFragmentRectForGlyphAtIndex: g
+                                       effectiveRange: &r1];
+      b = [parallel lineFragmentRectForGlyphAtIndex: g
+                                     effectiveRange: &r2];
+      PASS(NSEqualRects(a, b) && NSEqualRanges(r1, r2),
+           "parallel layout without font leading matches sequential layout");
+    }
+  NS_HANDLER
+    {
+      if ([[localException name] isEqualToString: NSInternalInconsistencyException]
+        || [[localException name] isEqualToString: @"NSWindowServerCommunicationException"])
+        SKIP("No display available");
+    }
+  NS_ENDHANDLER
+
+  END_SET("NSLayoutManager parallelLayout")
+  return 0;
+}
@@ -0,0 +1,106 @@
+/* A layout manager that isn't attached to a text view can lay out in
+   another thread, and uses the system typesetter of that thread.  The
+   typesetter uses the font backend, so the set is skipped when the backend
+   is unavailable.
+*/
+#include "Testing.h"
+
+#include <Foundation/NSAutoreleasePool.h>
+#include <Foundation/NSDate.h>
+#include <Foundation/NSDictionary.h>
+#include <Foundation/NSGeometry.h>
+#include <Foundation/NSString.h>
+#include <Foundation/NSThread.h>
+
+#include <AppKit/NSApplication.h>
+#include <AppKit/NSFont.h>
+#include <AppKit/NSLayoutManager.h>
+#include <AppKit/NSTextContainer.h>
+#include <AppKit/NSTextStorage.h>
+#include <Additions/GNUstepGUI/GSTypesetter.h>
+
+@interface Worker : NSObject
+{
+@public
+  NSLayoutManager *lm;
+  NSTextContainer *tc;
+  GSTypesetter *typesetter;
+  NSRect used;
+  BOOL done;
+}
+@end
+
+@implementation Worker
+- (void) layout: (id)sender
+{
+  NSAutoreleasePool *arp = [NSAutoreleasePool new];
+
+  typesetter = [lm typesetter];
+  used = [lm usedRectForTextContainer: tc];
+  [arp release];
+  done = YES;
+}
+@end
+
+int
+main(int argc, char **argv)
+{
+  START_SET("NSLayoutManager threadedLayout")
+
+  NS_DURING
+    {
+      [NSApplication sharedApplication];
+    }
+  NS_HANDLER
+    {
+      if ([[localException name] isEqualToString: NSInternalInconsistencyException])
+        SKIP("It looks like GNUstep backend is not yet installed")
+    }
+  NS_ENDHANDLER
+
+  NS_DURING
+    {
+      NSFont *font = [NSFont userFontOfSize: 12.0];
+      NSDictionary *attrs = [NSDictionary dictionaryWithObjectsAndKeys:
+        font, NSFontAttributeName, nil];
+      NSString *s = [@"" stringByPaddingToLength: 20000
+                                      withString: @"some words\n"
+                                 startingAtIndex: 0];
+      NSTextStorage *ts = AUTORELEASE([[NSTextStorage alloc]
+        initWithString: s attributes: attrs]);
+      Worker *w = AUTORELEASE([[Worker alloc] init]);
+      NSDate *limit;
+
+      w->lm = AUTORELEASE([[NSLayoutManager alloc] init]);
+      w->tc = AUTORELEASE([[NSTextContainer alloc]
+        initWithContainerSize: NSMakeSize(300, 1.0e7)]);
+      [w->lm addTextContainer: w->tc];
+      [ts addLayoutManager: w->lm];
+
+      PASS([w->lm typesetter] == [GSTypesetter sharedSystemTypesetter],
+           "a layout manager uses the system typesetter by default");
+
+      [NSThread detachNewThreadSelector: @selector(layout:)
+                               toTarget: w
+                             withObject: nil];
+      limit = [NSDate dateWithTimeIntervalSinceNow: 30.0];
+      while (!w->done && [limit timeIntervalSinceNow] > 0)
+        [NSThread sleepForTimeInterval: 0.01];
+
+      PASS(w->done && NSHeight(w->used) > 1000.0,
+           "the text is laid out in the other thread");
+      PASS(w->typesetter != nil
+           && w->typesetter != [GSTypesetter sharedSystemTypesetter],
+           "the other thread lays out with its own typesetter");
+    }
+  NS_HANDLER
+    {
+      if ([[localException name] isEqualToString: NSInternalInconsistencyException]
+        || [[localException name] isEqualToString: @"NSWindowServerCommunicationException"])
+        SKIP("No display available");
+    }
+  NS_ENDHANDLER
+
+  END_SET("NSLayoutManager threadedLayout")
+  return 0;
+}
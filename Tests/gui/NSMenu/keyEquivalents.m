@@ -0,0 +1,251 @@
+/* NSMenu -performKeyEquivalent: finds the item of a menu tree with the
+   key equivalent of an event without walking the tree.  Check that the
+   right item fires, that the modifiers must match, that added, removed and
+   changed items are taken into account, that items supplied by a delegate
+   are found, that a delegate which knows its key equivalents is asked
+   instead of filling in its menu, that a submenu with its own
+   -performKeyEquivalent: is sent the event, and that only the item matched
+   is validated.  Creating menus pulls in their windows, which needs the
+   backend, so the body is guarded. */
+#include "Testing.h"
+
+#include <Foundation/NSAutoreleasePool.h>
+#include <Foundation/NSString.h>
+
+#include <AppKit/NSApplication.h>
+#include <AppKit/NSEvent.h>
+#include <AppKit/NSMenu.h>
+#include <AppKit/NSMenuItem.h>
+
+#define MENUS 20
+#define ITEMS 25
+#define PRESSES 10
+
+@interface Recorder : NSObject
+{
+@public
+  int validated;
+  int fired;
+  id sender;
+}
+@end
+
+@implementation Recorder
+- (BOOL) validateMenuItem: (NSMenuItem *)item
+{
+  validated++;
+  return YES;
+}
+- (void) fired: (id)s
+{
+  fired++;
+  sender = s;
+}
+@end
+
+/* Adds an item with key equivalent "z" when the menu is updated. */
+@interface Filler : NSObject
+{
+@public
+  Recorder *target;
+  int updated;
+}
+@end
+
+/* Knows that its menu has key equivalent "y" without filling it in. */
+@interface Chooser : Filler
+{
+@public
+  int asked;
+}
+@end
+
+@implementation Chooser
+- (BOOL) menuHasKeyEquivalent: (NSMenu *)menu
+                     forEvent: (NSEvent *)event
+                       target: (id *)t
+                       action: (SEL *)action
+{
+  asked++;
+  if ([[event charactersIgnoringModifiers] isEqualToString: @"y"])
+    {
+      *t = target;
+      *action = @selector(fired:);
+      return YES;
+    }
+  return NO;
+}
+@end
+
+/* Counts the key presses it is sent. */
+@interface CountingMenu : NSMenu
+{
+@public
+  int pressed;
+}
+@end
+
+@implementation CountingMenu
+- (BOOL) performKeyEquivalent: (NSEvent *)event
+{
+  pressed++;
+  return [super performKeyEquivalent: event];
+}
+@end
+
+@implementation Filler
+- (void) menuNeedsUpdate: (NSMenu *)menu
+{
+  updated++;
+  if ([menu numberOfItems] == 0)
+    {
+      NSMenuItem *item = [menu addItemWithTitle: @"Late"
+                                         action: @selector(fired:)
+                                  keyEquivalent: @"z"];
+      [item setTarget: target];
+    }
+}
+@end
+
+static NSEvent *
+keyDown(NSString *key, NSUInteger modifiers)
+{
+  return [NSEvent keyEventWithType: NSKeyDown
+                          location: NSZeroPoint
+                     modifierFlags: modifiers
+                         timestamp: 0
+                      windowNumber: 0
+                           context: nil
+                        characters: key
+       charactersIgnoringModifiers: key
+                         isARepeat: NO
+                           keyCode: 0];
+}
+
+int
+main(int argc, const char **argv)
+{
+  START_SET("NSMenu keyEquivalents")
+
+  NS_DURING
+    [NSApplication sharedApplication];
+  NS_HANDLER
+    if ([[localException name] isEqualToString: NSInternalInconsistencyException])
+      SKIP("It looks like GNUstep backend is not yet installed")
+  NS_ENDHANDLER
+
+  NS_DURING
+    {
+      Recorder *r = AUTORELEASE([[Recorder alloc] init]);
+      Filler *f = AUTORELEASE([[Filler alloc] init]);
+      NSMenu *main = AUTORELEASE([[NSMenu alloc] initWithTitle: @"Main"]);
+      Chooser *c = AUTORELEASE([[Chooser alloc] init]);
+      NSMenu *late;
+      NSMenu *chosen;
+      CountingMenu *counting;
+      NSMenuItem *item;
+      NSMenuItem *last = nil;
+      NSEvent *event;
+      BOOL ok;
+      int i;
+      int j;
+
+      for (i = 0; i < MENUS; i++)
+        {
+          NSMenu *sub = AUTORELEASE([[NSMenu alloc]
+            initWithTitle: [NSString stringWithFormat: @"Menu %d", i]]);
+
+          item = [main addItemWithTitle: [sub title]
+                                 action: NULL
+                          keyEquivalent: @""];
+          [main setSubmenu: sub forItem: item];
+          for (j = 0; j < ITEMS; j++)
+            {
+              unichar c = 0x4e00 + i * ITEMS + j;
+
+              last = [sub addItemWithTitle: @"Item"
+                                    action: @selector(fired:)
+                             keyEquivalent: [NSString stringWithCharacters: &c
+                                                                    length: 1]];
+              [last setTarget: r];
+            }
+        }
+
+      /* The last item of the last submenu. */
+      event = keyDown([last keyEquivalent], NSCommandKeyMask);
+      PASS([main performKeyEquivalent: event] && r->fired == 1
+           && r->sender == last,
+           "the item with the key equivalent fires");
+      PASS(r->validated == 1, "only the item matched is validated");
+      PASS(![main performKeyEquivalent:
+                    keyDown([last keyEquivalent], NSAlternateKeyMask)]
+           && r->fired == 1,
+           "the modifiers must match");
+      PASS(![main performKeyEquivalent: keyDown(@"q", NSCommandKeyMask)],
+           "an unknown key equivalent is not handled");
+
+      [last setKeyEquivalent: @"q"];
+      ok = [main performKeyEquivalent: keyDown(@"q", NSCommandKeyMask)];
+      PASS(ok && r->fired == 2, "a changed key equivalent is found");
+      [[last menu] removeItem: last];
+      PASS(![main performKeyEquivalent: keyDown(@"q", NSCommandKeyMask)]
+           && r->fired == 2,
+           "a removed item is not found");
+
+      late = AUTORELEASE([[NSMenu alloc] initWithTitle: @"Late"]);
+      f->target = r;
+      [late setDelegate: f];
+      item = [main addItemWithTitle: @"Late" action: NULL keyEquivalent: @""];
+      [main setSubmenu: late forItem: item];
+      ok = [main performKeyEquivalent: keyDown(@"z", NSCommandKeyMask)];
+      PASS(ok && r->fired == 3, "an item supplied by a delegate is found");
+
+      chosen = AUTORELEASE([[NSMenu alloc] initWithTitle: @"Chosen"]);
+      c->target = r;
+      [chosen setDelegate: c];
+      item = [main addItemWithTitle: @"Chosen" action: NULL keyEquivalent: @""];
+      [main setSubmenu: chosen forItem: item];
+      ok = [main performKeyEquivalent: keyDown(@"y", NSCommandKeyMask)];
+      PASS(ok && r->fired == 4 && c->asked == 1 && c->updated == 0,
+           "a delegate which knows its key equivalents is asked instead");
+
+      counting = AUTORELEASE([[CountingMenu alloc] initWithTitle: @"Counting"]);
+      item = [counting addItemWithTitle: @"Counted"
+                                 action: @selector(fired:)
+                          keyEquivalent: @"x"];
+      [item setTarget: r];
+      item = [main addItemWithTitle: @"Counting" action: NULL keyEquivalent: @""];
+      [main setSubmenu: counting forItem: item];
+      ok = [main performKeyEquivalent: keyDown(@"x", NSCommandKeyMask)];
+      PASS(ok && r->fired == 5 && counting->pressed == 1,
+           "a submenu with its own -performKeyEquivalent: is sent the event");
+
+      r->validated = 0;
+      f->updated = 0;
+      c->asked = 0;
+      for (i = 0; i < PRESSES; i++)
+        {
+          CREATE_AUTORELEASE_POOL(pool);
+
+          [main performKeyEquivalent: event];
+          [pool drain];
+        }
+      PASS(r->validated == 0, "missed key presses validate nothing");
+      PASS(c->asked == PRESSES && c->updated == 0,
+           "a delegate which knows its key equivalents never fills in");
+      PASS(f->updated == PRESSES && r->fired == 5,
+           "other delegates fill in their menus for each key press");
+
+      [late setDelegate: nil];
+      [chosen setDelegate: nil];
+    }
+  NS_HANDLER
+    if ([[localException name] isEqualToString: NSInternalInconsistencyException]
+      || [[localException name] isEqualToString: @"NSWindowServerCommunicationException"])
+      SKIP("No display available")
+  NS_ENDHANDLER
+
+  END_SET("NSMenu keyEquivalents")
+
+  return 0;
+}
@@ -0,0 +1,263 @@
+/* After each event NSApplication updates only the menus on screen, menus
+   which are not shown are validated when they are displayed.  Run a modal
+   session over a few events and check that the items of a main menu which
+   is not on screen are not validated, that an explicit -update still
+   validates them, and that the validation counters count them.  The
+   Services menu is left alone while it is hidden, and once shown the
+   first responder is asked once per event and pair of types, however many
+   services take them.  Creating menus and windows needs the backend, so
+   the body is guarded. */
+#include "Testing.h"
+
+#include <Foundation/NSArray.h>
+#include <Foundation/NSAutoreleasePool.h>
+#include <Foundation/NSDictionary.h>
+#include <Foundation/NSNotification.h>
+#include <Foundation/NSString.h>
+#include <Foundation/NSValue.h>
+
+#include <AppKit/NSApplication.h>
+#include <AppKit/NSEvent.h>
+#include <AppKit/NSMenu.h>
+#include <AppKit/NSMenuItem.h>
+#include <AppKit/NSPanel.h>
+#include <AppKit/NSPasteboard.h>
+#include <AppKit/NSView.h>
+#include <GNUstepGUI/GSServicesManager.h>
+
+#define MENUS 20
+#define ITEMS 25
+#define SERVICES 5
+
+@interface NSApplication (Private)
+- (void) _windowDidBecomeKey: (NSNotification*)notification;
+- (void) _windowDidResignKey: (NSNotification*)notification;
+@end
+
+/* Puts services taking strings in a menu without reading the services
+   of the system. */
+@interface GSServicesManager (Testing)
+- (void) setTestServices: (NSArray*)titles menu: (NSMenu*)menu;
+@end
+
+@implementation GSServicesManager (Testing)
+- (void) setTestServices: (NSArray*)titles menu: (NSMenu*)menu
+{
+  NSMutableDictionary	*info = [NSMutableDictionary dictionary];
+  NSDictionary		*types;
+  NSUInteger		i;
+
+  types = [NSDictionary dictionaryWithObject:
+    [NSArray arrayWithObject: NSStringPboardType] forKey: @"NSSendTypes"];
+  for (i = 0; i < [titles count]; i++)
+    {
+      NSMenuItem	*item;
+
+      [info setObject: types forKey: [titles objectAtIndex: i]];
+      item = [menu addItemWithTitle: [titles objectAtIndex: i]
+                             action: @selector(doService:)
+                      keyEquivalent: @""];
+      [item setTarget: self];
+      [item setTag: i];
+    }
+  ASSIGN(_title2info, info);
+  ASSIGN(_menuTitles, titles);
+  ASSIGN(_servicesMenu, menu);
+}
+@end
+
+@interface Validator : NSObject
+{
+@public
+  int validated;
+}
+@end
+
+@implementation Validator
+- (BOOL) validateMenuItem: (NSMenuItem *)item
+{
+  validated++;
+  return YES;
+}
+- (void) fired: (id)sender
+{
+}
+@end
+
+@interface Requestor : NSView
+{
+@public
+  int asked;
+}
+@end
+
+@implementation Requestor
+- (BOOL) acceptsFirstResponder
+{
+  return YES;
+}
+- (id) validRequestorForSendType: (NSString *)sendType
+                      returnType: (NSString *)returnType
+{
+  asked++;
+  return self;
+}
+@end
+
+/* Posts an event to the panel and runs the modal session over it, so that
+   the application updates the menus as it does after each event. */
+static void
+runEvent(NSPanel *panel, NSModalSession session, NSTimeInterval when)
+{
+  NSEvent	*e;
+
+  e = [NSEvent otherEventWithType: NSApplicationDefined
+                         location: NSZeroPoint
+                    modifierFlags: 0
+                        timestamp: when
+                     windowNumber: [panel windowNumber]
+                          context: nil
+                          subtype: 0
+                            data1: 0
+                            data2: 0];
+  [NSApp postEvent: e atStart: NO];
+  [NSApp runModalSession: session];
+}
+
+int
+main(int argc, const char **argv)
+{
+  START_SET("NSMenu validation")
+
+  NS_DURING
+    [NSApplication sharedApplication];
+  NS_HANDLER
+    if ([[localException name] isEqualToString: NSInternalInconsistencyException])
+      SKIP("It looks like GNUstep backend is not yet installed")
+  NS_ENDHANDLER
+
+  NS_DURING
+    {
+      Validator *v = AUTORELEASE([[Validator alloc] init]);
+      NSMenu *root = AUTORELEASE([[NSMenu alloc] initWithTitle: @"Root"]);
+      NSMenu *services = AUTORELEASE([[NSMenu alloc]
+        initWithTitle: @"Services"]);
+      NSMutableArray *titles = [NSMutableArray array];
+      GSServicesManager *manager = [GSServicesManager manager];
+      Requestor *first = AUTORELEASE([[Requestor alloc]
+        initWithFrame: NSMakeRect(0, 0, 50, 50)]);
+      Requestor *other = AUTORELEASE([[Requestor alloc]
+        initWithFrame: NSMakeRect(50, 0, 50, 50)]);
+      NSPanel *panel;
+      NSModalSession session;
+      NSNotification *n;
+      NSDictionary *stats;
+      NSMenu *sub = nil;
+      NSMenuItem *item;
+      int i;
+      int j;
+
+      for (i = 0; i < ITEMS; i++)
+        {
+          item = [root addItemWithTitle: @"Item"
+                                 action: @selector(fired:)
+                          keyEquivalent: @""];
+          [item setTarget: v];
+        }
+      for (i = 0; i < MENUS; i++)
+        {
+          sub = AUTORELEASE([[NSMenu alloc]
+            initWithTitle: [NSString stringWithFormat: @"Menu %d", i]]);
+          item = [root addItemWithTitle: [sub title]
+                                 action: NULL
+                          keyEquivalent: @""];
+          [root setSubmenu: sub forItem: item];
+          for (j = 0; j < ITEMS; j++)
+            {
+              item = [sub addItemWithTitle: @"Item"
+                                    action: @selector(fired:)
+                             keyEquivalent: @""];
+              [item setTarget: v];
+            }
+        }
+      for (i = 0; i < SERVICES; i++)
+        {
+          [titles addObject: [NSString stringWithFormat: @"Service %d", i]];
+        }
+      [manager setTestServices: titles menu: services];
+
+      panel = AUTORELEASE([[NSPanel alloc]
+        initWithContentRect: NSMakeRect(0, 0, 100, 50)
+                  styleMask: NSTitledWindowMask
+                    backing: NSBackingStoreBuffered
+                      defer: NO]);
+      [panel setReleasedWhenClosed: NO];
+      [[panel contentView] addSubview: first];
+      [[panel contentView] addSubview: other];
+      [panel makeFirstResponder: first];
+      n = [NSNotification
+        notificationWithName: NSWindowDidBecomeKeyNotification
+                      object: panel];
+      [NSApp _windowDidBecomeKey: n];
+      [NSApp setMainMenu: root];
+      session = [NSApp beginModalSessionForWindow: panel];
+
+      /* Building the menus validated them as the items changed. */
+      v->validated = 0;
+      first->asked = 0;
+      [NSMenu resetValidationStatistics];
+      runEvent(panel, session, 1.0);
+      stats = [NSMenu validationStatistics];
+      PASS(v->validated == 0, "menus not on screen are not validated");
+      PASS([[stats objectForKey: @"Validations"] unsignedIntegerValue] == 0,
+           "no validation is counted");
+      PASS(first->asked == 0, "a hidden Services menu is not validated");
+
+      [sub update];
+      stats = [NSMenu validationStatistics];
+      PASS(v->validated == ITEMS, "an explicit update validates the items");
+      PASS([[stats objectForKey: @"Validations"] unsignedIntegerValue] == ITEMS
+           && [[stats objectForKey: @"Updates"] unsignedIntegerValue] == 1,
+           "the validations and updates are counted");
+      PASS([[stats objectForKey: @"ValidationsPerSecond"] doubleValue] > 0.0,
+           "the validations per second are reported");
+
+      [NSMenu resetValidationStatistics];
+      stats = [NSMenu validationStatistics];
+      PASS([[stats objectForKey: @"Validations"] unsignedIntegerValue] == 0,
+           "resetting sets the counters to zero");
+
+      [services display];
+      first->asked = 0;
+      runEvent(panel, session, 2.0);
+      PASS(first->asked == 1,
+           "a shown Services menu asks once for services of the same types");
+      [manager updateServicesMenu];
+      PASS(first->asked == 1, "the answer is kept during the event");
+      runEvent(panel, session, 3.0);
+      PASS(first->asked == 2, "the answer is not kept after the event");
+      [panel makeFirstResponder: other];
+      [manager updateServicesMenu];
+      PASS(first->asked == 2 && other->asked == 1,
+           "a new first responder is asked again");
+
+      [NSApp endModalSession: session];
+      [services close];
+      [panel close];
+      n = [NSNotification
+        notificationWithName: NSWindowDidResignKeyNotification
+                      object: panel];
+      [NSApp _windowDidResignKey: n];
+      [NSApp setMainMenu: nil];
+      [manager setTestServices: nil menu: nil];
+    }
+  NS_HANDLER
+    if ([[localException name] isEqualToString: NSInternalInconsistencyException]
+      || [[localException name] isEqualToString: @"NSWindowServerCommunicationException"])
+      SKIP("No display available")
+  NS_ENDHANDLER
+
+  END_SET("NSMenu validation")
+
+  return 0;
+}
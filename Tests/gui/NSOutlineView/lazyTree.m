@@ -0,0 +1,188 @@
+/* The outline view only asks for the children of the items it expands,
+   and finds rows and items in a tree of the loaded items.  Browse a tree
+   of a thousand folders of a thousand files each, check that expanding
+   and collapsing ask for the children of the expanded folder only and
+   keep the rows, items, levels and parents right, and that reloading a
+   folder picks up its new children.  */
+#include "Testing.h"
+
+#include <Foundation/NSArray.h>
+#include <Foundation/NSAutoreleasePool.h>
+#include <Foundation/NSDictionary.h>
+#include <Foundation/NSString.h>
+
+#include <AppKit/NSApplication.h>
+#include <AppKit/NSOutlineView.h>
+#include <AppKit/NSTableColumn.h>
+
+#define FOLDERS 1000
+#define FILES 1000
+
+@interface Tree : NSObject
+{
+@public
+  NSMutableDictionary *children;
+  NSUInteger asked;
+  NSUInteger files;
+}
+@end
+
+@implementation Tree
+- (id) init
+{
+  self = [super init];
+  if (self != nil)
+    {
+      children = [NSMutableDictionary new];
+      files = FILES;
+    }
+  return self;
+}
+- (void) dealloc
+{
+  RELEASE(children);
+  [super dealloc];
+}
+/* Items are made once, so that they keep their identity. */
+- (NSArray *) childrenOf: (id)item
+{
+  NSString *key = (item == nil) ? @"" : item;
+  NSMutableArray *a = [children objectForKey: key];
+
+  if (a == nil)
+    {
+      NSUInteger count = (item == nil) ? FOLDERS
+	: ([item hasPrefix: @"folder"] ? files : 0);
+      NSUInteger i;
+
+      a = [NSMutableArray arrayWithCapacity: count];
+      for (i = 0; i < count; i++)
+	{
+	  [a addObject: (item == nil)
+	    ? [NSString stringWithFormat: @"folder %lu", (unsigned long)i]
+	    : [NSString stringWithFormat: @"file %lu in %@",
+			(unsigned long)i, item]];
+	}
+      [children setObject: a forKey: key];
+    }
+  return a;
+}
+- (NSInteger) outlineView: (NSOutlineView *)ov numberOfChildrenOfItem: (id)item
+{
+  return [[self childrenOf: item] count];
+}
+- (id) outlineView: (NSOutlineView *)ov child: (NSInteger)i ofItem: (id)item
+{
+  asked++;
+  return [[self childrenOf: item] objectAtIndex: i];
+}
+- (BOOL) outlineView: (NSOutlineView *)ov isItemExpandable: (id)item
+{
+  return [item hasPrefix: @"folder"];
+}
+- (id) outlineView: (NSOutlineView *)ov
+  objectValueForTableColumn: (NSTableColumn *)col
+	    byItem: (id)item
+{
+  return item;
+}
+@end
+
+int
+main(int argc, char **argv)
+{
+  START_SET("NSOutlineView lazyTree")
+
+  NS_DURING
+    [NSApplication sharedApplication];
+  NS_HANDLER
+    if ([[localException name] isEqualToString: NSInternalInconsistencyException])
+      SKIP("It looks like GNUstep backend is not yet installed")
+  NS_ENDHANDLER
+
+  NS_DURING
+    {
+      NSOutlineView *ov;
+      NSTableColumn *col;
+      Tree *ds;
+      NSArray *folders;
+      id f10, f500, f999, file;
+      NSUInteger i;
+      BOOL ok;
+
+      ov = AUTORELEASE([[NSOutlineView alloc]
+	initWithFrame: NSMakeRect(0, 0, 200, 200)]);
+      col = AUTORELEASE([[NSTableColumn alloc] initWithIdentifier: @"c"]);
+      [ov addTableColumn: col];
+      [ov setOutlineTableColumn: col];
+      ds = AUTORELEASE([Tree new]);
+      [ov setDataSource: ds];
+      ds->asked = 0;
+      [ov reloadData];
+
+      folders = [ds childrenOf: nil];
+      f10 = [folders objectAtIndex: 10];
+      f500 = [folders objectAtIndex: 500];
+      f999 = [folders objectAtIndex: 999];
+      PASS([ov numberOfRows] == FOLDERS && ds->asked == FOLDERS,
+	   "reloading asks for the top level items only");
+
+      ds->asked = 0;
+      [ov expandItem: f500];
+      PASS(ds->asked == FILES, "expanding asks for the children of the item");
+      PASS([ov numberOfRows] == FOLDERS + FILES,
+	   "the children of the expanded item are shown");
+      [ov expandItem: f10];
+      PASS([ov numberOfRows] == FOLDERS + 2 * FILES,
+	   "two folders can be expanded");
+
+      file = [[ds childrenOf: f500] objectAtIndex: 7];
+      PASS([ov rowForItem: f500] == 500 + FILES,
+	   "a folder moves down by the rows of the folders above it");
+      PASS([ov rowForItem: file] == 500 + FILES + 8
+	   && [ov itemAtRow: 500 + FILES + 8] == file,
+	   "rowForItem: and itemAtRow: agree");
+      PASS([ov levelForItem: file] == 1 && [ov parentForItem: file] == f500,
+	   "a file knows its level and parent");
+      PASS([ov rowForItem: f999] == 999 + 2 * FILES,
+	   "the last folder is below all the files");
+
+      ok = YES;
+      for (i = 0; i < (NSUInteger)[ov numberOfRows]; i += 97)
+	{
+	  if ([ov rowForItem: [ov itemAtRow: i]] != (NSInteger)i)
+	    ok = NO;
+	}
+      PASS(ok, "every row maps back to itself");
+
+      ds->asked = 0;
+      [ov collapseItem: f10];
+      PASS(ds->asked == 0 && [ov numberOfRows] == FOLDERS + FILES,
+	   "collapsing doesn't ask the data source");
+      PASS([ov rowForItem: file] == 500 + 8 && [ov rowForItem:
+	[[ds childrenOf: f10] objectAtIndex: 0]] == -1,
+	   "the files of a collapsed folder have no row");
+      [ov expandItem: f10];
+      PASS(ds->asked == 0 && [ov numberOfRows] == FOLDERS + 2 * FILES,
+	   "expanding a folder again uses its loaded children");
+
+      ds->files = 3;
+      [ds->children removeObjectForKey: f500];
+      [ov reloadItem: f500 reloadChildren: YES];
+      PASS([ov numberOfRows] == FOLDERS + FILES + 3,
+	   "reloading an item picks up its new children");
+      PASS([ov rowForItem: file] == -1
+	   && [ov rowForItem: f999] == 999 + FILES + 3,
+	   "the rows below the reloaded item move");
+    }
+  NS_HANDLER
+    {
+      if ([[localException name] isEqualToString: NSInternalInconsistencyException]
+	|| [[localException name] isEqualToString: @"NSWindowServerCommunicationException"])
+	SKIP("No display available");
+    }
+  NS_ENDHANDLER
+
+  END_SET("NSOutlineView lazyTree")
+  return 0;
+}
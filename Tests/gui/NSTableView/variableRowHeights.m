@@ -0,0 +1,149 @@
+/* A table view whose delegate gives the height of each row keeps the
+   heights in a prefix sum index.  Check the row geometry against the sums
+   of the heights, that noting a changed height only asks the delegate for
+   the rows that changed, and that noting a changed number of rows or
+   reloading asks for the heights of all rows again.  */
+#import "Testing.h"
+
+#import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSGeometry.h>
+#import <Foundation/NSIndexSet.h>
+
+#import <AppKit/NSApplication.h>
+#import <AppKit/NSTableColumn.h>
+#import <AppKit/NSTableView.h>
+
+#define ROWS 100000
+
+@interface Source : NSObject
+{
+@public
+  NSInteger rows;
+  CGFloat tall;
+  NSUInteger asked;
+}
+@end
+
+@implementation Source
+- (NSInteger) numberOfRowsInTableView: (NSTableView *)tv
+{
+  return rows;
+}
+- (id) tableView: (NSTableView *)tv
+  objectValueForTableColumn: (NSTableColumn *)col
+             row: (NSInteger)row
+{
+  return @"x";
+}
+- (CGFloat) tableView: (NSTableView *)tv heightOfRow: (NSInteger)row
+{
+  asked++;
+  return (row % 3 == 0) ? tall : 17.0;
+}
+@end
+
+static CGFloat
+originOf(Source *ds, NSInteger row)
+{
+  NSInteger full = row / 3;
+  NSInteger rest = row % 3;
+  CGFloat y = full * (ds->tall + 34.0);
+
+  if (rest > 0)
+    y += ds->tall + (rest - 1) * 17.0;
+  return y;
+}
+
+int
+main(int argc, const char **argv)
+{
+  Source *ds;
+  NSTableView *tv;
+  NSTableColumn *col;
+
+  START_SET("NSTableView variableRowHeights")
+
+  NS_DURING
+    [NSApplication sharedApplication];
+  NS_HANDLER
+    if ([[localException name] isEqualToString: NSInternalInconsistencyException])
+      SKIP("It looks like GNUstep backend is not yet installed")
+  NS_ENDHANDLER
+
+  NS_DURING
+    {
+      NSInteger rows[] = {0, 1, 2, 3, 4, 5, 999, 54321, ROWS - 1};
+      NSUInteger i;
+      BOOL ok = YES;
+      NSRange range;
+
+      ds = AUTORELEASE([[Source alloc] init]);
+      ds->rows = ROWS;
+      ds->tall = 40.0;
+      tv = AUTORELEASE([[NSTableView alloc]
+        initWithFrame: NSMakeRect(0, 0, 200, 100)]);
+      col = AUTORELEASE([[NSTableColumn alloc] initWithIdentifier: @"c"]);
+      [tv addTableColumn: col];
+      [tv setDataSource: ds];
+      [tv setDelegate: ds];
+      [tv reloadData];
+
+      for (i = 0; i < sizeof(rows) / sizeof(rows[0]); i++)
+        {
+          NSRect r = [tv rectOfRow: rows[i]];
+          NSPoint p = NSMakePoint(10, NSMidY(r));
+
+          if (NSMinY(r) != originOf(ds, rows[i])
+            || NSHeight(r) != ((rows[i] % 3 == 0) ? 40.0 : 17.0)
+            || [tv rowAtPoint: p] != rows[i])
+            ok = NO;
+        }
+      PASS(ok, "rows are placed at the sums of the heights before them");
+      PASS(NSHeight([tv frame]) == originOf(ds, ROWS) + 1,
+           "the table is as high as all its rows");
+
+      range = [tv rowsInRect: NSMakeRect(0, originOf(ds, 300) + 1, 10, 100)];
+      PASS(range.location == 300 && range.length == 4,
+           "rowsInRect: finds the rows in a rect");
+
+      ds->asked = 0;
+      ds->tall = 60.0;
+      [tv noteHeightOfRowsWithIndexesChanged:
+        [NSIndexSet indexSetWithIndex: 3]];
+      PASS(ds->asked == 1,
+           "noting a changed height asks for the height of that row only");
+      PASS(NSHeight([tv rectOfRow: 3]) == 60.0
+        && NSMinY([tv rectOfRow: 4]) == 40.0 + 17.0 + 17.0 + 60.0,
+           "the rows below a changed row move down");
+      PASS(NSMinY([tv rectOfRow: 6]) == NSMinY([tv rectOfRow: 5]) + 17.0
+        && NSHeight([tv rectOfRow: 6]) == 40.0,
+           "the heights of the other rows are kept");
+
+      ds->asked = 0;
+      ds->tall = 40.0;
+      ds->rows = ROWS + 10;
+      [tv noteNumberOfRowsChanged];
+      PASS(NSMinY([tv rectOfRow: ROWS]) == originOf(ds, ROWS)
+        && NSHeight([tv rectOfRow: 3]) == 40.0,
+           "changing the number of rows takes the heights given now");
+      PASS(ds->asked == ROWS + 10,
+           "changing the number of rows asks for the height of each row");
+
+      ds->tall = 50.0;
+      ds->rows = ROWS - 5;
+      [tv reloadData];
+      PASS(NSHeight([tv rectOfRow: 3]) == 50.0
+        && NSHeight([tv frame]) == originOf(ds, ROWS - 5) + 1,
+           "reloading takes the heights given now");
+    }
+  NS_HANDLER
+    {
+      if ([[localException name] isEqualToString: NSInternalInconsistencyException]
+        || [[localException name] isEqualToString: @"NSWindowServerCommunicationException"])
+        SKIP("No display available");
+    }
+  NS_ENDHANDLER
+
+  END_SET("NSTableView variableRowHeights")
+  return 0;
+}
@@ -0,0 +1,157 @@
+/* A view-based table view keeps the views of rows scrolled out of sight
+   and hands them back from -makeViewWithIdentifier:owner:.  Scroll through
+   a long table and check that only about a screenful of views is ever
+   created, that the table holds no more row views than it shows, and that
+   it keeps no more views for reuse than it shows either.  */
+#import "Testing.h"
+
+#import <Foundation/NSArray.h>
+#import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSGeometry.h>
+
+#import <AppKit/NSApplication.h>
+#import <AppKit/NSScrollView.h>
+#import <AppKit/NSTableColumn.h>
+#import <AppKit/NSTableRowView.h>
+#import <AppKit/NSTableView.h>
+#import <AppKit/NSWindow.h>
+
+#define ROWS 10000
+
+@interface NSTableView (Private)
+- (void) _registerPrototypeViews: (NSArray *)prototypeViews;
+@end
+
+@interface Source : NSObject
+{
+@public
+  NSUInteger created;
+}
+@end
+
+@implementation Source
+- (NSInteger) numberOfRowsInTableView: (NSTableView *)tv
+{
+  return ROWS;
+}
+- (NSView *) tableView: (NSTableView *)tv
+    viewForTableColumn: (NSTableColumn *)col
+                   row: (NSInteger)row
+{
+  NSView *v = [tv makeViewWithIdentifier: @"cell" owner: self];
+
+  if (v == nil)
+    {
+      v = AUTORELEASE([[NSView alloc] initWithFrame: NSMakeRect(0, 0, 10, 10)]);
+      [v setIdentifier: @"cell"];
+      created++;
+    }
+  return v;
+}
+@end
+
+static NSUInteger
+rowViewCount(NSTableView *tv)
+{
+  NSEnumerator *e = [[tv subviews] objectEnumerator];
+  NSView *v;
+  NSUInteger n = 0;
+
+  while ((v = [e nextObject]) != nil)
+    {
+      if ([v isKindOfClass: [NSTableRowView class]])
+        n++;
+    }
+  return n;
+}
+
+int
+main(int argc, const char **argv)
+{
+  START_SET("NSTableView viewReuse")
+
+  NS_DURING
+    [NSApplication sharedApplication];
+  NS_HANDLER
+    if ([[localException name] isEqualToString: NSInternalInconsistencyException])
+      SKIP("It looks like GNUstep backend is not yet installed")
+  NS_ENDHANDLER
+
+  NS_DURING
+    {
+      NSWindow *window;
+      NSScrollView *sv;
+      NSTableView *tv;
+      NSTableColumn *col;
+      Source *ds;
+      NSUInteger visible, kept;
+      NSInteger row;
+      NSRect r;
+
+      window = AUTORELEASE([[NSWindow alloc]
+        initWithContentRect: NSMakeRect(0, 0, 200, 200)
+                  styleMask: NSTitledWindowMask
+                    backing: NSBackingStoreBuffered
+                      defer: NO]);
+      sv = AUTORELEASE([[NSScrollView alloc]
+        initWithFrame: NSMakeRect(0, 0, 200, 200)]);
+      tv = AUTORELEASE([[NSTableView alloc]
+        initWithFrame: NSMakeRect(0, 0, 200, 200)]);
+      col = AUTORELEASE([[NSTableColumn alloc] initWithIdentifier: @"c"]);
+      ds = AUTORELEASE([[Source alloc] init]);
+      [tv addTableColumn: col];
+      [tv _registerPrototypeViews: [NSArray array]];
+      [tv setDataSource: ds];
+      [tv setDelegate: ds];
+      [sv setDocumentView: tv];
+      [[window contentView] addSubview: sv];
+      [tv reloadData];
+
+      r = [tv visibleRect];
+      visible = [tv rowsInRect: r].length;
+      for (row = 0; row < ROWS; row += visible / 2 + 1)
+        {
+          NSAutoreleasePool *arp = [NSAutoreleasePool new];
+
+          [tv scrollRowToVisible: row];
+          r = [tv visibleRect];
+          [tv lockFocus];
+          [tv drawRect: r];
+          [tv unlockFocus];
+          [arp release];
+        }
+
+      PASS(visible > 0, "some rows are visible");
+      PASS(ds->created <= 3 * visible,
+           "cell views are reused while scrolling");
+      PASS(rowViewCount(tv) <= visible + 1,
+           "row views out of sight are taken out of the table");
+
+      [tv reloadData];
+      PASS(rowViewCount(tv) == 0, "reloading takes out all row views");
+      [tv lockFocus];
+      [tv drawRect: [tv visibleRect]];
+      [tv unlockFocus];
+      PASS(ds->created <= 3 * visible,
+           "the views of a reloaded table are reused");
+
+      [sv setFrameSize: NSMakeSize(200, 60)];
+      [tv reloadData];
+      visible = [tv rowsInRect: [tv visibleRect]].length;
+      for (kept = 0; kept < ROWS
+        && [tv makeViewWithIdentifier: @"cell" owner: nil] != nil; kept++)
+        ;
+      PASS(kept <= visible + 1,
+           "no more views are kept for reuse than rows are in sight");
+    }
+  NS_HANDLER
+    {
+      if ([[localException name] isEqualToString: NSInternalInconsistencyException]
+        || [[localException name] isEqualToString: @"NSWindowServerCommunicationException"])
+        SKIP("No display available");
+    }
+  NS_ENDHANDLER
+
+  END_SET("NSTableView viewReuse")
+  return 0;
+}
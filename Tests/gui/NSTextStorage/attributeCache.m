@@ -0,0 +1,131 @@
+/* Text storages unique their attribute dictionaries in a table shared by
+   all threads.  Create text storages with equal attributes in several
+   threads at once and check that the table counts one lookup per text
+   storage, finds the dictionary uniqued by the first, and is empty of it
+   again once the text storages are gone.
+*/
+#include "Testing.h"
+
+#include <Foundation/NSArray.h>
+#include <Foundation/NSAutoreleasePool.h>
+#include <Foundation/NSDate.h>
+#include <Foundation/NSDictionary.h>
+#include <Foundation/NSLock.h>
+#include <Foundation/NSString.h>
+#include <Foundation/NSThread.h>
+#include <Foundation/NSValue.h>
+
+#include <AppKit/NSTextStorage.h>
+
+@interface NSObject (GSTextStorage)
++ (NSDictionary*) _attributeCacheStatistics;
++ (void) _resetAttributeCacheStatistics;
+@end
+
+#define THREADS 4
+#define STORAGES 1000
+
+static NSLock *doneLock = nil;
+static int done = 0;
+
+static int
+finished(void)
+{
+  int n;
+
+  [doneLock lock];
+  n = done;
+  [doneLock unlock];
+  return n;
+}
+
+@interface Worker : NSObject
+@end
+
+@implementation Worker
+- (void) build: (id)sender
+{
+  NSAutoreleasePool *arp = [NSAutoreleasePool new];
+  NSMutableArray *storages = [NSMutableArray array];
+  int i;
+
+  for (i = 0; i < STORAGES; i++)
+    {
+      NSDictionary *attrs = [NSDictionary dictionaryWithObjectsAndKeys:
+        @"GSTestValue", @"GSTestKey", nil];
+      NSTextStorage *ts = [[NSTextStorage alloc] initWithString: @"text"
+                                                     attributes: attrs];
+
+      [storages addObject: ts];
+      RELEASE(ts);
+    }
+  [arp release];
+  [doneLock lock];
+  done++;
+  [doneLock unlock];
+}
+@end
+
+static NSUInteger
+counter(Class c, NSString *key)
+{
+  return [[[c _attributeCacheStatistics] objectForKey: key]
+    unsignedIntegerValue];
+}
+
+int
+main(int argc, char **argv)
+{
+  NSAutoreleasePool *arp = [NSAutoreleasePool new];
+  NSTextStorage *probe;
+  Class c;
+  Worker *w = AUTORELEASE([[Worker alloc] init]);
+  NSUInteger count;
+  NSDate *limit;
+  int i;
+
+  START_SET("NSTextStorage attributeCache")
+
+  doneLock = [NSLock new];
+  probe = AUTORELEASE([[NSTextStorage alloc] init]);
+  c = [probe class];
+  PASS([c respondsToSelector: @selector(_attributeCacheStatistics)],
+       "the concrete text storage class has attribute cache counters");
+
+  /* Become multithreaded before counting. */
+  [NSThread detachNewThreadSelector: @selector(build:)
+                           toTarget: w
+                         withObject: nil];
+  limit = [NSDate dateWithTimeIntervalSinceNow: 30.0];
+  while (finished() < 1 && [limit timeIntervalSinceNow] > 0)
+    [NSThread sleepForTimeInterval: 0.01];
+
+  [c _resetAttributeCacheStatistics];
+  count = counter(c, @"Count");
+  [doneLock lock];
+  done = 0;
+  [doneLock unlock];
+  for (i = 0; i < THREADS; i++)
+    {
+      [NSThread detachNewThreadSelector: @selector(build:)
+                               toTarget: w
+                             withObject: nil];
+    }
+  limit = [NSDate dateWithTimeIntervalSinceNow: 30.0];
+  while (finished() < THREADS && [limit timeIntervalSinceNow] > 0)
+    [NSThread sleepForTimeInterval: 0.01];
+
+  PASS(finished() == THREADS, "all threads finished");
+  PASS(counter(c, @"Hits") + counter(c, @"Misses") == THREADS * STORAGES,
+       "every text storage looked its attributes up once");
+  PASS(counter(c, @"Hits") >= THREADS * STORAGES - THREADS,
+       "equal attributes are found in the table");
+  PASS(counter(c, @"Count") == count,
+       "the attributes are removed from the table with the text storages");
+  PASS([[c _attributeCacheStatistics] objectForKey: @"Contentions"] != nil,
+       "contention is counted");
+
+  END_SET("NSTextStorage attributeCache")
+  [arp release];
+  return 0;
+}
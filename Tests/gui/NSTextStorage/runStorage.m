@@ -0,0 +1,165 @@
+/* The attribute runs of a text storage are kept in a gap buffer.  Apply the
+   same random edits to a text storage and to a plain mutable attributed
+   string, which keeps its runs in an array, and check that they end up with
+   the same attributes, also after typing at the start of a text with many
+   runs.  Processing the edits fixes attributes (which needs the font
+   system), so these are guarded by the usual backend check.
+*/
+#include "Testing.h"
+
+#include <Foundation/NSAttributedString.h>
+#include <Foundation/NSAutoreleasePool.h>
+#include <Foundation/NSDictionary.h>
+#include <Foundation/NSRange.h>
+#include <Foundation/NSString.h>
+#include <Foundation/NSValue.h>
+
+#include <AppKit/NSApplication.h>
+#include <AppKit/NSFont.h>
+#include <AppKit/NSTextStorage.h>
+
+static unsigned seed = 1;
+
+static unsigned
+next(unsigned limit)
+{
+  seed = seed * 1103515245 + 12345;
+  return ((seed >> 8) & 0xffffff) % limit;
+}
+
+static NSDictionary *
+style(NSFont *font, unsigned i)
+{
+  return [NSDictionary dictionaryWithObjectsAndKeys:
+    font, NSFontAttributeName,
+    [NSNumber numberWithUnsignedInt: i % 7], @"GSTestRun", nil];
+}
+
+/* Build a text with a run of attributes every five characters.  */
+static void
+fill(NSMutableAttributedString *s, NSFont *font, unsigned runs)
+{
+  unsigned i;
+
+  [s replaceCharactersInRange: NSMakeRange(0, [s length])
+                   withString: [@"" stringByPaddingToLength: runs * 5
+                                                 withString: @"abcde"
+                                            startingAtIndex: 0]];
+  for (i = 0; i < runs; i++)
+    {
+      [s setAttributes: style(font, i) range: NSMakeRange(i * 5, 5)];
+    }
+}
+
+static void
+edit(NSMutableAttributedString *s, NSFont *font, unsigned op,
+  NSRange r, unsigned i)
+{
+  if (op == 0)
+    [s replaceCharactersInRange: NSMakeRange(r.location, 0)
+                     withString: @"xyz"];
+  else if (op == 1)
+    [s deleteCharactersInRange: r];
+  else if (r.length > 0)
+    [s setAttributes: style(font, i) range: r];
+}
+
+static BOOL
+sameRuns(NSAttributedString *a, NSAttributedString *b)
+{
+  NSUInteger length = [a length];
+  NSUInteger loc = 0;
+
+  if (![[a string] isEqualToString: [b string]])
+    return NO;
+  while (loc < length)
+    {
+      NSRange ra, rb;
+      NSDictionary *da = [a attributesAtIndex: loc
+                        longestEffectiveRange: &ra
+                                      inRange: NSMakeRange(0, length)];
+      NSDictionary *db = [b attributesAtIndex: loc
+                        longestEffectiveRange: &rb
+                                      inRange: NSMakeRange(0, length)];
+
+      if (!NSEqualRanges(ra, rb) || ![da isEqualToDictionary: db])
+        return NO;
+      loc = NSMaxRange(ra);
+    }
+  return YES;
+}
+
+static void
+typeAtStart(NSMutableAttributedString *s, unsigned count)
+{
+  unsigned i;
+
+  for (i = 0; i < count; i++)
+    {
+      [s replaceCharactersInRange: NSMakeRange(12, 0) withString: @"k"];
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+  START_SET("NSTextStorage runStorage")
+
+  NS_DURING
+    {
+      [NSApplication sharedApplication];
+    }
+  NS_HANDLER
+    {
+      if ([[localException name] isEqualToString: NSInternalInconsistencyException])
+        SKIP("It looks like GNUstep backend is not yet installed")
+    }
+  NS_ENDHANDLER
+
+  NS_DURING
+    {
+      NSFont *font = [NSFont userFontOfSize: 12.0];
+      NSTextStorage *ts = AUTORELEASE([[NSTextStorage alloc] init]);
+      NSMutableAttributedString *as;
+      unsigned i;
+
+      as = AUTORELEASE([[NSMutableAttributedString alloc] init]);
+      [ts beginEditing];
+      fill(ts, font, 2000);
+      fill(as, font, 2000);
+      for (i = 0; i < 5000; i++)
+        {
+          unsigned length = [as length];
+          unsigned op = next(3);
+          NSRange r;
+
+          if (length == 0)
+            break;
+          r.location = next(length);
+          r.length = next(length - r.location < 12 ? length - r.location : 12);
+          edit(ts, font, op, r, i);
+          edit(as, font, op, r, i);
+        }
+      [ts endEditing];
+      PASS(sameRuns(ts, as),
+           "random edits leave the same runs as in an attributed string");
+
+      [ts beginEditing];
+      fill(ts, font, 100000);
+      fill(as, font, 100000);
+      typeAtStart(ts, 5000);
+      typeAtStart(as, 5000);
+      [ts endEditing];
+      PASS(sameRuns(ts, as), "typing leaves the same runs");
+    }
+  NS_HANDLER
+    {
+      if ([[localException name] isEqualToString: NSInternalInconsistencyException]
+        || [[localException name] isEqualToString: @"NSWindowServerCommunicationException"])
+        SKIP("No display available");
+    }
+  NS_ENDHANDLER
+
+  END_SET("NSTextStorage runStorage")
+  return 0;
+}
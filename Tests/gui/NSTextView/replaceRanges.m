@@ -0,0 +1,222 @@
+/* Replacing the text in many ranges at once, as the find panel's Replace
+   All does, asks the delegate once, is undone as a single action and
+   gives the same text as replacing the ranges one by one.  Replace All with
+   a regular expression fills in the template for each match and changes
+   nothing when the expression is invalid.  The text view lays out through
+   the theme and font backend, so the set is skipped when the backend is
+   unavailable. */
+#include "Testing.h"
+
+#include <Foundation/NSArray.h>
+#include <Foundation/NSAutoreleasePool.h>
+#include <Foundation/NSGeometry.h>
+#include <Foundation/NSString.h>
+#include <Foundation/NSUndoManager.h>
+#include <Foundation/NSValue.h>
+
+#include <AppKit/NSApplication.h>
+#include <AppKit/NSTextView.h>
+#include <AppKit/NSWindow.h>
+
+#define COUNT 50000
+
+@interface NSTextView (GSTextFinder)
+- (void) _replaceCharactersInRanges: (NSArray *)ranges
+			withStrings: (NSArray *)strings;
+@end
+
+@interface NSObject (GSTextFinder)
++ (id) sharedTextFinder;
+- (void) setFindString: (NSString *)aString;
+- (void) setReplaceString: (NSString *)aString;
+- (void) setUsesRegularExpressions: (BOOL)flag;
+- (void) replaceAllInTextView: (NSTextView *)aTextView
+	      onlyInSelection: (BOOL)flag;
+@end
+
+@interface Delegate : NSObject
+{
+@public
+  NSUndoManager *undo;
+  int asked;
+  int askedOne;
+}
+@end
+
+@implementation Delegate
+- (id) init
+{
+  if ((self = [super init]) != nil)
+    {
+      undo = [[NSUndoManager alloc] init];
+      [undo setGroupsByEvent: NO];
+    }
+  return self;
+}
+- (void) dealloc
+{
+  RELEASE(undo);
+  [super dealloc];
+}
+- (NSUndoManager *) undoManagerForTextView: (NSTextView *)tv
+{
+  return undo;
+}
+- (BOOL) textView: (NSTextView *)tv
+shouldChangeTextInRanges: (NSArray *)ranges
+replacementStrings: (NSArray *)strings
+{
+  asked++;
+  return YES;
+}
+- (BOOL) textView: (NSTextView *)tv
+shouldChangeTextInRange: (NSRange)range
+replacementString: (NSString *)string
+{
+  askedOne++;
+  return YES;
+}
+@end
+
+/* Replace every "foo" in the text view with replacement in one change. */
+static NSUInteger
+replaceAll(NSTextView *tv, NSString *replacement)
+{
+  NSString *string = [tv string];
+  NSMutableArray *ranges = [NSMutableArray array];
+  NSMutableArray *strings = [NSMutableArray array];
+  NSRange r = [string rangeOfString: @"foo"];
+
+  while (r.location != NSNotFound)
+    {
+      [ranges addObject: [NSValue valueWithRange: r]];
+      [strings addObject: replacement];
+      r = [string rangeOfString: @"foo"
+                        options: 0
+                          range: NSMakeRange(NSMaxRange(r),
+                                   [string length] - NSMaxRange(r))];
+    }
+  if ([tv shouldChangeTextInRanges: ranges replacementStrings: strings])
+    {
+      [tv _replaceCharactersInRanges: ranges withStrings: strings];
+      [tv didChangeText];
+    }
+  return [ranges count];
+}
+
+int
+main(int argc, char **argv)
+{
+  START_SET("NSTextView replaceRanges")
+
+  NS_DURING
+    {
+      [NSApplication sharedApplication];
+    }
+  NS_HANDLER
+    {
+      if ([[localException name] isEqualToString: NSInternalInconsistencyException])
+        SKIP("It looks like GNUstep backend is not yet installed")
+    }
+  NS_ENDHANDLER
+
+  NS_DURING
+    {
+      Delegate *d = AUTORELEASE([[Delegate alloc] init]);
+      NSTextView *tv;
+      NSWindow *w;
+      NSMutableString *text;
+      NSString *original;
+      id finder;
+      NSUInteger n;
+      int i;
+
+      tv = AUTORELEASE([[NSTextView alloc]
+        initWithFrame: NSMakeRect(0, 0, 200, 100)]);
+      [tv setEditable: YES];
+      [tv setAllowsUndo: YES];
+      [tv setDelegate: d];
+      w = AUTORELEASE([[NSWindow alloc]
+        initWithContentRect: NSMakeRect(0, 0, 220, 120)
+                  styleMask: NSTitledWindowMask
+                    backing: NSBackingStoreBuffered
+                      defer: NO]);
+      [[w contentView] addSubview: tv];
+
+      [tv setString: @"a foo b foo foo c"];
+      [d->undo beginUndoGrouping];
+      n = replaceAll(tv, @"quux");
+      [d->undo endUndoGrouping];
+      PASS(n == 3 && [[tv string] isEqualToString: @"a quux b quux quux c"],
+           "every range is replaced");
+      PASS(d->asked == 1 && d->askedOne == 0,
+           "the delegate is asked once for all the ranges");
+      [d->undo undo];
+      PASS([[tv string] isEqualToString: @"a foo b foo foo c"],
+           "a single undo restores every range");
+      [d->undo redo];
+      PASS([[tv string] isEqualToString: @"a quux b quux quux c"],
+           "a single redo replaces them again");
+
+      text = [NSMutableString string];
+      for (i = 0; i < COUNT; i++)
+        {
+          [text appendString: @"some text with foo in it\n"];
+        }
+      [tv setString: text];
+      original = [[tv string] copy];
+      [d->undo removeAllActions];
+      [d->undo beginUndoGrouping];
+      n = replaceAll(tv, @"bar");
+      [d->undo endUndoGrouping];
+      [text replaceOccurrencesOfString: @"foo"
+                            withString: @"bar"
+                               options: 0
+                                 range: NSMakeRange(0, [text length])];
+      PASS(n == COUNT && [[tv string] isEqualToString: text],
+           "replacing many ranges gives the same text as one by one");
+      [d->undo undo];
+      PASS([[tv string] isEqualToString: original],
+           "undoing many replacements restores the text");
+      RELEASE(original);
+
+      finder = [NSClassFromString(@"GSTextFinder") sharedTextFinder];
+      [finder setUsesRegularExpressions: YES];
+      [finder setFindString: @"(\\w+)@(\\w+)"];
+      [finder setReplaceString: @"$2:$1"];
+      [tv setString: @"mail john@example or mary@test"];
+      d->asked = 0;
+      [d->undo beginUndoGrouping];
+      [finder replaceAllInTextView: tv onlyInSelection: NO];
+      [d->undo endUndoGrouping];
+      PASS([[tv string] isEqualToString: @"mail example:john or test:mary"],
+           "a regular expression replaces each match with its template");
+      PASS(d->asked == 1,
+           "the delegate is asked once for all the matches");
+
+      [finder setFindString: @"(foo"];
+      [tv setString: @"a foo b"];
+      d->asked = 0;
+      [d->undo beginUndoGrouping];
+      [finder replaceAllInTextView: tv onlyInSelection: NO];
+      [d->undo endUndoGrouping];
+      PASS([[tv string] isEqualToString: @"a foo b"] && d->asked == 0,
+           "an invalid regular expression changes nothing");
+      [finder setUsesRegularExpressions: NO];
+
+      [tv setDelegate: nil];
+    }
+  NS_HANDLER
+    {
+      if ([[localException name] isEqualToString: NSInternalInconsistencyException]
+        || [[localException name] isEqualToString: @"NSWindowServerCommunicationException"])
+        SKIP("No display available")
+      else
+        [localException raise];
+    }
+  NS_ENDHANDLER
+
+  END_SET("NSTextView replaceRanges")
+
+  return 0;
+}
@@ -0,0 +1,249 @@
+/* Continuous spell checking hands the text to the spell checker in chunks
+   checked on a background thread.  Check a long text against a spell
+   server reached through its own connection, as the spell checker tool
+   is, and make sure every misspelled word is marked whole, including the
+   ones at the edges of chunks, and that text changed while it was being
+   checked is checked again.  The spell checker loads its panel and the
+   text view lays out through the backend, so the set is skipped when the
+   backend is unavailable. */
+#include "Testing.h"
+
+#include <Foundation/NSArray.h>
+#include <Foundation/NSAutoreleasePool.h>
+#include <Foundation/NSConnection.h>
+#include <Foundation/NSDate.h>
+#include <Foundation/NSGeometry.h>
+#include <Foundation/NSLock.h>
+#include <Foundation/NSProcessInfo.h>
+#include <Foundation/NSRunLoop.h>
+#include <Foundation/NSSpellServer.h>
+#include <Foundation/NSString.h>
+#include <Foundation/NSThread.h>
+#include <Foundation/NSValue.h>
+
+#include <AppKit/NSApplication.h>
+#include <AppKit/NSLayoutManager.h>
+#include <AppKit/NSSpellChecker.h>
+#include <AppKit/NSTextView.h>
+#include <AppKit/NSWindow.h>
+
+#define COUNT 2000
+
+extern NSString *GSSpellServerName(NSString *vendor, NSString *language);
+
+@interface NSTextView (TextChecking)
+- (void) _checkTextInRange: (NSRange)aRange;
+@end
+
+@interface NSSpellChecker (GSSpellServer)
+- (void) _setServerProxy: (id)proxy;
+@end
+
+/* Set to 1 once the spell server is registered, or to 2 if it can't be. */
+static NSConditionLock *ready = nil;
+
+/* Flags "teh" and "recieve" and nothing else. */
+@interface Speller : NSObject
+@end
+
+@implementation Speller
+/* Serves language in a thread of its own, as a spell checker tool would
+ * in a process of its own.
+ */
++ (void) serve: (NSString *)language
+{
+  NSAutoreleasePool *arp = [NSAutoreleasePool new];
+  NSSpellServer *server = [[NSSpellServer alloc] init];
+  Speller *speller = [[Speller alloc] init];
+  BOOL ok;
+
+  [server setDelegate: speller];
+  ok = [server registerLanguage: language byVendor: @"Test"];
+  [ready lock];
+  [ready unlockWithCondition: ok ? 1 : 2];
+  if (ok)
+    {
+      [server run];
+    }
+  RELEASE(server);
+  RELEASE(speller);
+  [arp release];
+}
+- (NSRange) spellServer: (NSSpellServer *)sender
+findMisspelledWordInString: (NSString *)stringToCheck
+               language: (NSString *)language
+              wordCount: (int *)wordCount
+              countOnly: (BOOL)countOnly
+{
+  NSRange a = [stringToCheck rangeOfString: @"teh"];
+  NSRange b = [stringToCheck rangeOfString: @"recieve"];
+
+  if (a.location == NSNotFound)
+    return b;
+  if (b.location == NSNotFound || a.location < b.location)
+    return a;
+  return b;
+}
+@end
+
+/* Count the characters marked as misspelled in text, and the marks which
+ * do not cover a whole misspelled word.
+ */
+static NSUInteger
+countMarks(NSTextView *tv, NSUInteger *bad)
+{
+  NSLayoutManager *lm = [tv layoutManager];
+  NSString *string = [tv string];
+  NSUInteger length = [string length];
+  NSUInteger i = 0;
+  NSUInteger n = 0;
+
+  *bad = 0;
+  while (i < length)
+    {
+      NSRange r;
+      id value = [lm temporaryAttribute: NSSpellingStateAttributeName
+                       atCharacterIndex: i
+                  longestEffectiveRange: &r
+                                inRange: NSMakeRange(i, length - i)];
+
+      if (value != nil)
+        {
+          NSString *word = [string substringWithRange: r];
+
+          n++;
+          if (![word isEqualToString: @"teh"]
+            && ![word isEqualToString: @"recieve"])
+            {
+              (*bad)++;
+            }
+        }
+      i = NSMaxRange(r);
+    }
+  return n;
+}
+
+/* Run the run loop until count words are marked or ten seconds pass. */
+static NSUInteger
+waitForMarks(NSTextView *tv, NSUInteger count, NSUInteger *bad)
+{
+  NSDate *limit = [NSDate dateWithTimeIntervalSinceNow: 10.0];
+  NSUInteger n;
+
+  while ((n = countMarks(tv, bad)) < count
+    && [limit timeIntervalSinceNow] > 0)
+    {
+      [[NSRunLoop currentRunLoop]
+        runMode: NSDefaultRunLoopMode
+        beforeDate: [NSDate dateWithTimeIntervalSinceNow: 0.01]];
+    }
+  return n;
+}
+
+int
+main(int argc, char **argv)
+{
+  START_SET("NSTextView spellChecking")
+
+  NS_DURING
+    {
+      [NSApplication sharedApplication];
+    }
+  NS_HANDLER
+    {
+      if ([[localException name] isEqualToString: NSInternalInconsistencyException])
+        SKIP("It looks like GNUstep backend is not yet installed")
+    }
+  NS_ENDHANDLER
+
+  NS_DURING
+    {
+      NSSpellChecker *sp = [NSSpellChecker sharedSpellChecker];
+      NSString *language;
+      NSMutableString *text;
+      NSTextView *tv;
+      NSWindow *w;
+      NSDate *limit;
+      id proxy = nil;
+      NSUInteger n;
+      NSUInteger bad;
+      int i;
+
+      language = [NSString stringWithFormat: @"Test%d",
+        [[NSProcessInfo processInfo] processIdentifier]];
+      ready = [[NSConditionLock alloc] initWithCondition: 0];
+      [NSThread detachNewThreadSelector: @selector(serve:)
+                               toTarget: [Speller class]
+                             withObject: language];
+      limit = [NSDate dateWithTimeIntervalSinceNow: 10.0];
+      while ([ready condition] == 0 && [limit timeIntervalSinceNow] > 0)
+        {
+          [NSThread sleepForTimeInterval: 0.01];
+        }
+      if ([ready condition] == 1)
+        {
+          proxy = [NSConnection
+            rootProxyForConnectionWithRegisteredName:
+              GSSpellServerName(@"Test", language)
+                                                host: nil];
+        }
+      if (proxy == nil)
+        SKIP("the spell server cannot be registered")
+      [sp _setServerProxy: proxy];
+
+      tv = AUTORELEASE([[NSTextView alloc]
+        initWithFrame: NSMakeRect(0, 0, 200, 100)]);
+      w = AUTORELEASE([[NSWindow alloc]
+        initWithContentRect: NSMakeRect(0, 0, 220, 120)
+                  styleMask: NSTitledWindowMask
+                    backing: NSBackingStoreBuffered
+                      defer: NO]);
+      [[w contentView] addSubview: tv];
+      [tv setContinuousSpellCheckingEnabled: YES];
+
+      /* Words of irregular lengths, so that chunk edges fall anywhere. */
+      text = [NSMutableString string];
+      for (i = 0; i < COUNT; i++)
+        {
+          [text appendFormat: @"we %@ recieve it%d\n",
+            (i % 3) ? @"do" : @"teh", i];
+        }
+      [tv setString: text];
+
+      [tv _checkTextInRange: NSMakeRange(0, [text length])];
+      n = waitForMarks(tv, COUNT + (COUNT + 2) / 3, &bad);
+      PASS(n == COUNT + (COUNT + 2) / 3,
+           "every misspelled word is marked");
+      PASS(bad == 0, "no mark covers part of a word or a correct word");
+
+      /* Check part of a short text starting in the middle of a word. */
+      [tv setString: @"recieve teh words"];
+      [tv _checkTextInRange: NSMakeRange(3, 6)];
+      n = waitForMarks(tv, 2, &bad);
+      PASS(n == 2 && bad == 0,
+           "checking from inside a word marks the whole word");
+
+      /* Change the text before the result arrives. */
+      [tv setString: @"good words here"];
+      [tv _checkTextInRange: NSMakeRange(0, 15)];
+      [tv replaceCharactersInRange: NSMakeRange(0, 4) withString: @"teh "];
+      n = waitForMarks(tv, 1, &bad);
+      PASS(n == 1 && bad == 0,
+           "text changed while it is checked is checked again");
+
+      [tv setContinuousSpellCheckingEnabled: NO];
+    }
+  NS_HANDLER
+    {
+      if ([[localException name] isEqualToString: NSInternalInconsistencyException]
+        || [[localException name] isEqualToString: @"NSWindowServerCommunicationException"])
+        SKIP("No display available")
+      else
+        [localException raise];
+    }
+  NS_ENDHANDLER
+
+  END_SET("NSTextView spellChecking")
+
+  return 0;
+}
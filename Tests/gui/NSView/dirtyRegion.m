@@ -0,0 +1,137 @@
+/* A view keeps the area needing display as a list of rects.  Marking two
+   small areas at opposite corners of a large view should draw just those
+   two areas, not the rect enclosing them, also over many frames of
+   scattered updates.  An opaque subview under those areas still draws
+   the areas it marked itself.  */
+#import "Testing.h"
+
+#import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSGeometry.h>
+
+#import <AppKit/NSApplication.h>
+#import <AppKit/NSView.h>
+#import <AppKit/NSWindow.h>
+
+@interface Recorder : NSView
+{
+@public
+  NSInteger count;
+  CGFloat area;
+  BOOL center;
+  BOOL corner;
+}
+@end
+
+@implementation Recorder
+- (BOOL) isOpaque
+{
+  return YES;
+}
+- (void) drawRect: (NSRect)r
+{
+  const NSRect *rects;
+  NSInteger n;
+  NSInteger i;
+
+  [self getRectsBeingDrawn: &rects count: &n];
+  count += n;
+  for (i = 0; i < n; i++)
+    {
+      area += NSWidth(rects[i]) * NSHeight(rects[i]);
+    }
+  if ([self needsToDrawRect: NSMakeRect(1000, 1000, 10, 10)])
+    center = YES;
+  if ([self needsToDrawRect: NSMakeRect(2, 2, 4, 4)])
+    corner = YES;
+}
+@end
+
+int
+main(int argc, const char **argv)
+{
+  START_SET("NSView dirtyRegion")
+
+  NS_DURING
+    [NSApplication sharedApplication];
+  NS_HANDLER
+    if ([[localException name] isEqualToString: NSInternalInconsistencyException])
+      SKIP("It looks like GNUstep backend is not yet installed")
+  NS_ENDHANDLER
+
+  NS_DURING
+    {
+      NSWindow *window;
+      Recorder *v;
+      Recorder *sub;
+      CGFloat enclosing = 0;
+      int i;
+
+      window = AUTORELEASE([[NSWindow alloc]
+        initWithContentRect: NSMakeRect(0, 0, 2000, 2000)
+                  styleMask: NSWindowStyleMaskBorderless
+                    backing: NSBackingStoreBuffered
+                      defer: NO]);
+      v = AUTORELEASE([[Recorder alloc]
+        initWithFrame: NSMakeRect(0, 0, 2000, 2000)]);
+      [window setContentView: v];
+      [v display];
+
+      v->count = 0;
+      v->area = 0;
+      v->center = NO;
+      v->corner = NO;
+      [v setNeedsDisplayInRect: NSMakeRect(0, 0, 10, 10)];
+      [v setNeedsDisplayInRect: NSMakeRect(1990, 1990, 10, 10)];
+      [v displayIfNeeded];
+      PASS(v->count == 2, "two separate areas are drawn as two rects");
+      PASS(v->area == 200.0, "only the marked areas are drawn");
+      PASS(v->center == NO && v->corner == YES,
+           "needsToDrawRect: is only true inside the rects being drawn");
+      PASS([v needsDisplay] == NO, "nothing is left to display");
+
+      [v setNeedsDisplayInRect: NSMakeRect(0, 0, 10, 10)];
+      [v setNeedsDisplayInRect: NSMakeRect(5, 5, 10, 10)];
+      v->count = 0;
+      v->area = 0;
+      [v displayIfNeeded];
+      PASS(v->count == 1 && v->area == 225.0,
+           "overlapping areas are merged");
+
+      v->area = 0;
+      for (i = 0; i < 1000; i++)
+        {
+          NSRect a = NSMakeRect((i * 37) % 1980, (i * 53) % 1980, 20, 20);
+          NSRect b = NSMakeRect((i * 71) % 1980, (i * 13) % 1980, 20, 20);
+          NSRect u = NSUnionRect(a, b);
+
+          enclosing += NSWidth(u) * NSHeight(u);
+          [v setNeedsDisplayInRect: a];
+          [v setNeedsDisplayInRect: b];
+          [v displayIfNeeded];
+        }
+      PASS(v->area <= 1000 * 800.0 && v->area < enclosing,
+           "scattered updates draw only the marked areas");
+
+      sub = AUTORELEASE([[Recorder alloc]
+        initWithFrame: NSMakeRect(400, 400, 1200, 1200)]);
+      [v addSubview: sub];
+      [v display];
+      sub->center = NO;
+      [sub setNeedsDisplayInRect: NSMakeRect(1000, 1000, 10, 10)];
+      [v setNeedsDisplayInRect: NSMakeRect(0, 0, 500, 500)];
+      [v setNeedsDisplayInRect: NSMakeRect(1500, 1500, 500, 500)];
+      [v displayIfNeeded];
+      PASS(sub->center && [sub needsDisplay] == NO,
+           "a subview draws its own marks between the areas drawn over it");
+    }
+  NS_HANDLER
+    {
+      if ([[localException name] isEqualToString: NSInternalInconsistencyException]
+        || [[localException name] isEqualToString: @"NSWindowServerCommunicationException"])
+        SKIP("No display available");
+    }
+  NS_ENDHANDLER
+
+  END_SET("NSView dirtyRegion")
+  return 0;
+}
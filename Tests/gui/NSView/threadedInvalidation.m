@@ -0,0 +1,220 @@
+/* Rects marked as needing display from another thread are collected and
+   marked in the main thread in one go.  Mark many rects from a thread and
+   check that the view needs to display all of them once the run loop has
+   run, and that marking the whole view from a thread draws its bounds.
+   Mark many views from a thread while the main thread drains the marks,
+   and check that a mark made afterwards is still drained.  */
+#import "Testing.h"
+
+#import <Foundation/NSArray.h>
+#import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSDate.h>
+#import <Foundation/NSGeometry.h>
+#import <Foundation/NSLock.h>
+#import <Foundation/NSRunLoop.h>
+#import <Foundation/NSThread.h>
+
+#import <AppKit/NSApplication.h>
+#import <AppKit/NSView.h>
+#import <AppKit/NSWindow.h>
+
+#define MARKS 100000
+#define VIEWS 50
+
+static NSLock *doneLock = nil;
+static BOOL done = NO;
+
+@interface NSView (GSPendingDisplay)
++ (void) _displayPendingViews;
+@end
+
+@interface Plot : NSView
+{
+@public
+  NSRect drawn;
+}
+@end
+
+@implementation Plot
+- (BOOL) isOpaque
+{
+  return YES;
+}
+- (void) drawRect: (NSRect)r
+{
+  drawn = NSUnionRect(drawn, r);
+}
+- (void) acquire: (id)sender
+{
+  NSAutoreleasePool *arp = [NSAutoreleasePool new];
+  int i;
+
+  for (i = 0; i < MARKS; i++)
+    {
+      [self setNeedsDisplayInRect: NSMakeRect(i % 100, 10, 1, 1)];
+    }
+  [doneLock lock];
+  done = YES;
+  [doneLock unlock];
+  [arp release];
+}
+- (void) spray: (id)sender
+{
+  NSAutoreleasePool *arp = [NSAutoreleasePool new];
+  NSArray *views = [self subviews];
+  int i;
+
+  for (i = 0; i < MARKS; i++)
+    {
+      [[views objectAtIndex: i % VIEWS]
+        setNeedsDisplayInRect: NSMakeRect(0, 0, 1, 1)];
+    }
+  [doneLock lock];
+  done = YES;
+  [doneLock unlock];
+  [arp release];
+}
+- (void) invalidate: (id)sender
+{
+  NSAutoreleasePool *arp = [NSAutoreleasePool new];
+
+  [self setNeedsDisplay: YES];
+  [doneLock lock];
+  done = YES;
+  [doneLock unlock];
+  [arp release];
+}
+@end
+
+static BOOL
+finished(void)
+{
+  BOOL b;
+
+  [doneLock lock];
+  b = done;
+  [doneLock unlock];
+  return b;
+}
+
+int
+main(int argc, const char **argv)
+{
+  START_SET("NSView threadedInvalidation")
+
+  NS_DURING
+    [NSApplication sharedApplication];
+  NS_HANDLER
+    if ([[localException name] isEqualToString: NSInternalInconsistencyException])
+      SKIP("It looks like GNUstep backend is not yet installed")
+  NS_ENDHANDLER
+
+  NS_DURING
+    {
+      NSWindow *window;
+      Plot *v;
+      NSDate *limit;
+      int i;
+
+      doneLock = [NSLock new];
+      window = AUTORELEASE([[NSWindow alloc]
+        initWithContentRect: NSMakeRect(0, 0, 200, 200)
+                  styleMask: NSWindowStyleMaskBorderless
+                    backing: NSBackingStoreBuffered
+                      defer: NO]);
+      v = AUTORELEASE([[Plot alloc]
+        initWithFrame: NSMakeRect(0, 0, 200, 200)]);
+      [window setContentView: v];
+      [v display];
+
+      for (i = 0; i < MARKS; i++)
+        {
+          [v setNeedsDisplayInRect: NSMakeRect(i % 100, 50, 1, 1)];
+        }
+      PASS([v needsDisplay], "marking in the main thread is immediate");
+      [v displayIfNeeded];
+
+      v->drawn = NSZeroRect;
+      [NSThread detachNewThreadSelector: @selector(acquire:)
+                               toTarget: v
+                             withObject: nil];
+      limit = [NSDate dateWithTimeIntervalSinceNow: 30.0];
+      while (finished() == NO && [limit timeIntervalSinceNow] > 0)
+        {
+          [NSThread sleepForTimeInterval: 0.01];
+        }
+      PASS(finished(), "the thread finished");
+
+      [[NSRunLoop currentRunLoop] runUntilDate:
+        [NSDate dateWithTimeIntervalSinceNow: 0.1]];
+      [v displayIfNeeded];
+      PASS(NSContainsRect(v->drawn, NSMakeRect(0, 10, 100, 1)),
+           "all rects marked in the thread are drawn");
+      PASS([v needsDisplay] == NO, "nothing is left to display");
+
+      v->drawn = NSZeroRect;
+      [doneLock lock];
+      done = NO;
+      [doneLock unlock];
+      [NSThread detachNewThreadSelector: @selector(invalidate:)
+                               toTarget: v
+                             withObject: nil];
+      limit = [NSDate dateWithTimeIntervalSinceNow: 30.0];
+      while (finished() == NO && [limit timeIntervalSinceNow] > 0)
+        {
+          [NSThread sleepForTimeInterval: 0.01];
+        }
+      [[NSRunLoop currentRunLoop] runUntilDate:
+        [NSDate dateWithTimeIntervalSinceNow: 0.1]];
+      [v displayIfNeeded];
+      PASS(NSEqualRects(v->drawn, [v bounds]),
+           "marking the whole view in a thread draws its bounds");
+
+      for (i = 0; i < VIEWS; i++)
+        {
+          [v addSubview: AUTORELEASE([[Plot alloc]
+            initWithFrame: NSMakeRect(i * 2, 100, 2, 2)])];
+        }
+      [doneLock lock];
+      done = NO;
+      [doneLock unlock];
+      [NSThread detachNewThreadSelector: @selector(spray:)
+                               toTarget: v
+                             withObject: nil];
+      limit = [NSDate dateWithTimeIntervalSinceNow: 30.0];
+      while (finished() == NO && [limit timeIntervalSinceNow] > 0)
+        {
+          [NSView _displayPendingViews];
+        }
+      [[NSRunLoop currentRunLoop] runUntilDate:
+        [NSDate dateWithTimeIntervalSinceNow: 0.1]];
+      [v displayIfNeeded];
+      PASS([v needsDisplay] == NO, "marks made during drains are drained");
+
+      [doneLock lock];
+      done = NO;
+      [doneLock unlock];
+      [NSThread detachNewThreadSelector: @selector(invalidate:)
+                               toTarget: v
+                             withObject: nil];
+      limit = [NSDate dateWithTimeIntervalSinceNow: 30.0];
+      while (finished() == NO && [limit timeIntervalSinceNow] > 0)
+        {
+          [NSThread sleepForTimeInterval: 0.01];
+        }
+      [[NSRunLoop currentRunLoop] runUntilDate:
+        [NSDate dateWithTimeIntervalSinceNow: 0.1]];
+      PASS([v needsDisplay],
+           "a mark made after drains raced with marks is still drained");
+    }
+  NS_HANDLER
+    {
+      if ([[localException name] isEqualToString: NSInternalInconsistencyException]
+        || [[localException name] isEqualToString: @"NSWindowServerCommunicationException"])
+        SKIP("No display available");
+    }
+  NS_ENDHANDLER
+
+  END_SET("NSView threadedInvalidation")
+  return 0;
+}
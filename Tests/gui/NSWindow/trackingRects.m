@@ -0,0 +1,134 @@
+/* A window finds the tracking rectangles near the mouse in a grid instead
+   of visiting every view.  Move the mouse across a grid of views with a
+   tracking rectangle each and check that each move enters and exits just
+   the right rectangles, also after the views have moved.  */
+#import "Testing.h"
+
+#import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSGeometry.h>
+
+#import <AppKit/NSApplication.h>
+#import <AppKit/NSEvent.h>
+#import <AppKit/NSView.h>
+#import <AppKit/NSWindow.h>
+
+#define SIDE 50
+#define CELL 20.0
+
+@interface Owner : NSObject
+{
+@public
+  NSInteger entered;
+  NSInteger exited;
+}
+@end
+
+@implementation Owner
+- (void) mouseEntered: (NSEvent *)e
+{
+  entered++;
+}
+- (void) mouseExited: (NSEvent *)e
+{
+  exited++;
+}
+@end
+
+static void
+moveTo(NSWindow *window, CGFloat x, CGFloat y)
+{
+  NSEvent *e = [NSEvent mouseEventWithType: NSMouseMoved
+                                  location: NSMakePoint(x, y)
+                             modifierFlags: 0
+                                 timestamp: 0
+                              windowNumber: [window windowNumber]
+                                   context: nil
+                               eventNumber: 0
+                                clickCount: 0
+                                  pressure: 0];
+  [window sendEvent: e];
+}
+
+int
+main(int argc, const char **argv)
+{
+  START_SET("NSWindow trackingRects")
+
+  NS_DURING
+    [NSApplication sharedApplication];
+  NS_HANDLER
+    if ([[localException name] isEqualToString: NSInternalInconsistencyException])
+      SKIP("It looks like GNUstep backend is not yet installed")
+  NS_ENDHANDLER
+
+  NS_DURING
+    {
+      NSWindow *window;
+      NSView *content;
+      NSView *first = nil;
+      Owner *owner = AUTORELEASE([[Owner alloc] init]);
+      int i;
+      int j;
+
+      window = AUTORELEASE([[NSWindow alloc]
+        initWithContentRect: NSMakeRect(0, 0, SIDE * CELL, SIDE * CELL)
+                  styleMask: NSWindowStyleMaskBorderless
+                    backing: NSBackingStoreBuffered
+                      defer: NO]);
+      content = [window contentView];
+      for (i = 0; i < SIDE; i++)
+        {
+          for (j = 0; j < SIDE; j++)
+            {
+              NSView *v = AUTORELEASE([[NSView alloc]
+                initWithFrame: NSMakeRect(j * CELL, i * CELL, CELL, CELL)]);
+
+              [content addSubview: v];
+              [v addTrackingRect: NSMakeRect(2, 2, CELL - 4, CELL - 4)
+                           owner: owner
+                        userData: NULL
+                    assumeInside: NO];
+              if (first == nil)
+                first = v;
+            }
+        }
+      [window orderFront: nil];
+
+      moveTo(window, 1, 1);
+      moveTo(window, CELL / 2, CELL / 2);
+      PASS(owner->entered == 1 && owner->exited == 0,
+           "moving into a rect enters it");
+      moveTo(window, CELL + CELL / 2, CELL / 2);
+      PASS(owner->entered == 2 && owner->exited == 1,
+           "moving to the next rect exits one and enters the other");
+      moveTo(window, CELL + 1, CELL / 2);
+      PASS(owner->entered == 2 && owner->exited == 2,
+           "moving into the gap between rects exits the rect");
+
+      [first setFrameOrigin: NSMakePoint(CELL, 0)];
+      moveTo(window, CELL + CELL / 2, CELL / 2);
+      PASS(owner->entered == 4,
+           "a rect is found where its view has moved to");
+      moveTo(window, CELL / 2, CELL / 2);
+      PASS(owner->entered == 4 && owner->exited == 4,
+           "a rect is not found where its view was");
+
+      for (i = 0; i < 10000; i++)
+        {
+          moveTo(window, (i * 7) % (int)(SIDE * CELL),
+            (i * 13) % (int)(SIDE * CELL));
+        }
+      PASS(owner->entered - owner->exited <= 1,
+           "every rect entered is exited again");
+    }
+  NS_HANDLER
+    {
+      if ([[localException name] isEqualToString: NSInternalInconsistencyException]
+        || [[localException name] isEqualToString: @"NSWindowServerCommunicationException"])
+        SKIP("No display available");
+    }
+  NS_ENDHANDLER
+
+  END_SET("NSWindow trackingRects")
+  return 0;
+}